@@ -24,6 +24,7 @@
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "ocpdiag/core/compat/status_macros.h"
 #include "ocpdiag/core/hwinterface/backends/lib/utils.h"
 #include "ocpdiag/core/hwinterface/cpu.pb.h"
@@ -43,14 +44,15 @@ bool SimpleHexAtoi(absl::string_view hex, uint64_t& num) {
 
 namespace internal {
 
-// Parses the content of file `path` into an range list.
+// Parses `content`, the content of file `path`, into an range list.
 // Example:
-//     ParseRangeListFile("1,3-5,7,9-10") return {1,3,4,5,7,9,10}
-absl::StatusOr<std::vector<int>> ParseRangeListFile(
-    HostAdapter& host, const std::filesystem::path& path) {
-  ASSIGN_OR_RETURN(std::string list_range, host.Read(path));
+//     ParseRangeListContent("1,3-5,7,9-10") return {1,3,4,5,7,9,10}
+absl::StatusOr<std::vector<int>> ParseRangeListContent(
+    const absl::StatusOr<std::string>& content,
+    const std::filesystem::path& path) {
+  RETURN_IF_ERROR(content.status());
 
-  absl::StatusOr<std::vector<int>> nums = ParseRangeList(list_range);
+  absl::StatusOr<std::vector<int>> nums = ParseRangeList(*content);
   if (!nums.ok()) {
     return absl::InternalError(absl::StrCat(
         "File parsed failed: ", path.string(), " : ", nums.status().message()));
@@ -58,12 +60,13 @@ absl::StatusOr<std::vector<int>> ParseRangeListFile(
   return nums;
 }
 
-// Parses the content of file `path` into an integer.
-absl::StatusOr<int> ParseIntegerFile(HostAdapter& host,
-                                     const std::filesystem::path& path) {
+// Parses `content`, the content of file `path`, into an integer.
+absl::StatusOr<int> ParseIntegerContent(
+    const absl::StatusOr<std::string>& content,
+    const std::filesystem::path& path) {
+  RETURN_IF_ERROR(content.status());
   int result = 0;
-  ASSIGN_OR_RETURN(std::string integer_str, host.Read(path));
-  if (!absl::SimpleAtoi(integer_str, &result)) {
+  if (!absl::SimpleAtoi(*content, &result)) {
     return absl::InternalError(
         absl::StrCat("File parsed failed: ", path.string()));
   }
@@ -71,27 +74,79 @@ absl::StatusOr<int> ParseIntegerFile(HostAdapter& host,
   return result;
 }
 
+// Reads `paths` in one batch and checks that the adapter returned one result
+// per path.
+absl::StatusOr<std::vector<absl::StatusOr<std::string>>> ReadFiles(
+    HostAdapter& host, absl::Span<const std::filesystem::path> paths) {
+  ASSIGN_OR_RETURN(std::vector<absl::StatusOr<std::string>> files,
+                   host.ReadMany(paths));
+  if (files.size() != paths.size()) {
+    return absl::InternalError(absl::StrCat("Read ", files.size(),
+                                            " files, expected ", paths.size()));
+  }
+  return files;
+}
+
+// Like ReadFiles(), for attributes that change while the machine is up.
+absl::StatusOr<std::vector<absl::StatusOr<std::string>>> SampleFiles(
+    HostAdapter& host, absl::Span<const std::filesystem::path> paths) {
+  ASSIGN_OR_RETURN(std::vector<absl::StatusOr<std::string>> files,
+                   host.Sample(paths));
+  if (files.size() != paths.size()) {
+    return absl::InternalError(absl::StrCat("Sampled ", files.size(),
+                                            " files, expected ", paths.size()));
+  }
+  return files;
+}
+
+std::filesystem::path SysfsCpuPath(int cpu_id) {
+  return absl::StrFormat("/sys/devices/system/cpu/cpu%d", cpu_id);
+}
+
+constexpr absl::string_view kNodeOnlinePath = "/sys/devices/system/node/online";
+
+// The wildcards matching every file that CpuTopology::Gather() reads.
+std::vector<std::string> TopologyFilePatterns() {
+  std::vector<std::string> patterns = {
+      std::string(kNodeOnlinePath),
+      "/sys/devices/system/node/node*/cpulist"};
+  for (const std::filesystem::path& path : CpuLpu(0, 0).TopologyFilePaths()) {
+    patterns.push_back(
+        absl::StrCat("/sys/devices/system/cpu/cpu[0-9]*/",
+                     path.lexically_relative(SysfsCpuPath(0)).string()));
+  }
+  return patterns;
+}
+
 void CpuLpu::NormalizeCpuLpu(absl::flat_hash_map<int, int>& socket_ids_map,
                              absl::flat_hash_map<int, int>& core_ids_map) {
   socket_id_ = socket_ids_map[socket_id_];
   core_id_ = core_ids_map[core_id_];
 }
 
-absl::Status CpuLpu::DoRealGather(HostAdapter& host) {
-  std::filesystem::path sysfs_cpu_path(
-      absl::StrFormat("/sys/devices/system/cpu/cpu%d", cpu_id_));
+std::vector<std::filesystem::path> CpuLpu::TopologyFilePaths() const {
+  std::filesystem::path sysfs_cpu_path = SysfsCpuPath(cpu_id_);
+  return {sysfs_cpu_path / "topology/physical_package_id",
+          sysfs_cpu_path / "topology/die_id",
+          sysfs_cpu_path / "topology/core_id",
+          sysfs_cpu_path / "topology/thread_siblings_list"};
+}
 
-  ASSIGN_OR_RETURN(
-      socket_id_,
-      ParseIntegerFile(host, sysfs_cpu_path / "topology/physical_package_id"));
-  ASSIGN_OR_RETURN(die_id_,
-                   ParseIntegerFile(host, sysfs_cpu_path / "topology/die_id"));
-  ASSIGN_OR_RETURN(core_id_,
-                   ParseIntegerFile(host, sysfs_cpu_path / "topology/core_id"));
+absl::Status CpuLpu::ParseTopologyFiles(
+    absl::Span<const absl::StatusOr<std::string>> files) {
+  std::vector<std::filesystem::path> paths = TopologyFilePaths();
+  if (files.size() != paths.size()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Expected ", paths.size(), " topology files for cpu ",
+                     cpu_id_, ", got ", files.size()));
+  }
+
+  ASSIGN_OR_RETURN(socket_id_, ParseIntegerContent(files[0], paths[0]));
+  ASSIGN_OR_RETURN(die_id_, ParseIntegerContent(files[1], paths[1]));
+  ASSIGN_OR_RETURN(core_id_, ParseIntegerContent(files[2], paths[2]));
 
   ASSIGN_OR_RETURN(std::vector<int> thread_siblings,
-                   ParseRangeListFile(
-                       host, sysfs_cpu_path / "topology/thread_siblings_list"));
+                   ParseRangeListContent(files[3], paths[3]));
   auto it = std::find(thread_siblings.begin(), thread_siblings.end(), cpu_id_);
   if (it == thread_siblings.end()) {
     return absl::InternalError(
@@ -102,6 +157,12 @@ absl::Status CpuLpu::DoRealGather(HostAdapter& host) {
   return absl::OkStatus();
 }
 
+absl::Status CpuLpu::DoRealGather(HostAdapter& host) {
+  ASSIGN_OR_RETURN(std::vector<absl::StatusOr<std::string>> files,
+                   ReadFiles(host, TopologyFilePaths()));
+  return ParseTopologyFiles(files);
+}
+
 absl::Status CpuLpu::Gather(HostAdapter& host) {
   if (result_.has_value()) {
     return result_.value();
@@ -110,6 +171,15 @@ absl::Status CpuLpu::Gather(HostAdapter& host) {
   return result_.value();
 }
 
+absl::Status CpuLpu::GatherFromFiles(
+    absl::Span<const absl::StatusOr<std::string>> files) {
+  if (result_.has_value()) {
+    return result_.value();
+  }
+  result_ = ParseTopologyFiles(files);
+  return result_.value();
+}
+
 void CpuNumaNode::NormalizeNumaNode(
     absl::flat_hash_map<int, int>& socket_ids_map,
     absl::flat_hash_map<int, int>& core_ids_map) {
@@ -118,16 +188,36 @@ void CpuNumaNode::NormalizeNumaNode(
   }
 }
 
-absl::Status CpuNumaNode::DoRealGather(HostAdapter& host) {
-  std::filesystem::path cpulist_path(absl::StrFormat(
-      "/sys/devices/system/node/node%d/cpulist", numa_node_id_));
+std::filesystem::path CpuNumaNode::CpuListPath() const {
+  return absl::StrFormat("/sys/devices/system/node/node%d/cpulist",
+                         numa_node_id_);
+}
 
+absl::Status CpuNumaNode::DoRealGather(
+    const absl::StatusOr<std::string>& cpulist, FileReader read_files) {
   ASSIGN_OR_RETURN(std::vector<int> cpu_ids,
-                   ParseRangeListFile(host, cpulist_path));
+                   ParseRangeListContent(cpulist, CpuListPath()));
 
+  // Read the topology files of all the node's LPUs in a single batch.
+  std::vector<CpuLpu> lpus;
+  std::vector<std::filesystem::path> paths;
   for (int cpu_id : cpu_ids) {
-    CpuLpu lpu(cpu_id, numa_node_id_);
-    RETURN_IF_ERROR(lpu.Gather(host));
+    CpuLpu& lpu = lpus.emplace_back(cpu_id, numa_node_id_);
+    std::vector<std::filesystem::path> lpu_paths = lpu.TopologyFilePaths();
+    paths.insert(paths.end(), lpu_paths.begin(), lpu_paths.end());
+  }
+  ASSIGN_OR_RETURN(std::vector<absl::StatusOr<std::string>> files,
+                   read_files(paths));
+  if (files.size() != paths.size()) {
+    return absl::InternalError(absl::StrCat("Read ", files.size(),
+                                            " files, expected ", paths.size()));
+  }
+
+  absl::Span<const absl::StatusOr<std::string>> remaining(files);
+  for (CpuLpu& lpu : lpus) {
+    size_t count = lpu.TopologyFilePaths().size();
+    RETURN_IF_ERROR(lpu.GatherFromFiles(remaining.subspan(0, count)));
+    remaining.remove_prefix(count);
     physical_processing_unit_count_ += (lpu.thread_id() == 0) ? 1 : 0;
     lpus_.push_back(std::move(lpu));
   }
@@ -139,7 +229,23 @@ absl::Status CpuNumaNode::Gather(HostAdapter& host) {
   if (result_.has_value()) {
     return result_.value();
   }
-  result_ = DoRealGather(host);
+  return GatherFromCpuList(host, host.Read(CpuListPath()));
+}
+
+absl::Status CpuNumaNode::GatherFromCpuList(
+    HostAdapter& host, const absl::StatusOr<std::string>& cpulist) {
+  return GatherFromCpuList(
+      cpulist, [&host](absl::Span<const std::filesystem::path> paths) {
+        return ReadFiles(host, paths);
+      });
+}
+
+absl::Status CpuNumaNode::GatherFromCpuList(
+    const absl::StatusOr<std::string>& cpulist, FileReader read_files) {
+  if (result_.has_value()) {
+    return result_.value();
+  }
+  result_ = DoRealGather(cpulist, read_files);
   return result_.value();
 }
 
@@ -166,16 +272,33 @@ void CpuTopology::NormalizeTopology() {
   }
 }
 
-absl::Status CpuTopology::DoRealGather(HostAdapter& host) {
-  std::filesystem::path node_online_path("/sys/devices/system/node/online");
-
+absl::Status CpuTopology::GatherFromFiles(FileReader read_files) {
+  std::filesystem::path node_online_path(kNodeOnlinePath);
+  ASSIGN_OR_RETURN(std::vector<absl::StatusOr<std::string>> node_online,
+                   read_files({node_online_path}));
+  if (node_online.size() != 1) {
+    return absl::InternalError(
+        absl::StrCat("Read ", node_online.size(), " files, expected 1"));
+  }
   ASSIGN_OR_RETURN(std::vector<int> numa_node_ids,
-                   ParseRangeListFile(host, node_online_path));
+                   ParseRangeListContent(node_online[0], node_online_path));
 
+  // Read the cpulists of all nodes in a single batch.
+  std::vector<CpuNumaNode> nodes;
+  std::vector<std::filesystem::path> cpulist_paths;
   for (int numa_id : numa_node_ids) {
-    CpuNumaNode numa_node(numa_id);
-    RETURN_IF_ERROR(numa_node.Gather(host));
-    numa_nodes_.push_back(std::move(numa_node));
+    cpulist_paths.push_back(nodes.emplace_back(numa_id).CpuListPath());
+  }
+  ASSIGN_OR_RETURN(std::vector<absl::StatusOr<std::string>> cpulists,
+                   read_files(cpulist_paths));
+  if (cpulists.size() != nodes.size()) {
+    return absl::InternalError(absl::StrCat(
+        "Read ", cpulists.size(), " files, expected ", nodes.size()));
+  }
+
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    RETURN_IF_ERROR(nodes[i].GatherFromCpuList(cpulists[i], read_files));
+    numa_nodes_.push_back(std::move(nodes[i]));
   }
 
   NormalizeTopology();
@@ -189,6 +312,38 @@ absl::Status CpuTopology::DoRealGather(HostAdapter& host) {
   return absl::OkStatus();
 }
 
+absl::Status CpuTopology::DoRealGather(HostAdapter& host) {
+  absl::StatusOr<std::vector<HostAdapter::GlobEntry>> entries =
+      host.ReadGlobs(TopologyFilePatterns());
+  if (absl::IsUnimplemented(entries.status())) {
+    return GatherFromFiles(
+        [&host](absl::Span<const std::filesystem::path> paths) {
+          return ReadFiles(host, paths);
+        });
+  }
+  RETURN_IF_ERROR(entries.status());
+
+  absl::flat_hash_map<std::string, const absl::StatusOr<std::string>*> files;
+  for (const HostAdapter::GlobEntry& entry : *entries) {
+    files[entry.path.string()] = &entry.content;
+  }
+  return GatherFromFiles([&files](absl::Span<const std::filesystem::path> paths)
+                             -> absl::StatusOr<
+                                 std::vector<absl::StatusOr<std::string>>> {
+    std::vector<absl::StatusOr<std::string>> contents;
+    contents.reserve(paths.size());
+    for (const std::filesystem::path& path : paths) {
+      auto it = files.find(path.string());
+      if (it == files.end()) {
+        contents.push_back(absl::NotFoundError(path.string()));
+      } else {
+        contents.push_back(*it->second);
+      }
+    }
+    return contents;
+  });
+}
+
 absl::Status CpuTopology::Gather(HostAdapter& host) {
   if (result_.has_value()) {
     return result_.value();
@@ -266,21 +421,22 @@ absl::Status CpuSignature::ParseFromCpuInfo(absl::string_view cpuinfo) {
   return absl::OkStatus();
 }
 
-absl::Status CpuFrequency::Gather(HostAdapter& host) {
-  ASSIGN_OR_RETURN(std::string cpuinfo, host.Read({"/proc/cpuinfo"}));
-  std::filesystem::path sysfs_cpu_path(
-      absl::StrFormat("/sys/devices/system/cpu/cpu%d", cpu_id_));
+std::vector<std::filesystem::path> CpuFrequency::FilePaths() const {
+  std::filesystem::path sysfs_cpu_path = SysfsCpuPath(cpu_id_);
+  return {sysfs_cpu_path / "tsc_freq_khz",
+          sysfs_cpu_path / "cpufreq/scaling_cur_freq",
+          sysfs_cpu_path / "cpufreq/scaling_max_freq"};
+}
 
-  ASSIGN_OR_RETURN(design_freq_,
-                   ParseIntegerFile(host, sysfs_cpu_path / "tsc_freq_khz"));
-  absl::StatusOr<int> cur_freq =
-      ParseIntegerFile(host, sysfs_cpu_path / "cpufreq/scaling_cur_freq");
+absl::Status CpuFrequency::GatherFromFiles(
+    absl::Span<const absl::StatusOr<std::string>> files) {
+  std::vector<std::filesystem::path> paths = FilePaths();
+  ASSIGN_OR_RETURN(design_freq_, ParseIntegerContent(files[0], paths[0]));
+  absl::StatusOr<int> cur_freq = ParseIntegerContent(files[1], paths[1]);
 
   if (cur_freq.ok()) {
     cur_freq_ = *cur_freq;
-    ASSIGN_OR_RETURN(
-        max_freq_,
-        ParseIntegerFile(host, sysfs_cpu_path / "cpufreq/scaling_max_freq"));
+    ASSIGN_OR_RETURN(max_freq_, ParseIntegerContent(files[2], paths[2]));
   } else if (cur_freq.status().code() == absl::StatusCode::kNotFound) {
     // System did not disclose cpu scaling.
     cur_freq_ = design_freq_;
@@ -292,18 +448,92 @@ absl::Status CpuFrequency::Gather(HostAdapter& host) {
   return absl::OkStatus();
 }
 
-absl::Status CpuThrottleInfo::Gather(HostAdapter& host) {
-  std::filesystem::path sysfs_cpu_path(
-      absl::StrFormat("/sys/devices/system/cpu/cpu%d", cpu_id_));
+absl::Status CpuFrequency::Gather(HostAdapter& host) {
+  ASSIGN_OR_RETURN(std::vector<absl::StatusOr<std::string>> files,
+                   SampleFiles(host, FilePaths()));
+  return GatherFromFiles(files);
+}
 
-  ASSIGN_OR_RETURN(
-      core_throttle_count_,
-      ParseIntegerFile(
-          host, sysfs_cpu_path / "thermal_throttle/core_throttle_count"));
+absl::StatusOr<std::vector<CpuFrequency>> CpuFrequency::GatherAll(
+    HostAdapter& host, absl::Span<const int> cpu_ids) {
+  std::vector<CpuFrequency> freqs;
+  std::vector<std::filesystem::path> paths;
+  for (int cpu_id : cpu_ids) {
+    std::vector<std::filesystem::path> cpu_paths =
+        freqs.emplace_back(cpu_id).FilePaths();
+    paths.insert(paths.end(), cpu_paths.begin(), cpu_paths.end());
+  }
+  ASSIGN_OR_RETURN(std::vector<absl::StatusOr<std::string>> files,
+                   SampleFiles(host, paths));
+
+  absl::Span<const absl::StatusOr<std::string>> remaining(files);
+  for (CpuFrequency& freq : freqs) {
+    size_t count = freq.FilePaths().size();
+    RETURN_IF_ERROR(freq.GatherFromFiles(remaining.subspan(0, count)));
+    remaining.remove_prefix(count);
+  }
+  return freqs;
+}
+
+std::filesystem::path CpuThrottleInfo::FilePath() const {
+  return SysfsCpuPath(cpu_id_) / "thermal_throttle/core_throttle_count";
+}
+
+absl::Status CpuThrottleInfo::Gather(HostAdapter& host) {
+  const std::filesystem::path path = FilePath();
+  ASSIGN_OR_RETURN(std::vector<absl::StatusOr<std::string>> files,
+                   SampleFiles(host, {path}));
+  ASSIGN_OR_RETURN(core_throttle_count_, ParseIntegerContent(files[0], path));
 
   return absl::OkStatus();
 }
 
+absl::StatusOr<std::vector<CpuThrottleInfo>> CpuThrottleInfo::GatherAll(
+    HostAdapter& host, absl::Span<const int> cpu_ids) {
+  std::vector<CpuThrottleInfo> throttles;
+  std::vector<std::filesystem::path> paths;
+  for (int cpu_id : cpu_ids) {
+    paths.push_back(throttles.emplace_back(cpu_id).FilePath());
+  }
+  ASSIGN_OR_RETURN(std::vector<absl::StatusOr<std::string>> files,
+                   SampleFiles(host, paths));
+
+  for (size_t i = 0; i < throttles.size(); ++i) {
+    ASSIGN_OR_RETURN(throttles[i].core_throttle_count_,
+                     ParseIntegerContent(files[i], paths[i]));
+  }
+  return throttles;
+}
+
+std::filesystem::path CpuMicrocode::FilePath() const {
+  return SysfsCpuPath(cpu_id_) / "microcode/version";
+}
+
+absl::StatusOr<std::vector<CpuMicrocode>> CpuMicrocode::GatherAll(
+    HostAdapter& host, absl::Span<const int> cpu_ids,
+    uint64_t fallback_revision) {
+  std::vector<CpuMicrocode> microcodes;
+  std::vector<std::filesystem::path> paths;
+  for (int cpu_id : cpu_ids) {
+    paths.push_back(microcodes.emplace_back(cpu_id).FilePath());
+  }
+  ASSIGN_OR_RETURN(std::vector<absl::StatusOr<std::string>> files,
+                   SampleFiles(host, paths));
+
+  for (size_t i = 0; i < microcodes.size(); ++i) {
+    if (absl::IsNotFound(files[i].status())) {
+      microcodes[i].revision_ = fallback_revision;
+      continue;
+    }
+    RETURN_IF_ERROR(files[i].status());
+    if (!SimpleHexAtoi(*files[i], microcodes[i].revision_)) {
+      return absl::InternalError(
+          absl::StrCat("File parsed failed: ", paths[i].string()));
+    }
+  }
+  return microcodes;
+}
+
 }  // namespace internal
 
 }  // namespace ocpdiag::hwinterface
@@ -10,6 +10,7 @@
 #include <stdint.h>
 
 #include <algorithm>
+#include <filesystem>
 #include <numeric>
 #include <optional>
 #include <string>
@@ -17,9 +18,12 @@
 #include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
 #include "ocpdiag/core/hwinterface/cpu.pb.h"
 
@@ -27,6 +31,12 @@ namespace ocpdiag::hwinterface {
 
 namespace internal {
 
+// Reads the files at `paths`, returning one result per path in the same order,
+// like HostAdapter::ReadMany().
+using FileReader =
+    absl::FunctionRef<absl::StatusOr<std::vector<absl::StatusOr<std::string>>>(
+        absl::Span<const std::filesystem::path> paths)>;
+
 class CpuLpu {
  public:
   CpuLpu(int cpu_id, int numa_node_id)
@@ -37,6 +47,15 @@ class CpuLpu {
   // cache will be used afterwards.
   absl::Status Gather(HostAdapter& host);
 
+  // Returns the sysfs files that Gather() reads. This lets callers read the
+  // files of many LPUs in one HostAdapter::ReadMany() call and pass each LPU
+  // its share through GatherFromFiles().
+  std::vector<std::filesystem::path> TopologyFilePaths() const;
+
+  // Same as Gather(), but parses `files`, the contents of TopologyFilePaths().
+  absl::Status GatherFromFiles(
+      absl::Span<const absl::StatusOr<std::string>> files);
+
   // unique id of cpu
   int cpu_id() const { return cpu_id_; }
   int socket_id() const { return socket_id_; }
@@ -60,6 +79,8 @@ class CpuLpu {
 
  private:
   absl::Status DoRealGather(HostAdapter& host);
+  absl::Status ParseTopologyFiles(
+      absl::Span<const absl::StatusOr<std::string>> files);
 
   int cpu_id_;
   int socket_id_ = 0;
@@ -80,6 +101,18 @@ class CpuNumaNode {
   // cache will be used afterwards.
   absl::Status Gather(HostAdapter& host);
 
+  // Same as Gather(), but with the content of the node's cpulist file already
+  // read by the caller. All the LPUs' files are read in a single batch.
+  absl::Status GatherFromCpuList(HostAdapter& host,
+                                 const absl::StatusOr<std::string>& cpulist);
+
+  // Same as above, with the LPUs' files read by `read_files`.
+  absl::Status GatherFromCpuList(const absl::StatusOr<std::string>& cpulist,
+                                 FileReader read_files);
+
+  // Returns the path of the node's cpulist file.
+  std::filesystem::path CpuListPath() const;
+
   int numa_node_id() const { return numa_node_id_; }
   int logical_processing_unit_count() const { return lpus_.size(); }
   int physical_processing_unit_count() const {
@@ -91,7 +124,8 @@ class CpuNumaNode {
                          absl::flat_hash_map<int, int>& core_ids_map);
 
  private:
-  absl::Status DoRealGather(HostAdapter& host);
+  absl::Status DoRealGather(const absl::StatusOr<std::string>& cpulist,
+                            FileReader read_files);
 
   int numa_node_id_;
   int physical_processing_unit_count_ = 0;
@@ -106,6 +140,10 @@ class CpuTopology {
   // Gathers CPU topology infomation from procfs and sysfs by
   // `host` adapter. The file system will be read only the first time, and the
   // cache will be used afterwards.
+  //
+  // All the files are read in a single HostAdapter::ReadGlobs() pass. Adapters
+  // that can't expand wildcards are read one level at a time instead: the
+  // online nodes, their cpulists, then each node's LPUs.
   absl::Status Gather(HostAdapter& host);
 
   const std::vector<CpuNumaNode>& numa_nodes() const { return numa_nodes_; }
@@ -136,6 +174,7 @@ class CpuTopology {
 
  private:
   absl::Status DoRealGather(HostAdapter& host);
+  absl::Status GatherFromFiles(FileReader read_files);
   void NormalizeTopology();
 
   // Caches `result_` after Gather() was called.
@@ -159,6 +198,8 @@ class CpuSignature {
   int family() const { return family_; }
   int model() const { return model_; }
   int stepping() const { return stepping_; }
+  // The microcode revision when the signature was gathered. A late microcode
+  // load changes it, see CpuMicrocode.
   uint64_t microcode() const { return microcode_; }
 
  private:
@@ -182,12 +223,20 @@ class CpuFrequency {
   // on each call.
   absl::Status Gather(HostAdapter& host);
 
+  // Gathers the frequencies of all `cpu_ids` with a single batched read.
+  static absl::StatusOr<std::vector<CpuFrequency>> GatherAll(
+      HostAdapter& host, absl::Span<const int> cpu_ids);
+
   int cpu_id() const { return cpu_id_; }
   int design_freq() const { return design_freq_; }
   int cur_freq() const { return cur_freq_; }
   int max_freq() const { return max_freq_; }
 
  private:
+  std::vector<std::filesystem::path> FilePaths() const;
+  absl::Status GatherFromFiles(
+      absl::Span<const absl::StatusOr<std::string>> files);
+
   int cpu_id_;
   int design_freq_ = 0;
   int cur_freq_ = 0;
@@ -202,14 +251,42 @@ class CpuThrottleInfo {
   // upated on each call.
   absl::Status Gather(HostAdapter& host);
 
+  // Gathers the throttle counts of all `cpu_ids` with a single batched read.
+  static absl::StatusOr<std::vector<CpuThrottleInfo>> GatherAll(
+      HostAdapter& host, absl::Span<const int> cpu_ids);
+
   int cpu_id() const { return cpu_id_; }
   int core_throttle_count() const { return core_throttle_count_; }
 
  private:
+  std::filesystem::path FilePath() const;
+
   int cpu_id_;
   int core_throttle_count_ = 0;
 };
 
+class CpuMicrocode {
+ public:
+  CpuMicrocode(int cpu_id) : cpu_id_(cpu_id) {}
+
+  // Gathers the microcode revisions of all `cpu_ids` with a single batched
+  // read. They are read again on each call, since a late microcode load
+  // updates them. A CPU without a sysfs revision has no microcode driver to
+  // reload it, so `fallback_revision` (from /proc/cpuinfo) is used instead.
+  static absl::StatusOr<std::vector<CpuMicrocode>> GatherAll(
+      HostAdapter& host, absl::Span<const int> cpu_ids,
+      uint64_t fallback_revision);
+
+  int cpu_id() const { return cpu_id_; }
+  uint64_t revision() const { return revision_; }
+
+ private:
+  std::filesystem::path FilePath() const;
+
+  int cpu_id_;
+  uint64_t revision_ = 0;
+};
+
 }  // namespace internal
 
 }  // namespace ocpdiag::hwinterface
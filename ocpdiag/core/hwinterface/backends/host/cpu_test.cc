@@ -6,11 +6,17 @@
 
 #include "ocpdiag/core/hwinterface/backends/host/cpu.h"
 
+#include <filesystem>
 #include <string>
 #include <vector>
 
+#include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "ocpdiag/core/hwinterface/backends/host/fake_host_adapter.h"
 #include "ocpdiag/core/hwinterface/cpu.pb.h"
 #include "ocpdiag/core/testing/file_utils.h"
@@ -21,8 +27,48 @@ namespace ocpdiag::hwinterface {
 namespace internal {
 namespace {
 
+using ::ocpdiag::testing::StatusIs;
 using ::ocpdiag::testutils::GetDataDependencyFileContents;
 
+// Forwards to a RealisticHostAdapter while counting the read calls, each of
+// which is a round trip on a remote host.
+class ReadCountingHostAdapter : public HostAdapter {
+ public:
+  explicit ReadCountingHostAdapter(bool support_globs = true)
+      : support_globs_(support_globs) {}
+
+  absl::StatusOr<CommandResult> RunCommand(
+      absl::Duration timeout, const std::vector<std::string>& args) override {
+    return host_.RunCommand(timeout, args);
+  }
+  absl::StatusOr<std::string> Read(const std::filesystem::path& path) override {
+    ++read_calls_;
+    return host_.Read(path);
+  }
+  absl::StatusOr<std::vector<absl::StatusOr<std::string>>> ReadMany(
+      absl::Span<const std::filesystem::path> paths) override {
+    ++read_calls_;
+    return host_.ReadMany(paths);
+  }
+  absl::StatusOr<std::vector<GlobEntry>> ReadGlobs(
+      absl::Span<const std::string> patterns) override {
+    if (!support_globs_) return HostAdapter::ReadGlobs(patterns);
+    ++read_calls_;
+    return host_.ReadGlobs(patterns);
+  }
+  absl::Status Write(const std::filesystem::path& path,
+                     absl::string_view data) override {
+    return host_.Write(path, data);
+  }
+
+  int read_calls() const { return read_calls_; }
+
+ private:
+  const bool support_globs_;
+  RealisticHostAdapter host_;
+  int read_calls_ = 0;
+};
+
 TEST(CpuTopologyTest, FakeHostAdapter) {
   CpuTopology topology;
   RealisticHostAdapter host_adapter;
@@ -49,6 +95,27 @@ TEST(CpuTopologyTest, FakeHostAdapter) {
   }
 }
 
+TEST(CpuTopologyTest, ReadsAreBatched) {
+  CpuTopology topology;
+  ReadCountingHostAdapter host_adapter;
+  ASSERT_OK(topology.Gather(host_adapter));
+
+  // All the files are read in a single pass.
+  EXPECT_EQ(host_adapter.read_calls(), 1);
+  EXPECT_EQ(topology.logical_cores_count(), 8);
+}
+
+TEST(CpuTopologyTest, ReadsAreBatchedWithoutGlobs) {
+  CpuTopology topology;
+  ReadCountingHostAdapter host_adapter(/*support_globs=*/false);
+  ASSERT_OK(topology.Gather(host_adapter));
+
+  // One read for the online nodes, one for all their cpulists, and one per
+  // node for its LPUs' topology files.
+  EXPECT_EQ(host_adapter.read_calls(), 4);
+  EXPECT_EQ(topology.logical_cores_count(), 8);
+}
+
 TEST(CpuLpuTest, FakeHostAdapter) {
   RealisticHostAdapter host_adapter;
   CpuLpu lpu1(1, 0);
@@ -152,6 +219,78 @@ TEST(CpuFrequencyTest, SystemNotDiscloseCpuScalingInfo) {
   }
 }
 
+TEST(CpuFrequencyTest, GatherAllReadsOnce) {
+  ReadCountingHostAdapter host;
+  std::vector<int> cpu_ids = {0, 3, 7};
+
+  absl::StatusOr<std::vector<CpuFrequency>> freqs =
+      CpuFrequency::GatherAll(host, cpu_ids);
+  ASSERT_OK(freqs);
+  EXPECT_EQ(host.read_calls(), 1);
+  ASSERT_EQ(freqs->size(), cpu_ids.size());
+  for (int i = 0; i < cpu_ids.size(); ++i) {
+    EXPECT_EQ((*freqs)[i].cpu_id(), cpu_ids[i]);
+    EXPECT_EQ((*freqs)[i].design_freq(), 2000127);
+    EXPECT_EQ((*freqs)[i].cur_freq(), 1000000 + cpu_ids[i]);
+    EXPECT_EQ((*freqs)[i].max_freq(), 2001000);
+  }
+}
+
+TEST(CpuFrequencyTest, GatherAllWithoutCpuScalingInfo) {
+  RealisticHostAdapter host(/*support_cpu_scaling=*/false);
+
+  absl::StatusOr<std::vector<CpuFrequency>> freqs =
+      CpuFrequency::GatherAll(host, {1, 2});
+  ASSERT_OK(freqs);
+  for (const CpuFrequency& freq : *freqs) {
+    EXPECT_EQ(freq.cur_freq(), 2000127);
+    EXPECT_EQ(freq.max_freq(), 2000127);
+  }
+}
+
+TEST(CpuThrottleInfoTest, GatherAllReadsOnce) {
+  ReadCountingHostAdapter host;
+
+  absl::StatusOr<std::vector<CpuThrottleInfo>> throttles =
+      CpuThrottleInfo::GatherAll(host, {2, 5});
+  ASSERT_OK(throttles);
+  EXPECT_EQ(host.read_calls(), 1);
+  ASSERT_EQ(throttles->size(), 2);
+  EXPECT_EQ((*throttles)[0].core_throttle_count(), 2);
+  EXPECT_EQ((*throttles)[1].core_throttle_count(), 5);
+}
+
+TEST(CpuThrottleInfoTest, GatherAllMissingFileFails) {
+  RealisticHostAdapter host;
+
+  EXPECT_THAT(CpuThrottleInfo::GatherAll(host, {0, 100}),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST(CpuMicrocodeTest, GatherAllReadsSysfsRevisions) {
+  RealisticHostAdapter host;
+  ASSERT_OK(host.Write("/sys/devices/system/cpu/cpu1/microcode/version",
+                       "0x2b000461\n"));
+
+  // CPU 0 has no sysfs revision, so the one from /proc/cpuinfo is used.
+  absl::StatusOr<std::vector<CpuMicrocode>> microcodes =
+      CpuMicrocode::GatherAll(host, {0, 1}, /*fallback_revision=*/0x1f);
+  ASSERT_OK(microcodes);
+  ASSERT_EQ(microcodes->size(), 2);
+  EXPECT_EQ((*microcodes)[0].revision(), 0x1f);
+  EXPECT_EQ((*microcodes)[1].cpu_id(), 1);
+  EXPECT_EQ((*microcodes)[1].revision(), 0x2b000461);
+}
+
+TEST(CpuMicrocodeTest, GatherAllMalformedRevisionFails) {
+  RealisticHostAdapter host;
+  ASSERT_OK(
+      host.Write("/sys/devices/system/cpu/cpu0/microcode/version", "bad"));
+
+  EXPECT_THAT(CpuMicrocode::GatherAll(host, {0}, 0),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
 TEST(CpuThrottleInfoTest, FakeHostAdapter) {
   CpuTopology topology;
   RealisticHostAdapter host;
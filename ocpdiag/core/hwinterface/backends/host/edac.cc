@@ -0,0 +1,198 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/host/edac.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "ocpdiag/core/compat/status_macros.h"
+#include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
+#include "ocpdiag/core/hwinterface/backends/lib/hw_info.h"
+#include "ocpdiag/core/hwinterface/error.pb.h"
+#include "ocpdiag/core/hwinterface/identifier.pb.h"
+
+namespace ocpdiag::hwinterface::internal {
+namespace {
+
+// The counters of the errors a memory controller couldn't attribute to a DIMM.
+constexpr char kMcNoInfoPattern[] =
+    "/sys/devices/system/edac/mc/mc[0-9]*/ce_noinfo_count";
+// The DIMMs, or ranks for the drivers that only know about those.
+constexpr char kDimmLabelPattern[] =
+    "/sys/devices/system/edac/mc/mc[0-9]*/dimm[0-9]*/dimm_label";
+constexpr char kRankLabelPattern[] =
+    "/sys/devices/system/edac/mc/mc[0-9]*/rank[0-9]*/dimm_label";
+
+absl::StatusOr<int64_t> ParseCounter(
+    const std::filesystem::path& path,
+    const absl::StatusOr<std::string>& content) {
+  RETURN_IF_ERROR(content.status());
+  int64_t count;
+  if (!absl::SimpleAtoi(absl::StripAsciiWhitespace(*content), &count)) {
+    return absl::InternalError(
+        absl::StrFormat("Failed to parse EDAC counter %s: \"%s\"",
+                        path.string(), *content));
+  }
+  return count;
+}
+
+// Returns how much a counter increased from `before` to `after`. A counter
+// that decreased was reset in between.
+int64_t Increase(int64_t before, int64_t after) {
+  return after >= before ? after - before : after;
+}
+
+}  // namespace
+
+absl::StatusOr<EdacCounters> EdacCounters::Create(
+    HostAdapter& host,
+    const absl::flat_hash_map<std::string, std::string>& dimm_names) {
+  EdacCounters counters(host);
+  ASSIGN_OR_RETURN(std::vector<HostAdapter::GlobEntry> entries,
+                   host.ReadGlobs({kMcNoInfoPattern, kDimmLabelPattern,
+                                   kRankLabelPattern}));
+  for (const HostAdapter::GlobEntry& entry : entries) {
+    const std::filesystem::path dir = entry.path.parent_path();
+    EdacCount count;
+    if (entry.path.filename() == "ce_noinfo_count") {
+      count.memory_controller = dir.filename().string();
+      counters.paths_.push_back(dir / "ce_noinfo_count");
+      counters.paths_.push_back(dir / "ue_noinfo_count");
+    } else {
+      count.memory_controller = dir.parent_path().filename().string();
+      // A DIMM without a label is still told apart by its directory.
+      absl::string_view label;
+      if (entry.content.ok()) {
+        label = absl::StripAsciiWhitespace(*entry.content);
+      }
+      count.label = std::string(label);
+      count.dimm = label.empty() ? absl::StrFormat("%s_%s",
+                                                   count.memory_controller,
+                                                   dir.filename().string())
+                                 : EdacDimmName(label, dimm_names);
+      counters.paths_.push_back(dir / "dimm_ce_count");
+      counters.paths_.push_back(dir / "dimm_ue_count");
+    }
+    counters.counts_.push_back(std::move(count));
+  }
+
+  RETURN_IF_ERROR(counters.Sample(counters.counts_));
+  return counters;
+}
+
+absl::Status EdacCounters::Sample(std::vector<EdacCount>& counts) {
+  if (paths_.empty()) {
+    sampled_at_ = absl::Now();
+    return absl::OkStatus();
+  }
+  ASSIGN_OR_RETURN(std::vector<absl::StatusOr<std::string>> files,
+                   host_->Sample(paths_));
+  sampled_at_ = absl::Now();
+  if (files.size() != paths_.size()) {
+    return absl::InternalError(
+        absl::StrFormat("Sampled %d EDAC counters, expected %d", files.size(),
+                        paths_.size()));
+  }
+  for (size_t i = 0; i < counts.size(); ++i) {
+    ASSIGN_OR_RETURN(counts[i].ce_count,
+                     ParseCounter(paths_[2 * i], files[2 * i]));
+    ASSIGN_OR_RETURN(counts[i].ue_count,
+                     ParseCounter(paths_[2 * i + 1], files[2 * i + 1]));
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::vector<EdacCount>> EdacCounters::Poll() {
+  std::vector<EdacCount> counts = counts_;
+  RETURN_IF_ERROR(Sample(counts));
+
+  std::vector<EdacCount> increases;
+  for (size_t i = 0; i < counts.size(); ++i) {
+    EdacCount increase = counts[i];
+    increase.ce_count = Increase(counts_[i].ce_count, counts[i].ce_count);
+    increase.ue_count = Increase(counts_[i].ue_count, counts[i].ue_count);
+    if (increase.ce_count > 0 || increase.ue_count > 0) {
+      increases.push_back(std::move(increase));
+    }
+  }
+  counts_ = std::move(counts);
+  return increases;
+}
+
+absl::StatusOr<std::vector<EdacCount>> EdacCounters::WaitForErrors(
+    absl::Duration interval, absl::Duration timeout) {
+  const absl::Time deadline = absl::Now() + timeout;
+  while (true) {
+    ASSIGN_OR_RETURN(std::vector<EdacCount> increases, Poll());
+    if (!increases.empty() || sampled_at_ + interval > deadline) {
+      return increases;
+    }
+    absl::SleepFor(sampled_at_ + interval - absl::Now());
+  }
+}
+
+std::string EdacDimmName(
+    absl::string_view label,
+    const absl::flat_hash_map<std::string, std::string>& dimm_names) {
+  if (auto it = dimm_names.find(label); it != dimm_names.end()) {
+    return it->second;
+  }
+  if (size_t space = label.rfind(' '); space != absl::string_view::npos) {
+    auto it = dimm_names.find(label.substr(space + 1));
+    if (it != dimm_names.end()) return it->second;
+  }
+  return std::string(label);
+}
+
+std::vector<error::ErrorInfo> EdacErrorInfos(absl::Span<const EdacCount> counts,
+                                             absl::Time sampled_at) {
+  std::vector<error::ErrorInfo> infos;
+  for (const EdacCount& count : counts) {
+    for (const auto& [errors, is_correctable] :
+         {std::make_pair(count.ce_count, true),
+          std::make_pair(count.ue_count, false)}) {
+      if (errors <= 0) continue;
+      error::ErrorInfo& info = infos.emplace_back();
+      info.set_event_source(error::EventSource::EDAC_MEMORY_ERROR);
+      info.mutable_event_timestamp()->set_seconds(
+          absl::ToUnixSeconds(sampled_at));
+      info.set_count(static_cast<int32_t>(std::min<int64_t>(
+          errors, std::numeric_limits<int32_t>::max())));
+      info.set_is_correctable(is_correctable);
+      info.set_is_fatal(false);
+      info.set_other_debug_info(
+          count.label.empty()
+              ? count.memory_controller
+              : absl::StrFormat("%s: %s", count.memory_controller,
+                                count.label));
+      if (!count.dimm.empty()) {
+        Identifier& id = *info.add_ids();
+        id.set_type("dimm");
+        id.set_name(count.dimm);
+        PopulateId(id);
+      }
+    }
+  }
+  return infos;
+}
+
+}  // namespace ocpdiag::hwinterface::internal
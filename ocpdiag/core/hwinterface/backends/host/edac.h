@@ -0,0 +1,104 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_EDAC_H_
+#define OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_EDAC_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
+#include "ocpdiag/core/hwinterface/error.pb.h"
+
+namespace ocpdiag::hwinterface::internal {
+
+// The memory errors counted by the kernel's EDAC driver for a DIMM, or for a
+// memory controller when the driver couldn't tell the DIMM.
+struct EdacCount {
+  // The memory controller, e.g. "mc0".
+  std::string memory_controller;
+  // The DIMM, named like the DIMM identifiers of GetMemoryInfo(), e.g.
+  // "DIMM3", if its SMBIOS device locator is known, or else by its EDAC label.
+  // Empty for the errors of the memory controller that aren't attributed to
+  // any DIMM.
+  std::string dimm;
+  // The EDAC label of the DIMM, e.g. "Node0_Bank0 DIMM_A1".
+  std::string label;
+  int64_t ce_count = 0;
+  int64_t ue_count = 0;
+
+  bool operator==(const EdacCount& other) const {
+    return memory_controller == other.memory_controller &&
+           dimm == other.dimm && label == other.label &&
+           ce_count == other.ce_count && ue_count == other.ue_count;
+  }
+};
+
+// EdacCounters samples the memory error counters of the EDAC driver under
+// /sys/devices/system/edac/mc. The counters are found once, after which each
+// sample reads them through HostAdapter::Sample(), which keeps the files open,
+// without spawning a process. That makes it cheap enough to poll every few
+// milliseconds, e.g. to catch a burst of correctable errors during a memory
+// stress test.
+class EdacCounters {
+ public:
+  // Finds the counters on `host`, which must outlive this, and samples them.
+  // A host without EDAC has no counters. The DIMM labels that name one of the
+  // SMBIOS device locators of `dimm_names` are reported as the DIMM name that
+  // it maps the locator to.
+  static absl::StatusOr<EdacCounters> Create(
+      HostAdapter& host,
+      const absl::flat_hash_map<std::string, std::string>& dimm_names);
+
+  // The counts of the last sample, since boot or since they were reset.
+  const std::vector<EdacCount>& counts() const { return counts_; }
+  absl::Time sampled_at() const { return sampled_at_; }
+
+  // Samples the counters again, and returns how much those that increased
+  // did since the previous sample.
+  absl::StatusOr<std::vector<EdacCount>> Poll();
+
+  // Polls every `interval` until some counter increases, and returns the
+  // increase, or until `timeout` passed, and returns nothing.
+  absl::StatusOr<std::vector<EdacCount>> WaitForErrors(absl::Duration interval,
+                                                       absl::Duration timeout);
+
+ private:
+  explicit EdacCounters(HostAdapter& host) : host_(&host) {}
+
+  // Reads all the counters into `counts`.
+  absl::Status Sample(std::vector<EdacCount>& counts);
+
+  HostAdapter* host_;
+  // The corrected and uncorrected counter files of each of `counts_`.
+  std::vector<std::filesystem::path> paths_;
+  std::vector<EdacCount> counts_;
+  absl::Time sampled_at_ = absl::InfinitePast();
+};
+
+// Returns the name in `dimm_names`, keyed by SMBIOS device locator, of the
+// DIMM that the EDAC `label` names, or else `label`. Most drivers label DIMMs
+// with their locator, while ghes_edac uses "<bank locator> <device locator>".
+std::string EdacDimmName(
+    absl::string_view label,
+    const absl::flat_hash_map<std::string, std::string>& dimm_names);
+
+// Returns the errors of `counts` sampled at `sampled_at`, one for the
+// corrected and one for the uncorrected errors of each count, if any.
+std::vector<error::ErrorInfo> EdacErrorInfos(absl::Span<const EdacCount> counts,
+                                             absl::Time sampled_at);
+
+}  // namespace ocpdiag::hwinterface::internal
+
+#endif  // OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_EDAC_H_
@@ -0,0 +1,173 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/host/edac.h"
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/log/check.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/hwinterface/backends/lib/fake_host_adapter.h"
+#include "ocpdiag/core/hwinterface/error.pb.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::hwinterface::internal {
+namespace {
+
+using ::ocpdiag::testing::IsOkAndHolds;
+using ::ocpdiag::testing::StatusIs;
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+using ::testing::SizeIs;
+
+constexpr char kMc0[] = "/sys/devices/system/edac/mc/mc0";
+
+class EdacCountersTest : public ::testing::Test {
+ protected:
+  EdacCountersTest() {
+    WriteCounter("ce_noinfo_count", 0);
+    WriteCounter("ue_noinfo_count", 0);
+    CHECK_OK(host_.Write(absl::StrCat(kMc0, "/dimm0/dimm_label"),
+                         "Node0_Bank0 DIMM_A1\n"));
+    WriteCounter("dimm0/dimm_ce_count", 3);
+    WriteCounter("dimm0/dimm_ue_count", 0);
+    CHECK_OK(host_.Write(absl::StrCat(kMc0, "/dimm1/dimm_label"),
+                         "CPU_SrcID#0_MC#0_Chan#1_DIMM#0\n"));
+    WriteCounter("dimm1/dimm_ce_count", 0);
+    WriteCounter("dimm1/dimm_ue_count", 0);
+  }
+
+  void WriteCounter(absl::string_view file, int count) {
+    CHECK_OK(host_.Write(absl::StrCat(kMc0, "/", file),
+                         absl::StrCat(count, "\n")));
+  }
+
+  FakeHostAdapter host_;
+  const absl::flat_hash_map<std::string, std::string> dimm_names_ = {
+      {"DIMM_A1", "DIMM0"}};
+};
+
+TEST_F(EdacCountersTest, SamplesDimmAndControllerCounters) {
+  absl::StatusOr<EdacCounters> counters =
+      EdacCounters::Create(host_, dimm_names_);
+  ASSERT_OK(counters);
+  EXPECT_THAT(
+      counters->counts(),
+      ElementsAre(EdacCount{.memory_controller = "mc0"},
+                  EdacCount{.memory_controller = "mc0",
+                            .dimm = "DIMM0",
+                            .label = "Node0_Bank0 DIMM_A1",
+                            .ce_count = 3},
+                  EdacCount{.memory_controller = "mc0",
+                            .dimm = "CPU_SrcID#0_MC#0_Chan#1_DIMM#0",
+                            .label = "CPU_SrcID#0_MC#0_Chan#1_DIMM#0"}));
+}
+
+TEST_F(EdacCountersTest, PollReturnsIncreases) {
+  absl::StatusOr<EdacCounters> counters =
+      EdacCounters::Create(host_, dimm_names_);
+  ASSERT_OK(counters);
+
+  WriteCounter("dimm0/dimm_ce_count", 5);
+  WriteCounter("ue_noinfo_count", 1);
+  EXPECT_THAT(counters->Poll(),
+              IsOkAndHolds(ElementsAre(
+                  EdacCount{.memory_controller = "mc0", .ue_count = 1},
+                  EdacCount{.memory_controller = "mc0",
+                            .dimm = "DIMM0",
+                            .label = "Node0_Bank0 DIMM_A1",
+                            .ce_count = 2})));
+  EXPECT_THAT(counters->Poll(), IsOkAndHolds(IsEmpty()));
+
+  // The counters were reset, and counted again since.
+  WriteCounter("dimm0/dimm_ce_count", 1);
+  EXPECT_THAT(counters->Poll(),
+              IsOkAndHolds(ElementsAre(EdacCount{
+                  .memory_controller = "mc0",
+                  .dimm = "DIMM0",
+                  .label = "Node0_Bank0 DIMM_A1",
+                  .ce_count = 1})));
+}
+
+TEST_F(EdacCountersTest, WaitForErrorsTimesOut) {
+  absl::StatusOr<EdacCounters> counters =
+      EdacCounters::Create(host_, dimm_names_);
+  ASSERT_OK(counters);
+  EXPECT_THAT(
+      counters->WaitForErrors(absl::Milliseconds(1), absl::Milliseconds(5)),
+      IsOkAndHolds(IsEmpty()));
+
+  WriteCounter("dimm1/dimm_ue_count", 1);
+  EXPECT_THAT(counters->WaitForErrors(absl::Milliseconds(1), absl::Seconds(1)),
+              IsOkAndHolds(SizeIs(1)));
+}
+
+TEST_F(EdacCountersTest, MalformedCounter) {
+  absl::StatusOr<EdacCounters> counters =
+      EdacCounters::Create(host_, dimm_names_);
+  ASSERT_OK(counters);
+  WriteCounter("dimm1/dimm_ue_count", 1);
+  CHECK_OK(host_.Write(absl::StrCat(kMc0, "/dimm0/dimm_ce_count"), "x"));
+  EXPECT_THAT(counters->Poll(), StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST(EdacCounters, NoEdac) {
+  FakeHostAdapter host;
+  absl::StatusOr<EdacCounters> counters = EdacCounters::Create(host, {});
+  ASSERT_OK(counters);
+  EXPECT_THAT(counters->counts(), IsEmpty());
+  EXPECT_THAT(counters->Poll(), IsOkAndHolds(IsEmpty()));
+}
+
+TEST(EdacDimmName, MatchesLocators) {
+  const absl::flat_hash_map<std::string, std::string> names = {
+      {"DIMM_A1", "DIMM0"}, {"DIMM_B1", "DIMM4"}};
+  EXPECT_EQ(EdacDimmName("DIMM_B1", names), "DIMM4");
+  EXPECT_EQ(EdacDimmName("Node0_Bank0 DIMM_A1", names), "DIMM0");
+  EXPECT_EQ(EdacDimmName("mc#0csrow#1channel#0", names),
+            "mc#0csrow#1channel#0");
+}
+
+TEST(EdacErrorInfos, ReportsCorrectedAndUncorrectedErrors) {
+  const absl::Time sampled_at = absl::FromUnixSeconds(1622733217);
+  std::vector<error::ErrorInfo> infos = EdacErrorInfos(
+      {EdacCount{.memory_controller = "mc0", .ue_count = 1},
+       EdacCount{.memory_controller = "mc1",
+                 .dimm = "DIMM0",
+                 .label = "Node0_Bank0 DIMM_A1",
+                 .ce_count = 2,
+                 .ue_count = 1}},
+      sampled_at);
+  ASSERT_THAT(infos, SizeIs(3));
+
+  EXPECT_FALSE(infos[0].is_correctable());
+  EXPECT_EQ(infos[0].count(), 1);
+  EXPECT_THAT(infos[0].ids(), IsEmpty());
+  EXPECT_EQ(infos[0].other_debug_info(), "mc0");
+
+  EXPECT_EQ(infos[1].event_source(), error::EventSource::EDAC_MEMORY_ERROR);
+  EXPECT_EQ(infos[1].event_timestamp().seconds(), 1622733217);
+  EXPECT_TRUE(infos[1].is_correctable());
+  EXPECT_EQ(infos[1].count(), 2);
+  ASSERT_THAT(infos[1].ids(), SizeIs(1));
+  EXPECT_EQ(infos[1].ids(0).type(), "dimm");
+  EXPECT_EQ(infos[1].ids(0).name(), "DIMM0");
+  EXPECT_EQ(infos[1].other_debug_info(), "mc1: Node0_Bank0 DIMM_A1");
+
+  EXPECT_FALSE(infos[2].is_correctable());
+  EXPECT_EQ(infos[2].count(), 1);
+}
+
+}  // namespace
+}  // namespace ocpdiag::hwinterface::internal
@@ -6,13 +6,18 @@
 
 #include "ocpdiag/core/hwinterface/backends/host/error.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <cstdio>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "absl/log/log.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_split.h"
@@ -28,6 +33,8 @@ namespace {
 constexpr char kTimeFormat[] = "%E4Y-%m-%d %H:%M:%S %z";
 // RunCommand timeout second.
 const int kRunCommandTimeoutSecond = 30;
+// The database where rasdaemon records the events.
+constexpr char kRasDatabasePath[] = "/var/lib/rasdaemon/ras-mc_event.db";
 
 enum class ParsingStep {
   MC_TITLE,
@@ -101,11 +108,41 @@ absl::StatusOr<ParsingStep> ParseMcRecord(absl::string_view line,
   return ParsingStep::MC_RECORD;
 }
 
-}  // namespace
+// Returns the id of the event on `line`, which starts with it, if any.
+std::optional<int64_t> EventId(absl::string_view line) {
+  int64_t id;
+  if (!absl::SimpleAtoi(line.substr(0, line.find(' ')), &id)) {
+    return std::nullopt;
+  }
+  return id;
+}
 
-absl::Status RasDaemonErrors::Gather(HostAdapter& host) {
-  memory_errors_.clear();
+// Returns the largest event id in `lines`, or 0 if there is none.
+int64_t MaxEventId(absl::string_view lines) {
+  int64_t max_id = 0;
+  for (absl::string_view line : absl::StrSplit(lines, '\n')) {
+    max_id = std::max(max_id, EventId(line).value_or(0));
+  }
+  return max_id;
+}
+
+// Returns a query of the memory controller events after `since_id`, printed
+// one per line as by `ras-mc-ctl --errors`. If the database holds no event
+// that recent, it was recreated, and all the events are returned.
+std::string McEventQuery(int64_t since_id) {
+  return absl::StrFormat(
+      "SELECT id || ' ' || timestamp || ' ' || err_count || ' ' || err_type "
+      "|| ' error(s): ' || ifnull(err_msg, '') || ' at ' || "
+      "ifnull(nullif(label, ''), 'unknown memory') || ' location: ' || mc || "
+      "':' || top_layer || ':' || middle_layer || ':' || lower_layer || "
+      "', addr ' || address || ', grain ' || grain || ', syndrome ' || "
+      "syndrome || ' ' || ifnull(driver_detail, '') FROM mc_event "
+      "WHERE id > %d OR (SELECT max(id) FROM mc_event) < %d ORDER BY id;",
+      since_id, since_id);
+}
 
+// Returns the output of `ras-mc-ctl --errors` on `host`.
+absl::StatusOr<std::string> RunRasMcCtl(HostAdapter& host) {
   ASSIGN_OR_RETURN(HostAdapter::CommandResult result,
                    host.RunCommand(absl::Seconds(kRunCommandTimeoutSecond),
                                    {"ras-mc-ctl", "--errors"}));
@@ -116,11 +153,61 @@ absl::Status RasDaemonErrors::Gather(HostAdapter& host) {
                         "\nstdout: [%s]\nstderr:[%s] ",
                         result.exit_code, result.stdout, result.stderr));
   }
-  return ParseErrorReport(result.stdout);
+  return std::move(result.stdout);
+}
+
+}  // namespace
+
+absl::Status RasDaemonErrors::Gather(HostAdapter& host) {
+  memory_errors_.clear();
+  last_event_id_ = 0;
+  ASSIGN_OR_RETURN(std::string report, RunRasMcCtl(host));
+  return ParseErrorReport(report);
+}
+
+absl::Status RasDaemonErrors::GatherSince(HostAdapter& host, int64_t since_id) {
+  absl::StatusOr<HostAdapter::CommandResult> result = host.RunCommand(
+      absl::Seconds(kRunCommandTimeoutSecond),
+      {"sqlite3", "-batch", "-noheader", kRasDatabasePath,
+       McEventQuery(since_id)});
+  if (!result.ok() || result->exit_code != 0) {
+    // No sqlite3, or no database yet.
+    LOG(INFO) << "Failed to query " << kRasDatabasePath
+              << ", falling back to `ras-mc-ctl --errors`: "
+              << (result.ok() ? result->stderr : result.status().ToString());
+    memory_errors_.clear();
+    last_event_id_ = since_id;
+    ASSIGN_OR_RETURN(std::string report, RunRasMcCtl(host));
+    return ParseErrorReport(report, since_id);
+  }
+
+  memory_errors_.clear();
+  // Events older than `since_id` are only returned for a recreated database.
+  const std::optional<int64_t> first_id = EventId(result->stdout);
+  last_event_id_ =
+      first_id.has_value() && *first_id <= since_id ? 0 : since_id;
+  for (absl::string_view line :
+       absl::StrSplit(result->stdout, '\n', absl::SkipEmpty())) {
+    SkipEvent(line, /*since_id=*/0);
+    RETURN_IF_ERROR(ParseMcRecord(line, memory_errors_).status());
+  }
+  return absl::OkStatus();
 }
 
-absl::Status RasDaemonErrors::ParseErrorReport(absl::string_view ras_errors) {
+bool RasDaemonErrors::SkipEvent(absl::string_view line, int64_t since_id) {
+  std::optional<int64_t> id = EventId(line);
+  if (!id.has_value()) return false;
+  last_event_id_ = std::max(last_event_id_, *id);
+  return *id <= since_id;
+}
+
+absl::Status RasDaemonErrors::ParseErrorReport(absl::string_view ras_errors,
+                                               int64_t since_id) {
   ParsingStep step = ParsingStep::MC_TITLE;
+  memory_errors_.clear();
+  // The database was recreated, and all its events are new.
+  if (since_id > 0 && MaxEventId(ras_errors) < since_id) since_id = 0;
+  last_event_id_ = since_id;
 
   for (absl::string_view line : absl::StrSplit(ras_errors, '\n')) {
     switch (step) {
@@ -129,6 +216,7 @@ absl::Status RasDaemonErrors::ParseErrorReport(absl::string_view ras_errors) {
         break;
       }
       case ParsingStep::MC_RECORD: {
+        if (SkipEvent(line, since_id)) break;
         ASSIGN_OR_RETURN(step, ParseMcRecord(line, memory_errors_));
         break;
       }
@@ -7,6 +7,7 @@
 #ifndef OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_ERROR_H_
 #define OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_ERROR_H_
 
+#include <cstdint>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -55,14 +56,34 @@ class RasDaemonErrors {
   // `ras-mc-ctl --errors` will be executed every call.
   absl::Status Gather(HostAdapter& host);
 
+  // Gathers only the errors that rasdaemon recorded after the event with id
+  // `since_id`, e.g. the last_event_id() of a previous call, so that polling
+  // doesn't parse the whole history every time. The new events are queried
+  // from rasdaemon's database with `sqlite3` if the host has it. Otherwise,
+  // the older events are skipped in the output of `ras-mc-ctl --errors`
+  // without being parsed. If the database was recreated since `since_id`, all
+  // its events are gathered.
+  absl::Status GatherSince(HostAdapter& host, int64_t since_id);
+
   // Parses the `ras-mc-ctl --errors` content, `ras_errors`, into structured.
-  absl::Status ParseErrorReport(absl::string_view ras_errors);
+  // Events with an id up to `since_id` are skipped, unless they all are.
+  absl::Status ParseErrorReport(absl::string_view ras_errors,
+                                int64_t since_id = 0);
 
   // Memory controller errors.
   const std::vector<Error>& memory_errors() { return memory_errors_; }
 
+  // The id of the last event gathered, or the `since_id` of GatherSince() if
+  // there was no new event.
+  int64_t last_event_id() const { return last_event_id_; }
+
  private:
+  // Returns true if `line` is an event up to `since_id`, which is skipped
+  // without being parsed.
+  bool SkipEvent(absl::string_view line, int64_t since_id);
+
   std::vector<Error> memory_errors_;
+  int64_t last_event_id_ = 0;
 };
 
 }  // namespace ocpdiag::hwinterface::internal
@@ -6,13 +6,23 @@
 
 #include "ocpdiag/core/hwinterface/backends/host/error.h"
 
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
 #include "absl/time/time.h"
+#include "ocpdiag/core/compat/status_macros.h"
+#include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
+#include "ocpdiag/core/hwinterface/backends/lib/mock_host_adapter.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/mock_remote.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/remote.h"
 #include "ocpdiag/core/testing/file_utils.h"
 #include "ocpdiag/core/testing/status_matchers.h"
 
@@ -22,8 +32,21 @@ namespace {
 using ::ocpdiag::testing::IsOk;
 using ::ocpdiag::testing::StatusIs;
 using ::ocpdiag::testutils::GetDataDependencyFileContents;
+using ::testing::_;
+using ::testing::AllOf;
 using ::testing::ContainerEq;
+using ::testing::ElementsAre;
+using ::testing::Field;
+using ::testing::HasSubstr;
 using ::testing::IsEmpty;
+using ::testing::Return;
+using ::testing::StartsWith;
+
+std::string GetErrorReport() {
+  return GetDataDependencyFileContents(
+      "ocpdiag/core/hwinterface/backends/host/testdata/get_errors/"
+      "error.report");
+}
 
 TEST(RasDaemonErrors, ParseErrorReport) {
   RasDaemonErrors ras;
@@ -118,5 +141,96 @@ TEST(RasDaemonErrors, ParseErrorReportEmpty) {
                        "msg:[malform], line []"));
 }
 
+TEST(RasDaemonErrors, ParseErrorReportSinceId) {
+  RasDaemonErrors ras;
+  EXPECT_THAT(ras.ParseErrorReport(GetErrorReport(), /*since_id=*/3), IsOk());
+  EXPECT_THAT(ras.memory_errors(),
+              ElementsAre(Field(&Error::debuginfo, StartsWith("4 ")),
+                          Field(&Error::debuginfo, StartsWith("6 "))));
+  EXPECT_EQ(ras.last_event_id(), 6);
+
+  EXPECT_THAT(ras.ParseErrorReport(GetErrorReport(), /*since_id=*/6), IsOk());
+  EXPECT_THAT(ras.memory_errors(), IsEmpty());
+  EXPECT_EQ(ras.last_event_id(), 6);
+}
+
+TEST(RasDaemonErrors, ParseErrorReportAfterDatabaseRecreated) {
+  RasDaemonErrors ras;
+  EXPECT_THAT(ras.ParseErrorReport(GetErrorReport(), /*since_id=*/100),
+              IsOk());
+  EXPECT_EQ(ras.memory_errors().size(), 5);
+  EXPECT_EQ(ras.last_event_id(), 6);
+}
+
+TEST(RasDaemonErrors, GatherSinceQueriesDatabase) {
+  MockHostAdapter host;
+  EXPECT_CALL(host, RunCommand(_, ElementsAre("sqlite3", _, _, _, _)))
+      .WillOnce(Return(HostAdapter::CommandResult{
+          .stdout =
+              "7 2021-06-03 15:13:41 +0000 1 Corrected error(s): FAKE ERROR "
+              "at CPU_SrcID#0_MC#0_Chan#0_DIMM#0 location: 0:0:0:0, addr 0, "
+              "grain 5, syndrome 0 for EDAC testing only\n"
+              "8 2021-06-03 15:13:42 +0000 1 Info error(s): FAKE ERROR at "
+              "CPU_SrcID#0_MC#0_Chan#0_DIMM#0 location: 0:0:0:0, addr 0, "
+              "grain 5, syndrome 0 for EDAC testing only\n"}));
+
+  RasDaemonErrors ras;
+  EXPECT_THAT(ras.GatherSince(host, /*since_id=*/6), IsOk());
+  EXPECT_THAT(ras.memory_errors(),
+              ElementsAre(Field(&Error::debuginfo, StartsWith("7 "))));
+  EXPECT_EQ(ras.last_event_id(), 8);
+
+  EXPECT_CALL(host, RunCommand(_, ElementsAre("sqlite3", _, _, _, _)))
+      .WillOnce(Return(HostAdapter::CommandResult{}));
+  EXPECT_THAT(ras.GatherSince(host, /*since_id=*/8), IsOk());
+  EXPECT_THAT(ras.memory_errors(), IsEmpty());
+  EXPECT_EQ(ras.last_event_id(), 8);
+}
+
+TEST(RasDaemonErrors, GatherSinceQueryReachesRemoteSqliteAsOneArgument) {
+  // Splits the remote command line into words like the remote shell does.
+  std::vector<std::string> words;
+  auto conn = std::make_unique<remote::MockConnInterface>();
+  EXPECT_CALL(*conn, RunCommand)
+      .WillOnce([&words](absl::Duration timeout,
+                         const std::vector<std::string>& args,
+                         const remote::ConnInterface::CommandOption&)
+                    -> absl::StatusOr<remote::ConnInterface::CommandResult> {
+        LocalHostAdapter local;
+        ASSIGN_OR_RETURN(
+            HostAdapter::CommandResult result,
+            local.RunCommand(timeout, {"/bin/sh", "-c",
+                                       absl::StrCat("printf '%s\\n' ",
+                                                    absl::StrJoin(args, " "))}));
+        words = absl::StrSplit(result.stdout, '\n', absl::SkipEmpty());
+        return remote::ConnInterface::CommandResult{.exit_code = 0};
+      });
+  RemoteHostAdapter remote(std::move(conn));
+
+  RasDaemonErrors ras;
+  EXPECT_THAT(ras.GatherSince(remote, /*since_id=*/6), IsOk());
+  EXPECT_THAT(
+      words,
+      ElementsAre("sqlite3", "-batch", "-noheader",
+                  "/var/lib/rasdaemon/ras-mc_event.db",
+                  AllOf(StartsWith("SELECT id || ' ' || timestamp || "),
+                        HasSubstr(" FROM mc_event WHERE id > 6 OR (SELECT "
+                                  "max(id) FROM mc_event) < 6 ORDER BY id;"))));
+}
+
+TEST(RasDaemonErrors, GatherSinceWithoutSqliteFallsBackToRasMcCtl) {
+  MockHostAdapter host;
+  EXPECT_CALL(host, RunCommand(_, ElementsAre("sqlite3", _, _, _, _)))
+      .WillOnce(Return(HostAdapter::CommandResult{.exit_code = 127}));
+  EXPECT_CALL(host, RunCommand(_, ElementsAre("ras-mc-ctl", "--errors")))
+      .WillOnce(Return(HostAdapter::CommandResult{.stdout = GetErrorReport()}));
+
+  RasDaemonErrors ras;
+  EXPECT_THAT(ras.GatherSince(host, /*since_id=*/4), IsOk());
+  EXPECT_THAT(ras.memory_errors(),
+              ElementsAre(Field(&Error::debuginfo, StartsWith("6 "))));
+  EXPECT_EQ(ras.last_event_id(), 6);
+}
+
 }  // namespace
 }  // namespace ocpdiag::hwinterface::internal
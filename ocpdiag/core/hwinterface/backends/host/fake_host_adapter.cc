@@ -40,6 +40,8 @@ RealisticHostAdapter::RealisticHostAdapter(bool support_cpu_scaling) {
   const int kCpuTotalCount = kSocketCount * kThreadsPerCore * kCoresPerSocket;
 
   CHECK_OK(Write("/proc/cpuinfo", GetTestDataContents("cpuinfo.tsv")));
+  CHECK_OK(Write("/sys/devices/system/cpu/online",
+                 absl::StrCat("0-", kCpuTotalCount - 1)));
   CHECK_OK(Write("/sys/devices/system/node/online", "0-1"));
   CHECK_OK(Write("/sys/devices/system/node/node0/cpulist", "0-1,4-5"));
   CHECK_OK(Write("/sys/devices/system/node/node1/cpulist", "2-3,6-7"));
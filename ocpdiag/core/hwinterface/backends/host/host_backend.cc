@@ -8,25 +8,32 @@
 
 #include <stdint.h>
 
+#include <filesystem>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
 #include "google/protobuf/timestamp.pb.h"
+#include "absl/algorithm/container.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
 #include "absl/time/time.h"
 #include "ecclesia/lib/smbios/reader.h"
 #include "ecclesia/lib/smbios/structures.emb.h"
 #include "ecclesia/lib/smbios/system_information.h"
 #include "ocpdiag/core/compat/status_macros.h"
 #include "ocpdiag/core/hwinterface/backends/host/cpu.h"
+#include "ocpdiag/core/hwinterface/backends/host/edac.h"
 #include "ocpdiag/core/hwinterface/backends/host/error.h"
+#include "ocpdiag/core/hwinterface/backends/host/network.h"
 #include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
 #include "ocpdiag/core/hwinterface/backends/lib/hw_info.h"
 #include "ocpdiag/core/hwinterface/backends/lib/utils.h"
@@ -43,6 +50,23 @@ namespace internal {
 
 const absl::Duration kSoftRebootTimeout = absl::Minutes(5);
 constexpr absl::string_view kDmiTablePath = "/sys/firmware/dmi/tables/DMI";
+constexpr absl::string_view kCpuOnlinePath = "/sys/devices/system/cpu/online";
+constexpr absl::string_view kNodeOnlinePath = "/sys/devices/system/node/online";
+// The GetErrors cursor is the id of the last rasdaemon event after this.
+constexpr absl::string_view kMcEventCursorPrefix = "mc_event:";
+
+namespace {
+
+// Returns the ids of all LPUs in `topology`.
+std::vector<int> TopologyCpuIds(const CpuTopology& topology) {
+  std::vector<int> cpu_ids;
+  for (const CpuNumaNode& node : topology.numa_nodes()) {
+    for (const CpuLpu& lpu : node.lpus()) cpu_ids.push_back(lpu.cpu_id());
+  }
+  return cpu_ids;
+}
+
+}  // namespace
 
 absl::StatusOr<std::unique_ptr<OCPDiagServiceInterface>> HostBackend::Create(
     const EntityConfiguration& config) {
@@ -52,7 +76,8 @@ absl::StatusOr<std::unique_ptr<OCPDiagServiceInterface>> HostBackend::Create(
     return std::make_unique<HostBackend>(config, std::move(remote));
   }
   return std::make_unique<HostBackend>(config,
-                                       std::make_unique<LocalHostAdapter>());
+                                       std::make_unique<LocalHostAdapter>(),
+                                       std::make_unique<RtnetlinkSocket>());
 }
 
 absl::StatusOr<ecclesia::SmbiosReader*> HostBackend::GetSmbiosReader() {
@@ -66,35 +91,81 @@ absl::StatusOr<ecclesia::SmbiosReader*> HostBackend::GetSmbiosReader() {
   return smbios_reader_.get();
 }
 
+void HostBackend::InvalidateCpuInventoryOnHotplug() {
+  // Hotplug uevents aren't visible through a HostAdapter, so compare the
+  // online masks instead, which is a single small read.
+  const std::vector<std::filesystem::path> paths = {kCpuOnlinePath,
+                                                    kNodeOnlinePath};
+  absl::StatusOr<std::vector<absl::StatusOr<std::string>>> online =
+      host_adapter_->Sample(paths);
+  std::string cpu_online;
+  if (online.ok() && online->size() == paths.size() && (*online)[0].ok() &&
+      (*online)[1].ok()) {
+    cpu_online = absl::StrCat(*(*online)[0], "\n", *(*online)[1]);
+  }
+  // An inventory gathered without the masks is never reused.
+  if (cpu_online.empty() || cpu_online != cpu_online_) {
+    cpu_topology_ = nullptr;
+    cpu_signature_ = nullptr;
+  }
+  cpu_online_ = std::move(cpu_online);
+}
+
+absl::StatusOr<const CpuTopology*> HostBackend::GetCpuTopology() {
+  if (cpu_topology_ == nullptr) {
+    auto topology = std::make_unique<CpuTopology>();
+    RETURN_IF_ERROR(topology->Gather(*host_adapter_));
+    cpu_topology_ = std::move(topology);
+  }
+  return cpu_topology_.get();
+}
+
+absl::StatusOr<const CpuSignature*> HostBackend::GetCpuSignature() {
+  if (cpu_signature_ == nullptr) {
+    auto signature = std::make_unique<CpuSignature>();
+    RETURN_IF_ERROR(signature->Gather(*host_adapter_));
+    cpu_signature_ = std::move(signature);
+  }
+  return cpu_signature_.get();
+}
+
 absl::StatusOr<GetCpuInfoResponse> HostBackend::GetCpuInfo(
     const GetCpuInfoRequest& req) {
   GetCpuInfoResponse resp;
   cpu::Info& info = *resp.mutable_info();
-  CpuTopology topology;
-  CpuSignature sig;
+  InvalidateCpuInventoryOnHotplug();
 
   if (InfoTypeHave(req.info_types(), cpu::InfoType::TOPOLOGY)) {
-    RETURN_IF_ERROR(topology.Gather(*host_adapter_));
+    ASSIGN_OR_RETURN(const CpuTopology* topology, GetCpuTopology());
     cpu::Topology& t = *info.mutable_topology();
-    t.set_sockets_enabled(topology.sockets_count());
-    t.set_logical_cores_enabled(topology.logical_cores_count());
-    t.set_physical_cores_enabled(topology.physical_cores_count());
-    t.set_logical_cores_max_per_socket(topology.logical_cores_max_per_socket());
+    t.set_sockets_enabled(topology->sockets_count());
+    t.set_logical_cores_enabled(topology->logical_cores_count());
+    t.set_physical_cores_enabled(topology->physical_cores_count());
+    t.set_logical_cores_max_per_socket(
+        topology->logical_cores_max_per_socket());
   }
 
   if (InfoTypeHave(req.info_types(), cpu::InfoType::SIGNATURE)) {
-    RETURN_IF_ERROR(sig.Gather(*host_adapter_));
+    ASSIGN_OR_RETURN(const CpuSignature* sig, GetCpuSignature());
     cpu::Signature& c = *info.mutable_signature();
-    c.set_vendor(sig.vendor());
-    c.set_family(sig.family());
-    c.set_model(sig.model());
-    c.set_stepping(sig.stepping());
+    c.set_vendor(sig->vendor());
+    c.set_family(sig->family());
+    c.set_model(sig->model());
+    c.set_stepping(sig->stepping());
   }
 
   if (InfoTypeHave(req.info_types(), cpu::InfoType::LPU_INFO)) {
-    RETURN_IF_ERROR(topology.Gather(*host_adapter_));
-    RETURN_IF_ERROR(sig.Gather(*host_adapter_));
-    for (const CpuNumaNode& node : topology.numa_nodes()) {
+    ASSIGN_OR_RETURN(const CpuTopology* topology, GetCpuTopology());
+    ASSIGN_OR_RETURN(const CpuSignature* sig, GetCpuSignature());
+    ASSIGN_OR_RETURN(std::vector<CpuMicrocode> microcodes,
+                     CpuMicrocode::GatherAll(*host_adapter_,
+                                             TopologyCpuIds(*topology),
+                                             sig->microcode()));
+    for (const CpuMicrocode& microcode : microcodes) {
+      (*info.mutable_lpu_info())[microcode.cpu_id()].set_microcode_revision(
+          microcode.revision());
+    }
+    for (const CpuNumaNode& node : topology->numa_nodes()) {
       for (const CpuLpu& host_lpu : node.lpus()) {
         cpu::LpuInfo& lpu = (*info.mutable_lpu_info())[host_lpu.cpu_id()];
         lpu.set_socket_id(host_lpu.socket_id());
@@ -102,41 +173,37 @@ absl::StatusOr<GetCpuInfoResponse> HostBackend::GetCpuInfo(
         lpu.set_core_id(host_lpu.core_id());
         lpu.set_thread_id(host_lpu.thread_id());
         lpu.set_numa_node_id(host_lpu.numa_node_id());
-        lpu.set_microcode_revision(sig.microcode());
       }
     }
   }
 
   if (InfoTypeHave(req.info_types(), cpu::InfoType::FREQUENCY)) {
-    RETURN_IF_ERROR(topology.Gather(*host_adapter_));
-    for (const CpuNumaNode& node : topology.numa_nodes()) {
-      for (const CpuLpu& host_lpu : node.lpus()) {
-        CpuFrequency cpu_freq(host_lpu.cpu_id());
-        RETURN_IF_ERROR(cpu_freq.Gather(*host_adapter_));
-        cpu::LpuFrequency& freq =
-            (*info.mutable_frequency())[cpu_freq.cpu_id()];
-        freq.set_design_freq(cpu_freq.design_freq());
-        freq.set_cur_freq(cpu_freq.cur_freq());
-        freq.set_max_freq(cpu_freq.max_freq());
-      }
+    ASSIGN_OR_RETURN(const CpuTopology* topology, GetCpuTopology());
+    ASSIGN_OR_RETURN(
+        std::vector<CpuFrequency> cpu_freqs,
+        CpuFrequency::GatherAll(*host_adapter_, TopologyCpuIds(*topology)));
+    for (const CpuFrequency& cpu_freq : cpu_freqs) {
+      cpu::LpuFrequency& freq = (*info.mutable_frequency())[cpu_freq.cpu_id()];
+      freq.set_design_freq(cpu_freq.design_freq());
+      freq.set_cur_freq(cpu_freq.cur_freq());
+      freq.set_max_freq(cpu_freq.max_freq());
     }
   }
 
   if (InfoTypeHave(req.info_types(), cpu::InfoType::THROTTLE_INFO)) {
-    RETURN_IF_ERROR(topology.Gather(*host_adapter_));
-    for (const CpuNumaNode& node : topology.numa_nodes()) {
-      for (const CpuLpu& host_lpu : node.lpus()) {
-        CpuThrottleInfo cpu_throttle(host_lpu.cpu_id());
-        RETURN_IF_ERROR(cpu_throttle.Gather(*host_adapter_));
-        (*info.mutable_thermal_throttle_count())[cpu_throttle.cpu_id()] =
-            cpu_throttle.core_throttle_count();
-      }
+    ASSIGN_OR_RETURN(const CpuTopology* topology, GetCpuTopology());
+    ASSIGN_OR_RETURN(
+        std::vector<CpuThrottleInfo> cpu_throttles,
+        CpuThrottleInfo::GatherAll(*host_adapter_, TopologyCpuIds(*topology)));
+    for (const CpuThrottleInfo& cpu_throttle : cpu_throttles) {
+      (*info.mutable_thermal_throttle_count())[cpu_throttle.cpu_id()] =
+          cpu_throttle.core_throttle_count();
     }
   }
 
   if (InfoTypeHave(req.info_types(), cpu::InfoType::LPU_IDENTIFIER)) {
-    RETURN_IF_ERROR(topology.Gather(*host_adapter_));
-    for (const CpuNumaNode& node : topology.numa_nodes()) {
+    ASSIGN_OR_RETURN(const CpuTopology* topology, GetCpuTopology());
+    for (const CpuNumaNode& node : topology->numa_nodes()) {
       for (const CpuLpu& host_lpu : node.lpus()) {
         Identifier& id = (*info.mutable_lpu_identifiers())[host_lpu.cpu_id()];
         id.set_name(host_lpu.name());
@@ -146,8 +213,8 @@ absl::StatusOr<GetCpuInfoResponse> HostBackend::GetCpuInfo(
   }
 
   if (InfoTypeHave(req.info_types(), cpu::InfoType::SOCKET_IDENTIFIER)) {
-    RETURN_IF_ERROR(topology.Gather(*host_adapter_));
-    for (const CpuNumaNode& node : topology.numa_nodes()) {
+    ASSIGN_OR_RETURN(const CpuTopology* topology, GetCpuTopology());
+    for (const CpuNumaNode& node : topology->numa_nodes()) {
       for (const CpuLpu& host_lpu : node.lpus()) {
         Identifier& id =
             (*info.mutable_socket_identifiers())[host_lpu.cpu_id()];
@@ -158,8 +225,8 @@ absl::StatusOr<GetCpuInfoResponse> HostBackend::GetCpuInfo(
   }
 
   if (InfoTypeHave(req.info_types(), cpu::InfoType::PACKAGE_IDENTIFIER)) {
-    RETURN_IF_ERROR(topology.Gather(*host_adapter_));
-    for (const CpuNumaNode& node : topology.numa_nodes()) {
+    ASSIGN_OR_RETURN(const CpuTopology* topology, GetCpuTopology());
+    for (const CpuNumaNode& node : topology->numa_nodes()) {
       for (const CpuLpu& host_lpu : node.lpus()) {
         Identifier& id =
             (*info.mutable_package_identifiers())[host_lpu.cpu_id()];
@@ -185,9 +252,21 @@ absl::StatusOr<GetErrorsResponse> HostBackend::GetErrors(
         req.filter().end_timestamp().seconds()));
   }
 
-  RETURN_IF_ERROR(ras.Gather(*host_adapter_));
-
   if (InfoTypeHave(req.event_sources(), error::EventSource::MEMORY_ERROR)) {
+    if (req.since_cursor().empty()) {
+      RETURN_IF_ERROR(ras.Gather(*host_adapter_));
+    } else {
+      absl::string_view since_cursor = req.since_cursor();
+      int64_t since_id;
+      if (!absl::ConsumePrefix(&since_cursor, kMcEventCursorPrefix) ||
+          !absl::SimpleAtoi(since_cursor, &since_id) || since_id < 0) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Invalid since_cursor: ", req.since_cursor()));
+      }
+      RETURN_IF_ERROR(ras.GatherSince(*host_adapter_, since_id));
+    }
+    resp.set_cursor(absl::StrCat(kMcEventCursorPrefix, ras.last_event_id()));
+
     for (const Error& err : ras.memory_errors()) {
       google::protobuf::Timestamp ts;
       ts.set_seconds(absl::ToUnixSeconds(err.timestamp));
@@ -219,9 +298,37 @@ absl::StatusOr<GetErrorsResponse> HostBackend::GetErrors(
       }
     }
   }
+
+  if (absl::c_linear_search(req.event_sources(),
+                            error::EventSource::EDAC_MEMORY_ERROR)) {
+    ASSIGN_OR_RETURN(EdacCounters edac, WatchMemoryErrors());
+    for (error::ErrorInfo& err_info :
+         EdacErrorInfos(edac.counts(), edac.sampled_at())) {
+      if (!req.report_debug_info()) err_info.clear_other_debug_info();
+      *resp.add_errors() = std::move(err_info);
+    }
+  }
   return resp;
 }
 
+absl::StatusOr<EdacCounters> HostBackend::WatchMemoryErrors() {
+  // The DIMMs are named like the DIMM identifiers of GetMemoryInfo(), by their
+  // index among the memory devices. Without SMBIOS tables, they keep their
+  // EDAC labels.
+  absl::flat_hash_map<std::string, std::string> dimm_names;
+  if (absl::StatusOr<ecclesia::SmbiosReader*> reader = GetSmbiosReader();
+      reader.ok()) {
+    int index = 0;
+    for (const auto& memory_device : (*reader)->GetAllMemoryDevices()) {
+      dimm_names.emplace(
+          memory_device.GetString(
+              memory_device.GetMessageView().device_locator_snum().Read()),
+          absl::StrCat("DIMM", index++));
+    }
+  }
+  return EdacCounters::Create(*host_adapter_, dimm_names);
+}
+
 absl::StatusOr<GetHwInfoResponse> HostBackend::GetHwInfo(
     const GetHwInfoRequest& request) {
   GetHwInfoResponse response;
@@ -11,11 +11,20 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include "google/protobuf/repeated_field.h"
 #include "absl/status/statusor.h"
 #include "ecclesia/lib/smbios/reader.h"
+#include "ocpdiag/core/hwinterface/backends/host/cpu.h"
+#include "ocpdiag/core/hwinterface/backends/host/edac.h"
+#include "ocpdiag/core/hwinterface/backends/host/hwmon.h"
+#include "ocpdiag/core/hwinterface/backends/host/memory_address_index.h"
+#include "ocpdiag/core/hwinterface/backends/host/network.h"
+#include "ocpdiag/core/hwinterface/backends/host/pcie.h"
 #include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
 #include "ocpdiag/core/hwinterface/config.pb.h"
+#include "ocpdiag/core/hwinterface/identifier.pb.h"
 #include "ocpdiag/core/hwinterface/service.pb.h"
 #include "ocpdiag/core/hwinterface/service_interface.h"
 
@@ -23,15 +32,24 @@ namespace ocpdiag::hwinterface {
 
 namespace internal {
 
+// The FRUs of a source that GetNodeInfo() gathers in the background.
+struct PendingFrus;
+
 // This class implements the methods of OCPDiagServiceInterface via
 // host diagnostic interface.
 // It is not meant to be called directly, instead please use the OCPDiag
 // Service Client.
 class HostBackend : public OCPDiagServiceInterface {
  public:
+  // The network interfaces are dumped through `netlink`, which is only
+  // possible on the local host. Without it, GetNetworkInterfaceInfo() is
+  // unimplemented.
   explicit HostBackend(const EntityConfiguration& config,
-                       std::unique_ptr<HostAdapter> host_adapter)
-      : config_(config), host_adapter_(std::move(host_adapter)) {
+                       std::unique_ptr<HostAdapter> host_adapter,
+                       std::unique_ptr<NetlinkSocket> netlink = nullptr)
+      : config_(config),
+        host_adapter_(std::move(host_adapter)),
+        netlink_(std::move(netlink)) {
     assert(host_adapter_.get());
   }
   static absl::StatusOr<std::unique_ptr<OCPDiagServiceInterface>> Create(
@@ -64,15 +82,102 @@ class HostBackend : public OCPDiagServiceInterface {
   absl::StatusOr<GetStorageInfoResponse> GetStorageInfo(
       const GetStorageInfoRequest& req) final;
 
+  // The FRUs are the CPUs, DIMMs, storage devices and PCIe cards. Storage
+  // devices and PCIe cards are enumerated concurrently, each within a deadline.
+  // A source that fails or misses its deadline is reported in fru_errors, with
+  // the FRUs of the other sources; an error is only returned if every source
+  // failed. A source that missed its deadline isn't restarted until it is
+  // done, and neither this nor the destructor blocks on it.
   absl::StatusOr<GetNodeInfoResponse> GetNodeInfo(
       const GetNodeInfoRequest& req) final;
 
+  // The PCI functions under /sys/bus/pci/devices, read in process. A request
+  // for nothing but the METRIC or ENABLED state of the functions re-samples the
+  // links and AER counters of those walked by the previous request, which is
+  // much cheaper than walking them again, e.g. to audit the links repeatedly.
+  absl::StatusOr<GetPcieInfoResponse> GetPcieInfo(
+      const GetPcieInfoRequest& req) final;
+
+  // The network interfaces, with their links and counters, from a single
+  // RTM_GETLINK dump, and the link speeds from sysfs. Unlike running `ip` or
+  // `ethtool` per interface, this scales to hosts with many virtual functions.
+  absl::StatusOr<GetNetworkInterfaceInfoResponse> GetNetworkInterfaceInfo(
+      const GetNetworkInterfaceInfoRequest& req) final;
+
+  // Returns a sampler of the counters of the network interfaces named
+  // `interfaces`, e.g. as in the identifiers of GetNetworkInterfaceInfo(), to
+  // measure their throughput or error rates much more cheaply than with
+  // repeated GetNetworkInterfaceInfo() calls.
+  std::unique_ptr<LinkCounterSampler> SampleLinkCounters(
+      std::vector<std::string> interfaces);
+
+  // The temperature, voltage, fan, power and current sensors of the hwmon
+  // devices under /sys/class/hwmon, with their crit, max, lcrit and min
+  // attributes as limits.
+  absl::StatusOr<GetSensorsResponse> GetSensors(
+      const GetSensorsRequest& req) final;
+
+  // Starts a sampling session of the sensors matching `sensor_filters`, or of
+  // all of them without filters, like GetSensors(). The sampler re-reads the
+  // same files at a fixed rate, e.g. every 10ms to follow the temperatures and
+  // power of a thermal test, which GetSensors() is far too slow for.
+  absl::StatusOr<std::unique_ptr<HwmonSampler>> SampleSensors(
+      const google::protobuf::RepeatedPtrField<Filter>& sensor_filters);
+
+  // Starts watching the memory error counters of the EDAC driver, which is
+  // much cheaper than polling GetErrors(), e.g. to catch a burst of errors
+  // during a memory stress test with EdacCounters::WaitForErrors(). The DIMMs
+  // whose labels match an SMBIOS device locator are named like the DIMM
+  // identifiers of GetMemoryInfo() and GetNodeInfo().
+  absl::StatusOr<EdacCounters> WatchMemoryErrors();
+
  private:
   EntityConfiguration config_;
-  std::unique_ptr<HostAdapter> host_adapter_;
+  // Shared with the threads that GetNodeInfo() gathers FRUs on, which may
+  // outlive the backend.
+  std::shared_ptr<HostAdapter> host_adapter_;
+  std::unique_ptr<NetlinkSocket> netlink_;
+
+  // Implements GetStorageInfo() with `host` alone, so that it can run on a
+  // thread that doesn't hold the backend.
+  static absl::StatusOr<GetStorageInfoResponse> ReadStorageInfo(
+      HostAdapter& host, const GetStorageInfoRequest& req);
 
   absl::StatusOr<ecclesia::SmbiosReader*> GetSmbiosReader();
   std::unique_ptr<ecclesia::SmbiosReader> smbios_reader_;
+
+  // Built from the SMBIOS tables on the first MemoryConvert().
+  absl::StatusOr<const MemoryAddressIndex*> GetMemoryAddressIndex();
+  std::unique_ptr<MemoryAddressIndex> memory_address_index_;
+
+  // The CPU topology and signature don't change while the same CPUs are
+  // online, so they are gathered once and kept until a CPU or NUMA node is
+  // hotplugged. The microcode revisions are not cached, since a late
+  // microcode load changes them.
+  absl::StatusOr<const CpuTopology*> GetCpuTopology();
+  absl::StatusOr<const CpuSignature*> GetCpuSignature();
+  // Drops the cached CPU inventory if the online CPUs or NUMA nodes changed
+  // since it was gathered.
+  void InvalidateCpuInventoryOnHotplug();
+  // The online CPUs and NUMA nodes when the cached inventory was gathered.
+  std::string cpu_online_;
+  std::unique_ptr<CpuTopology> cpu_topology_;
+  std::unique_ptr<CpuSignature> cpu_signature_;
+
+  // Reads the hwmon sensors matching `sensor_filters`. Fails with NOT_FOUND if
+  // there are filters that no sensor matches.
+  absl::StatusOr<std::vector<HwmonSensor>> FindSensors(
+      const google::protobuf::RepeatedPtrField<Filter>& sensor_filters);
+
+  // The PCI functions walked by the last GetPcieInfo().
+  std::unique_ptr<PcieDevices> pcie_devices_;
+
+  // The FRUs of the storage devices and PCIe cards, each gathered on a
+  // detached thread for GetNodeInfo(). A source that missed its deadline keeps
+  // running, and the next GetNodeInfo() waits for it rather than starting
+  // another, so a hung command doesn't pile up threads.
+  std::shared_ptr<PendingFrus> storage_frus_;
+  std::shared_ptr<PendingFrus> pcie_frus_;
 };
 
 }  // namespace internal
@@ -21,6 +21,7 @@
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
 #include "ocpdiag/core/hwinterface/backends/host/fake_host_adapter.h"
+#include "ocpdiag/core/hwinterface/backends/lib/fake_host_adapter.h"
 #include "ocpdiag/core/hwinterface/backends/lib/mock_host_adapter.h"
 #include "ocpdiag/core/hwinterface/error.pb.h"
 #include "ocpdiag/core/hwinterface/service.pb.h"
@@ -43,6 +44,8 @@ using ::ocpdiag::testing::IsOkAndHolds;
 using ::ocpdiag::testing::ParseTextProtoOrDie;
 using ::ocpdiag::testing::StatusIs;
 using ::testing::_;
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
 using ::testing::NotNull;
 using ::testing::Return;
 
@@ -77,6 +80,57 @@ TEST(HostBackend, GetCpuInfo) {
               IsOkAndHolds(EqualsProto(expected)));
 }
 
+TEST(HostBackend, GetCpuInfoKeepsTopologyUntilHotplug) {
+  auto host = std::make_unique<RealisticHostAdapter>();
+  RealisticHostAdapter* fake = host.get();
+  HostBackend backend(EntityConfiguration(), std::move(host));
+  GetCpuInfoRequest req;
+  req.add_info_types(cpu::InfoType::TOPOLOGY);
+  req.add_info_types(cpu::InfoType::FREQUENCY);
+
+  absl::StatusOr<GetCpuInfoResponse> resp = backend.GetCpuInfo(req);
+  ASSERT_OK(resp);
+  EXPECT_EQ(resp->info().topology().logical_cores_enabled(), 8);
+
+  // The topology is not read again while the same CPUs are online, but the
+  // frequencies are.
+  ASSERT_OK(fake->Write("/sys/devices/system/node/node1/cpulist", "2-3"));
+  ASSERT_OK(fake->Write(
+      "/sys/devices/system/cpu/cpu2/cpufreq/scaling_cur_freq", "1234"));
+  resp = backend.GetCpuInfo(req);
+  ASSERT_OK(resp);
+  EXPECT_EQ(resp->info().topology().logical_cores_enabled(), 8);
+  EXPECT_EQ(resp->info().frequency().at(2).cur_freq(), 1234);
+
+  // CPUs 6 and 7 went offline.
+  ASSERT_OK(fake->Write("/sys/devices/system/cpu/online", "0-5"));
+  resp = backend.GetCpuInfo(req);
+  ASSERT_OK(resp);
+  EXPECT_EQ(resp->info().topology().logical_cores_enabled(), 6);
+  EXPECT_EQ(resp->info().frequency().size(), 6);
+}
+
+TEST(HostBackend, GetCpuInfoRereadsMicrocodeRevision) {
+  auto host = std::make_unique<RealisticHostAdapter>();
+  RealisticHostAdapter* fake = host.get();
+  HostBackend backend(EntityConfiguration(), std::move(host));
+  GetCpuInfoRequest req;
+  req.add_info_types(cpu::InfoType::LPU_INFO);
+
+  ASSERT_OK(fake->Write("/sys/devices/system/cpu/cpu3/microcode/version",
+                        "0x2b000461"));
+  absl::StatusOr<GetCpuInfoResponse> resp = backend.GetCpuInfo(req);
+  ASSERT_OK(resp);
+  EXPECT_EQ(resp->info().lpu_info().at(3).microcode_revision(), 0x2b000461);
+
+  // A late microcode load updates the revision without a hotplug.
+  ASSERT_OK(fake->Write("/sys/devices/system/cpu/cpu3/microcode/version",
+                        "0x2b000590"));
+  resp = backend.GetCpuInfo(req);
+  ASSERT_OK(resp);
+  EXPECT_EQ(resp->info().lpu_info().at(3).microcode_revision(), 0x2b000590);
+}
+
 TEST(GetErrors, ReturnsSuccessfullyWithTimestampFilter) {
   auto mock_host = std::make_unique<MockHostAdapter>();
 
@@ -126,6 +180,61 @@ TEST(GetErrors, ReturnsSuccessfully) {
               IsOkAndHolds(EqualsProto(expected)));
 }
 
+TEST(GetErrors, ReturnsErrorsSinceCursor) {
+  auto mock_host = std::make_unique<MockHostAdapter>();
+  EXPECT_CALL(*mock_host, RunCommand(_, ElementsAre("sqlite3", _, _, _, _)))
+      .WillOnce(Return(HostAdapter::CommandResult{.exit_code = 127}));
+  EXPECT_CALL(*mock_host, RunCommand(_, ElementsAre("ras-mc-ctl", "--errors")))
+      .WillOnce(Return(HostAdapter::CommandResult{
+          .stdout = GetTestDataContents("get_errors/error.report")}));
+  HostBackend backend(EntityConfiguration{}, std::move(mock_host));
+
+  GetErrorsRequest req;
+  req.set_since_cursor("mc_event:4");
+  absl::StatusOr<GetErrorsResponse> resp = backend.GetErrors(req);
+  ASSERT_OK(resp);
+  ASSERT_EQ(resp->errors_size(), 1);
+  EXPECT_EQ(resp->errors(0).event_timestamp().seconds(), 1622733220);
+  EXPECT_EQ(resp->cursor(), "mc_event:6");
+}
+
+TEST(GetErrors, InvalidCursor) {
+  HostBackend backend(EntityConfiguration{},
+                      std::make_unique<MockHostAdapter>());
+
+  GetErrorsRequest req;
+  req.set_since_cursor("kmsg:4");
+  EXPECT_THAT(backend.GetErrors(req),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(GetErrors, ReturnsEdacCountsWithoutRunningCommands) {
+  auto host = std::make_unique<FakeHostAdapter>();
+  ASSERT_OK(host->Write("/sys/devices/system/edac/mc/mc0/dimm0/dimm_label",
+                        "CPU_SrcID#0_MC#0_Chan#0_DIMM#0"));
+  ASSERT_OK(
+      host->Write("/sys/devices/system/edac/mc/mc0/dimm0/dimm_ce_count", "4"));
+  ASSERT_OK(
+      host->Write("/sys/devices/system/edac/mc/mc0/dimm0/dimm_ue_count", "0"));
+  HostBackend backend(EntityConfiguration{}, std::move(host));
+
+  GetErrorsRequest req;
+  req.add_event_sources(error::EventSource::EDAC_MEMORY_ERROR);
+  absl::StatusOr<GetErrorsResponse> resp = backend.GetErrors(req);
+  ASSERT_OK(resp);
+  ASSERT_EQ(resp->errors_size(), 1);
+  EXPECT_EQ(resp->errors(0).event_source(),
+            error::EventSource::EDAC_MEMORY_ERROR);
+  EXPECT_EQ(resp->errors(0).count(), 4);
+  EXPECT_TRUE(resp->errors(0).is_correctable());
+  EXPECT_EQ(resp->errors(0).ids(0).name(), "CPU_SrcID#0_MC#0_Chan#0_DIMM#0");
+  EXPECT_TRUE(resp->errors(0).other_debug_info().empty());
+
+  absl::StatusOr<EdacCounters> watch = backend.WatchMemoryErrors();
+  ASSERT_OK(watch);
+  EXPECT_THAT(watch->Poll(), IsOkAndHolds(IsEmpty()));
+}
+
 TEST(GetErrors, TimeFilterStartTimestampGeaterThanEndTimestampInvalid) {
   HostBackend backend(EntityConfiguration{},
                       std::make_unique<MockHostAdapter>());
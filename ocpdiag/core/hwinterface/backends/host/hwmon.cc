@@ -0,0 +1,265 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/host/hwmon.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/compat/status_macros.h"
+#include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
+#include "ocpdiag/core/hwinterface/backends/lib/hw_info.h"
+#include "ocpdiag/core/hwinterface/identifier.pb.h"
+#include "ocpdiag/core/hwinterface/sensor.pb.h"
+#include "ocpdiag/core/results/data_model/input_model.h"
+#include "ocpdiag/core/results/measurement_series.h"
+#include "ocpdiag/core/results/test_step.h"
+
+namespace ocpdiag::hwinterface::internal {
+namespace {
+
+constexpr char kHwmonNamePattern[] = "/sys/class/hwmon/hwmon*/name";
+
+// A kind of hwmon sensor, after the prefix of its attributes.
+struct HwmonType {
+  absl::string_view prefix;
+  absl::string_view type;
+  absl::string_view unit;
+  // The hwmon sysfs ABI has millidegrees, millivolts, RPMs, microwatts and
+  // milliamperes.
+  double scale;
+};
+
+constexpr HwmonType kHwmonTypes[] = {
+    {"temp", "temperature", "celsius", 1e-3},
+    {"in", "voltage", "volts", 1e-3},
+    {"fan", "fan", "rpm", 1},
+    {"power", "power", "watts", 1e-6},
+    {"curr", "current", "amps", 1e-3},
+};
+
+// Returns the type of the sensor named like "temp1", or nullptr if it isn't a
+// sensor of one of the types.
+const HwmonType* FindHwmonType(absl::string_view sensor) {
+  const size_t digits = sensor.find_first_of("0123456789");
+  if (digits == absl::string_view::npos || digits == 0) return nullptr;
+  for (char c : sensor.substr(digits)) {
+    if (!absl::ascii_isdigit(c)) return nullptr;
+  }
+  for (const HwmonType& type : kHwmonTypes) {
+    if (sensor.substr(0, digits) == type.prefix) return &type;
+  }
+  return nullptr;
+}
+
+absl::StatusOr<double> ParseValue(const std::filesystem::path& path,
+                                  absl::string_view content) {
+  double value;
+  if (!absl::SimpleAtod(absl::StripAsciiWhitespace(content), &value)) {
+    return absl::InternalError(absl::StrFormat(
+        "Failed to parse hwmon attribute %s: \"%s\"", path.string(), content));
+  }
+  return value;
+}
+
+// The attributes of a sensor, by their suffix, e.g. "input" for temp1_input.
+struct SensorAttributes {
+  const HwmonType* type = nullptr;
+  absl::flat_hash_map<std::string, std::string> values;
+};
+
+// Returns the limit of the sensor with the attributes at `prefix` from the
+// attribute `suffix`, in the unit of the sensor, if it has one.
+std::optional<double> Limit(const std::filesystem::path& prefix,
+                            const SensorAttributes& attributes,
+                            absl::string_view suffix) {
+  auto it = attributes.values.find(suffix);
+  if (it == attributes.values.end()) return std::nullopt;
+  absl::StatusOr<double> value =
+      ParseValue(absl::StrCat(prefix.string(), "_", suffix), it->second);
+  if (!value.ok()) return std::nullopt;
+  return *value * attributes.type->scale;
+}
+
+std::vector<std::filesystem::path> Inputs(
+    const std::vector<HwmonSensor>& sensors) {
+  std::vector<std::filesystem::path> inputs;
+  inputs.reserve(sensors.size());
+  for (const HwmonSensor& sensor : sensors) inputs.push_back(sensor.input);
+  return inputs;
+}
+
+}  // namespace
+
+absl::StatusOr<std::vector<HwmonSensor>> ReadHwmonSensors(HostAdapter& host) {
+  std::vector<std::string> patterns = {kHwmonNamePattern};
+  for (const HwmonType& type : kHwmonTypes) {
+    patterns.push_back(
+        absl::StrCat("/sys/class/hwmon/hwmon*/", type.prefix, "[0-9]*_*"));
+  }
+  ASSIGN_OR_RETURN(std::vector<HostAdapter::GlobEntry> entries,
+                   host.ReadGlobs(patterns));
+
+  // The names of the devices, by their directory.
+  absl::flat_hash_map<std::string, std::string> device_names;
+  // The sensors, by the prefix of their attributes, e.g.
+  // /sys/class/hwmon/hwmon2/temp1.
+  std::map<std::filesystem::path, SensorAttributes> sensors;
+  for (const HostAdapter::GlobEntry& entry : entries) {
+    // Write-only attributes can't be read, and some fail without a sensor.
+    if (!entry.content.ok()) continue;
+    const std::string file = entry.path.filename().string();
+    if (file == "name") {
+      device_names[entry.path.parent_path().string()] =
+          std::string(absl::StripAsciiWhitespace(*entry.content));
+      continue;
+    }
+    const size_t separator = file.find('_');
+    if (separator == std::string::npos) continue;
+    const HwmonType* type = FindHwmonType(
+        absl::string_view(file).substr(0, separator));
+    if (type == nullptr) continue;
+    SensorAttributes& attributes =
+        sensors[entry.path.parent_path() / file.substr(0, separator)];
+    attributes.type = type;
+    attributes.values[file.substr(separator + 1)] = *entry.content;
+  }
+
+  std::vector<HwmonSensor> hwmon_sensors;
+  for (const auto& [prefix, attributes] : sensors) {
+    HwmonSensor sensor{.unit = std::string(attributes.type->unit),
+                       .scale = attributes.type->scale};
+    // Some power meters only report an average.
+    absl::string_view input_suffix = "input";
+    if (!attributes.values.contains(input_suffix)) input_suffix = "average";
+    auto input = attributes.values.find(input_suffix);
+    if (input == attributes.values.end()) continue;
+    sensor.input = absl::StrCat(prefix.string(), "_", input_suffix);
+    absl::StatusOr<double> reading = ParseValue(sensor.input, input->second);
+    if (!reading.ok()) continue;
+    sensor.info.mutable_reading()->set_reading(*reading * sensor.scale);
+
+    Identifier& id = *sensor.info.mutable_id();
+    id.set_devpath(prefix.string());
+    auto label = attributes.values.find("label");
+    id.set_name(label != attributes.values.end()
+                    ? std::string(absl::StripAsciiWhitespace(label->second))
+                    : prefix.filename().string());
+    auto device_name = device_names.find(prefix.parent_path().string());
+    if (device_name != device_names.end()) id.set_arena(device_name->second);
+    id.set_type(
+        absl::StrCat(attributes.type->type, "_", attributes.type->unit));
+    PopulateId(id);
+
+    sensor::Limits& limits = *sensor.info.mutable_limits();
+    if (std::optional<double> crit = Limit(prefix, attributes, "crit")) {
+      limits.mutable_upper_critical()->set_limit(*crit);
+    }
+    if (std::optional<double> max = Limit(prefix, attributes, "max")) {
+      limits.mutable_upper_noncritical()->set_limit(*max);
+    }
+    if (std::optional<double> lcrit = Limit(prefix, attributes, "lcrit")) {
+      limits.mutable_lower_critical()->set_limit(*lcrit);
+    }
+    if (std::optional<double> min = Limit(prefix, attributes, "min")) {
+      limits.mutable_lower_noncritical()->set_limit(*min);
+    }
+    hwmon_sensors.push_back(std::move(sensor));
+  }
+  return hwmon_sensors;
+}
+
+HwmonSampler::HwmonSampler(HostAdapter& host, std::vector<HwmonSensor> sensors)
+    : host_(&host), sensors_(std::move(sensors)), inputs_(Inputs(sensors_)) {}
+
+HwmonSampler::~HwmonSampler() { StopStreaming(); }
+
+absl::StatusOr<std::vector<absl::StatusOr<double>>> HwmonSampler::Sample() {
+  if (inputs_.empty()) return std::vector<absl::StatusOr<double>>();
+  ASSIGN_OR_RETURN(std::vector<absl::StatusOr<std::string>> files,
+                   host_->Sample(inputs_));
+  if (files.size() != inputs_.size()) {
+    return absl::InternalError(
+        absl::StrFormat("Sampled %d hwmon sensors, expected %d", files.size(),
+                        inputs_.size()));
+  }
+  std::vector<absl::StatusOr<double>> readings;
+  readings.reserve(files.size());
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (!files[i].ok()) {
+      readings.push_back(files[i].status());
+      continue;
+    }
+    absl::StatusOr<double> value = ParseValue(inputs_[i], *files[i]);
+    if (value.ok()) *value *= sensors_[i].scale;
+    readings.push_back(std::move(value));
+  }
+  return readings;
+}
+
+void HwmonSampler::StreamTo(results::TestStep& step, absl::Duration interval) {
+  StopStreaming();
+  for (const HwmonSensor& sensor : sensors_) {
+    series_.push_back(std::make_unique<results::MeasurementSeries>(
+        results::MeasurementSeriesStart{
+            .name = absl::StrCat(sensor.info.id().arena(), "/",
+                                 sensor.info.id().name()),
+            .unit = sensor.unit},
+        step));
+  }
+  stop_streaming_ = std::make_unique<absl::Notification>();
+  streaming_thread_ = std::thread([this, interval,
+                                   stop = stop_streaming_.get()] {
+    absl::Time next_sample = absl::Now();
+    while (true) {
+      absl::StatusOr<std::vector<absl::StatusOr<double>>> readings = Sample();
+      const timeval timestamp = absl::ToTimeval(absl::Now());
+      if (!readings.ok()) {
+        LOG(ERROR) << "Stopped sampling the hwmon sensors: "
+                   << readings.status();
+        return;
+      }
+      for (size_t i = 0; i < readings->size(); ++i) {
+        if (!(*readings)[i].ok()) continue;
+        series_[i]->AddElement(
+            {.value = *(*readings)[i], .timestamp = timestamp});
+      }
+      // At a fixed rate, without catching up on the samples that were late.
+      next_sample = std::max(next_sample + interval, absl::Now());
+      if (stop->WaitForNotificationWithDeadline(next_sample)) return;
+    }
+  });
+}
+
+void HwmonSampler::StopStreaming() {
+  if (stop_streaming_ == nullptr) return;
+  stop_streaming_->Notify();
+  streaming_thread_.join();
+  stop_streaming_ = nullptr;
+  series_.clear();
+}
+
+}  // namespace ocpdiag::hwinterface::internal
@@ -0,0 +1,94 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_HWMON_H_
+#define OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_HWMON_H_
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
+#include "ocpdiag/core/hwinterface/sensor.pb.h"
+#include "ocpdiag/core/results/measurement_series.h"
+#include "ocpdiag/core/results/test_step.h"
+
+namespace ocpdiag::hwinterface::internal {
+
+// A temperature, voltage, fan, power or current sensor of a hwmon device,
+// e.g. the temp1_* attributes of /sys/class/hwmon/hwmon2.
+struct HwmonSensor {
+  // The identifier is named by the label of the sensor, or else by its
+  // attributes, e.g. "temp1", in the arena of the device's name, e.g.
+  // "coretemp". Its type is like "temperature_celsius", and its devpath is
+  // the common prefix of the attributes, e.g. /sys/class/hwmon/hwmon2/temp1.
+  // The reading and the limits are in `unit`: the crit, max, lcrit and min
+  // attributes are the upper and lower, critical and noncritical limits.
+  sensor::Info info;
+  // For example "celsius".
+  std::string unit;
+  // The attribute of the readings, e.g. temp1_input.
+  std::filesystem::path input;
+  // Converts the attributes, e.g. in millidegrees, to `unit`.
+  double scale = 1;
+};
+
+// Reads the sensors of all the hwmon devices with a single
+// HostAdapter::ReadGlobs() call. The sensors whose input can't be read, e.g.
+// because nothing is connected, are left out.
+absl::StatusOr<std::vector<HwmonSensor>> ReadHwmonSensors(HostAdapter& host);
+
+// HwmonSampler reads a set of sensors over and over through
+// HostAdapter::Sample(), which keeps the files open on the local host. A sample
+// of dozens of sensors is then a pread() each, without spawning or opening
+// anything, which is cheap enough to sample at 100 Hz or more.
+//
+// Sample() is thread-safe, but StreamTo() and StopStreaming() must not be
+// called concurrently.
+class HwmonSampler {
+ public:
+  // Samples `sensors` of `host`, which must outlive this.
+  HwmonSampler(HostAdapter& host, std::vector<HwmonSensor> sensors);
+  HwmonSampler(const HwmonSampler&) = delete;
+  HwmonSampler& operator=(const HwmonSampler&) = delete;
+  // Stops streaming.
+  ~HwmonSampler();
+
+  const std::vector<HwmonSensor>& sensors() const { return sensors_; }
+
+  // Reads the sensors, and returns their readings in the order of sensors().
+  // Each sensor succeeds or fails on its own.
+  absl::StatusOr<std::vector<absl::StatusOr<double>>> Sample();
+
+  // Samples every `interval` in the background, at a fixed rate, until
+  // StopStreaming() is called. The readings of each sensor are added to a
+  // MeasurementSeries of its own in `step`, which must outlive the streaming.
+  void StreamTo(results::TestStep& step,
+                absl::Duration interval = absl::Milliseconds(10));
+
+  // Stops streaming, and ends the series.
+  void StopStreaming();
+
+ private:
+  HostAdapter* host_;
+  const std::vector<HwmonSensor> sensors_;
+  // The inputs of `sensors_`.
+  const std::vector<std::filesystem::path> inputs_;
+
+  // A series per sensor while streaming.
+  std::vector<std::unique_ptr<results::MeasurementSeries>> series_;
+  std::unique_ptr<absl::Notification> stop_streaming_;
+  std::thread streaming_thread_;
+};
+
+}  // namespace ocpdiag::hwinterface::internal
+
+#endif  // OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_HWMON_H_
@@ -0,0 +1,176 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/host/hwmon.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/log/check.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/hwinterface/backends/lib/fake_host_adapter.h"
+#include "ocpdiag/core/hwinterface/backends/lib/mock_host_adapter.h"
+#include "ocpdiag/core/hwinterface/sensor.pb.h"
+#include "ocpdiag/core/results/data_model/dut_info.h"
+#include "ocpdiag/core/results/data_model/output_model.h"
+#include "ocpdiag/core/results/data_model/variant.h"
+#include "ocpdiag/core/results/output_receiver.h"
+#include "ocpdiag/core/results/test_run.h"
+#include "ocpdiag/core/results/test_step.h"
+#include "ocpdiag/core/testing/proto_matchers.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::hwinterface::internal {
+namespace {
+
+using ::ocpdiag::testing::EqualsProto;
+using ::ocpdiag::testing::IsOkAndHolds;
+using ::ocpdiag::testing::StatusIs;
+using ::testing::DoubleEq;
+using ::testing::Each;
+using ::testing::Field;
+using ::testing::IsEmpty;
+using ::testing::Not;
+using ::testing::SizeIs;
+
+constexpr char kCoretemp[] = "/sys/class/hwmon/hwmon0";
+constexpr char kSuperIo[] = "/sys/class/hwmon/hwmon1";
+
+class HwmonTest : public ::testing::Test {
+ protected:
+  HwmonTest() {
+    Write(kCoretemp, "name", "coretemp\n");
+    Write(kCoretemp, "temp1_label", "Package id 0\n");
+    Write(kCoretemp, "temp1_input", "45000\n");
+    Write(kCoretemp, "temp1_max", "80000\n");
+    Write(kCoretemp, "temp1_crit", "100000\n");
+    Write(kCoretemp, "temp1_crit_alarm", "0\n");
+    Write(kSuperIo, "name", "nct6775\n");
+    Write(kSuperIo, "fan1_input", "1200\n");
+    Write(kSuperIo, "fan1_min", "300\n");
+    Write(kSuperIo, "in0_input", "1056\n");
+    Write(kSuperIo, "power1_average", "125000000\n");
+    // A sensor without anything connected.
+    Write(kSuperIo, "temp7_input", "");
+    host_.SetReadError(absl::StrCat(kSuperIo, "/temp7_input"),
+                       absl::StatusCode::kUnavailable);
+  }
+
+  void Write(absl::string_view device, absl::string_view attribute,
+             absl::string_view content) {
+    CHECK_OK(host_.Write(absl::StrCat(device, "/", attribute), content));
+  }
+
+  FakeHostAdapter host_;
+};
+
+TEST_F(HwmonTest, ReadsSensors) {
+  absl::StatusOr<std::vector<HwmonSensor>> sensors = ReadHwmonSensors(host_);
+  ASSERT_OK(sensors);
+  ASSERT_THAT(*sensors, SizeIs(4));
+
+  const sensor::Info& package = (*sensors)[0].info;
+  EXPECT_THAT(package.id(), EqualsProto(R"pb(
+                devpath: "/sys/class/hwmon/hwmon0/temp1"
+                name: "Package id 0"
+                arena: "coretemp"
+                type: "temperature_celsius"
+                id: "/sys/class/hwmon/hwmon0/temp1%%Package id 0%coretemp%"
+                    "temperature_celsius"
+              )pb"));
+  EXPECT_EQ(package.reading().reading(), 45);
+  EXPECT_THAT(package.limits(), EqualsProto(R"pb(
+                upper_critical { limit: 100 }
+                upper_noncritical { limit: 80 }
+              )pb"));
+  EXPECT_EQ((*sensors)[0].unit, "celsius");
+  EXPECT_EQ((*sensors)[0].input, "/sys/class/hwmon/hwmon0/temp1_input");
+
+  // Without labels, the sensors are named by their attributes.
+  EXPECT_EQ((*sensors)[1].info.id().name(), "fan1");
+  EXPECT_EQ((*sensors)[1].info.id().type(), "fan_rpm");
+  EXPECT_EQ((*sensors)[1].info.reading().reading(), 1200);
+  EXPECT_EQ((*sensors)[1].info.limits().lower_noncritical().limit(), 300);
+  EXPECT_FALSE((*sensors)[1].info.limits().has_upper_critical());
+
+  EXPECT_EQ((*sensors)[2].info.id().type(), "voltage_volts");
+  EXPECT_THAT((*sensors)[2].info.reading().reading(), DoubleEq(1.056));
+
+  EXPECT_EQ((*sensors)[3].info.id().type(), "power_watts");
+  EXPECT_THAT((*sensors)[3].info.reading().reading(), DoubleEq(125));
+  EXPECT_EQ((*sensors)[3].input, "/sys/class/hwmon/hwmon1/power1_average");
+}
+
+TEST(ReadHwmonSensors, NoSensors) {
+  FakeHostAdapter host;
+  EXPECT_THAT(ReadHwmonSensors(host), IsOkAndHolds(IsEmpty()));
+}
+
+TEST(ReadHwmonSensors, GlobsNotSupported) {
+  MockHostAdapter host;
+  EXPECT_THAT(ReadHwmonSensors(host),
+              StatusIs(absl::StatusCode::kUnimplemented));
+}
+
+TEST_F(HwmonTest, SamplesSensors) {
+  absl::StatusOr<std::vector<HwmonSensor>> sensors = ReadHwmonSensors(host_);
+  ASSERT_OK(sensors);
+  HwmonSampler sampler(host_, *sensors);
+
+  Write(kCoretemp, "temp1_input", "52000\n");
+  host_.SetReadError(absl::StrCat(kSuperIo, "/fan1_input"),
+                     absl::StatusCode::kUnavailable);
+  absl::StatusOr<std::vector<absl::StatusOr<double>>> readings =
+      sampler.Sample();
+  ASSERT_OK(readings);
+  ASSERT_THAT(*readings, SizeIs(4));
+  EXPECT_THAT((*readings)[0], IsOkAndHolds(DoubleEq(52)));
+  EXPECT_THAT((*readings)[1], StatusIs(absl::StatusCode::kUnavailable));
+  EXPECT_THAT((*readings)[3], IsOkAndHolds(DoubleEq(125)));
+}
+
+TEST_F(HwmonTest, StreamsToMeasurementSeries) {
+  absl::StatusOr<std::vector<HwmonSensor>> sensors = ReadHwmonSensors(host_);
+  ASSERT_OK(sensors);
+  sensors->resize(1);
+  HwmonSampler sampler(host_, *sensors);
+
+  results::OutputReceiver receiver;
+  {
+    results::TestRun run({.name = "hwmon_test",
+                          .version = "1.0",
+                          .command_line = "hwmon_test",
+                          .parameters_json = "{}"},
+                         receiver.MakeArtifactWriter());
+    run.StartAndRegisterDutInfo(
+        std::make_unique<results::DutInfo>("dut", "id"));
+    results::TestStep step("step", run);
+    sampler.StreamTo(step, absl::Milliseconds(1));
+    sampler.StopStreaming();
+  }
+
+  ASSERT_THAT(receiver.GetOutputModel().test_steps, SizeIs(1));
+  const std::vector<results::MeasurementSeriesModel>& series =
+      receiver.GetOutputModel().test_steps[0].measurement_series;
+  ASSERT_THAT(series, SizeIs(1));
+  EXPECT_EQ(series[0].start.name, "coretemp/Package id 0");
+  EXPECT_EQ(series[0].start.unit, "celsius");
+  // The first sample is taken right away.
+  EXPECT_THAT(series[0].elements, Not(IsEmpty()));
+  EXPECT_THAT(series[0].elements,
+              Each(Field(&results::MeasurementSeriesElementOutput::value,
+                         results::Variant(45.0))));
+}
+
+}  // namespace
+}  // namespace ocpdiag::hwinterface::internal
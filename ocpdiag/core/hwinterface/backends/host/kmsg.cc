@@ -0,0 +1,272 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/host/kmsg.h"
+
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/hwinterface/error.pb.h"
+#include "ocpdiag/core/results/data_model/input_model.h"
+#include "ocpdiag/core/results/test_step.h"
+#include "re2/re2.h"
+#include "re2/set.h"
+
+namespace ocpdiag::hwinterface::internal {
+namespace {
+
+// /dev/kmsg returns a single record per read, which fails if the record
+// doesn't fit in the buffer. Records are at most about 8KiB.
+constexpr size_t kReadSize = 16384;
+
+// Returns the wall time of the origin of the monotonic clock, which times the
+// kernel log records.
+absl::Time BootTime() {
+  timespec monotonic;
+  clock_gettime(CLOCK_MONOTONIC, &monotonic);
+  return absl::Now() - absl::DurationFromTimespec(monotonic);
+}
+
+}  // namespace
+
+std::vector<KmsgPattern> DefaultKmsgPatterns() {
+  using error::EventSource;
+  return {
+      {.regex = R"(AER: Corrected error)",
+       .event_source = EventSource::PCIE_ERROR,
+       .event_type = "PCIE_AER",
+       .is_correctable = true},
+      {.regex = R"(AER: Uncorrected \(Non-Fatal\) error)",
+       .event_source = EventSource::PCIE_ERROR,
+       .event_type = "PCIE_AER"},
+      {.regex = R"(AER: Uncorrected \(Fatal\) error)",
+       .event_source = EventSource::PCIE_ERROR,
+       .event_type = "PCIE_AER",
+       .is_fatal = true},
+      {.regex = R"(EDAC MC\d+: \d+ CE )",
+       .event_source = EventSource::MEMORY_ERROR,
+       .event_type = "EDAC",
+       .is_correctable = true},
+      {.regex = R"(EDAC MC\d+: \d+ UE )",
+       .event_source = EventSource::MEMORY_ERROR,
+       .event_type = "EDAC"},
+      {.regex = R"(nvme\d+: I/O \d+ .*timeout)",
+       .event_type = "NVME_TIMEOUT"},
+      {.regex = R"(Machine check events logged)",
+       .event_source = EventSource::CPU_ERROR,
+       .event_type = "MCE",
+       .is_correctable = true},
+      {.regex = R"(\[Hardware Error\]: .*Machine check)",
+       .event_source = EventSource::CPU_ERROR,
+       .event_type = "MCE",
+       .is_fatal = true},
+  };
+}
+
+absl::StatusOr<KmsgRecord> ParseKmsgRecord(absl::string_view line) {
+  const size_t prefix_end = line.find(';');
+  if (prefix_end == absl::string_view::npos) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Malformed kmsg record: \"%s\"", line));
+  }
+
+  KmsgRecord record;
+  std::vector<absl::string_view> fields =
+      absl::StrSplit(line.substr(0, prefix_end), ',');
+  int64_t usec;
+  if (fields.size() < 4 || !absl::SimpleAtoi(fields[0], &record.priority) ||
+      !absl::SimpleAtoi(fields[1], &record.sequence) ||
+      !absl::SimpleAtoi(fields[2], &usec)) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Malformed kmsg record: \"%s\"", line));
+  }
+  record.since_boot = absl::Microseconds(usec);
+  record.message = std::string(line.substr(prefix_end + 1));
+  return record;
+}
+
+absl::StatusOr<std::unique_ptr<KmsgTailer>> KmsgTailer::Create(
+    Options options) {
+  auto matcher =
+      std::make_unique<RE2::Set>(RE2::DefaultOptions, RE2::UNANCHORED);
+  for (const KmsgPattern& pattern : options.patterns) {
+    std::string error;
+    if (matcher->Add(pattern.regex, &error) < 0) {
+      return absl::InvalidArgumentError(absl::StrFormat(
+          "Invalid kmsg pattern \"%s\": %s", pattern.regex, error));
+    }
+  }
+  if (!matcher->Compile()) {
+    return absl::ResourceExhaustedError("Failed to compile the kmsg patterns");
+  }
+
+  const int fd = open(options.path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    return absl::Status(
+        absl::ErrnoToStatusCode(errno),
+        absl::StrFormat("Failed to open %s", options.path.string()));
+  }
+  // Past the last record for /dev/kmsg, or the end of a regular file.
+  if (!options.from_start && lseek(fd, 0, SEEK_END) < 0) {
+    const int error = errno;
+    close(fd);
+    return absl::Status(
+        absl::ErrnoToStatusCode(error),
+        absl::StrFormat("Failed to seek to the end of %s",
+                        options.path.string()));
+  }
+  return std::unique_ptr<KmsgTailer>(new KmsgTailer(
+      fd, BootTime(), std::move(options.patterns), std::move(matcher)));
+}
+
+KmsgTailer::KmsgTailer(int fd, absl::Time boot_time,
+                       std::vector<KmsgPattern> patterns,
+                       std::unique_ptr<RE2::Set> matcher)
+    : fd_(fd),
+      boot_time_(boot_time),
+      patterns_(std::move(patterns)),
+      matcher_(std::move(matcher)) {}
+
+KmsgTailer::~KmsgTailer() {
+  StopStreaming();
+  close(fd_);
+}
+
+absl::StatusOr<std::vector<error::ErrorInfo>> KmsgTailer::Poll() {
+  absl::MutexLock lock(&mutex_);
+  std::vector<error::ErrorInfo> errors;
+  char buffer[kReadSize];
+  while (true) {
+    const ssize_t count = read(fd_, buffer, sizeof(buffer));
+    if (count == 0) break;
+    if (count < 0) {
+      if (errno == EAGAIN) break;
+      if (errno == EINTR) continue;
+      // The kernel overwrote records, and the next read returns the oldest
+      // one it still has. How many is told by its sequence number.
+      if (errno == EPIPE) continue;
+      return absl::Status(absl::ErrnoToStatusCode(errno),
+                          "Failed to read the kernel log");
+    }
+
+    // Records are read whole from /dev/kmsg, but may be split across reads
+    // of a regular file.
+    absl::string_view data(buffer, count);
+    std::string joined;
+    if (!partial_record_.empty()) {
+      joined = absl::StrCat(partial_record_, data);
+      data = joined;
+    }
+    for (size_t end = data.find('\n'); end != absl::string_view::npos;
+         end = data.find('\n')) {
+      MatchRecord(data.substr(0, end), errors);
+      data.remove_prefix(end + 1);
+    }
+    partial_record_ = std::string(data);
+  }
+  return errors;
+}
+
+void KmsgTailer::MatchRecord(absl::string_view line,
+                             std::vector<error::ErrorInfo>& errors) {
+  // Skip the continuation lines of dictionary properties, e.g. " DEVICE=+pci:"
+  // and the empty lines.
+  if (line.empty() || line.front() == ' ') return;
+
+  // Match the message before parsing the whole record, since most records
+  // aren't errors.
+  const size_t prefix_end = line.find(';');
+  if (prefix_end == absl::string_view::npos) return;
+  std::vector<absl::string_view> fields =
+      absl::StrSplit(line.substr(0, prefix_end), absl::MaxSplits(',', 2));
+  uint64_t sequence;
+  if (fields.size() >= 2 && absl::SimpleAtoi(fields[1], &sequence)) {
+    if (last_sequence_.has_value() && sequence > *last_sequence_ + 1) {
+      dropped_records_ += sequence - *last_sequence_ - 1;
+    }
+    last_sequence_ = sequence;
+  }
+
+  std::vector<int> matches;
+  if (!matcher_->Match(line.substr(prefix_end + 1), &matches)) return;
+
+  absl::StatusOr<KmsgRecord> record = ParseKmsgRecord(line);
+  if (!record.ok()) {
+    LOG(WARNING) << record.status();
+    return;
+  }
+  const KmsgPattern& pattern =
+      patterns_[*std::min_element(matches.begin(), matches.end())];
+  error::ErrorInfo& error = errors.emplace_back();
+  error.set_event_source(pattern.event_source);
+  error.set_event_type(pattern.event_type);
+  error.set_is_correctable(pattern.is_correctable);
+  error.set_is_fatal(pattern.is_fatal);
+  error.set_count(1);
+  error.mutable_event_timestamp()->set_seconds(
+      absl::ToUnixSeconds(boot_time_ + record->since_boot));
+  error.set_other_debug_info(std::move(record->message));
+}
+
+void KmsgTailer::StreamTo(results::TestStep& step, absl::Duration interval) {
+  StopStreaming();
+  stop_streaming_ = std::make_unique<absl::Notification>();
+  streaming_thread_ = std::thread([this, &step, interval,
+                                   stop = stop_streaming_.get()] {
+    bool stopping = false;
+    while (!stopping) {
+      stopping = stop->WaitForNotificationWithTimeout(interval);
+      absl::StatusOr<std::vector<error::ErrorInfo>> errors = Poll();
+      if (!errors.ok()) {
+        LOG(ERROR) << "Stopped streaming the kernel log: " << errors.status();
+        return;
+      }
+      for (const error::ErrorInfo& error : *errors) {
+        step.AddError({.symptom = error.event_type().empty()
+                                      ? "KMSG"
+                                      : error.event_type(),
+                       .message = error.other_debug_info()});
+      }
+    }
+  });
+}
+
+void KmsgTailer::StopStreaming() {
+  if (stop_streaming_ == nullptr) return;
+  stop_streaming_->Notify();
+  streaming_thread_.join();
+  stop_streaming_ = nullptr;
+}
+
+uint64_t KmsgTailer::dropped_records() const {
+  absl::MutexLock lock(&mutex_);
+  return dropped_records_;
+}
+
+}  // namespace ocpdiag::hwinterface::internal
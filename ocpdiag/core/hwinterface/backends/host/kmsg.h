@@ -0,0 +1,133 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_KMSG_H_
+#define OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_KMSG_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/hwinterface/error.pb.h"
+#include "ocpdiag/core/results/test_step.h"
+#include "re2/set.h"
+
+namespace ocpdiag::hwinterface::internal {
+
+// A kind of kernel log message that reports a hardware error.
+struct KmsgPattern {
+  // An RE2 regular expression, searched for in the message.
+  std::string regex;
+  error::EventSource event_source = error::EventSource::DEFAULT;
+  // For example "PCIE_AER". It is also the symptom of the Error artifacts, or
+  // "KMSG" if empty.
+  std::string event_type;
+  bool is_correctable = false;
+  bool is_fatal = false;
+};
+
+// The messages of machine checks, PCIe AER, EDAC and NVMe timeouts. A message
+// matching several patterns is reported for the first of them.
+std::vector<KmsgPattern> DefaultKmsgPatterns();
+
+// A record of the kernel log, as read from /dev/kmsg.
+struct KmsgRecord {
+  int priority = 0;
+  uint64_t sequence = 0;
+  // When the record was logged, on the monotonic clock.
+  absl::Duration since_boot;
+  std::string message;
+};
+
+// Parses a record line of /dev/kmsg, "<priority>,<sequence>,<usec>,<flags>
+// [,...];<message>".
+absl::StatusOr<KmsgRecord> ParseKmsgRecord(absl::string_view line);
+
+// KmsgTailer follows the kernel log from /dev/kmsg, and reports the records
+// matching any of a set of patterns as errors as soon as they are logged,
+// instead of diffing `dmesg` before and after a test step. The patterns are
+// compiled into a single RE2::Set, so each record is matched once whatever
+// the number of patterns, and a flood of messages is read in full on every
+// poll. The log is read directly, so this only works on the local host.
+//
+// Poll() is thread-safe, but StreamTo() and StopStreaming() must not be called
+// concurrently.
+class KmsgTailer {
+ public:
+  struct Options {
+    // A file of records, one per line, can stand in for /dev/kmsg in tests.
+    std::filesystem::path path = "/dev/kmsg";
+    // Whether to read the records that were logged before Create(), as far as
+    // the kernel still has them, instead of only the new ones.
+    bool from_start = false;
+    std::vector<KmsgPattern> patterns = DefaultKmsgPatterns();
+  };
+
+  static absl::StatusOr<std::unique_ptr<KmsgTailer>> Create(Options options);
+  KmsgTailer(const KmsgTailer&) = delete;
+  KmsgTailer& operator=(const KmsgTailer&) = delete;
+  // Stops streaming.
+  ~KmsgTailer();
+
+  // Reads all the records logged since the previous poll, without blocking,
+  // and returns the errors that they report.
+  absl::StatusOr<std::vector<error::ErrorInfo>> Poll();
+
+  // Polls every `interval` in the background, adding each error to `step` as
+  // an Error artifact, until StopStreaming() is called. `step` must outlive
+  // the streaming.
+  void StreamTo(results::TestStep& step,
+                absl::Duration interval = absl::Milliseconds(100));
+
+  // Stops streaming after a last poll, so that the errors logged until now
+  // are added to the step.
+  void StopStreaming();
+
+  // The records that the kernel overwrote before they were read, from the gaps
+  // in the sequence numbers of the records read one after the other.
+  uint64_t dropped_records() const;
+
+ private:
+  KmsgTailer(int fd, absl::Time boot_time, std::vector<KmsgPattern> patterns,
+             std::unique_ptr<RE2::Set> matcher);
+
+  // Matches the record `line`, adding the error it reports to `errors`, and
+  // counts the records missing before it.
+  void MatchRecord(absl::string_view line,
+                   std::vector<error::ErrorInfo>& errors)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const int fd_;
+  // The wall time of the monotonic clock's origin.
+  const absl::Time boot_time_;
+  const std::vector<KmsgPattern> patterns_;
+  const std::unique_ptr<RE2::Set> matcher_;
+
+  mutable absl::Mutex mutex_;
+  // The start of a record that wasn't read in full yet.
+  std::string partial_record_ ABSL_GUARDED_BY(mutex_);
+  // The sequence number of the last record read, if any.
+  std::optional<uint64_t> last_sequence_ ABSL_GUARDED_BY(mutex_);
+  uint64_t dropped_records_ ABSL_GUARDED_BY(mutex_) = 0;
+
+  std::unique_ptr<absl::Notification> stop_streaming_;
+  std::thread streaming_thread_;
+};
+
+}  // namespace ocpdiag::hwinterface::internal
+
+#endif  // OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_KMSG_H_
@@ -0,0 +1,188 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/host/kmsg.h"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/hwinterface/error.pb.h"
+#include "ocpdiag/core/results/data_model/dut_info.h"
+#include "ocpdiag/core/results/output_receiver.h"
+#include "ocpdiag/core/results/test_run.h"
+#include "ocpdiag/core/results/test_step.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::hwinterface::internal {
+namespace {
+
+using ::ocpdiag::testing::IsOkAndHolds;
+using ::ocpdiag::testing::StatusIs;
+using ::testing::ElementsAre;
+using ::testing::Field;
+using ::testing::IsEmpty;
+using ::testing::Property;
+using ::testing::SizeIs;
+
+constexpr absl::string_view kAerRecord =
+    "3,1042,5000000,-;pcieport 0000:00:1c.0: AER: Corrected error received: "
+    "0000:03:00.0\n";
+constexpr absl::string_view kEdacRecord =
+    "3,1043,6000000,-;EDAC MC0: 1 CE memory read error on "
+    "CPU_SrcID#0_MC#0_Chan#0_DIMM#0\n";
+
+class KmsgTailerTest : public ::testing::Test {
+ protected:
+  KmsgTailerTest()
+      : path_(std::filesystem::path(::testing::TempDir()) / "kmsg") {
+    std::ofstream(path_) << "6,1040,1000000,-;Linux version 5.10\n"
+                         << kAerRecord << " SUBSYSTEM=pci\n"
+                         << " DEVICE=+pci:0000:00:1c.0\n";
+  }
+
+  void Append(absl::string_view data) {
+    std::ofstream(path_, std::ios::app) << data;
+  }
+
+  std::filesystem::path path_;
+};
+
+TEST_F(KmsgTailerTest, ReportsMatchingRecords) {
+  absl::StatusOr<std::unique_ptr<KmsgTailer>> tailer =
+      KmsgTailer::Create({.path = path_, .from_start = true});
+  ASSERT_OK(tailer);
+
+  absl::StatusOr<std::vector<error::ErrorInfo>> errors = (*tailer)->Poll();
+  ASSERT_OK(errors);
+  ASSERT_THAT(*errors, SizeIs(1));
+  EXPECT_EQ((*errors)[0].event_source(), error::EventSource::PCIE_ERROR);
+  EXPECT_EQ((*errors)[0].event_type(), "PCIE_AER");
+  EXPECT_TRUE((*errors)[0].is_correctable());
+  EXPECT_EQ((*errors)[0].count(), 1);
+  EXPECT_EQ((*errors)[0].other_debug_info(),
+            "pcieport 0000:00:1c.0: AER: Corrected error received: "
+            "0000:03:00.0");
+
+  // Only the new records are read.
+  Append(kEdacRecord);
+  EXPECT_THAT((*tailer)->Poll(),
+              IsOkAndHolds(ElementsAre(Property(
+                  &error::ErrorInfo::event_source,
+                  error::EventSource::MEMORY_ERROR))));
+  EXPECT_THAT((*tailer)->Poll(), IsOkAndHolds(IsEmpty()));
+}
+
+TEST_F(KmsgTailerTest, StartsAtTheEnd) {
+  absl::StatusOr<std::unique_ptr<KmsgTailer>> tailer =
+      KmsgTailer::Create({.path = path_});
+  ASSERT_OK(tailer);
+  EXPECT_THAT((*tailer)->Poll(), IsOkAndHolds(IsEmpty()));
+}
+
+TEST_F(KmsgTailerTest, WaitsForWholeRecords) {
+  absl::StatusOr<std::unique_ptr<KmsgTailer>> tailer =
+      KmsgTailer::Create({.path = path_});
+  ASSERT_OK(tailer);
+
+  Append(kEdacRecord.substr(0, 20));
+  EXPECT_THAT((*tailer)->Poll(), IsOkAndHolds(IsEmpty()));
+  Append(kEdacRecord.substr(20));
+  EXPECT_THAT((*tailer)->Poll(),
+              IsOkAndHolds(ElementsAre(
+                  Property(&error::ErrorInfo::event_type, "EDAC"))));
+}
+
+TEST_F(KmsgTailerTest, CountsDroppedRecordsFromSequenceNumbers) {
+  absl::StatusOr<std::unique_ptr<KmsgTailer>> tailer =
+      KmsgTailer::Create({.path = path_, .from_start = true});
+  ASSERT_OK(tailer);
+  ASSERT_OK((*tailer)->Poll());
+  // 1041 is missing.
+  EXPECT_EQ((*tailer)->dropped_records(), 1);
+
+  Append(kEdacRecord);
+  ASSERT_OK((*tailer)->Poll());
+  EXPECT_EQ((*tailer)->dropped_records(), 1);
+
+  // The kernel overwrote 1044 to 1049 at once.
+  Append("6,1050,7000000,-;usb 1-1: new high-speed USB device\n");
+  ASSERT_OK((*tailer)->Poll());
+  EXPECT_EQ((*tailer)->dropped_records(), 7);
+}
+
+TEST_F(KmsgTailerTest, ReportsFirstMatchingPattern) {
+  absl::StatusOr<std::unique_ptr<KmsgTailer>> tailer = KmsgTailer::Create(
+      {.path = path_,
+       .from_start = true,
+       .patterns = {{.regex = "Corrected", .event_type = "FIRST"},
+                    {.regex = "AER", .event_type = "SECOND"}}});
+  ASSERT_OK(tailer);
+  EXPECT_THAT((*tailer)->Poll(),
+              IsOkAndHolds(ElementsAre(
+                  Property(&error::ErrorInfo::event_type, "FIRST"))));
+}
+
+TEST_F(KmsgTailerTest, InvalidPattern) {
+  EXPECT_THAT(KmsgTailer::Create({.path = path_, .patterns = {{.regex = "("}}}),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(KmsgTailer, MissingLog) {
+  EXPECT_THAT(KmsgTailer::Create({.path = "/no/such/kmsg"}),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST_F(KmsgTailerTest, StreamsErrorsToTestStep) {
+  absl::StatusOr<std::unique_ptr<KmsgTailer>> tailer =
+      KmsgTailer::Create({.path = path_});
+  ASSERT_OK(tailer);
+
+  results::OutputReceiver receiver;
+  {
+    results::TestRun run({.name = "kmsg_test",
+                          .version = "1.0",
+                          .command_line = "kmsg_test",
+                          .parameters_json = "{}"},
+                         receiver.MakeArtifactWriter());
+    run.StartAndRegisterDutInfo(
+        std::make_unique<results::DutInfo>("dut", "id"));
+    results::TestStep step("step", run);
+    (*tailer)->StreamTo(step, absl::Milliseconds(1));
+    Append(kEdacRecord);
+    (*tailer)->StopStreaming();
+  }
+
+  ASSERT_THAT(receiver.GetOutputModel().test_steps, SizeIs(1));
+  EXPECT_THAT(receiver.GetOutputModel().test_steps[0].errors,
+              ElementsAre(Field(&results::ErrorOutput::symptom, "EDAC")));
+}
+
+TEST(ParseKmsgRecord, ParsesFields) {
+  absl::StatusOr<KmsgRecord> record =
+      ParseKmsgRecord("4,1043,6000123,c,extra;message; with semicolon");
+  ASSERT_OK(record);
+  EXPECT_EQ(record->priority, 4);
+  EXPECT_EQ(record->sequence, 1043);
+  EXPECT_EQ(record->since_boot, absl::Microseconds(6000123));
+  EXPECT_EQ(record->message, "message; with semicolon");
+
+  EXPECT_THAT(ParseKmsgRecord("no prefix"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ParseKmsgRecord("4,x,1,-;message"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace ocpdiag::hwinterface::internal
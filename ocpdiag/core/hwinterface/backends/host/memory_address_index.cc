@@ -0,0 +1,78 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/host/memory_address_index.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+
+namespace ocpdiag::hwinterface::internal {
+
+MemoryAddressIndex::MemoryAddressIndex(
+    std::vector<Range> ranges,
+    absl::flat_hash_map<uint16_t, std::string> device_locators)
+    : device_locators_(std::move(device_locators)) {
+  ranges_.reserve(ranges.size());
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    ranges_.push_back({.range = ranges[i], .order = i});
+  }
+  std::sort(ranges_.begin(), ranges_.end(),
+            [](const IndexedRange& a, const IndexedRange& b) {
+              return a.range.start < b.range.start;
+            });
+  uint64_t max_end = 0;
+  for (IndexedRange& range : ranges_) {
+    max_end = std::max(max_end, range.range.end);
+    range.max_end = max_end;
+  }
+}
+
+absl::StatusOr<absl::string_view> MemoryAddressIndex::Lookup(
+    uint64_t address) const {
+  // Walk back from the last range starting at or before `address`, for as
+  // long as an earlier range may still reach it. Ranges don't overlap in
+  // practice, so this is usually a single step.
+  auto it = std::upper_bound(
+      ranges_.begin(), ranges_.end(), address,
+      [](uint64_t address, const IndexedRange& range) {
+        return address < range.range.start;
+      });
+  const IndexedRange* found = nullptr;
+  while (it != ranges_.begin()) {
+    --it;
+    if (it->max_end < address) break;
+    if (it->range.end >= address &&
+        (found == nullptr || it->order < found->order)) {
+      found = &*it;
+    }
+  }
+  if (found == nullptr) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Unable to find physical address 0x%x in the Memory "
+                        "Device Mapped Address table.",
+                        address));
+  }
+
+  auto device = device_locators_.find(found->range.device_handle);
+  if (device == device_locators_.end()) {
+    return absl::NotFoundError(
+        absl::StrFormat("Unable to find memory device with handle 0x%x.",
+                        found->range.device_handle));
+  }
+  return device->second;
+}
+
+}  // namespace ocpdiag::hwinterface::internal
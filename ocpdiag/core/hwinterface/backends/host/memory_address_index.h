@@ -0,0 +1,64 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_MEMORY_ADDRESS_INDEX_H_
+#define OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_MEMORY_ADDRESS_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+
+namespace ocpdiag::hwinterface::internal {
+
+// MemoryAddressIndex maps physical addresses to the memory devices they are
+// mapped to, as described by the SMBIOS Memory Device Mapped Address and
+// Memory Device structures. It is built once from the tables, after which
+// each address is translated with a binary search over the ranges sorted by
+// start address, instead of a scan of both tables.
+class MemoryAddressIndex {
+ public:
+  // A range of physical addresses mapped to a memory device.
+  struct Range {
+    // The first and last addresses of the range, inclusive.
+    uint64_t start;
+    uint64_t end;
+    uint16_t device_handle;
+  };
+
+  // `ranges` are in table order: an address contained in several ranges maps
+  // to the first of them. `device_locators` maps the handle of each memory
+  // device to its locator, e.g. "DIMM1".
+  MemoryAddressIndex(
+      std::vector<Range> ranges,
+      absl::flat_hash_map<uint16_t, std::string> device_locators);
+
+  // Returns the locator of the memory device that `address` is mapped to,
+  // which lives as long as the index. Returns InvalidArgument if no range
+  // contains `address`, or NotFound if its device is unknown.
+  absl::StatusOr<absl::string_view> Lookup(uint64_t address) const;
+
+ private:
+  struct IndexedRange {
+    Range range;
+    // The position of the range in the table.
+    size_t order;
+    // The largest end of this range and all the ones sorted before it.
+    uint64_t max_end;
+  };
+
+  // Sorted by start address.
+  std::vector<IndexedRange> ranges_;
+  absl::flat_hash_map<uint16_t, std::string> device_locators_;
+};
+
+}  // namespace ocpdiag::hwinterface::internal
+
+#endif  // OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_MEMORY_ADDRESS_INDEX_H_
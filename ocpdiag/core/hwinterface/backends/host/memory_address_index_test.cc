@@ -0,0 +1,62 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/host/memory_address_index.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::hwinterface::internal {
+namespace {
+
+using ::ocpdiag::testing::IsOkAndHolds;
+using ::ocpdiag::testing::StatusIs;
+
+TEST(MemoryAddressIndex, FindsDeviceOfAddress) {
+  MemoryAddressIndex index(
+      {{.start = 0x2000, .end = 0x2fff, .device_handle = 2},
+       {.start = 0x0, .end = 0xfff, .device_handle = 1},
+       {.start = 0x1000, .end = 0x1fff, .device_handle = 3}},
+      {{1, "DIMM1"}, {2, "DIMM2"}, {3, "DIMM3"}});
+
+  EXPECT_THAT(index.Lookup(0x0), IsOkAndHolds("DIMM1"));
+  EXPECT_THAT(index.Lookup(0xfff), IsOkAndHolds("DIMM1"));
+  EXPECT_THAT(index.Lookup(0x1000), IsOkAndHolds("DIMM3"));
+  EXPECT_THAT(index.Lookup(0x2abc), IsOkAndHolds("DIMM2"));
+  EXPECT_THAT(index.Lookup(0x3000),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(MemoryAddressIndex, OverlappingRangesMapToFirstInTable) {
+  MemoryAddressIndex index(
+      {{.start = 0x1000, .end = 0x1fff, .device_handle = 2},
+       {.start = 0x0, .end = 0xffff, .device_handle = 1},
+       {.start = 0x1800, .end = 0x27ff, .device_handle = 3}},
+      {{1, "DIMM1"}, {2, "DIMM2"}, {3, "DIMM3"}});
+
+  EXPECT_THAT(index.Lookup(0x800), IsOkAndHolds("DIMM1"));
+  EXPECT_THAT(index.Lookup(0x1900), IsOkAndHolds("DIMM2"));
+  // Only the large range, which starts first, reaches this address.
+  EXPECT_THAT(index.Lookup(0x3000), IsOkAndHolds("DIMM1"));
+  EXPECT_THAT(index.Lookup(0x10000),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(MemoryAddressIndex, UnknownDeviceIsNotFound) {
+  MemoryAddressIndex index({{.start = 0x0, .end = 0xfff, .device_handle = 7}},
+                           {{1, "DIMM1"}});
+  EXPECT_THAT(index.Lookup(0x10), StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST(MemoryAddressIndex, Empty) {
+  MemoryAddressIndex index({}, {});
+  EXPECT_THAT(index.Lookup(0), StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace ocpdiag::hwinterface::internal
@@ -6,17 +6,22 @@
 
 
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
-#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
 #include "ecclesia/lib/smbios/memory_device.h"
 #include "ecclesia/lib/smbios/memory_device_mapped_address.h"
 #include "ecclesia/lib/smbios/reader.h"
 #include "ecclesia/lib/smbios/structures.emb.h"
 #include "ocpdiag/core/compat/status_macros.h"
 #include "ocpdiag/core/hwinterface/backends/host/host_backend.h"
+#include "ocpdiag/core/hwinterface/backends/host/memory_address_index.h"
 #include "ocpdiag/core/hwinterface/backends/lib/hw_info.h"
 #include "ocpdiag/core/hwinterface/identifier.pb.h"
 #include "ocpdiag/core/hwinterface/service.pb.h"
@@ -26,9 +31,12 @@ namespace ocpdiag::hwinterface::internal {
 constexpr uint32_t kExtendedAddressMarker = 0xFFFFFFFF;
 constexpr int kBytesPerKilobyte = 1024;
 
-bool IsAddressWithinMap(uint64_t address,
-                        const ecclesia::MemoryDeviceMappedAddressStructureView&
-                            mapped_address_view) {
+namespace {
+
+// Returns the range of byte addresses in a mapped address structure.
+MemoryAddressIndex::Range MappedRange(
+    const ecclesia::MemoryDeviceMappedAddressStructureView&
+        mapped_address_view) {
   uint64_t start_address =
       mapped_address_view.starting_address().Read() == kExtendedAddressMarker
           ? mapped_address_view.extended_starting_address().Read()
@@ -37,49 +45,75 @@ bool IsAddressWithinMap(uint64_t address,
       mapped_address_view.ending_address().Read() == kExtendedAddressMarker
           ? mapped_address_view.extended_ending_address().Read()
           : mapped_address_view.ending_address().Read();
-  start_address *= kBytesPerKilobyte;
-  end_address *= kBytesPerKilobyte;
+  return {.start = start_address * kBytesPerKilobyte,
+          .end = end_address * kBytesPerKilobyte,
+          .device_handle = mapped_address_view.memory_device_handle().Read()};
+}
 
-  return address >= start_address && address <= end_address;
+Identifier DimmIdentifier(absl::string_view locator) {
+  Identifier identifier;
+  identifier.set_name(std::string(locator));
+  identifier.set_type("dimm");
+  PopulateId(identifier);
+  return identifier;
+}
+
+}  // namespace
+
+absl::StatusOr<const MemoryAddressIndex*> HostBackend::GetMemoryAddressIndex() {
+  if (memory_address_index_ == nullptr) {
+    ASSIGN_OR_RETURN(ecclesia::SmbiosReader * reader, GetSmbiosReader());
+
+    std::vector<MemoryAddressIndex::Range> ranges;
+    for (const auto& mapped_address :
+         reader->GetAllMemoryDeviceMappedAddresses()) {
+      MemoryAddressIndex::Range range =
+          MappedRange(mapped_address.GetMessageView());
+      // A range without a device isn't mapped to any.
+      if (range.device_handle != 0) ranges.push_back(range);
+    }
+
+    absl::flat_hash_map<uint16_t, std::string> device_locators;
+    for (const auto& memory_device : reader->GetAllMemoryDevices()) {
+      ecclesia::MemoryDeviceStructureView memory_device_view =
+          memory_device.GetMessageView();
+      device_locators.try_emplace(
+          memory_device_view.handle().Read(),
+          memory_device.GetString(
+              memory_device_view.device_locator_snum().Read()));
+    }
+
+    memory_address_index_ = std::make_unique<MemoryAddressIndex>(
+        std::move(ranges), std::move(device_locators));
+  }
+  return memory_address_index_.get();
 }
 
 absl::StatusOr<MemoryConvertResponse> HostBackend::MemoryConvert(
     const MemoryConvertRequest& req) {
   MemoryConvertResponse resp;
-  ASSIGN_OR_RETURN(ecclesia::SmbiosReader * reader, GetSmbiosReader());
-
-  uint16_t device_handle = 0;
-  for (const auto& mapped_address :
-       reader->GetAllMemoryDeviceMappedAddresses()) {
-    ecclesia::MemoryDeviceMappedAddressStructureView mapped_address_view =
-        mapped_address.GetMessageView();
-    if (IsAddressWithinMap(req.physical_address(), mapped_address_view)) {
-      device_handle = mapped_address_view.memory_device_handle().Read();
-      break;
-    }
-  }
-  if (device_handle == 0) {
-    return absl::InvalidArgumentError(
-        absl::StrFormat("Unable to find physical address 0x%x in the Memory "
-                        "Device Mapped Address table.",
-                        req.physical_address()));
+  ASSIGN_OR_RETURN(const MemoryAddressIndex* index, GetMemoryAddressIndex());
+
+  if (req.physical_addresses().empty()) {
+    ASSIGN_OR_RETURN(absl::string_view locator,
+                     index->Lookup(req.physical_address()));
+    *resp.add_identifiers() = DimmIdentifier(locator);
+    return resp;
   }
 
-  for (const auto& memory_device : reader->GetAllMemoryDevices()) {
-    ecclesia::MemoryDeviceStructureView memory_device_view =
-        memory_device.GetMessageView();
-    if (memory_device_view.handle().Read() == device_handle) {
-      Identifier& identifier = *resp.add_identifiers();
-      identifier.set_name(std::string(memory_device.GetString(
-          memory_device_view.device_locator_snum().Read())));
-      identifier.set_type("dimm");
-      PopulateId(identifier);
-      return resp;
+  // Each address succeeds or fails on its own.
+  resp.mutable_conversions()->Reserve(req.physical_addresses_size());
+  for (uint64_t address : req.physical_addresses()) {
+    MemoryConvertResponse::Conversion& conversion = *resp.add_conversions();
+    conversion.set_physical_address(address);
+    absl::StatusOr<absl::string_view> locator = index->Lookup(address);
+    if (locator.ok()) {
+      *conversion.mutable_identifier() = DimmIdentifier(*locator);
+    } else {
+      conversion.set_error(std::string(locator.status().message()));
     }
   }
-
-  return absl::NotFoundError(absl::StrFormat(
-      "Unable to find memory device with handle 0x%x.", device_handle));
+  return resp;
 }
 
 }  // namespace ocpdiag::hwinterface::internal
@@ -82,4 +82,39 @@ TEST(HostBackend, MemoryConvertUnableToFindMemoryDevice) {
               StatusIs(absl::StatusCode::kNotFound));
 }
 
+TEST(HostBackend, MemoryConvertBatch) {
+  auto mock_host = std::make_unique<MockHostAdapter>();
+  // The SMBIOS tables are read once for all the addresses.
+  EXPECT_CALL(*mock_host, Read)
+      .WillOnce(Return(GetTestDataContents(kDmiFilePath)));
+
+  HostBackend backend(EntityConfiguration{}, std::move(mock_host));
+
+  MemoryConvertRequest req;
+  req.add_physical_addresses(1);
+  req.add_physical_addresses(0xFFFFFFFFFFF);
+  req.add_physical_addresses(0x00100000001);
+  req.add_physical_addresses(2);
+  EXPECT_THAT(backend.MemoryConvert(req),
+              IsOkAndHolds(EqualsProto(R"pb(
+                conversions {
+                  physical_address: 1
+                  identifier { name: "DIMM1" type: "dimm" id: "%%DIMM1%%dimm" }
+                }
+                conversions {
+                  physical_address: 0xFFFFFFFFFFF
+                  error: "Unable to find physical address 0xfffffffffff in "
+                         "the Memory Device Mapped Address table."
+                }
+                conversions {
+                  physical_address: 0x00100000001
+                  error: "Unable to find memory device with handle 0x7001."
+                }
+                conversions {
+                  physical_address: 2
+                  identifier { name: "DIMM1" type: "dimm" id: "%%DIMM1%%dimm" }
+                }
+              )pb")));
+}
+
 }  // namespace ocpdiag::hwinterface::internal
@@ -0,0 +1,330 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/host/network.h"
+
+#include <linux/if.h>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/cleanup/cleanup.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/string_view.h"
+#include "ocpdiag/core/compat/status_macros.h"
+#include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
+
+namespace ocpdiag::hwinterface::internal {
+namespace {
+
+// Large enough for a link message with a few VFs. The messages of physical
+// functions with many VFs are larger, and grow the buffer.
+constexpr size_t kReceiveSize = 32768;
+// How many times a dump interrupted by a change of the links is requested.
+constexpr int kDumpAttempts = 3;
+
+// The counters of /sys/class/net/<name>/statistics that LinkStats has.
+struct LinkCounter {
+  absl::string_view file;
+  uint64_t LinkStats::*field;
+};
+
+constexpr LinkCounter kLinkCounters[] = {
+    {"rx_bytes", &LinkStats::rx_bytes},
+    {"tx_bytes", &LinkStats::tx_bytes},
+    {"rx_packets", &LinkStats::rx_packets},
+    {"tx_packets", &LinkStats::tx_packets},
+    {"rx_errors", &LinkStats::rx_errors},
+    {"tx_errors", &LinkStats::tx_errors},
+    {"rx_dropped", &LinkStats::rx_dropped},
+    {"tx_dropped", &LinkStats::tx_dropped},
+};
+constexpr size_t kNumLinkCounters = sizeof(kLinkCounters) / sizeof(LinkCounter);
+
+absl::Status ErrnoToStatus(int error, absl::string_view message) {
+  return absl::Status(absl::ErrnoToStatusCode(error),
+                      absl::StrCat(message, ": ", strerror(error)));
+}
+
+// Reads a T from the start of `data`, which is unaligned in general. Missing
+// bytes are left zero, e.g. for a struct that grew in later kernels.
+template <typename T>
+T ReadStruct(absl::string_view data) {
+  T value{};
+  std::memcpy(&value, data.data(), std::min(data.size(), sizeof(T)));
+  return value;
+}
+
+std::vector<std::filesystem::path> CounterPaths(
+    const std::vector<std::string>& interfaces) {
+  std::vector<std::filesystem::path> paths;
+  paths.reserve(interfaces.size() * kNumLinkCounters);
+  for (const std::string& interface : interfaces) {
+    for (const LinkCounter& counter : kLinkCounters) {
+      paths.push_back(absl::StrCat("/sys/class/net/", interface,
+                                   "/statistics/", counter.file));
+    }
+  }
+  return paths;
+}
+
+absl::StatusOr<NetworkLink> ParseLink(absl::string_view message) {
+  if (message.size() < sizeof(ifinfomsg)) {
+    return absl::InternalError("Truncated RTM_NEWLINK message");
+  }
+  const auto info = ReadStruct<ifinfomsg>(message);
+  NetworkLink link{.index = info.ifi_index,
+                   .up = (info.ifi_flags & IFF_UP) != 0,
+                   .lower_up = (info.ifi_flags & IFF_LOWER_UP) != 0};
+
+  absl::string_view attributes =
+      message.substr(std::min<size_t>(NLMSG_ALIGN(sizeof(ifinfomsg)),
+                                      message.size()));
+  while (attributes.size() >= sizeof(rtattr)) {
+    const auto attribute = ReadStruct<rtattr>(attributes);
+    if (attribute.rta_len < sizeof(rtattr) ||
+        attribute.rta_len > attributes.size()) {
+      return absl::InternalError(
+          absl::StrFormat("Truncated attribute of link %d", link.index));
+    }
+    const absl::string_view data = attributes.substr(
+        RTA_LENGTH(0), attribute.rta_len - RTA_LENGTH(0));
+    attributes.remove_prefix(
+        std::min<size_t>(RTA_ALIGN(attribute.rta_len), attributes.size()));
+    switch (attribute.rta_type) {
+      case IFLA_IFNAME:
+        link.name = std::string(data.substr(0, data.find('\0')));
+        break;
+      case IFLA_ADDRESS: {
+        std::vector<std::string> octets;
+        for (unsigned char octet : data) {
+          octets.push_back(absl::StrFormat("%02x", octet));
+        }
+        link.mac_address = absl::StrJoin(octets, ":");
+        break;
+      }
+      case IFLA_MTU:
+        link.mtu = ReadStruct<uint32_t>(data);
+        break;
+      case IFLA_NUM_VF:
+        link.num_vfs = ReadStruct<uint32_t>(data);
+        break;
+      case IFLA_STATS64: {
+        const auto stats = ReadStruct<rtnl_link_stats64>(data);
+        link.stats = {.rx_bytes = stats.rx_bytes,
+                      .tx_bytes = stats.tx_bytes,
+                      .rx_packets = stats.rx_packets,
+                      .tx_packets = stats.tx_packets,
+                      .rx_errors = stats.rx_errors,
+                      .tx_errors = stats.tx_errors,
+                      .rx_dropped = stats.rx_dropped,
+                      .tx_dropped = stats.tx_dropped};
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  return link;
+}
+
+// Requests a single dump with sequence number `seq`.
+absl::StatusOr<std::string> DumpLinksOnce(uint32_t seq) {
+  const int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (fd < 0) return ErrnoToStatus(errno, "Failed to open a netlink socket");
+  absl::Cleanup closer = [fd] { close(fd); };
+
+  const std::string request = LinkDumpRequest(seq);
+  sockaddr_nl kernel{.nl_family = AF_NETLINK};
+  if (sendto(fd, request.data(), request.size(), 0,
+             reinterpret_cast<sockaddr*>(&kernel), sizeof(kernel)) < 0) {
+    return ErrnoToStatus(errno, "Failed to send RTM_GETLINK");
+  }
+
+  std::string dump;
+  std::string buffer(kReceiveSize, '\0');
+  while (true) {
+    // Peeks at the size of the next datagram, so that it isn't truncated.
+    const ssize_t size = recv(fd, nullptr, 0, MSG_PEEK | MSG_TRUNC);
+    if (size < 0) {
+      if (errno == EINTR) continue;
+      return ErrnoToStatus(errno, "Failed to receive the links");
+    }
+    if (static_cast<size_t>(size) > buffer.size()) buffer.resize(size);
+    const ssize_t count = recv(fd, buffer.data(), buffer.size(), MSG_TRUNC);
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      return ErrnoToStatus(errno, "Failed to receive the links");
+    }
+    if (count == 0) break;
+    if (static_cast<size_t>(count) > buffer.size()) {
+      return absl::InternalError(absl::StrFormat(
+          "Truncated netlink datagram of %d bytes", count));
+    }
+    ASSIGN_OR_RETURN(
+        const bool done,
+        AppendDumpMessages(absl::string_view(buffer.data(), count), seq, dump));
+    if (done) break;
+  }
+  return dump;
+}
+
+}  // namespace
+
+absl::StatusOr<std::string> RtnetlinkSocket::DumpLinks() {
+  // Each dump has its own socket, so the sequence numbers only tell the
+  // attempts apart.
+  absl::Status status;
+  for (int attempt = 1; attempt <= kDumpAttempts; ++attempt) {
+    absl::StatusOr<std::string> dump = DumpLinksOnce(attempt);
+    if (!absl::IsAborted(dump.status())) return dump;
+    status = dump.status();
+  }
+  return status;
+}
+
+std::string LinkDumpRequest(uint32_t seq) {
+  struct {
+    nlmsghdr header;
+    ifinfomsg info;
+    rtattr ext_mask_attribute;
+    uint32_t ext_mask;
+  } request{};
+  request.header.nlmsg_len = sizeof(request);
+  request.header.nlmsg_type = RTM_GETLINK;
+  request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  request.header.nlmsg_seq = seq;
+  request.info.ifi_family = AF_UNSPEC;
+  request.ext_mask_attribute.rta_len = RTA_LENGTH(sizeof(uint32_t));
+  request.ext_mask_attribute.rta_type = IFLA_EXT_MASK;
+  request.ext_mask = RTEXT_FILTER_VF | RTEXT_FILTER_SKIP_STATS;
+  static_assert(sizeof(request) == NLMSG_LENGTH(sizeof(ifinfomsg)) +
+                                       RTA_LENGTH(sizeof(uint32_t)));
+  return std::string(reinterpret_cast<const char*>(&request), sizeof(request));
+}
+
+absl::StatusOr<bool> AppendDumpMessages(absl::string_view datagram,
+                                        uint32_t seq, std::string& dump) {
+  while (!datagram.empty()) {
+    if (datagram.size() < sizeof(nlmsghdr)) {
+      return absl::InternalError("Truncated netlink message header");
+    }
+    const auto header = ReadStruct<nlmsghdr>(datagram);
+    if (header.nlmsg_len < sizeof(nlmsghdr) ||
+        header.nlmsg_len > datagram.size()) {
+      return absl::InternalError(
+          absl::StrFormat("Truncated netlink message of %d bytes, %d left",
+                          header.nlmsg_len, datagram.size()));
+    }
+    const absl::string_view message = datagram.substr(
+        0, std::min<size_t>(NLMSG_ALIGN(header.nlmsg_len), datagram.size()));
+    datagram.remove_prefix(message.size());
+
+    if (header.nlmsg_seq != seq) continue;
+    if (header.nlmsg_flags & NLM_F_DUMP_INTR) {
+      return absl::AbortedError(
+          "The link dump was interrupted by a change of the links");
+    }
+    absl::StrAppend(&dump, message);
+    if (header.nlmsg_type == NLMSG_DONE || header.nlmsg_type == NLMSG_ERROR) {
+      return true;
+    }
+  }
+  return false;
+}
+
+absl::StatusOr<std::vector<NetworkLink>> ParseLinkDump(absl::string_view dump) {
+  std::vector<NetworkLink> links;
+  while (!dump.empty()) {
+    if (dump.size() < sizeof(nlmsghdr)) {
+      return absl::InternalError("Truncated netlink message header");
+    }
+    const auto header = ReadStruct<nlmsghdr>(dump);
+    if (header.nlmsg_len < sizeof(nlmsghdr) ||
+        header.nlmsg_len > dump.size()) {
+      return absl::InternalError(
+          absl::StrFormat("Truncated netlink message of %d bytes, %d left",
+                          header.nlmsg_len, dump.size()));
+    }
+    const absl::string_view message =
+        dump.substr(NLMSG_HDRLEN, header.nlmsg_len - NLMSG_HDRLEN);
+    dump.remove_prefix(
+        std::min<size_t>(NLMSG_ALIGN(header.nlmsg_len), dump.size()));
+
+    if (header.nlmsg_type == NLMSG_DONE) break;
+    if (header.nlmsg_type == NLMSG_ERROR) {
+      // An acknowledgement has no error.
+      const int error = ReadStruct<nlmsgerr>(message).error;
+      if (error != 0) return ErrnoToStatus(-error, "RTM_GETLINK failed");
+      continue;
+    }
+    if (header.nlmsg_type != RTM_NEWLINK) continue;
+    ASSIGN_OR_RETURN(NetworkLink link, ParseLink(message));
+    links.push_back(std::move(link));
+  }
+  return links;
+}
+
+LinkCounterSampler::LinkCounterSampler(HostAdapter& host,
+                                       std::vector<std::string> interfaces)
+    : host_(&host),
+      interfaces_(std::move(interfaces)),
+      paths_(CounterPaths(interfaces_)) {}
+
+absl::StatusOr<std::vector<absl::StatusOr<LinkStats>>>
+LinkCounterSampler::Sample() {
+  if (paths_.empty()) return std::vector<absl::StatusOr<LinkStats>>();
+  ASSIGN_OR_RETURN(std::vector<absl::StatusOr<std::string>> files,
+                   host_->Sample(paths_));
+  if (files.size() != paths_.size()) {
+    return absl::InternalError(
+        absl::StrFormat("Sampled %d link counters, expected %d", files.size(),
+                        paths_.size()));
+  }
+  std::vector<absl::StatusOr<LinkStats>> samples;
+  samples.reserve(interfaces_.size());
+  for (size_t i = 0; i < interfaces_.size(); ++i) {
+    LinkStats stats;
+    absl::Status status;
+    for (size_t j = 0; j < kNumLinkCounters && status.ok(); ++j) {
+      const size_t file = i * kNumLinkCounters + j;
+      if (!files[file].ok()) {
+        status = files[file].status();
+      } else if (!absl::SimpleAtoi(absl::StripAsciiWhitespace(*files[file]),
+                                   &(stats.*kLinkCounters[j].field))) {
+        status = absl::InternalError(absl::StrFormat(
+            "Failed to parse %s: \"%s\"", paths_[file].string(),
+            *files[file]));
+      }
+    }
+    if (status.ok()) {
+      samples.push_back(stats);
+    } else {
+      samples.push_back(status);
+    }
+  }
+  return samples;
+}
+
+}  // namespace ocpdiag::hwinterface::internal
@@ -0,0 +1,119 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_NETWORK_H_
+#define OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_NETWORK_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
+
+namespace ocpdiag::hwinterface::internal {
+
+// The traffic counters of a link, as in /sys/class/net/<name>/statistics.
+struct LinkStats {
+  uint64_t rx_bytes = 0;
+  uint64_t tx_bytes = 0;
+  uint64_t rx_packets = 0;
+  uint64_t tx_packets = 0;
+  uint64_t rx_errors = 0;
+  uint64_t tx_errors = 0;
+  uint64_t rx_dropped = 0;
+  uint64_t tx_dropped = 0;
+
+  bool operator==(const LinkStats& other) const {
+    return rx_bytes == other.rx_bytes && tx_bytes == other.tx_bytes &&
+           rx_packets == other.rx_packets && tx_packets == other.tx_packets &&
+           rx_errors == other.rx_errors && tx_errors == other.tx_errors &&
+           rx_dropped == other.rx_dropped && tx_dropped == other.tx_dropped;
+  }
+};
+
+// A network interface, from an RTM_NEWLINK message.
+struct NetworkLink {
+  int index = 0;
+  // For example "eth0".
+  std::string name;
+  // For example "0c:c4:7a:12:34:56", or empty without a hardware address.
+  std::string mac_address;
+  int mtu = 0;
+  // Whether the interface is administratively up, and whether its carrier is.
+  bool up = false;
+  bool lower_up = false;
+  // The number of SR-IOV virtual functions of a physical function.
+  int num_vfs = 0;
+  LinkStats stats;
+};
+
+// NetlinkSocket dumps the links of the host over rtnetlink. It is an interface
+// so that tests can replay a recorded dump.
+class NetlinkSocket {
+ public:
+  virtual ~NetlinkSocket() = default;
+
+  // Sends an RTM_GETLINK dump request, and returns the netlink messages of the
+  // reply, up to and including NLMSG_DONE, as received.
+  virtual absl::StatusOr<std::string> DumpLinks() = 0;
+};
+
+// Dumps the links of the local host through a NETLINK_ROUTE socket, which is
+// opened for each dump. All the links, along with their counters, come in a
+// few messages, instead of running `ip` or `ethtool` per interface. A dump
+// interrupted by a change of the links is requested again, a few times.
+class RtnetlinkSocket final : public NetlinkSocket {
+ public:
+  absl::StatusOr<std::string> DumpLinks() override;
+};
+
+// Returns the RTM_GETLINK dump request with sequence number `seq`. It asks for
+// the VF details with RTEXT_FILTER_VF, without which the kernel leaves out
+// IFLA_NUM_VF, and skips their per-VF counters.
+std::string LinkDumpRequest(uint32_t seq);
+
+// Appends the messages of a netlink `datagram` that answer the dump request
+// with sequence number `seq` to `dump`, skipping the others, and returns
+// whether the dump is complete. Fails with ABORTED if the kernel flagged the
+// dump as interrupted by a change of the links, so that it is requested again.
+absl::StatusOr<bool> AppendDumpMessages(absl::string_view datagram,
+                                        uint32_t seq, std::string& dump);
+
+// Parses the messages of an RTM_GETLINK dump. Fails on a truncated message, or
+// if the dump reports an error.
+absl::StatusOr<std::vector<NetworkLink>> ParseLinkDump(absl::string_view dump);
+
+// LinkCounterSampler reads the counters of a set of interfaces over and over,
+// e.g. to measure the throughput or the error rate of the links during a
+// network stress test. It reads /sys/class/net/<name>/statistics through
+// HostAdapter::Sample(), which keeps the files open on the local host, so that
+// a sample of many virtual functions is a pread() per counter.
+class LinkCounterSampler {
+ public:
+  // Samples the counters of the interfaces named `interfaces` on `host`, which
+  // must outlive this.
+  LinkCounterSampler(HostAdapter& host, std::vector<std::string> interfaces);
+
+  const std::vector<std::string>& interfaces() const { return interfaces_; }
+
+  // Reads the counters, and returns them in the order of interfaces(). Each
+  // interface succeeds or fails on its own, e.g. when it went away.
+  absl::StatusOr<std::vector<absl::StatusOr<LinkStats>>> Sample();
+
+ private:
+  HostAdapter* host_;
+  const std::vector<std::string> interfaces_;
+  // The counter files of all the interfaces, in the order of the fields of
+  // LinkStats.
+  const std::vector<std::filesystem::path> paths_;
+};
+
+}  // namespace ocpdiag::hwinterface::internal
+
+#endif  // OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_NETWORK_H_
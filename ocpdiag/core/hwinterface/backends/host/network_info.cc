@@ -0,0 +1,115 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "ocpdiag/core/compat/status_macros.h"
+#include "ocpdiag/core/hwinterface/backends/host/host_backend.h"
+#include "ocpdiag/core/hwinterface/backends/host/network.h"
+#include "ocpdiag/core/hwinterface/backends/lib/hw_info.h"
+#include "ocpdiag/core/hwinterface/backends/lib/utils.h"
+#include "ocpdiag/core/hwinterface/identifier.pb.h"
+#include "ocpdiag/core/hwinterface/networkinterface.pb.h"
+#include "ocpdiag/core/hwinterface/service.pb.h"
+
+namespace ocpdiag::hwinterface::internal {
+
+namespace {
+
+std::string NetDevicePath(const NetworkLink& link) {
+  return absl::StrCat("/sys/class/net/", link.name);
+}
+
+// Returns the speeds in Mb/s of the links, or 0 where unknown, e.g. for a
+// link that is down, or a virtual device.
+absl::StatusOr<std::vector<int>> ReadSpeeds(
+    HostAdapter& host, const std::vector<NetworkLink>& links) {
+  std::vector<std::filesystem::path> paths;
+  paths.reserve(links.size());
+  for (const NetworkLink& link : links) {
+    paths.push_back(absl::StrCat(NetDevicePath(link), "/speed"));
+  }
+  ASSIGN_OR_RETURN(std::vector<absl::StatusOr<std::string>> files,
+                   host.ReadMany(paths));
+  std::vector<int> speeds(links.size());
+  for (size_t i = 0; i < files.size() && i < speeds.size(); ++i) {
+    int speed;
+    if (files[i].ok() &&
+        absl::SimpleAtoi(absl::StripAsciiWhitespace(*files[i]), &speed) &&
+        speed > 0) {
+      speeds[i] = speed;
+    }
+  }
+  return speeds;
+}
+
+}  // namespace
+
+absl::StatusOr<GetNetworkInterfaceInfoResponse>
+HostBackend::GetNetworkInterfaceInfo(
+    const GetNetworkInterfaceInfoRequest& req) {
+  if (netlink_ == nullptr) {
+    return absl::UnimplementedError(
+        "GetNetworkInterfaceInfo needs netlink, only on the local host");
+  }
+  ASSIGN_OR_RETURN(std::string dump, netlink_->DumpLinks());
+  ASSIGN_OR_RETURN(std::vector<NetworkLink> links, ParseLinkDump(dump));
+
+  std::vector<int> speeds;
+  if (InfoTypeHave(req.info_types(), networkinterface::InfoType::LINKINFO)) {
+    ASSIGN_OR_RETURN(speeds, ReadSpeeds(*host_adapter_, links));
+  }
+
+  GetNetworkInterfaceInfoResponse resp;
+  for (size_t i = 0; i < links.size(); ++i) {
+    const NetworkLink& link = links[i];
+    networkinterface::Info& info = *resp.add_info();
+    if (InfoTypeHave(req.info_types(),
+                     networkinterface::InfoType::IDENTIFIER)) {
+      Identifier& id = *info.mutable_id();
+      id.set_devpath(NetDevicePath(link));
+      id.set_name(link.name);
+      id.set_type("network_interface");
+      PopulateId(id);
+    }
+    if (InfoTypeHave(req.info_types(), networkinterface::InfoType::LINKINFO)) {
+      networkinterface::LinkInfo& link_info = *info.mutable_link_info();
+      link_info.set_enabled(link.up && link.lower_up);
+      link_info.set_speed_mbps(speeds[i]);
+      link_info.set_mac_address(link.mac_address);
+      link_info.set_num_vfs(link.num_vfs);
+    }
+    if (InfoTypeHave(req.info_types(), networkinterface::InfoType::COUNTERS)) {
+      networkinterface::Counters& counters = *info.mutable_counters();
+      counters.set_rx_bytes(link.stats.rx_bytes);
+      counters.set_tx_bytes(link.stats.tx_bytes);
+      counters.set_rx_packets(link.stats.rx_packets);
+      counters.set_tx_packets(link.stats.tx_packets);
+      counters.set_rx_errors(link.stats.rx_errors);
+      counters.set_tx_errors(link.stats.tx_errors);
+      counters.set_rx_dropped(link.stats.rx_dropped);
+      counters.set_tx_dropped(link.stats.tx_dropped);
+    }
+  }
+  return resp;
+}
+
+std::unique_ptr<LinkCounterSampler> HostBackend::SampleLinkCounters(
+    std::vector<std::string> interfaces) {
+  return std::make_unique<LinkCounterSampler>(*host_adapter_,
+                                              std::move(interfaces));
+}
+
+}  // namespace ocpdiag::hwinterface::internal
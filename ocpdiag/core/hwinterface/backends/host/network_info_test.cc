@@ -0,0 +1,138 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/log/check.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "ocpdiag/core/hwinterface/backends/host/host_backend.h"
+#include "ocpdiag/core/hwinterface/backends/host/network.h"
+#include "ocpdiag/core/hwinterface/backends/lib/fake_host_adapter.h"
+#include "ocpdiag/core/hwinterface/networkinterface.pb.h"
+#include "ocpdiag/core/hwinterface/service.pb.h"
+#include "ocpdiag/core/testing/file_utils.h"
+#include "ocpdiag/core/testing/proto_matchers.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::hwinterface::internal {
+namespace {
+
+using ::ocpdiag::testing::EqualsProto;
+using ::ocpdiag::testing::IsOkAndHolds;
+using ::ocpdiag::testing::StatusIs;
+using ::ocpdiag::testutils::GetDataDependencyFileContents;
+using ::testing::Field;
+using ::testing::SizeIs;
+
+// Replays a dump recorded on a host with a loopback, two ifb devices and an
+// Ethernet interface. See testdata/get_network_interface_info/rtm_getlink.txt.
+class RecordedNetlinkSocket : public NetlinkSocket {
+ public:
+  absl::StatusOr<std::string> DumpLinks() override {
+    return GetDataDependencyFileContents(
+        "ocpdiag/core/hwinterface/backends/host/testdata/"
+        "get_network_interface_info/rtm_getlink.bin");
+  }
+};
+
+class GetNetworkInterfaceInfoTest : public ::testing::Test {
+ protected:
+  GetNetworkInterfaceInfoTest() {
+    auto host = std::make_unique<FakeHostAdapter>();
+    host_ = host.get();
+    CHECK_OK(host_->Write("/sys/class/net/eth0/speed", "25000\n"));
+    // Virtual devices have no speed.
+    CHECK_OK(host_->Write("/sys/class/net/lo/speed", "-1\n"));
+    backend_ = std::make_unique<HostBackend>(
+        EntityConfiguration{}, std::move(host),
+        std::make_unique<RecordedNetlinkSocket>());
+  }
+
+  FakeHostAdapter* host_;
+  std::unique_ptr<HostBackend> backend_;
+};
+
+TEST_F(GetNetworkInterfaceInfoTest, ReadsInterfaces) {
+  absl::StatusOr<GetNetworkInterfaceInfoResponse> resp =
+      backend_->GetNetworkInterfaceInfo(GetNetworkInterfaceInfoRequest());
+  ASSERT_OK(resp);
+  ASSERT_THAT(resp->info(), SizeIs(4));
+  EXPECT_THAT(resp->info(3), EqualsProto(R"pb(
+                id {
+                  devpath: "/sys/class/net/eth0"
+                  name: "eth0"
+                  type: "network_interface"
+                  id: "/sys/class/net/eth0%%eth0%%network_interface"
+                }
+                link_info {
+                  enabled: true
+                  speed_mbps: 25000
+                  mac_address: "02:fc:00:00:00:01"
+                }
+                counters {
+                  rx_bytes: 930
+                  tx_bytes: 1030
+                  rx_packets: 13
+                  tx_packets: 13
+                }
+              )pb"));
+  EXPECT_EQ(resp->info(0).id().name(), "lo");
+  EXPECT_EQ(resp->info(0).link_info().speed_mbps(), 0);
+  EXPECT_EQ(resp->info(1).id().name(), "ifb0");
+  EXPECT_FALSE(resp->info(1).link_info().enabled());
+}
+
+TEST_F(GetNetworkInterfaceInfoTest, ReadsRequestedInfo) {
+  GetNetworkInterfaceInfoRequest req;
+  req.add_info_types(networkinterface::InfoType::COUNTERS);
+  absl::StatusOr<GetNetworkInterfaceInfoResponse> resp =
+      backend_->GetNetworkInterfaceInfo(req);
+  ASSERT_OK(resp);
+  ASSERT_THAT(resp->info(), SizeIs(4));
+  EXPECT_THAT(resp->info(0), EqualsProto(R"pb(
+                counters {
+                  rx_bytes: 182742280
+                  tx_bytes: 182742280
+                  rx_packets: 18578
+                  tx_packets: 18578
+                }
+              )pb"));
+}
+
+TEST_F(GetNetworkInterfaceInfoTest, SamplesLinkCounters) {
+  CHECK_OK(host_->Write("/sys/class/net/eth0/statistics/rx_bytes", "930\n"));
+  for (const char* counter : {"tx_bytes", "rx_packets", "tx_packets",
+                              "rx_errors", "tx_errors", "rx_dropped",
+                              "tx_dropped"}) {
+    CHECK_OK(host_->Write(
+        absl::StrCat("/sys/class/net/eth0/statistics/", counter), "0\n"));
+  }
+  std::unique_ptr<LinkCounterSampler> sampler =
+      backend_->SampleLinkCounters({"eth0"});
+  absl::StatusOr<std::vector<absl::StatusOr<LinkStats>>> samples =
+      sampler->Sample();
+  ASSERT_OK(samples);
+  ASSERT_THAT(*samples, SizeIs(1));
+  EXPECT_THAT((*samples)[0], IsOkAndHolds(Field(&LinkStats::rx_bytes, 930)));
+}
+
+TEST(GetNetworkInterfaceInfo, NeedsNetlink) {
+  HostBackend backend(EntityConfiguration{},
+                      std::make_unique<FakeHostAdapter>());
+  EXPECT_THAT(
+      backend.GetNetworkInterfaceInfo(GetNetworkInterfaceInfoRequest()),
+      StatusIs(absl::StatusCode::kUnimplemented));
+}
+
+}  // namespace
+}  // namespace ocpdiag::hwinterface::internal
@@ -0,0 +1,248 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/host/network.h"
+
+#include <linux/if.h>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/log/check.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "ocpdiag/core/hwinterface/backends/lib/fake_host_adapter.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::hwinterface::internal {
+namespace {
+
+using ::ocpdiag::testing::IsOkAndHolds;
+using ::ocpdiag::testing::StatusIs;
+using ::testing::Contains;
+using ::testing::Field;
+using ::testing::IsEmpty;
+
+template <typename T>
+absl::string_view Bytes(const T& value) {
+  return absl::string_view(reinterpret_cast<const char*>(&value),
+                           sizeof(value));
+}
+
+void AddAttribute(std::string& message, uint16_t type,
+                  absl::string_view data) {
+  const rtattr attribute{.rta_len = static_cast<uint16_t>(RTA_LENGTH(
+                             data.size())),
+                         .rta_type = type};
+  absl::StrAppend(&message, Bytes(attribute), data);
+  message.resize(RTA_ALIGN(message.size()), '\0');
+}
+
+// Returns a netlink message of `type`, as the kernel sends it in reply to the
+// request with sequence number `seq`.
+std::string Message(uint16_t type, absl::string_view payload, uint32_t seq = 0,
+                    uint16_t flags = NLM_F_MULTI) {
+  const nlmsghdr header{
+      .nlmsg_len = static_cast<uint32_t>(NLMSG_LENGTH(payload.size())),
+      .nlmsg_type = type,
+      .nlmsg_flags = flags,
+      .nlmsg_seq = seq};
+  std::string message = absl::StrCat(Bytes(header), payload);
+  message.resize(NLMSG_ALIGN(message.size()), '\0');
+  return message;
+}
+
+std::string LinkMessage(int index, absl::string_view name, unsigned flags,
+                        const rtnl_link_stats64& stats, int num_vfs) {
+  const ifinfomsg info{.ifi_index = index, .ifi_flags = flags};
+  std::string payload = absl::StrCat(Bytes(info));
+  AddAttribute(payload, IFLA_IFNAME, absl::StrCat(name, std::string(1, '\0')));
+  AddAttribute(payload, IFLA_ADDRESS, "\x0c\xc4\x7a\x12\x34\x56");
+  const uint32_t mtu = 1500;
+  AddAttribute(payload, IFLA_MTU, Bytes(mtu));
+  const uint32_t vfs = num_vfs;
+  AddAttribute(payload, IFLA_NUM_VF, Bytes(vfs));
+  // The details of each VF, which RTEXT_FILTER_VF also brings.
+  std::string vf_list;
+  for (int vf = 0; vf < num_vfs; ++vf) {
+    std::string vf_info;
+    const ifla_vf_mac mac{.vf = static_cast<uint32_t>(vf)};
+    AddAttribute(vf_info, IFLA_VF_MAC, Bytes(mac));
+    AddAttribute(vf_list, IFLA_VF_INFO, vf_info);
+  }
+  if (num_vfs > 0) AddAttribute(payload, IFLA_VFINFO_LIST, vf_list);
+  AddAttribute(payload, IFLA_STATS64, Bytes(stats));
+  return Message(RTM_NEWLINK, payload);
+}
+
+std::string DoneMessage() {
+  const int status = 0;
+  return Message(NLMSG_DONE, Bytes(status));
+}
+
+TEST(ParseLinkDump, ParsesLinks) {
+  rtnl_link_stats64 stats{};
+  stats.rx_bytes = 1000;
+  stats.tx_bytes = 2000;
+  stats.rx_packets = 10;
+  stats.tx_dropped = 1;
+  const std::string dump = absl::StrCat(
+      LinkMessage(2, "eth0", IFF_UP | IFF_LOWER_UP, stats, 2),
+      LinkMessage(3, "eth1", 0, rtnl_link_stats64{}, 0), DoneMessage());
+
+  absl::StatusOr<std::vector<NetworkLink>> links = ParseLinkDump(dump);
+  ASSERT_OK(links);
+  ASSERT_EQ(links->size(), 2);
+  const NetworkLink& eth0 = (*links)[0];
+  EXPECT_EQ(eth0.index, 2);
+  EXPECT_EQ(eth0.name, "eth0");
+  EXPECT_EQ(eth0.mac_address, "0c:c4:7a:12:34:56");
+  EXPECT_EQ(eth0.mtu, 1500);
+  EXPECT_TRUE(eth0.up);
+  EXPECT_TRUE(eth0.lower_up);
+  EXPECT_EQ(eth0.num_vfs, 2);
+  EXPECT_EQ(eth0.stats, (LinkStats{.rx_bytes = 1000,
+                                   .tx_bytes = 2000,
+                                   .rx_packets = 10,
+                                   .tx_dropped = 1}));
+  EXPECT_EQ((*links)[1].name, "eth1");
+  EXPECT_FALSE((*links)[1].up);
+}
+
+TEST(ParseLinkDump, EmptyDump) {
+  EXPECT_THAT(ParseLinkDump(DoneMessage()), IsOkAndHolds(IsEmpty()));
+}
+
+TEST(ParseLinkDump, ReportsErrors) {
+  nlmsgerr error{.error = -EPERM};
+  EXPECT_THAT(ParseLinkDump(Message(NLMSG_ERROR, Bytes(error))),
+              StatusIs(absl::StatusCode::kPermissionDenied));
+}
+
+TEST(ParseLinkDump, FailsOnTruncatedMessages) {
+  const std::string message =
+      LinkMessage(2, "eth0", IFF_UP, rtnl_link_stats64{}, 0);
+  EXPECT_THAT(ParseLinkDump(absl::string_view(message).substr(0, 40)),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST(LinkDumpRequest, RequestsVfDetails) {
+  const std::string request = LinkDumpRequest(7);
+  ASSERT_EQ(request.size(), NLMSG_LENGTH(sizeof(ifinfomsg)) +
+                                RTA_LENGTH(sizeof(uint32_t)));
+  nlmsghdr header;
+  memcpy(&header, request.data(), sizeof(header));
+  EXPECT_EQ(header.nlmsg_len, request.size());
+  EXPECT_EQ(header.nlmsg_type, RTM_GETLINK);
+  EXPECT_EQ(header.nlmsg_flags, NLM_F_REQUEST | NLM_F_DUMP);
+  EXPECT_EQ(header.nlmsg_seq, 7);
+
+  rtattr attribute;
+  memcpy(&attribute, request.data() + NLMSG_LENGTH(sizeof(ifinfomsg)),
+         sizeof(attribute));
+  EXPECT_EQ(attribute.rta_type, IFLA_EXT_MASK);
+  uint32_t ext_mask;
+  memcpy(&ext_mask, request.data() + request.size() - sizeof(ext_mask),
+         sizeof(ext_mask));
+  EXPECT_TRUE(ext_mask & RTEXT_FILTER_VF);
+}
+
+TEST(AppendDumpMessages, SkipsOtherRequests) {
+  const ifinfomsg info{.ifi_index = 2};
+  const std::string stale = Message(RTM_NEWLINK, Bytes(info), 1);
+  const std::string link = Message(RTM_NEWLINK, Bytes(info), 2);
+  const int status = 0;
+  const std::string done = Message(NLMSG_DONE, Bytes(status), 2);
+
+  std::string dump;
+  EXPECT_THAT(AppendDumpMessages(absl::StrCat(stale, link), 2, dump),
+              IsOkAndHolds(false));
+  EXPECT_EQ(dump, link);
+  EXPECT_THAT(AppendDumpMessages(absl::StrCat(done, stale), 2, dump),
+              IsOkAndHolds(true));
+  EXPECT_EQ(dump, absl::StrCat(link, done));
+}
+
+TEST(AppendDumpMessages, ReportsInterruptedDumps) {
+  const int status = 0;
+  const std::string done =
+      Message(NLMSG_DONE, Bytes(status), 1, NLM_F_MULTI | NLM_F_DUMP_INTR);
+  std::string dump;
+  EXPECT_THAT(AppendDumpMessages(done, 1, dump),
+              StatusIs(absl::StatusCode::kAborted));
+  // Not for another request.
+  EXPECT_THAT(AppendDumpMessages(done, 2, dump), IsOkAndHolds(false));
+}
+
+TEST(AppendDumpMessages, FailsOnTruncatedMessages) {
+  const std::string message =
+      LinkMessage(2, "eth0", IFF_UP, rtnl_link_stats64{}, 0);
+  std::string dump;
+  EXPECT_THAT(
+      AppendDumpMessages(absl::string_view(message).substr(0, 40), 0, dump),
+      StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST(RtnetlinkSocket, DumpsLoopback) {
+  RtnetlinkSocket socket;
+  absl::StatusOr<std::string> dump = socket.DumpLinks();
+  if (!dump.ok()) GTEST_SKIP() << "No netlink: " << dump.status();
+  EXPECT_THAT(ParseLinkDump(*dump),
+              IsOkAndHolds(Contains(Field(&NetworkLink::name, "lo"))));
+}
+
+class LinkCounterSamplerTest : public ::testing::Test {
+ protected:
+  void WriteCounters(absl::string_view interface, int value) {
+    for (absl::string_view counter :
+         {"rx_bytes", "tx_bytes", "rx_packets", "tx_packets", "rx_errors",
+          "tx_errors", "rx_dropped", "tx_dropped"}) {
+      CHECK_OK(host_.Write(absl::StrCat("/sys/class/net/", interface,
+                                        "/statistics/", counter),
+                           absl::StrCat(value, "\n")));
+    }
+  }
+
+  FakeHostAdapter host_;
+};
+
+TEST_F(LinkCounterSamplerTest, SamplesCounters) {
+  WriteCounters("eth0v0", 1);
+  WriteCounters("eth0v1", 2);
+  LinkCounterSampler sampler(host_, {"eth0v0", "eth0v1", "eth0v2"});
+  absl::StatusOr<std::vector<absl::StatusOr<LinkStats>>> samples =
+      sampler.Sample();
+  ASSERT_OK(samples);
+  ASSERT_EQ(samples->size(), 3);
+  EXPECT_THAT((*samples)[0],
+              IsOkAndHolds(Field(&LinkStats::tx_dropped, 1)));
+  EXPECT_THAT((*samples)[1], IsOkAndHolds(Field(&LinkStats::rx_bytes, 2)));
+  // The interface went away.
+  EXPECT_THAT((*samples)[2], StatusIs(absl::StatusCode::kNotFound));
+
+  WriteCounters("eth0v0", 5);
+  samples = sampler.Sample();
+  ASSERT_OK(samples);
+  EXPECT_THAT((*samples)[0], IsOkAndHolds(Field(&LinkStats::rx_bytes, 5)));
+}
+
+TEST_F(LinkCounterSamplerTest, NoInterfaces) {
+  LinkCounterSampler sampler(host_, {});
+  EXPECT_THAT(sampler.Sample(), IsOkAndHolds(IsEmpty()));
+}
+
+}  // namespace
+}  // namespace ocpdiag::hwinterface::internal
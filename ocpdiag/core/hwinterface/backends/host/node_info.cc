@@ -4,10 +4,32 @@
 // license that can be found in the LICENSE file or at
 // https://opensource.org/licenses/MIT.
 
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/functional/any_invocable.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "ecclesia/lib/smbios/memory_device.h"
+#include "ecclesia/lib/smbios/reader.h"
 #include "ocpdiag/core/compat/status_macros.h"
+#include "ocpdiag/core/hwinterface/backends/host/cpu.h"
 #include "ocpdiag/core/hwinterface/backends/host/host_backend.h"
+#include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
+#include "ocpdiag/core/hwinterface/backends/lib/hw_info.h"
 #include "ocpdiag/core/hwinterface/backends/lib/utils.h"
 #include "ocpdiag/core/hwinterface/identifier.pb.h"
 #include "ocpdiag/core/hwinterface/node.pb.h"
@@ -16,26 +38,185 @@
 
 namespace ocpdiag::hwinterface::internal {
 
-namespace {}  // namespace
+namespace {
+
+// How long each source of FRUs gathered in the background may take. Storage
+// devices may need a smartctl command each.
+constexpr absl::Duration kStorageFruTimeout = absl::Seconds(30);
+constexpr absl::Duration kPcieFruTimeout = absl::Seconds(10);
+// CPUs, DIMMs, storage devices and PCIe cards.
+constexpr int kFruSourceCount = 4;
+
+constexpr char kPcieSlotAddressPattern[] = "/sys/bus/pci/slots/*/address";
+constexpr char kPcieDevicePattern[] = "/sys/bus/pci/devices/*/vendor";
+
+// One per socket, named like the package identifiers of GetCpuInfo().
+std::vector<Identifier> CpuFruIds(const CpuTopology& topology) {
+  std::vector<Identifier> ids;
+  absl::flat_hash_set<int> sockets;
+  for (const CpuNumaNode& node : topology.numa_nodes()) {
+    for (const CpuLpu& lpu : node.lpus()) {
+      if (!sockets.insert(lpu.socket_id()).second) continue;
+      Identifier& id = ids.emplace_back();
+      id.set_name(lpu.socket_name());
+      PopulateId(id);
+    }
+  }
+  return ids;
+}
+
+// The populated memory devices, named like the DIMM identifiers of
+// GetMemoryInfo().
+std::vector<Identifier> DimmFruIds(const ecclesia::SmbiosReader& reader) {
+  std::vector<Identifier> ids;
+  int index = -1;
+  for (const auto& memory_device : reader.GetAllMemoryDevices()) {
+    ++index;
+    if (memory_device.GetMessageView().size().Read() == 0) continue;
+    Identifier& id = ids.emplace_back();
+    id.set_type("dimm");
+    id.set_name(absl::StrCat("DIMM", index));
+    PopulateId(id);
+  }
+  return ids;
+}
+
+// The cards in the PCIe slots that the platform describes, named by their
+// slots. A card is in a slot if a function has the address of the slot, e.g.
+// /sys/bus/pci/devices/0000:3b:00.0 for the address "0000:3b:00".
+absl::StatusOr<std::vector<Identifier>> PcieCardIds(HostAdapter& host) {
+  ASSIGN_OR_RETURN(
+      std::vector<HostAdapter::GlobEntry> entries,
+      host.ReadGlobs({kPcieSlotAddressPattern, kPcieDevicePattern}));
+
+  absl::flat_hash_set<std::string> device_addresses;
+  for (const HostAdapter::GlobEntry& entry : entries) {
+    if (absl::StartsWith(entry.path.string(), "/sys/bus/pci/devices/")) {
+      // Drops the function number.
+      const std::string function =
+          entry.path.parent_path().filename().string();
+      device_addresses.insert(function.substr(0, function.rfind('.')));
+    }
+  }
+
+  std::vector<Identifier> ids;
+  for (const HostAdapter::GlobEntry& entry : entries) {
+    if (!absl::StartsWith(entry.path.string(), "/sys/bus/pci/slots/") ||
+        !entry.content.ok() ||
+        !device_addresses.contains(
+            absl::StripAsciiWhitespace(*entry.content))) {
+      continue;
+    }
+    Identifier& id = ids.emplace_back();
+    id.set_type("pcie_card");
+    id.set_name(entry.path.parent_path().filename().string());
+    PopulateId(id);
+  }
+  return ids;
+}
+
+void AddFrus(absl::string_view source,
+             const absl::StatusOr<std::vector<Identifier>>& ids,
+             GetNodeInfoResponse& resp) {
+  if (!ids.ok()) {
+    node::FruSourceError& error = *resp.add_fru_errors();
+    error.set_source(std::string(source));
+    error.set_message(ids.status().ToString());
+    return;
+  }
+  for (const Identifier& id : *ids) {
+    *resp.mutable_info()->add_frus()->mutable_identifier() = id;
+  }
+}
+
+}  // namespace
+
+// The FRUs of a source gathered on a detached thread. The thread shares it with
+// GetNodeInfo(), which may stop waiting for it.
+struct PendingFrus {
+  absl::Notification done;
+  absl::StatusOr<std::vector<Identifier>> ids;
+};
+
+namespace {
+
+// Starts gathering the FRUs of a source on a detached thread, unless `pending`
+// is still being gathered for an earlier call, which is then waited for
+// instead. `gather` must not use the backend, which the thread may outlive.
+std::shared_ptr<PendingFrus> StartFruSource(
+    std::shared_ptr<PendingFrus>& pending,
+    absl::AnyInvocable<absl::StatusOr<std::vector<Identifier>>() &&> gather) {
+  if (pending != nullptr && !pending->done.HasBeenNotified()) return pending;
+  pending = std::make_shared<PendingFrus>();
+  std::thread([pending, gather = std::move(gather)]() mutable {
+    pending->ids = std::move(gather)();
+    // Releases the host adapter before notifying, so that a source done in
+    // time doesn't hold it past GetNodeInfo().
+    gather = nullptr;
+    pending->done.Notify();
+  }).detach();
+  return pending;
+}
+
+absl::StatusOr<std::vector<Identifier>> WaitForFrus(const PendingFrus& pending,
+                                                    absl::Time deadline) {
+  if (!pending.done.WaitForNotificationWithDeadline(deadline)) {
+    return absl::DeadlineExceededError("Timed out enumerating the FRUs");
+  }
+  return pending.ids;
+}
+
+}  // namespace
 
 absl::StatusOr<GetNodeInfoResponse> HostBackend::GetNodeInfo(
     const GetNodeInfoRequest& req) {
   GetNodeInfoResponse resp;
+  if (!InfoTypeHave(req.info_types(), node::InfoType::FRUS)) return resp;
 
-  // Currently, only storage devices are included in the FRUS infotype.
-  if (InfoTypeHave(req.info_types(), node::InfoType::FRUS)) {
-    GetStorageInfoRequest storage_info_req;
-    storage_info_req.add_info_types(storage::InfoType::IDENTIFIER);
-    ASSIGN_OR_RETURN_WITH_MESSAGE(GetStorageInfoResponse storage_info_resp,
-                                  GetStorageInfo(storage_info_req),
-                                  "GetStorageInfo failed.");
-
-    for (const storage::Info& storage_info : storage_info_resp.info()) {
-      node::Fru& fru = *resp.mutable_info()->add_frus();
-      *fru.mutable_identifier() = storage_info.id();
-    }
+  // The sources that may be slow run in the background, while the CPUs and
+  // DIMMs are read from their caches.
+  const absl::Time start = absl::Now();
+  std::shared_ptr<PendingFrus> storage = StartFruSource(
+      storage_frus_,
+      [host = host_adapter_]() -> absl::StatusOr<std::vector<Identifier>> {
+        GetStorageInfoRequest storage_info_req;
+        storage_info_req.add_info_types(storage::InfoType::IDENTIFIER);
+        ASSIGN_OR_RETURN_WITH_MESSAGE(
+            GetStorageInfoResponse storage_info_resp,
+            ReadStorageInfo(*host, storage_info_req), "GetStorageInfo failed.");
+        std::vector<Identifier> ids;
+        for (const storage::Info& storage_info : storage_info_resp.info()) {
+          ids.push_back(storage_info.id());
+        }
+        return ids;
+      });
+  std::shared_ptr<PendingFrus> pcie = StartFruSource(
+      pcie_frus_, [host = host_adapter_] { return PcieCardIds(*host); });
+
+  InvalidateCpuInventoryOnHotplug();
+  if (absl::StatusOr<const CpuTopology*> topology = GetCpuTopology();
+      topology.ok()) {
+    AddFrus("cpu", CpuFruIds(**topology), resp);
+  } else {
+    AddFrus("cpu", topology.status(), resp);
+  }
+  if (absl::StatusOr<ecclesia::SmbiosReader*> reader = GetSmbiosReader();
+      reader.ok()) {
+    AddFrus("dimm", DimmFruIds(**reader), resp);
+  } else {
+    AddFrus("dimm", reader.status(), resp);
   }
+  AddFrus("storage", WaitForFrus(*storage, start + kStorageFruTimeout), resp);
+  AddFrus("pcie", WaitForFrus(*pcie, start + kPcieFruTimeout), resp);
 
+  if (resp.fru_errors_size() == kFruSourceCount) {
+    std::vector<std::string> errors;
+    for (const node::FruSourceError& error : resp.fru_errors()) {
+      errors.push_back(absl::StrCat(error.source(), ": ", error.message()));
+    }
+    return absl::UnavailableError(absl::StrCat(
+        "Failed to enumerate the FRUs: ", absl::StrJoin(errors, "; ")));
+  }
   return resp;
 }
 
@@ -6,13 +6,19 @@
 
 #include <cstdio>
 #include <memory>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/algorithm/container.h"
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
 #include "ocpdiag/core/hwinterface/backends/host/host_backend.h"
 #include "ocpdiag/core/hwinterface/backends/lib/mock_host_adapter.h"
+#include "ocpdiag/core/hwinterface/node.pb.h"
 #include "ocpdiag/core/hwinterface/service.pb.h"
 #include "ocpdiag/core/testing/proto_matchers.h"
 #include "ocpdiag/core/testing/status_matchers.h"
@@ -21,13 +27,37 @@ namespace ocpdiag::hwinterface::internal {
 namespace {
 
 using ::ocpdiag::testing::EqualsProto;
-using ::ocpdiag::testing::IsOkAndHolds;
 using ::ocpdiag::testing::StatusIs;
+using ::testing::AllOf;
+using ::testing::ElementsAre;
 using ::testing::HasSubstr;
+using ::testing::Property;
 using ::testing::Return;
 
-TEST(HostBackend, GetNodeInfoSucceeds) {
+// The CPUs and DIMMs can't be read, nor globs.
+std::unique_ptr<MockHostAdapter> MockHostWithoutFiles() {
   auto mock_host = std::make_unique<MockHostAdapter>();
+  ON_CALL(*mock_host, Read)
+      .WillByDefault(Return(absl::NotFoundError("No such file")));
+  return mock_host;
+}
+
+// Returns the cards of PCIe slots 1 and 2, of which only slot 1 is occupied.
+absl::StatusOr<std::vector<HostAdapter::GlobEntry>> ReadPcieGlobs(
+    absl::Span<const std::string> patterns) {
+  if (!absl::c_linear_search(patterns, "/sys/bus/pci/slots/*/address")) {
+    return absl::UnimplementedError("Not a PCIe glob");
+  }
+  return std::vector<HostAdapter::GlobEntry>{
+      {"/sys/bus/pci/devices/0000:3b:00.0/vendor", "0x8086\n"},
+      {"/sys/bus/pci/devices/0000:3b:00.1/vendor", "0x8086\n"},
+      {"/sys/bus/pci/slots/1/address", "0000:3b:00\n"},
+      {"/sys/bus/pci/slots/2/address", "0000:5e:00\n"},
+  };
+}
+
+TEST(HostBackend, GetNodeInfoSucceeds) {
+  auto mock_host = MockHostWithoutFiles();
 
   EXPECT_CALL(*mock_host, RunCommand)
       .WillOnce(
@@ -69,22 +99,28 @@ TEST(HostBackend, GetNodeInfoSucceeds) {
 
   HostBackend backend(EntityConfiguration{}, std::move(mock_host));
 
-  EXPECT_THAT(backend.GetNodeInfo(GetNodeInfoRequest()),
-              IsOkAndHolds(EqualsProto(R"pb(
-                info {
-                  frus {
-                    identifier {
-                      name: "ModelName#SerialName"
-                      type: "scsi"
-                      id: "%%ModelName#SerialName%%scsi"
-                    }
+  absl::StatusOr<GetNodeInfoResponse> resp =
+      backend.GetNodeInfo(GetNodeInfoRequest());
+  ASSERT_OK(resp);
+  EXPECT_THAT(resp->info(), EqualsProto(R"pb(
+                frus {
+                  identifier {
+                    name: "ModelName#SerialName"
+                    type: "scsi"
+                    id: "%%ModelName#SerialName%%scsi"
                   }
                 }
-              )pb")));
+              )pb"));
+  // The sources that failed don't fail the others.
+  EXPECT_THAT(resp->fru_errors(),
+              ElementsAre(Property(&node::FruSourceError::source, "cpu"),
+                          Property(&node::FruSourceError::source, "dimm"),
+                          Property(&node::FruSourceError::source, "pcie")));
 }
 
-TEST(HostBackend, GetNodeInfoShouldPropagateGetStorageInfoFailure) {
-  auto mock_host = std::make_unique<MockHostAdapter>();
+TEST(HostBackend, GetNodeInfoReportsGetStorageInfoFailure) {
+  auto mock_host = MockHostWithoutFiles();
+  ON_CALL(*mock_host, ReadGlobs).WillByDefault(ReadPcieGlobs);
 
   // GetStorageInfo propagates RunCommand failure.
   EXPECT_CALL(*mock_host, RunCommand)
@@ -93,8 +129,39 @@ TEST(HostBackend, GetNodeInfoShouldPropagateGetStorageInfoFailure) {
 
   HostBackend backend(EntityConfiguration{}, std::move(mock_host));
 
+  absl::StatusOr<GetNodeInfoResponse> resp =
+      backend.GetNodeInfo(GetNodeInfoRequest());
+  ASSERT_OK(resp);
+  EXPECT_THAT(resp->info(), EqualsProto(R"pb(
+                frus {
+                  identifier {
+                    name: "1"
+                    type: "pcie_card"
+                    id: "%%1%%pcie_card"
+                  }
+                }
+              )pb"));
+  EXPECT_THAT(
+      resp->fru_errors(),
+      ElementsAre(
+          Property(&node::FruSourceError::source, "cpu"),
+          Property(&node::FruSourceError::source, "dimm"),
+          AllOf(Property(&node::FruSourceError::source, "storage"),
+                Property(&node::FruSourceError::message,
+                         HasSubstr("Exit code: 1. Stderr: smartctl error")))));
+}
+
+TEST(HostBackend, GetNodeInfoFailsWhenEverySourceFails) {
+  auto mock_host = MockHostWithoutFiles();
+
+  EXPECT_CALL(*mock_host, RunCommand)
+      .WillOnce(Return(HostAdapter::CommandResult{.exit_code = 1,
+                                                  .stderr = "smartctl error"}));
+
+  HostBackend backend(EntityConfiguration{}, std::move(mock_host));
+
   EXPECT_THAT(backend.GetNodeInfo(GetNodeInfoRequest()),
-              StatusIs(absl::StatusCode::kInternal,
+              StatusIs(absl::StatusCode::kUnavailable,
                        HasSubstr("Exit code: 1. Stderr: smartctl error")));
 }
 
@@ -0,0 +1,338 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/host/pcie.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
+#include "ocpdiag/core/compat/status_macros.h"
+#include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
+
+namespace ocpdiag::hwinterface::internal {
+namespace {
+
+constexpr char kPciDevicesDir[] = "/sys/bus/pci/devices";
+
+// The attributes of each function that the walk reads. The config space is
+// only read for the functions without link attributes.
+constexpr absl::string_view kAttributes[] = {
+    "vendor",
+    "device",
+    "numa_node",
+    "max_link_speed",
+    "max_link_width",
+    "current_link_speed",
+    "current_link_width",
+    "aer_dev_correctable",
+    "aer_dev_nonfatal",
+    "aer_dev_fatal",
+};
+
+// The config space header, and the registers that are decoded.
+constexpr size_t kConfigHeaderSize = 0x40;
+constexpr size_t kVendorIdOffset = 0x00;
+constexpr size_t kDeviceIdOffset = 0x02;
+constexpr size_t kStatusOffset = 0x06;
+constexpr size_t kCapabilitiesPointerOffset = 0x34;
+constexpr uint32_t kStatusCapabilitiesList = 1 << 4;
+constexpr uint8_t kPciExpressCapabilityId = 0x10;
+// Relative to the PCI Express capability.
+constexpr size_t kLinkCapabilitiesOffset = 0x0c;
+constexpr size_t kLinkStatusOffset = 0x12;
+// Bounds the walk of a capability list that loops, as there is room for no
+// more than that many capabilities after the header.
+constexpr int kMaxCapabilities = 48;
+
+// Whether Resample() reads the attribute again.
+bool IsSampled(absl::string_view name) {
+  return absl::StartsWith(name, "current_link_") ||
+         absl::StartsWith(name, "aer_dev_");
+}
+
+uint32_t ReadLittleEndian(absl::string_view data, size_t offset, int size) {
+  uint32_t value = 0;
+  for (int i = size - 1; i >= 0; --i) {
+    value = value << 8 | static_cast<unsigned char>(data[offset + i]);
+  }
+  return value;
+}
+
+// Decodes the speed and width of the Link Capabilities or Link Status
+// register, which share their layout.
+PcieLink DecodeLink(uint32_t reg) {
+  static constexpr int kSpeeds[] = {0, 2500, 5000, 8000, 16000, 32000, 64000};
+  const uint32_t speed = reg & 0xf;
+  return PcieLink{.speed = speed < std::size(kSpeeds) ? kSpeeds[speed] : 0,
+                  .width = static_cast<int>((reg >> 4) & 0x3f)};
+}
+
+absl::Status ParseError(const std::filesystem::path& path,
+                        absl::string_view content) {
+  return absl::InternalError(absl::StrFormat(
+      "Failed to parse PCIe attribute %s: \"%s\"", path.string(), content));
+}
+
+// Returns the total of an aer_dev_* attribute, which counts each kind of
+// error on a line, e.g. "BadTLP 0", followed by e.g. "TOTAL_ERR_COR 0".
+absl::StatusOr<int64_t> ParseAerTotal(const std::filesystem::path& path,
+                                      absl::string_view content) {
+  for (absl::string_view line : absl::StrSplit(content, '\n')) {
+    std::pair<absl::string_view, absl::string_view> counter =
+        absl::StrSplit(line, absl::MaxSplits(' ', 1));
+    int64_t total;
+    if (absl::StartsWith(counter.first, "TOTAL_ERR_") &&
+        absl::SimpleAtoi(absl::StripAsciiWhitespace(counter.second),
+                         &total)) {
+      return total;
+    }
+  }
+  return ParseError(path, content);
+}
+
+// Sets what the attribute at `path` tells about `function`.
+absl::Status ApplyAttribute(const std::filesystem::path& path,
+                            absl::string_view content,
+                            PcieFunction& function) {
+  const std::string name = path.filename().string();
+  const absl::string_view value = absl::StripAsciiWhitespace(content);
+  bool parsed = true;
+  if (name == "vendor") {
+    parsed = absl::SimpleHexAtoi(value, &function.vendor_id);
+  } else if (name == "device") {
+    parsed = absl::SimpleHexAtoi(value, &function.device_id);
+  } else if (name == "numa_node") {
+    parsed = absl::SimpleAtoi(value, &function.numa_node);
+  } else if (name == "max_link_width") {
+    parsed = absl::SimpleAtoi(value, &function.max_link.width);
+  } else if (name == "current_link_width") {
+    parsed = absl::SimpleAtoi(value, &function.current_link.width);
+  } else if (name == "max_link_speed" || name == "current_link_speed") {
+    absl::StatusOr<int> speed = ParsePcieLinkSpeed(value);
+    if (!speed.ok()) return ParseError(path, content);
+    (name == "max_link_speed" ? function.max_link : function.current_link)
+        .speed = *speed;
+  } else if (absl::StartsWith(name, "aer_dev_")) {
+    ASSIGN_OR_RETURN(int64_t total, ParseAerTotal(path, content));
+    PcieAerCounts& aer = function.aer ? *function.aer : function.aer.emplace();
+    if (name == "aer_dev_correctable") {
+      aer.correctable = total;
+    } else if (name == "aer_dev_nonfatal") {
+      aer.nonfatal = total;
+    } else if (name == "aer_dev_fatal") {
+      aer.fatal = total;
+    }
+  } else if (name == "config") {
+    ASSIGN_OR_RETURN_WITH_MESSAGE(PcieConfigSpace config,
+                                  DecodePcieConfigSpace(content),
+                                  path.string());
+    function.vendor_id = config.vendor_id;
+    function.device_id = config.device_id;
+    if (config.max_link) function.max_link = *config.max_link;
+    if (config.current_link) function.current_link = *config.current_link;
+  }
+  if (!parsed) return ParseError(path, content);
+  return absl::OkStatus();
+}
+
+// Returns a function with the location of `address`, e.g. "0000:3b:00.0".
+absl::StatusOr<PcieFunction> NewFunction(absl::string_view address) {
+  PcieFunction function{.address = std::string(address)};
+  std::vector<absl::string_view> fields =
+      absl::StrSplit(address, absl::ByAnyChar(":."));
+  if (fields.size() != 4 ||
+      !absl::SimpleHexAtoi(fields[0], &function.domain) ||
+      !absl::SimpleHexAtoi(fields[1], &function.bus) ||
+      !absl::SimpleHexAtoi(fields[2], &function.device) ||
+      !absl::SimpleHexAtoi(fields[3], &function.function)) {
+    return absl::InternalError(
+        absl::StrCat("Invalid PCI function address: ", address));
+  }
+  return function;
+}
+
+}  // namespace
+
+absl::StatusOr<PcieDevices> PcieDevices::Create(HostAdapter& host) {
+  std::vector<std::string> patterns;
+  for (absl::string_view attribute : kAttributes) {
+    patterns.push_back(absl::StrCat(kPciDevicesDir, "/*/", attribute));
+  }
+  ASSIGN_OR_RETURN(std::vector<HostAdapter::GlobEntry> entries,
+                   host.ReadGlobs(patterns));
+
+  struct WalkedFunction {
+    PcieFunction function;
+    std::vector<std::filesystem::path> sampled_paths;
+    bool has_link_attributes = false;
+  };
+  // By address, so that the functions come out sorted.
+  std::map<std::string, WalkedFunction> walked;
+  for (const HostAdapter::GlobEntry& entry : entries) {
+    const std::string address = entry.path.parent_path().filename().string();
+    auto it = walked.find(address);
+    if (it == walked.end()) {
+      ASSIGN_OR_RETURN(PcieFunction function, NewFunction(address));
+      it = walked.emplace(address, WalkedFunction{.function = function}).first;
+    }
+    // E.g. a function that went away during the walk.
+    if (!entry.content.ok()) continue;
+    RETURN_IF_ERROR(
+        ApplyAttribute(entry.path, *entry.content, it->second.function));
+    const std::string name = entry.path.filename().string();
+    if (IsSampled(name)) it->second.sampled_paths.push_back(entry.path);
+    if (name == "max_link_speed") it->second.has_link_attributes = true;
+  }
+
+  // Kernels without the link attributes, or conventional PCI functions, which
+  // don't have a PCI Express capability to decode anyway.
+  std::vector<std::filesystem::path> config_paths;
+  std::vector<WalkedFunction*> config_functions;
+  for (auto& [address, function] : walked) {
+    if (function.has_link_attributes) continue;
+    config_paths.push_back(
+        std::filesystem::path(kPciDevicesDir) / address / "config");
+    config_functions.push_back(&function);
+  }
+  if (!config_paths.empty()) {
+    ASSIGN_OR_RETURN(std::vector<absl::StatusOr<std::string>> configs,
+                     host.ReadMany(config_paths));
+    for (size_t i = 0; i < configs.size() && i < config_paths.size(); ++i) {
+      if (!configs[i].ok()) continue;
+      RETURN_IF_ERROR(ApplyAttribute(config_paths[i], *configs[i],
+                                     config_functions[i]->function));
+      if (config_functions[i]->function.max_link.width > 0) {
+        config_functions[i]->sampled_paths.push_back(config_paths[i]);
+      }
+    }
+  }
+
+  PcieDevices devices(host);
+  for (auto& [address, function] : walked) {
+    for (std::filesystem::path& path : function.sampled_paths) {
+      devices.sampled_paths_.push_back(std::move(path));
+      devices.sampled_functions_.push_back(devices.functions_.size());
+    }
+    devices.functions_.push_back(std::move(function.function));
+  }
+  devices.sampled_at_ = absl::Now();
+  return devices;
+}
+
+absl::Status PcieDevices::Resample() {
+  if (sampled_paths_.empty()) {
+    sampled_at_ = absl::Now();
+    return absl::OkStatus();
+  }
+  ASSIGN_OR_RETURN(std::vector<absl::StatusOr<std::string>> files,
+                   host_->Sample(sampled_paths_));
+  sampled_at_ = absl::Now();
+  if (files.size() != sampled_paths_.size()) {
+    return absl::InternalError(
+        absl::StrFormat("Sampled %d PCIe attributes, expected %d",
+                        files.size(), sampled_paths_.size()));
+  }
+  std::vector<PcieFunction> functions = functions_;
+  for (size_t i = 0; i < files.size(); ++i) {
+    RETURN_IF_ERROR(files[i].status());
+    RETURN_IF_ERROR(ApplyAttribute(sampled_paths_[i], *files[i],
+                                   functions[sampled_functions_[i]]));
+  }
+  functions_ = std::move(functions);
+  return absl::OkStatus();
+}
+
+absl::StatusOr<PcieConfigSpace> DecodePcieConfigSpace(
+    absl::string_view config) {
+  if (config.size() < kConfigHeaderSize) {
+    return absl::InternalError(
+        absl::StrFormat("PCI config space has %d bytes, expected at least %d",
+                        config.size(), kConfigHeaderSize));
+  }
+  PcieConfigSpace decoded{
+      .vendor_id = static_cast<int>(
+          ReadLittleEndian(config, kVendorIdOffset, /*size=*/2)),
+      .device_id = static_cast<int>(
+          ReadLittleEndian(config, kDeviceIdOffset, /*size=*/2)),
+  };
+  // Reads of a function that went away return all ones.
+  if (decoded.vendor_id == 0xffff) {
+    return absl::NotFoundError("PCI config space reads all ones");
+  }
+  if ((ReadLittleEndian(config, kStatusOffset, /*size=*/2) &
+       kStatusCapabilitiesList) == 0) {
+    return decoded;
+  }
+
+  size_t offset =
+      ReadLittleEndian(config, kCapabilitiesPointerOffset, /*size=*/1) & ~3u;
+  for (int i = 0; i < kMaxCapabilities && offset >= kConfigHeaderSize; ++i) {
+    // The config space past the header may not have been readable.
+    if (offset + 2 > config.size()) break;
+    if (static_cast<uint8_t>(config[offset]) == kPciExpressCapabilityId) {
+      if (offset + kLinkStatusOffset + 2 > config.size()) break;
+      decoded.max_link = DecodeLink(ReadLittleEndian(
+          config, offset + kLinkCapabilitiesOffset, /*size=*/4));
+      decoded.current_link = DecodeLink(
+          ReadLittleEndian(config, offset + kLinkStatusOffset, /*size=*/2));
+      break;
+    }
+    offset = ReadLittleEndian(config, offset + 1, /*size=*/1) & ~3u;
+  }
+  return decoded;
+}
+
+absl::StatusOr<int> ParsePcieLinkSpeed(absl::string_view speed) {
+  speed = absl::StripAsciiWhitespace(speed);
+  // The kernel reports "Unknown", or "Unknown speed" on older versions.
+  if (absl::StartsWith(speed, "Unknown")) return 0;
+  const absl::string_view number = speed.substr(0, speed.find(' '));
+  double gts;
+  if (!absl::StartsWith(speed.substr(number.size()), " GT/s") ||
+      !absl::SimpleAtod(number, &gts)) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Invalid PCIe link speed: \"%s\"", speed));
+  }
+  return static_cast<int>(std::lround(gts * 1000));
+}
+
+int PcieGeneration(int speed) {
+  switch (speed) {
+    case 2500:
+      return 1;
+    case 5000:
+      return 2;
+    case 8000:
+      return 3;
+    case 16000:
+      return 4;
+    case 32000:
+      return 5;
+    case 64000:
+      return 6;
+    default:
+      return 0;
+  }
+}
+
+}  // namespace ocpdiag::hwinterface::internal
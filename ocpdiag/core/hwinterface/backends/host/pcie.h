@@ -0,0 +1,129 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_PCIE_H_
+#define OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_PCIE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
+
+namespace ocpdiag::hwinterface::internal {
+
+// The speed and width of a PCIe link.
+struct PcieLink {
+  // In MT/s, e.g. 16000 for a PCIe 4.0 link, or 0 if unknown.
+  int speed = 0;
+  // The number of lanes, or 0 if the link is down or unknown.
+  int width = 0;
+
+  bool operator==(const PcieLink& other) const {
+    return speed == other.speed && width == other.width;
+  }
+};
+
+// The errors that Advanced Error Reporting counted for a function since boot.
+struct PcieAerCounts {
+  int64_t correctable = 0;
+  int64_t nonfatal = 0;
+  int64_t fatal = 0;
+
+  bool operator==(const PcieAerCounts& other) const {
+    return correctable == other.correctable && nonfatal == other.nonfatal &&
+           fatal == other.fatal;
+  }
+};
+
+// A PCI function, e.g. /sys/bus/pci/devices/0000:3b:00.0.
+struct PcieFunction {
+  // For example "0000:3b:00.0".
+  std::string address;
+  int domain = 0;
+  int bus = 0;
+  int device = 0;
+  int function = 0;
+  int vendor_id = 0;
+  int device_id = 0;
+  // -1 if the function isn't local to a NUMA node.
+  int numa_node = -1;
+  // What the function is capable of, and what its link trained to. Both are
+  // unknown for conventional PCI functions.
+  PcieLink max_link;
+  PcieLink current_link;
+  // Unset if the function doesn't report AER errors.
+  std::optional<PcieAerCounts> aer;
+
+  // Whether the link is up, but slower or narrower than the function is
+  // capable of, like LnkSta against LnkCap in `lspci -vv`.
+  bool TrainedDown() const {
+    return current_link.width > 0 &&
+           (current_link.speed < max_link.speed ||
+            current_link.width < max_link.width);
+  }
+};
+
+// PcieDevices reads the PCI functions under /sys/bus/pci/devices in process,
+// instead of spawning lspci and parsing its output. The functions are walked
+// once, with a single HostAdapter::ReadGlobs() call, after which Resample()
+// only reads their link state and AER counters again through
+// HostAdapter::Sample(), which keeps the files open.
+class PcieDevices {
+ public:
+  // Walks the functions of `host`, which must outlive this.
+  static absl::StatusOr<PcieDevices> Create(HostAdapter& host);
+
+  // Sorted by address.
+  const std::vector<PcieFunction>& functions() const { return functions_; }
+  absl::Time sampled_at() const { return sampled_at_; }
+
+  // Reads the current links and the AER counters again. Fails if a function
+  // went away, in which case the functions need to be walked again.
+  absl::Status Resample();
+
+ private:
+  explicit PcieDevices(HostAdapter& host) : host_(&host) {}
+
+  HostAdapter* host_;
+  std::vector<PcieFunction> functions_;
+  // The files that Resample() reads, and the index of their function in
+  // `functions_`.
+  std::vector<std::filesystem::path> sampled_paths_;
+  std::vector<size_t> sampled_functions_;
+  absl::Time sampled_at_ = absl::InfinitePast();
+};
+
+// What the config space of a function tells, from the content of its sysfs
+// `config` file. Only the first 64 bytes can be read without CAP_SYS_ADMIN,
+// which leaves the PCI Express capability, and so the links, out of reach.
+struct PcieConfigSpace {
+  int vendor_id = 0;
+  int device_id = 0;
+  // Unset without a PCI Express capability.
+  std::optional<PcieLink> max_link;
+  std::optional<PcieLink> current_link;
+};
+absl::StatusOr<PcieConfigSpace> DecodePcieConfigSpace(absl::string_view config);
+
+// Returns the speed in MT/s of a sysfs link speed attribute, e.g.
+// "16.0 GT/s PCIe", or 0 for "Unknown".
+absl::StatusOr<int> ParsePcieLinkSpeed(absl::string_view speed);
+
+// Returns the PCIe generation of a link running at `speed` MT/s, e.g. 4 for
+// 16000, or 0 if unknown.
+int PcieGeneration(int speed);
+
+}  // namespace ocpdiag::hwinterface::internal
+
+#endif  // OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_PCIE_H_
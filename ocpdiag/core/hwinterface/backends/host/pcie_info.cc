@@ -0,0 +1,96 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include <memory>
+#include <utility>
+
+#include "absl/algorithm/container.h"
+#include "absl/status/statusor.h"
+#include "ocpdiag/core/compat/status_macros.h"
+#include "ocpdiag/core/hwinterface/backends/host/host_backend.h"
+#include "ocpdiag/core/hwinterface/backends/host/pcie.h"
+#include "ocpdiag/core/hwinterface/backends/lib/hw_info.h"
+#include "ocpdiag/core/hwinterface/backends/lib/utils.h"
+#include "ocpdiag/core/hwinterface/identifier.pb.h"
+#include "ocpdiag/core/hwinterface/interface.pb.h"
+#include "ocpdiag/core/hwinterface/service.pb.h"
+
+namespace ocpdiag::hwinterface::internal {
+
+namespace {
+
+// Whether the request only asks for what changes while the functions stay the
+// same.
+bool OnlyLinkState(const GetPcieInfoRequest& req) {
+  return !req.info_types().empty() &&
+         absl::c_all_of(req.info_types(), [](int type) {
+           return type == interface::InfoType::METRIC ||
+                  type == interface::InfoType::ENABLED;
+         });
+}
+
+void SetMetric(const PcieLink& link,
+               interface::PcieInfo::PcieMetric& metric) {
+  metric.set_enabled(link.width > 0);
+  metric.set_lanes_in_use(link.width);
+  metric.set_speed(link.speed);
+  metric.set_pcie_type(static_cast<interface::PcieInfo::PcieMetric::Type>(
+      PcieGeneration(link.speed)));
+}
+
+}  // namespace
+
+absl::StatusOr<GetPcieInfoResponse> HostBackend::GetPcieInfo(
+    const GetPcieInfoRequest& req) {
+  // Re-sampling fails if a function went away, which walks them again.
+  if (pcie_devices_ == nullptr || !OnlyLinkState(req) ||
+      !pcie_devices_->Resample().ok()) {
+    ASSIGN_OR_RETURN(PcieDevices devices,
+                     PcieDevices::Create(*host_adapter_));
+    pcie_devices_ = std::make_unique<PcieDevices>(std::move(devices));
+  }
+
+  GetPcieInfoResponse resp;
+  for (const PcieFunction& function : pcie_devices_->functions()) {
+    interface::PcieInfo& info = *resp.add_info();
+    if (InfoTypeHave(req.info_types(), interface::InfoType::IDENTIFIER)) {
+      Identifier& id = *info.mutable_id();
+      id.set_name(function.address);
+      id.set_type("pcie_function");
+      PopulateId(id);
+    }
+    if (InfoTypeHave(req.info_types(), interface::InfoType::LOCATION)) {
+      interface::PcieInfo::Location& location = *info.mutable_local_link();
+      location.set_domain(function.domain);
+      location.set_bus(function.bus);
+      location.set_device(function.device);
+      location.set_function(function.function);
+      info.set_numa_node(function.numa_node);
+    }
+    if (InfoTypeHave(req.info_types(), interface::InfoType::SIGNATURE)) {
+      info.mutable_signature()->set_vendor_id(function.vendor_id);
+      info.mutable_signature()->set_device_id(function.device_id);
+    }
+    if (InfoTypeHave(req.info_types(), interface::InfoType::ENABLED)) {
+      info.mutable_expected_metric()->set_enabled(function.max_link.width > 0);
+      info.mutable_actual_metric()->set_enabled(
+          function.current_link.width > 0);
+    }
+    if (InfoTypeHave(req.info_types(), interface::InfoType::METRIC)) {
+      SetMetric(function.max_link, *info.mutable_expected_metric());
+      SetMetric(function.current_link, *info.mutable_actual_metric());
+      if (function.aer) {
+        interface::PcieInfo::AerCounters& aer = *info.mutable_aer_counters();
+        aer.set_correctable(function.aer->correctable);
+        aer.set_nonfatal(function.aer->nonfatal);
+        aer.set_fatal(function.aer->fatal);
+      }
+    }
+  }
+  return resp;
+}
+
+}  // namespace ocpdiag::hwinterface::internal
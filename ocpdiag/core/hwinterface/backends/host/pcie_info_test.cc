@@ -0,0 +1,122 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include <memory>
+#include <utility>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/log/check.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "ocpdiag/core/hwinterface/backends/host/host_backend.h"
+#include "ocpdiag/core/hwinterface/backends/lib/fake_host_adapter.h"
+#include "ocpdiag/core/hwinterface/interface.pb.h"
+#include "ocpdiag/core/hwinterface/service.pb.h"
+#include "ocpdiag/core/testing/proto_matchers.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::hwinterface::internal {
+namespace {
+
+using ::ocpdiag::testing::EqualsProto;
+using ::ocpdiag::testing::IsOkAndHolds;
+
+constexpr char kFunction[] = "/sys/bus/pci/devices/0000:3b:00.0";
+
+class GetPcieInfoTest : public ::testing::Test {
+ protected:
+  GetPcieInfoTest() {
+    auto host = std::make_unique<FakeHostAdapter>();
+    host_ = host.get();
+    Write("vendor", "0x10de\n");
+    Write("device", "0x20b0\n");
+    Write("numa_node", "1\n");
+    Write("max_link_speed", "16.0 GT/s PCIe\n");
+    Write("max_link_width", "16\n");
+    Write("current_link_speed", "8.0 GT/s PCIe\n");
+    Write("current_link_width", "16\n");
+    Write("aer_dev_correctable", "BadTLP 0\nTOTAL_ERR_COR 0\n");
+    Write("aer_dev_nonfatal", "Undefined 0\nTOTAL_ERR_NONFATAL 0\n");
+    Write("aer_dev_fatal", "Undefined 0\nTOTAL_ERR_FATAL 0\n");
+    backend_ = std::make_unique<HostBackend>(EntityConfiguration{},
+                                             std::move(host));
+  }
+
+  void Write(absl::string_view attribute, absl::string_view content) {
+    CHECK_OK(host_->Write(absl::StrCat(kFunction, "/", attribute), content));
+  }
+
+  FakeHostAdapter* host_;
+  std::unique_ptr<HostBackend> backend_;
+};
+
+TEST_F(GetPcieInfoTest, ReadsFunctions) {
+  EXPECT_THAT(backend_->GetPcieInfo(GetPcieInfoRequest()),
+              IsOkAndHolds(EqualsProto(R"pb(
+                info {
+                  id {
+                    name: "0000:3b:00.0"
+                    type: "pcie_function"
+                    id: "%%0000:3b:00.0%%pcie_function"
+                  }
+                  local_link { bus: 59 }
+                  signature { vendor_id: 4318 device_id: 8368 }
+                  expected_metric {
+                    enabled: true
+                    lanes_in_use: 16
+                    pcie_type: PCIETYPE_GEN4
+                    speed: 16000
+                  }
+                  actual_metric {
+                    enabled: true
+                    lanes_in_use: 16
+                    pcie_type: PCIETYPE_GEN3
+                    speed: 8000
+                  }
+                  aer_counters {}
+                  numa_node: 1
+                }
+              )pb")));
+}
+
+TEST_F(GetPcieInfoTest, ResamplesMetrics) {
+  ASSERT_OK(backend_->GetPcieInfo(GetPcieInfoRequest()));
+
+  Write("current_link_width", "4\n");
+  Write("aer_dev_correctable", "BadTLP 3\nTOTAL_ERR_COR 3\n");
+  GetPcieInfoRequest req;
+  req.add_info_types(interface::InfoType::METRIC);
+  EXPECT_THAT(backend_->GetPcieInfo(req), IsOkAndHolds(EqualsProto(R"pb(
+                info {
+                  expected_metric {
+                    enabled: true
+                    lanes_in_use: 16
+                    pcie_type: PCIETYPE_GEN4
+                    speed: 16000
+                  }
+                  actual_metric {
+                    enabled: true
+                    lanes_in_use: 4
+                    pcie_type: PCIETYPE_GEN3
+                    speed: 8000
+                  }
+                  aer_counters { correctable: 3 }
+                }
+              )pb")));
+
+  // The functions are walked again for anything but their link state.
+  Write("numa_node", "0\n");
+  req.add_info_types(interface::InfoType::LOCATION);
+  absl::StatusOr<GetPcieInfoResponse> resp = backend_->GetPcieInfo(req);
+  ASSERT_OK(resp);
+  EXPECT_EQ(resp->info(0).numa_node(), 0);
+}
+
+}  // namespace
+}  // namespace ocpdiag::hwinterface::internal
@@ -0,0 +1,240 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/host/pcie.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/log/check.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "ocpdiag/core/hwinterface/backends/lib/fake_host_adapter.h"
+#include "ocpdiag/core/hwinterface/backends/lib/mock_host_adapter.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::hwinterface::internal {
+namespace {
+
+using ::ocpdiag::testing::IsOkAndHolds;
+using ::ocpdiag::testing::StatusIs;
+using ::testing::Optional;
+using ::testing::SizeIs;
+
+constexpr char kGpu[] = "/sys/bus/pci/devices/0000:3b:00.0";
+constexpr char kBridge[] = "/sys/bus/pci/devices/0000:00:1f.0";
+
+void PutLittleEndian(std::string& data, size_t offset, uint32_t value,
+                     int size) {
+  for (int i = 0; i < size; ++i) data[offset + i] = (value >> (8 * i)) & 0xff;
+}
+
+// Returns the config space of a function whose PCI Express capability, at
+// 0x60, follows a power management capability at 0x40.
+std::string ConfigSpace(uint16_t vendor_id, uint16_t device_id,
+                        uint32_t link_capabilities, uint16_t link_status) {
+  std::string config(256, '\0');
+  PutLittleEndian(config, 0x00, vendor_id, 2);
+  PutLittleEndian(config, 0x02, device_id, 2);
+  // The Capabilities List bit of the status register.
+  PutLittleEndian(config, 0x06, 1 << 4, 2);
+  config[0x34] = 0x40;
+  config[0x40] = 0x01;
+  config[0x41] = 0x60;
+  config[0x60] = 0x10;
+  PutLittleEndian(config, 0x6c, link_capabilities, 4);
+  PutLittleEndian(config, 0x72, link_status, 2);
+  return config;
+}
+
+// Returns an aer_dev_correctable attribute with a total of `count`.
+std::string AerCorrectable(int count) {
+  return absl::StrCat("RxErr 0\nBadTLP ", count, "\nBadDLLP 0\nTOTAL_ERR_COR ",
+                      count, "\n");
+}
+
+class PcieDevicesTest : public ::testing::Test {
+ protected:
+  PcieDevicesTest() {
+    // A PCIe 4.0 x16 device that trained at PCIe 3.0 x8.
+    Write(kGpu, "vendor", "0x10de\n");
+    Write(kGpu, "device", "0x20b0\n");
+    Write(kGpu, "numa_node", "1\n");
+    Write(kGpu, "max_link_speed", "16.0 GT/s PCIe\n");
+    Write(kGpu, "max_link_width", "16\n");
+    Write(kGpu, "current_link_speed", "8.0 GT/s PCIe\n");
+    Write(kGpu, "current_link_width", "8\n");
+    Write(kGpu, "aer_dev_correctable", AerCorrectable(2));
+    Write(kGpu, "aer_dev_nonfatal", "Undefined 0\nTOTAL_ERR_NONFATAL 0\n");
+    Write(kGpu, "aer_dev_fatal", "Undefined 0\nTOTAL_ERR_FATAL 1\n");
+    // A conventional PCI function, with only the header readable.
+    Write(kBridge, "vendor", "0x8086\n");
+    Write(kBridge, "device", "0xa1c1\n");
+    Write(kBridge, "numa_node", "-1\n");
+    Write(kBridge, "config",
+          std::string(64, '\0').replace(0, 4, "\x86\x80\xc1\xa1"));
+  }
+
+  void Write(absl::string_view function, absl::string_view attribute,
+             absl::string_view content) {
+    CHECK_OK(host_.Write(absl::StrCat(function, "/", attribute), content));
+  }
+
+  FakeHostAdapter host_;
+};
+
+TEST_F(PcieDevicesTest, WalksFunctions) {
+  absl::StatusOr<PcieDevices> devices = PcieDevices::Create(host_);
+  ASSERT_OK(devices);
+  ASSERT_THAT(devices->functions(), SizeIs(2));
+
+  const PcieFunction& bridge = devices->functions()[0];
+  EXPECT_EQ(bridge.address, "0000:00:1f.0");
+  EXPECT_EQ(bridge.device, 0x1f);
+  EXPECT_EQ(bridge.vendor_id, 0x8086);
+  EXPECT_EQ(bridge.device_id, 0xa1c1);
+  EXPECT_EQ(bridge.numa_node, -1);
+  EXPECT_EQ(bridge.max_link, PcieLink{});
+  EXPECT_EQ(bridge.aer, std::nullopt);
+  EXPECT_FALSE(bridge.TrainedDown());
+
+  const PcieFunction& gpu = devices->functions()[1];
+  EXPECT_EQ(gpu.address, "0000:3b:00.0");
+  EXPECT_EQ(gpu.domain, 0);
+  EXPECT_EQ(gpu.bus, 0x3b);
+  EXPECT_EQ(gpu.device, 0);
+  EXPECT_EQ(gpu.function, 0);
+  EXPECT_EQ(gpu.vendor_id, 0x10de);
+  EXPECT_EQ(gpu.device_id, 0x20b0);
+  EXPECT_EQ(gpu.numa_node, 1);
+  EXPECT_EQ(gpu.max_link, (PcieLink{.speed = 16000, .width = 16}));
+  EXPECT_EQ(gpu.current_link, (PcieLink{.speed = 8000, .width = 8}));
+  EXPECT_THAT(gpu.aer, Optional(PcieAerCounts{.correctable = 2, .fatal = 1}));
+  EXPECT_TRUE(gpu.TrainedDown());
+}
+
+TEST_F(PcieDevicesTest, ResampleOnlyReadsLinksAndCounters) {
+  absl::StatusOr<PcieDevices> devices = PcieDevices::Create(host_);
+  ASSERT_OK(devices);
+
+  Write(kGpu, "current_link_speed", "16.0 GT/s PCIe\n");
+  Write(kGpu, "current_link_width", "16\n");
+  Write(kGpu, "aer_dev_correctable", AerCorrectable(5));
+  Write(kGpu, "numa_node", "0\n");
+  ASSERT_OK(devices->Resample());
+
+  const PcieFunction& gpu = devices->functions()[1];
+  EXPECT_EQ(gpu.current_link, (PcieLink{.speed = 16000, .width = 16}));
+  EXPECT_THAT(gpu.aer, Optional(PcieAerCounts{.correctable = 5, .fatal = 1}));
+  EXPECT_FALSE(gpu.TrainedDown());
+  EXPECT_EQ(gpu.numa_node, 1);
+}
+
+TEST_F(PcieDevicesTest, ResampleFailsWhenFunctionIsGone) {
+  absl::StatusOr<PcieDevices> devices = PcieDevices::Create(host_);
+  ASSERT_OK(devices);
+
+  host_.SetReadError(absl::StrCat(kGpu, "/current_link_width"),
+                     absl::StatusCode::kNotFound);
+  EXPECT_THAT(devices->Resample(), StatusIs(absl::StatusCode::kNotFound));
+  // The previous sample is kept.
+  EXPECT_EQ(devices->functions()[1].current_link.width, 8);
+}
+
+TEST_F(PcieDevicesTest, DecodesConfigSpaceWithoutLinkAttributes) {
+  const std::string nic = "/sys/bus/pci/devices/0000:5e:00.1";
+  Write(nic, "vendor", "0x15b3\n");
+  // Gen3 x8 capable, trained at Gen3 x4.
+  Write(nic, "config", ConfigSpace(0x15b3, 0x1017, 0x83, 0x43));
+  absl::StatusOr<PcieDevices> devices = PcieDevices::Create(host_);
+  ASSERT_OK(devices);
+  ASSERT_THAT(devices->functions(), SizeIs(3));
+  EXPECT_EQ(devices->functions()[2].device_id, 0x1017);
+  EXPECT_EQ(devices->functions()[2].max_link,
+            (PcieLink{.speed = 8000, .width = 8}));
+  EXPECT_EQ(devices->functions()[2].current_link,
+            (PcieLink{.speed = 8000, .width = 4}));
+
+  // The link state is sampled from the config space too.
+  Write(nic, "config", ConfigSpace(0x15b3, 0x1017, 0x83, 0x83));
+  ASSERT_OK(devices->Resample());
+  EXPECT_EQ(devices->functions()[2].current_link.width, 8);
+}
+
+TEST_F(PcieDevicesTest, InvalidAttribute) {
+  Write(kGpu, "max_link_width", "wide\n");
+  EXPECT_THAT(PcieDevices::Create(host_),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST(PcieDevices, GlobsNotSupported) {
+  MockHostAdapter host;
+  EXPECT_THAT(PcieDevices::Create(host),
+              StatusIs(absl::StatusCode::kUnimplemented));
+}
+
+TEST(DecodePcieConfigSpace, DecodesLinks) {
+  // Gen5 x16 capable, trained at Gen4 x16.
+  absl::StatusOr<PcieConfigSpace> config =
+      DecodePcieConfigSpace(ConfigSpace(0x1234, 0x5678, 0x105, 0x104));
+  ASSERT_OK(config);
+  EXPECT_EQ(config->vendor_id, 0x1234);
+  EXPECT_EQ(config->device_id, 0x5678);
+  EXPECT_THAT(config->max_link,
+              Optional(PcieLink{.speed = 32000, .width = 16}));
+  EXPECT_THAT(config->current_link,
+              Optional(PcieLink{.speed = 16000, .width = 16}));
+}
+
+TEST(DecodePcieConfigSpace, OnlyHeaderReadable) {
+  absl::StatusOr<PcieConfigSpace> config =
+      DecodePcieConfigSpace(ConfigSpace(0x1234, 0x5678, 0x105, 0x104)
+                                .substr(0, 64));
+  ASSERT_OK(config);
+  EXPECT_EQ(config->vendor_id, 0x1234);
+  EXPECT_EQ(config->max_link, std::nullopt);
+}
+
+TEST(DecodePcieConfigSpace, CapabilityListLoops) {
+  std::string config = ConfigSpace(0x1234, 0x5678, 0x105, 0x104);
+  config[0x60] = 0x05;
+  config[0x61] = 0x40;
+  absl::StatusOr<PcieConfigSpace> decoded = DecodePcieConfigSpace(config);
+  ASSERT_OK(decoded);
+  EXPECT_EQ(decoded->max_link, std::nullopt);
+}
+
+TEST(DecodePcieConfigSpace, InvalidConfigSpace) {
+  EXPECT_THAT(DecodePcieConfigSpace(std::string(16, '\0')),
+              StatusIs(absl::StatusCode::kInternal));
+  EXPECT_THAT(DecodePcieConfigSpace(std::string(64, '\xff')),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST(ParsePcieLinkSpeed, ParsesSysfsSpeeds) {
+  EXPECT_THAT(ParsePcieLinkSpeed("2.5 GT/s PCIe\n"), IsOkAndHolds(2500));
+  EXPECT_THAT(ParsePcieLinkSpeed("8 GT/s"), IsOkAndHolds(8000));
+  EXPECT_THAT(ParsePcieLinkSpeed("64.0 GT/s PCIe"), IsOkAndHolds(64000));
+  EXPECT_THAT(ParsePcieLinkSpeed("Unknown"), IsOkAndHolds(0));
+  EXPECT_THAT(ParsePcieLinkSpeed("fast"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(PcieGeneration, MapsSpeeds) {
+  EXPECT_EQ(PcieGeneration(2500), 1);
+  EXPECT_EQ(PcieGeneration(16000), 4);
+  EXPECT_EQ(PcieGeneration(64000), 6);
+  EXPECT_EQ(PcieGeneration(0), 0);
+}
+
+}  // namespace
+}  // namespace ocpdiag::hwinterface::internal
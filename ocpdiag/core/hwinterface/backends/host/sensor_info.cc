@@ -0,0 +1,68 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "google/protobuf/repeated_field.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "ocpdiag/core/compat/status_macros.h"
+#include "ocpdiag/core/hwinterface/backends/host/host_backend.h"
+#include "ocpdiag/core/hwinterface/backends/host/hwmon.h"
+#include "ocpdiag/core/hwinterface/backends/lib/utils.h"
+#include "ocpdiag/core/hwinterface/identifier.pb.h"
+#include "ocpdiag/core/hwinterface/lib/identifier_utils.h"
+#include "ocpdiag/core/hwinterface/sensor.pb.h"
+#include "ocpdiag/core/hwinterface/service.pb.h"
+
+namespace ocpdiag::hwinterface::internal {
+
+absl::StatusOr<std::vector<HwmonSensor>> HostBackend::FindSensors(
+    const google::protobuf::RepeatedPtrField<Filter>& sensor_filters) {
+  ASSIGN_OR_RETURN(IdentifierMatchersUnion matchers,
+                   IdentifierMatchersUnion::Create(sensor_filters));
+  ASSIGN_OR_RETURN(std::vector<HwmonSensor> sensors,
+                   ReadHwmonSensors(*host_adapter_));
+  std::vector<HwmonSensor> matched;
+  for (HwmonSensor& sensor : sensors) {
+    if (matchers.Match(sensor.info.id())) matched.push_back(std::move(sensor));
+  }
+  if (matched.empty() && !sensor_filters.empty()) {
+    return absl::NotFoundError("No sensor matches the filters");
+  }
+  return matched;
+}
+
+absl::StatusOr<GetSensorsResponse> HostBackend::GetSensors(
+    const GetSensorsRequest& req) {
+  ASSIGN_OR_RETURN(std::vector<HwmonSensor> sensors,
+                   FindSensors(req.sensor_filters()));
+  GetSensorsResponse resp;
+  for (HwmonSensor& sensor : sensors) {
+    sensor::Info& info = *resp.add_sensors();
+    if (InfoTypeHave(req.info_types(), sensor::InfoType::IDENTIFIER)) {
+      *info.mutable_id() = std::move(*sensor.info.mutable_id());
+    }
+    if (InfoTypeHave(req.info_types(), sensor::InfoType::READING)) {
+      *info.mutable_reading() = std::move(*sensor.info.mutable_reading());
+    }
+    if (InfoTypeHave(req.info_types(), sensor::InfoType::LIMITS)) {
+      *info.mutable_limits() = std::move(*sensor.info.mutable_limits());
+    }
+  }
+  return resp;
+}
+
+absl::StatusOr<std::unique_ptr<HwmonSampler>> HostBackend::SampleSensors(
+    const google::protobuf::RepeatedPtrField<Filter>& sensor_filters) {
+  ASSIGN_OR_RETURN(std::vector<HwmonSensor> sensors,
+                   FindSensors(sensor_filters));
+  return std::make_unique<HwmonSampler>(*host_adapter_, std::move(sensors));
+}
+
+}  // namespace ocpdiag::hwinterface::internal
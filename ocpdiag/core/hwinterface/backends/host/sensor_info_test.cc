@@ -0,0 +1,115 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "google/protobuf/repeated_field.h"
+#include "absl/log/check.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "ocpdiag/core/hwinterface/backends/host/host_backend.h"
+#include "ocpdiag/core/hwinterface/backends/host/hwmon.h"
+#include "ocpdiag/core/hwinterface/backends/lib/fake_host_adapter.h"
+#include "ocpdiag/core/hwinterface/identifier.pb.h"
+#include "ocpdiag/core/hwinterface/sensor.pb.h"
+#include "ocpdiag/core/hwinterface/service.pb.h"
+#include "ocpdiag/core/testing/proto_matchers.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::hwinterface::internal {
+namespace {
+
+using ::ocpdiag::testing::EqualsProto;
+using ::ocpdiag::testing::IsOkAndHolds;
+using ::ocpdiag::testing::StatusIs;
+using ::testing::DoubleEq;
+using ::testing::ElementsAre;
+using ::testing::SizeIs;
+
+constexpr char kHwmon[] = "/sys/class/hwmon/hwmon0";
+
+class GetSensorsTest : public ::testing::Test {
+ protected:
+  GetSensorsTest() {
+    auto host = std::make_unique<FakeHostAdapter>();
+    host_ = host.get();
+    Write("name", "coretemp\n");
+    Write("temp1_label", "Package id 0\n");
+    Write("temp1_input", "45000\n");
+    Write("temp1_max", "80000\n");
+    Write("temp1_crit", "100000\n");
+    Write("temp2_label", "Core 0\n");
+    Write("temp2_input", "43000\n");
+    backend_ = std::make_unique<HostBackend>(EntityConfiguration{},
+                                             std::move(host));
+  }
+
+  void Write(absl::string_view attribute, absl::string_view content) {
+    CHECK_OK(host_->Write(absl::StrCat(kHwmon, "/", attribute), content));
+  }
+
+  FakeHostAdapter* host_;
+  std::unique_ptr<HostBackend> backend_;
+};
+
+TEST_F(GetSensorsTest, ReadsSensors) {
+  GetSensorsRequest req;
+  req.add_info_types(sensor::InfoType::READING);
+  req.add_info_types(sensor::InfoType::LIMITS);
+  EXPECT_THAT(backend_->GetSensors(req), IsOkAndHolds(EqualsProto(R"pb(
+                sensors {
+                  reading { reading: 45 }
+                  limits {
+                    upper_critical { limit: 100 }
+                    upper_noncritical { limit: 80 }
+                  }
+                }
+                sensors {
+                  reading { reading: 43 }
+                  limits {}
+                }
+              )pb")));
+}
+
+TEST_F(GetSensorsTest, FiltersSensors) {
+  GetSensorsRequest req;
+  req.add_info_types(sensor::InfoType::IDENTIFIER);
+  req.add_sensor_filters()->mutable_id_regex()->set_name("Core.*");
+  absl::StatusOr<GetSensorsResponse> resp = backend_->GetSensors(req);
+  ASSERT_OK(resp);
+  ASSERT_THAT(resp->sensors(), SizeIs(1));
+  EXPECT_EQ(resp->sensors(0).id().name(), "Core 0");
+  EXPECT_EQ(resp->sensors(0).id().arena(), "coretemp");
+  EXPECT_FALSE(resp->sensors(0).has_reading());
+
+  req.mutable_sensor_filters(0)->mutable_id_regex()->set_name("DIMM.*");
+  EXPECT_THAT(backend_->GetSensors(req),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST_F(GetSensorsTest, SamplesSensors) {
+  google::protobuf::RepeatedPtrField<Filter> filters;
+  filters.Add()->mutable_id_regex()->set_name("Package.*");
+  absl::StatusOr<std::unique_ptr<HwmonSampler>> sampler =
+      backend_->SampleSensors(filters);
+  ASSERT_OK(sampler);
+  ASSERT_THAT((*sampler)->sensors(), SizeIs(1));
+
+  Write("temp1_input", "61500\n");
+  absl::StatusOr<std::vector<absl::StatusOr<double>>> readings =
+      (*sampler)->Sample();
+  ASSERT_OK(readings);
+  EXPECT_THAT(*readings, ElementsAre(IsOkAndHolds(DoubleEq(61.5))));
+}
+
+}  // namespace
+}  // namespace ocpdiag::hwinterface::internal
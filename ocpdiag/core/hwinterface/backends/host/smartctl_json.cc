@@ -0,0 +1,227 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/host/smartctl_json.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "include/nlohmann/json.hpp"
+#include "ocpdiag/core/compat/status_macros.h"
+
+namespace ocpdiag::hwinterface::internal {
+namespace {
+
+// A value of a JSON document. Nulls, and the objects and arrays before their
+// members, are monostate.
+using JsonValue =
+    std::variant<std::monostate, bool, int64_t, double, absl::string_view>;
+
+// Called with the path of each value, e.g. "devices[].name" for the names of
+// the objects of the "devices" array.
+using JsonCallback =
+    absl::FunctionRef<void(absl::string_view path, const JsonValue& value)>;
+
+// Reports the values of a document to a callback as they are parsed.
+class JsonPathHandler : public nlohmann::json_sax<nlohmann::json> {
+ public:
+  explicit JsonPathHandler(JsonCallback callback) : callback_(callback) {}
+
+  bool null() override { return Value(std::monostate()); }
+  bool boolean(bool value) override { return Value(value); }
+  bool number_integer(number_integer_t value) override {
+    return Value(static_cast<int64_t>(value));
+  }
+  bool number_unsigned(number_unsigned_t value) override {
+    if (value > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+      return Value(static_cast<double>(value));
+    }
+    return Value(static_cast<int64_t>(value));
+  }
+  bool number_float(number_float_t value, const string_t&) override {
+    return Value(static_cast<double>(value));
+  }
+  bool string(string_t& value) override {
+    return Value(absl::string_view(value));
+  }
+  bool binary(binary_t&) override { return Value(std::monostate()); }
+
+  bool start_object(std::size_t) override {
+    Value(std::monostate());
+    containers_.push_back(path_.size());
+    return true;
+  }
+  bool key(string_t& key) override {
+    path_.resize(containers_.back());
+    if (!path_.empty()) path_.push_back('.');
+    path_.append(key);
+    return true;
+  }
+  bool end_object() override { return EndContainer(); }
+
+  bool start_array(std::size_t) override {
+    Value(std::monostate());
+    containers_.push_back(path_.size());
+    path_.append("[]");
+    return true;
+  }
+  bool end_array() override { return EndContainer(); }
+
+  bool parse_error(std::size_t, const std::string&,
+                   const nlohmann::detail::exception&) override {
+    return false;
+  }
+
+ private:
+  bool Value(const JsonValue& value) {
+    callback_(path_, value);
+    return true;
+  }
+
+  bool EndContainer() {
+    path_.resize(containers_.back());
+    containers_.pop_back();
+    return true;
+  }
+
+  JsonCallback callback_;
+  std::string path_;
+  // The length of the path of each enclosing object or array.
+  std::vector<size_t> containers_;
+};
+
+absl::Status ParseJson(absl::string_view json, JsonCallback callback) {
+  JsonPathHandler handler(callback);
+  if (!nlohmann::json::sax_parse(json.begin(), json.end(), &handler)) {
+    return absl::InternalError(
+        absl::StrCat("Unable to parse text to json. Result from smartctl is "
+                     "not in json format. Result: ",
+                     json));
+  }
+  return absl::OkStatus();
+}
+
+template <typename T>
+std::optional<T> Get(const JsonValue& value) {
+  if (const T* v = std::get_if<T>(&value); v != nullptr) return *v;
+  return std::nullopt;
+}
+
+std::optional<std::string> GetString(const JsonValue& value) {
+  if (const auto* v = std::get_if<absl::string_view>(&value); v != nullptr) {
+    return std::string(*v);
+  }
+  return std::nullopt;
+}
+
+// Adds the value at `path` if it is a boolean member of the object at
+// `object_path`.
+void AddCapability(absl::string_view object_path, absl::string_view path,
+                   const JsonValue& value,
+                   std::vector<std::pair<std::string, bool>>& capabilities) {
+  const bool* supported = std::get_if<bool>(&value);
+  if (supported == nullptr || !absl::ConsumePrefix(&path, object_path) ||
+      !absl::ConsumePrefix(&path, ".") ||
+      path.find_first_of(".[") != absl::string_view::npos) {
+    return;
+  }
+  capabilities.emplace_back(path, *supported);
+}
+
+}  // namespace
+
+absl::StatusOr<std::vector<SmartctlDevice>> ParseSmartctlScan(
+    absl::string_view json) {
+  std::vector<SmartctlDevice> devices;
+  RETURN_IF_ERROR(ParseJson(
+      json, [&](absl::string_view path, const JsonValue& value) {
+        if (path == "devices[]") {
+          devices.emplace_back();
+        } else if (devices.empty()) {
+          return;
+        } else if (path == "devices[].name") {
+          devices.back().name = GetString(value).value_or("");
+        } else if (path == "devices[].type") {
+          devices.back().type = GetString(value).value_or("");
+        }
+      }));
+  for (const SmartctlDevice& device : devices) {
+    if (device.name.empty()) {
+      return absl::InternalError(absl::StrCat(
+          "smartctl --scan reported a device without a name: ", json));
+    }
+  }
+  return devices;
+}
+
+absl::StatusOr<SmartctlDeviceInfo> ParseSmartctlDeviceInfo(
+    absl::string_view json) {
+  constexpr absl::string_view kSmartCapabilities =
+      "ata_smart_data.capabilities";
+  constexpr absl::string_view kSctCapabilities = "ata_sct_capabilities";
+
+  SmartctlDeviceInfo info;
+  RETURN_IF_ERROR(ParseJson(
+      json, [&](absl::string_view path, const JsonValue& value) {
+        if (path == "model_name") {
+          info.model_name = GetString(value);
+        } else if (path == "serial_number") {
+          info.serial_number = GetString(value);
+        } else if (path == "rotation_rate") {
+          info.rotation_rate = Get<int64_t>(value);
+        } else if (path == "user_capacity.blocks") {
+          info.num_blocks = Get<int64_t>(value);
+        } else if (path == "logical_block_size") {
+          info.logical_block_size = Get<int64_t>(value);
+        } else if (path == "physical_block_size") {
+          info.physical_block_size = Get<int64_t>(value);
+        } else if (path == "sata_version") {
+          info.has_sata_version = true;
+        } else if (path == "nvme_version") {
+          info.has_nvme_version = true;
+        } else if (path == "smart_support.available") {
+          info.smart_available = Get<bool>(value).value_or(false);
+        } else if (path == "smart_support.enabled") {
+          info.smart_enabled = Get<bool>(value).value_or(false);
+        } else if (path == kSctCapabilities) {
+          info.has_sct_capabilities = true;
+        } else {
+          AddCapability(kSmartCapabilities, path, value,
+                        info.smart_capabilities);
+          AddCapability(kSctCapabilities, path, value, info.sct_capabilities);
+        }
+      }));
+  return info;
+}
+
+absl::StatusOr<SmartctlSecurityInfo> ParseSmartctlSecurityInfo(
+    absl::string_view json) {
+  SmartctlSecurityInfo info;
+  RETURN_IF_ERROR(ParseJson(
+      json, [&](absl::string_view path, const JsonValue& value) {
+        if (path == "ata_security.enabled") {
+          info.ata_security_enabled = Get<bool>(value).value_or(false);
+        } else if (path == "ata_security.string") {
+          info.ata_security_string = GetString(value).value_or("");
+        }
+      }));
+  return info;
+}
+
+}  // namespace ocpdiag::hwinterface::internal
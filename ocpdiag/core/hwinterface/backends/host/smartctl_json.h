@@ -0,0 +1,74 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_SMARTCTL_JSON_H_
+#define OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_SMARTCTL_JSON_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+
+namespace ocpdiag::hwinterface::internal {
+
+// The parsers below stream through the JSON output of smartctl and only keep
+// the fields that are reported, instead of building a document of the whole
+// output, which for NVMe devices includes large SMART and error logs. They
+// return an error if the output isn't valid JSON, but a missing field is
+// left empty, for the caller to decide whether it needs it.
+
+// A device found by `smartctl --json --scan`.
+struct SmartctlDevice {
+  // For example "/dev/sda".
+  std::string name;
+  // For example "sat" or "nvme".
+  std::string type;
+};
+
+absl::StatusOr<std::vector<SmartctlDevice>> ParseSmartctlScan(
+    absl::string_view json);
+
+// The fields of `smartctl --json --all <device>` that describe a device.
+struct SmartctlDeviceInfo {
+  std::optional<std::string> model_name;
+  std::optional<std::string> serial_number;
+  std::optional<int64_t> rotation_rate;
+  // user_capacity.blocks
+  std::optional<int64_t> num_blocks;
+  std::optional<int64_t> logical_block_size;
+  std::optional<int64_t> physical_block_size;
+  bool has_sata_version = false;
+  bool has_nvme_version = false;
+  // smart_support.available and smart_support.enabled
+  bool smart_available = false;
+  bool smart_enabled = false;
+  bool has_sct_capabilities = false;
+  // The boolean members of ata_smart_data.capabilities and of
+  // ata_sct_capabilities, in order, e.g. {"gp_logging_supported", true}.
+  std::vector<std::pair<std::string, bool>> smart_capabilities;
+  std::vector<std::pair<std::string, bool>> sct_capabilities;
+};
+
+absl::StatusOr<SmartctlDeviceInfo> ParseSmartctlDeviceInfo(
+    absl::string_view json);
+
+// The fields of `smartctl --json -g security <device>`.
+struct SmartctlSecurityInfo {
+  // ata_security.enabled and ata_security.string
+  bool ata_security_enabled = false;
+  std::string ata_security_string;
+};
+
+absl::StatusOr<SmartctlSecurityInfo> ParseSmartctlSecurityInfo(
+    absl::string_view json);
+
+}  // namespace ocpdiag::hwinterface::internal
+
+#endif  // OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_SMARTCTL_JSON_H_
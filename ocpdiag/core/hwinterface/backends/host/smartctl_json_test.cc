@@ -0,0 +1,161 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/host/smartctl_json.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::hwinterface::internal {
+namespace {
+
+using ::ocpdiag::testing::StatusIs;
+using ::testing::AllOf;
+using ::testing::ElementsAre;
+using ::testing::Field;
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+using ::testing::Optional;
+using ::testing::Pair;
+
+TEST(ParseSmartctlScan, ParsesDevices) {
+  absl::StatusOr<std::vector<SmartctlDevice>> devices =
+      ParseSmartctlScan(R"json(
+    {
+      "json_format_version": [1, 0],
+      "devices": [
+        {"name": "/dev/sda", "info_name": "/dev/sda", "type": "sat"},
+        {"name": "/dev/nvme0", "type": "nvme", "protocol": "NVMe"}
+      ]
+    })json");
+  ASSERT_OK(devices);
+  EXPECT_THAT(
+      *devices,
+      ElementsAre(
+          AllOf(Field(&SmartctlDevice::name, "/dev/sda"),
+                Field(&SmartctlDevice::type, "sat")),
+          AllOf(Field(&SmartctlDevice::name, "/dev/nvme0"),
+                Field(&SmartctlDevice::type, "nvme"))));
+}
+
+TEST(ParseSmartctlScan, NoDevices) {
+  absl::StatusOr<std::vector<SmartctlDevice>> devices =
+      ParseSmartctlScan(R"json({"devices": []})json");
+  ASSERT_OK(devices);
+  EXPECT_THAT(*devices, IsEmpty());
+}
+
+TEST(ParseSmartctlScan, DeviceWithoutName) {
+  EXPECT_THAT(ParseSmartctlScan(R"json({"devices": [{"type": "sat"}]})json"),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST(ParseSmartctlScan, InvalidJson) {
+  EXPECT_THAT(ParseSmartctlScan(R"json({"devices": [})json"),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("Unable to parse text to json")));
+}
+
+TEST(ParseSmartctlDeviceInfo, ParsesAtaDevice) {
+  absl::StatusOr<SmartctlDeviceInfo> info = ParseSmartctlDeviceInfo(R"json(
+    {
+      "device": {"name": "/dev/sda", "type": "sat"},
+      "model_name": "ModelName",
+      "serial_number": "SerialName",
+      "user_capacity": {"blocks": 209715200, "bytes": 107374182400},
+      "logical_block_size": 512,
+      "physical_block_size": 4096,
+      "rotation_rate": 7200,
+      "sata_version": {"string": "SATA 3.2", "value": 255},
+      "smart_support": {"available": true, "enabled": false},
+      "ata_smart_data": {
+        "offline_data_collection": {"status": {"passed": true}},
+        "capabilities": {
+          "values": [113, 3],
+          "exec_offline_immediate_supported": true,
+          "gp_logging_supported": false
+        }
+      },
+      "ata_sct_capabilities": {
+        "value": 49,
+        "data_table_supported": true
+      }
+    })json");
+  ASSERT_OK(info);
+  EXPECT_THAT(info->model_name, Optional(std::string("ModelName")));
+  EXPECT_THAT(info->serial_number, Optional(std::string("SerialName")));
+  EXPECT_THAT(info->num_blocks, Optional(209715200));
+  EXPECT_THAT(info->logical_block_size, Optional(512));
+  EXPECT_THAT(info->physical_block_size, Optional(4096));
+  EXPECT_THAT(info->rotation_rate, Optional(7200));
+  EXPECT_TRUE(info->has_sata_version);
+  EXPECT_FALSE(info->has_nvme_version);
+  EXPECT_TRUE(info->smart_available);
+  EXPECT_FALSE(info->smart_enabled);
+  EXPECT_TRUE(info->has_sct_capabilities);
+  EXPECT_THAT(info->smart_capabilities,
+              ElementsAre(Pair("exec_offline_immediate_supported", true),
+                          Pair("gp_logging_supported", false)));
+  EXPECT_THAT(info->sct_capabilities,
+              ElementsAre(Pair("data_table_supported", true)));
+}
+
+TEST(ParseSmartctlDeviceInfo, LeavesMissingFieldsEmpty) {
+  absl::StatusOr<SmartctlDeviceInfo> info = ParseSmartctlDeviceInfo(R"json(
+    {
+      "model_name": "NvmeModel",
+      "nvme_version": {"string": "1.3", "value": 66304},
+      "nvme_smart_health_information_log": {"temperature": 35},
+      "nvme_error_information_log": {
+        "table": [{"error_count": 1, "status_field": {"value": 8198}}]
+      }
+    })json");
+  ASSERT_OK(info);
+  EXPECT_THAT(info->model_name, Optional(std::string("NvmeModel")));
+  EXPECT_EQ(info->serial_number, std::nullopt);
+  EXPECT_EQ(info->rotation_rate, std::nullopt);
+  EXPECT_EQ(info->num_blocks, std::nullopt);
+  EXPECT_FALSE(info->has_sata_version);
+  EXPECT_TRUE(info->has_nvme_version);
+  EXPECT_FALSE(info->has_sct_capabilities);
+  EXPECT_THAT(info->smart_capabilities, IsEmpty());
+}
+
+TEST(ParseSmartctlDeviceInfo, InvalidJson) {
+  EXPECT_THAT(ParseSmartctlDeviceInfo("not json"),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("Unable to parse text to json")));
+}
+
+TEST(ParseSmartctlSecurityInfo, ParsesAtaSecurity) {
+  absl::StatusOr<SmartctlSecurityInfo> info = ParseSmartctlSecurityInfo(R"json(
+    {
+      "ata_security": {
+        "state": 291,
+        "string": "ENABLED, PW level MAX, not locked, not frozen [SEC5]",
+        "enabled": true
+      }
+    })json");
+  ASSERT_OK(info);
+  EXPECT_TRUE(info->ata_security_enabled);
+  EXPECT_EQ(info->ata_security_string,
+            "ENABLED, PW level MAX, not locked, not frozen [SEC5]");
+
+  info = ParseSmartctlSecurityInfo("{}");
+  ASSERT_OK(info);
+  EXPECT_FALSE(info->ata_security_enabled);
+  EXPECT_THAT(info->ata_security_string, IsEmpty());
+}
+
+}  // namespace
+}  // namespace ocpdiag::hwinterface::internal
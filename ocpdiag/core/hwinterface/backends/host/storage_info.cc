@@ -21,9 +21,10 @@
 #include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
-#include "include/nlohmann/json.hpp"
 #include "ocpdiag/core/compat/status_macros.h"
 #include "ocpdiag/core/hwinterface/backends/host/host_backend.h"
+#include "ocpdiag/core/hwinterface/backends/host/smartctl_json.h"
+#include "ocpdiag/core/hwinterface/backends/host/storage_sysfs.h"
 #include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
 #include "ocpdiag/core/hwinterface/backends/lib/hw_info.h"
 #include "ocpdiag/core/hwinterface/backends/lib/utils.h"
@@ -36,77 +37,59 @@ namespace ocpdiag::hwinterface::internal {
 namespace {
 
 constexpr absl::Duration kSmartctlTimeout = absl::Seconds(10);
+// The number of smartctl commands run at once when querying the devices.
+constexpr int kMaxConcurrentSmartctl = 16;
 constexpr char kSmartctlDir[] = "/usr/sbin/smartctl";
 constexpr char kJsonArg[] = "--json";
 constexpr char kScanArg[] = "--scan";
 constexpr char kAllArg[] = "--all";
 constexpr char kGetNonSmartSettingsArg[] = "-g";
 constexpr char kSecuritySettingArg[] = "security";
-constexpr char kDevices[] = "devices";
-constexpr char kName[] = "name";
-constexpr char kType[] = "type";
-constexpr char kUserCapacity[] = "user_capacity";
-constexpr char kBlocks[] = "blocks";
-constexpr char kLogicalBlockSize[] = "logical_block_size";
-constexpr char kPhysicalBlockSize[] = "physical_block_size";
-constexpr char kRotationRate[] = "rotation_rate";
-constexpr char kSataVersion[] = "sata_version";
-constexpr char kNvmeVersion[] = "nvme_version";
-constexpr char kModelName[] = "model_name";
-constexpr char kSerialNumber[] = "serial_number";
-constexpr char kSmartSupport[] = "smart_support";
-constexpr char kAvailable[] = "available";
-constexpr char kEnabled[] = "enabled";
-constexpr char kAtaSmartData[] = "ata_smart_data";
-constexpr char kCapabilities[] = "capabilities";
-constexpr char kAtaSctCapabilities[] = "ata_sct_capabilities";
-constexpr char kAtaSecurity[] = "ata_security";
-constexpr char kString[] = "string";
-
-absl::StatusOr<nlohmann::basic_json<>> ParseJson(absl::string_view json_str) {
-  nlohmann::basic_json<> scan_result =
-      nlohmann::json::parse(json_str, nullptr, false);
-  if (scan_result.is_discarded()) {
-    return absl::InternalError(
-        absl::StrCat("Unable to parse text to json. Result from smartctl is "
-                     "not in json format. Result: ",
-                     json_str));
-  }
-  return scan_result;
-}
 
-storage::DeviceType GetDeviceType(nlohmann::basic_json<>& device_result) {
-  if (device_result.contains(kSataVersion)) {
-    switch (device_result[kRotationRate].get<int>()) {
+// Returns the type of a device from the output of `smartctl --all`.
+absl::StatusOr<storage::DeviceType> GetDeviceType(
+    const std::string& device_name, const SmartctlDeviceInfo& device_info) {
+  if (device_info.has_sata_version) {
+    if (!device_info.rotation_rate.has_value()) {
+      return absl::InternalError(absl::StrFormat(
+          "smartctl output for %s has no rotation_rate", device_name));
+    }
+    switch (*device_info.rotation_rate) {
       case 0:
         return storage::DEVICETYPE_SSD;
       default:
         return storage::DEVICETYPE_HDD;
     }
-  } else if (device_result.contains(kNvmeVersion)) {
+  } else if (device_info.has_nvme_version) {
     return storage::DEVICETYPE_NVME_SSD;
   }
   LOG(WARNING) << "Unable to determine the type of storage device.";
   return storage::DEVICETYPE_UNKNOWN;
 }
 
-// Runs command with given `args` through `host_adapter` and returns the STDOUT.
-absl::StatusOr<std::string> RunCommand(
-    std::unique_ptr<HostAdapter>& host_adapter,
-    const std::vector<std::string>& args) {
-  ASSIGN_OR_RETURN(HostAdapter::CommandResult cmd_result,
-                   (host_adapter->RunCommand(kSmartctlTimeout, args)));
-  if (cmd_result.exit_code == 64) {
+// Returns the STDOUT of a smartctl command run with `args`, or an error if the
+// command failed.
+absl::StatusOr<std::string> SmartctlOutput(
+    const std::vector<std::string>& args,
+    absl::StatusOr<HostAdapter::CommandResult> cmd_result) {
+  RETURN_IF_ERROR(cmd_result.status());
+  if (cmd_result->exit_code == 64) {
     // If a disk has old indications of failure in its SMART log, exit code 64
     // is provided. smartctl is still successfully executed.
-    return cmd_result.stdout;
-  } else if (cmd_result.exit_code) {
+    return std::move(cmd_result->stdout);
+  } else if (cmd_result->exit_code) {
     return absl::InternalError(absl::StrFormat(
         "Command \"%s\" failed. Exit code: %d. Stderr: %s. Stdout: %s",
-        absl::StrJoin(args, " "), cmd_result.exit_code, cmd_result.stderr,
-        cmd_result.stdout));
+        absl::StrJoin(args, " "), cmd_result->exit_code, cmd_result->stderr,
+        cmd_result->stdout));
   }
-  return cmd_result.stdout;
+  return std::move(cmd_result->stdout);
+}
+
+// Runs command with given `args` through `host_adapter` and returns the STDOUT.
+absl::StatusOr<std::string> RunCommand(HostAdapter& host_adapter,
+                                       const std::vector<std::string>& args) {
+  return SmartctlOutput(args, host_adapter.RunCommand(kSmartctlTimeout, args));
 }
 
 std::optional<storage::Capability> CapabilityMapping(
@@ -155,33 +138,40 @@ void MapAndSetCap(const std::string& smartctl_cap_key, const bool cap_status,
   }
 }
 
-void SetAtaInfo(const std::string& device_name,
-                const nlohmann::basic_json<>& device_result,
+void SetAtaInfo(const SmartctlDeviceInfo& device_info,
                 storage::AtaInfo& ata_info) {
-  ata_info.set_num_sectors(device_result[kUserCapacity][kBlocks]);
-  ata_info.set_logical_sector_size(device_result[kLogicalBlockSize]);
-  ata_info.set_physical_sector_size(device_result[kPhysicalBlockSize]);
-  ata_info.set_rpm(device_result[kRotationRate]);
+  // The fields that smartctl doesn't report for a device, e.g. the rotation
+  // rate of most NVMe devices, are left unset.
+  if (device_info.num_blocks.has_value()) {
+    ata_info.set_num_sectors(*device_info.num_blocks);
+  }
+  if (device_info.logical_block_size.has_value()) {
+    ata_info.set_logical_sector_size(*device_info.logical_block_size);
+  }
+  if (device_info.physical_block_size.has_value()) {
+    ata_info.set_physical_sector_size(*device_info.physical_block_size);
+  }
+  if (device_info.rotation_rate.has_value()) {
+    ata_info.set_rpm(*device_info.rotation_rate);
+  }
 
-  if (device_result[kSmartSupport][kAvailable]) {
+  if (device_info.smart_available) {
     ata_info.add_supported_capabilities(storage::CAP_SMART);
   }
-  if (device_result[kSmartSupport][kEnabled]) {
+  if (device_info.smart_enabled) {
     ata_info.add_enabled_capabilities(storage::CAP_SMART);
   }
 
   // Sets enabled_capabilities and supported_capabilities for AtaInfo.
   for (const auto& [smartctl_cap_key, cap_status] :
-       device_result[kAtaSmartData][kCapabilities].items()) {
-    if (!cap_status.is_boolean()) continue;
+       device_info.smart_capabilities) {
     MapAndSetCap(smartctl_cap_key, cap_status, ata_info);
   }
 
-  if (device_result.contains(kAtaSctCapabilities)) {
+  if (device_info.has_sct_capabilities) {
     ata_info.add_supported_capabilities(storage::CAP_SCT);
     for (const auto& [smartctl_cap_key, cap_status] :
-         device_result[kAtaSctCapabilities].items()) {
-      if (!cap_status.is_boolean()) continue;
+         device_info.sct_capabilities) {
       MapAndSetCap(smartctl_cap_key, cap_status, ata_info);
     }
   }
@@ -208,25 +198,20 @@ SecurityLevelMap() {
 
 #undef SECURITY_LEVEL_PAIR
 
-absl::Status SetSecurityInfo(const std::string& device_name,
-                             std::unique_ptr<HostAdapter>& host_adapter,
+// Sets the security info from the output of `smartctl -g security`.
+absl::Status SetSecurityInfo(const std::string& stdout,
                              storage::SecurityInfo& security_info) {
-  ASSIGN_OR_RETURN(
-      const std::string& stdout,
-      RunCommand(host_adapter, {kSmartctlDir, kJsonArg, kGetNonSmartSettingsArg,
-                                kSecuritySettingArg, device_name}));
-  ASSIGN_OR_RETURN(nlohmann::basic_json<> security_json, ParseJson(stdout));
+  ASSIGN_OR_RETURN(const SmartctlSecurityInfo smartctl_security_info,
+                   ParseSmartctlSecurityInfo(stdout));
 
   // Only ATA security can be determined for now. An unknown security mode would
   // be shown even if TCG security is enabled.
-  if (security_json.contains(kAtaSecurity) &&
-      security_json[kAtaSecurity][kEnabled] == true) {
+  if (smartctl_security_info.ata_security_enabled) {
     security_info.set_mode(storage::SECURITYMODE_ATA);
 
     for (const auto& [sec_keyword, security_level] : SecurityLevelMap()) {
-      if (absl::StrContains(
-              security_json[kAtaSecurity][kString].get<std::string>(),
-              sec_keyword)) {
+      if (absl::StrContains(smartctl_security_info.ata_security_string,
+                            sec_keyword)) {
         security_info.set_level(security_level);
         break;
       }
@@ -236,55 +221,146 @@ absl::Status SetSecurityInfo(const std::string& device_name,
   return absl::OkStatus();
 }
 
+// Returns the storage info read from sysfs, or nullopt if smartctl has to be
+// run instead: for the info types that come from SMART data, when the adapter
+// can't read sysfs in bulk, or when sysfs lacks the identity of a device.
+absl::StatusOr<std::optional<GetStorageInfoResponse>> SysfsStorageInfo(
+    HostAdapter& host_adapter, const GetStorageInfoRequest& req) {
+  if (InfoTypeHave(req.info_types(), storage::InfoType::ATA_INFO) ||
+      InfoTypeHave(req.info_types(), storage::InfoType::SECURITY_INFO)) {
+    return std::nullopt;
+  }
+  absl::StatusOr<std::vector<SysfsStorageDevice>> devices =
+      ReadSysfsStorageDevices(host_adapter);
+  if (absl::IsUnimplemented(devices.status())) return std::nullopt;
+  RETURN_IF_ERROR(devices.status());
+  // The devices may only be visible to smartctl, e.g. behind a RAID
+  // controller.
+  if (devices->empty()) return std::nullopt;
+
+  const bool need_identifier =
+      InfoTypeHave(req.info_types(), storage::InfoType::IDENTIFIER);
+  GetStorageInfoResponse resp;
+  for (const SysfsStorageDevice& device : *devices) {
+    if (need_identifier && !device.has_full_identity) return std::nullopt;
+    storage::Info& info = *resp.add_info();
+    if (InfoTypeHave(req.info_types(), storage::InfoType::SYSTEM_INFO)) {
+      info.mutable_system_info()->set_kernel_name(device.kernel_name);
+    }
+    if (need_identifier) {
+      info.mutable_id()->set_name(
+          absl::StrCat(device.model, "#", device.serial_number));
+      info.mutable_id()->set_type(device.type);
+      PopulateId(*info.mutable_id());
+    }
+    if (InfoTypeHave(req.info_types(), storage::InfoType::DEVICE_TYPE)) {
+      info.set_device_type(device.device_type);
+    }
+  }
+  return resp;
+}
+
 }  // namespace
 
 absl::StatusOr<GetStorageInfoResponse> HostBackend::GetStorageInfo(
     const GetStorageInfoRequest& req) {
-  GetStorageInfoResponse resp;
+  return ReadStorageInfo(*host_adapter_, req);
+}
 
-  ASSIGN_OR_RETURN(
-      const std::string scan_cmd_stdout,
-      RunCommand(host_adapter_, {kSmartctlDir, kJsonArg, kScanArg}));
+absl::StatusOr<GetStorageInfoResponse> HostBackend::ReadStorageInfo(
+    HostAdapter& host, const GetStorageInfoRequest& req) {
+  // The identity and type of the devices are read from sysfs when possible,
+  // which is much faster than running smartctl for every device.
+  ASSIGN_OR_RETURN(std::optional<GetStorageInfoResponse> sysfs_resp,
+                   SysfsStorageInfo(host, req));
+  if (sysfs_resp.has_value()) return *std::move(sysfs_resp);
 
-  ASSIGN_OR_RETURN(nlohmann::basic_json<> scan_result,
-                   ParseJson(scan_cmd_stdout));
+  GetStorageInfoResponse resp;
 
-  for (const auto& device : scan_result[kDevices]) {
+  ASSIGN_OR_RETURN(const std::string scan_cmd_stdout,
+                   RunCommand(host, {kSmartctlDir, kJsonArg, kScanArg}));
+
+  ASSIGN_OR_RETURN(const std::vector<SmartctlDevice> devices,
+                   ParseSmartctlScan(scan_cmd_stdout));
+
+  const bool need_all_info =
+      InfoTypeHave(req.info_types(), storage::InfoType::IDENTIFIER) ||
+      InfoTypeHave(req.info_types(), storage::InfoType::DEVICE_TYPE) ||
+      InfoTypeHave(req.info_types(), storage::InfoType::ATA_INFO);
+  const bool need_security_info =
+      InfoTypeHave(req.info_types(), storage::InfoType::SECURITY_INFO);
+
+  // Query all the devices at once rather than one command at a time. The
+  // commands for each device are queued in the order they used to run in.
+  std::vector<HostAdapter::Command> commands;
+  for (const SmartctlDevice& device : devices) {
+    if (need_all_info) {
+      commands.push_back({.args = {kSmartctlDir, kJsonArg, kAllArg,
+                                   device.name},
+                          .timeout = kSmartctlTimeout});
+    }
+    if (need_security_info) {
+      commands.push_back({.args = {kSmartctlDir, kJsonArg,
+                                   kGetNonSmartSettingsArg, kSecuritySettingArg,
+                                   device.name},
+                          .timeout = kSmartctlTimeout});
+    }
+  }
+  ASSIGN_OR_RETURN(
+      std::vector<absl::StatusOr<HostAdapter::CommandResult>> cmd_results,
+      host.RunCommands(commands, kMaxConcurrentSmartctl));
+  if (cmd_results.size() != commands.size()) {
+    return absl::InternalError(
+        absl::StrFormat("Expected %d smartctl results, got %d",
+                        commands.size(), cmd_results.size()));
+  }
+  size_t next_result = 0;
+  auto next_output = [&]() -> absl::StatusOr<std::string> {
+    size_t index = next_result++;
+    return SmartctlOutput(commands[index].args,
+                          std::move(cmd_results[index]));
+  };
+
+  for (const SmartctlDevice& device : devices) {
     storage::Info& info = *resp.add_info();
 
     if (InfoTypeHave(req.info_types(), storage::InfoType::SYSTEM_INFO)) {
-      info.mutable_system_info()->set_kernel_name(device[kName]);
+      info.mutable_system_info()->set_kernel_name(device.name);
     }
 
-    nlohmann::basic_json<> device_result;
-    if (InfoTypeHave(req.info_types(), storage::InfoType::IDENTIFIER) ||
-        InfoTypeHave(req.info_types(), storage::InfoType::DEVICE_TYPE) ||
-        InfoTypeHave(req.info_types(), storage::InfoType::ATA_INFO)) {
-      ASSIGN_OR_RETURN(const std::string& all_info_cmd_stdout,
-                       RunCommand(host_adapter_, {kSmartctlDir, kJsonArg,
-                                                  kAllArg, device[kName]}));
-      ASSIGN_OR_RETURN(device_result, ParseJson(all_info_cmd_stdout));
+    SmartctlDeviceInfo device_info;
+    if (need_all_info) {
+      ASSIGN_OR_RETURN(const std::string& all_info_cmd_stdout, next_output());
+      ASSIGN_OR_RETURN(device_info,
+                       ParseSmartctlDeviceInfo(all_info_cmd_stdout));
     }
 
     if (InfoTypeHave(req.info_types(), storage::InfoType::IDENTIFIER)) {
-      info.mutable_id()->set_name(device_result[kSerialNumber]);
-      info.mutable_id()->set_name(
-          absl::StrCat(device_result[kModelName].get<std::string>(), "#",
-                       device_result[kSerialNumber].get<std::string>()));
-      info.mutable_id()->set_type(device[kType]);
+      if (!device_info.model_name.has_value() ||
+          !device_info.serial_number.has_value()) {
+        return absl::InternalError(absl::StrFormat(
+            "smartctl output for %s has no model_name or serial_number",
+            device.name));
+      }
+      info.mutable_id()->set_name(absl::StrCat(
+          *device_info.model_name, "#", *device_info.serial_number));
+      info.mutable_id()->set_type(device.type);
       PopulateId(*info.mutable_id());
     }
 
     if (InfoTypeHave(req.info_types(), storage::InfoType::DEVICE_TYPE)) {
-      info.set_device_type(GetDeviceType(device_result));
+      ASSIGN_OR_RETURN(storage::DeviceType device_type,
+                       GetDeviceType(device.name, device_info));
+      info.set_device_type(device_type);
     }
 
     if (InfoTypeHave(req.info_types(), storage::InfoType::ATA_INFO)) {
-      SetAtaInfo(device[kName], device_result, *info.mutable_ata_info());
+      SetAtaInfo(device_info, *info.mutable_ata_info());
     }
 
-    if (InfoTypeHave(req.info_types(), storage::InfoType::SECURITY_INFO)) {
-      RETURN_IF_ERROR(SetSecurityInfo(device[kName], host_adapter_,
+    if (need_security_info) {
+      ASSIGN_OR_RETURN(const std::string& security_cmd_stdout, next_output());
+      RETURN_IF_ERROR(SetSecurityInfo(security_cmd_stdout,
                                       *info.mutable_security_info()));
     }
   }
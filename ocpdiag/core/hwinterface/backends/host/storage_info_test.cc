@@ -33,6 +33,9 @@ using ::ocpdiag::testing::EqualsProto;
 using ::ocpdiag::testing::IsOkAndHolds;
 using ::ocpdiag::testing::ParseTextProtoOrDie;
 using ::ocpdiag::testing::StatusIs;
+using ::testing::_;
+using ::testing::Contains;
+using ::testing::Gt;
 using ::testing::HasSubstr;
 using ::testing::Return;
 using ::testing::SizeIs;
@@ -122,6 +125,31 @@ TEST(HostBackend, GetStorageInfoSucceeds) {
               IsOkAndHolds(EqualsProto(expected)));
 }
 
+TEST(HostBackend, GetStorageInfoReadsIdentifiersFromSysfs) {
+  auto mock_host = std::make_unique<MockHostAdapter>();
+  EXPECT_CALL(*mock_host, ReadGlobs)
+      .WillOnce(Return(std::vector<HostAdapter::GlobEntry>{
+          {.path = "/sys/class/nvme/nvme0/model", .content = "ModelName\n"},
+          {.path = "/sys/class/nvme/nvme0/serial", .content = "SerialName\n"},
+      }));
+  EXPECT_CALL(*mock_host, RunCommand).Times(0);
+  HostBackend backend(EntityConfiguration{}, std::move(mock_host));
+  GetStorageInfoRequest req;
+  req.add_info_types(storage::InfoType::IDENTIFIER);
+  req.add_info_types(storage::InfoType::DEVICE_TYPE);
+
+  EXPECT_THAT(backend.GetStorageInfo(req), IsOkAndHolds(EqualsProto(R"pb(
+                info {
+                  id {
+                    name: "ModelName#SerialName"
+                    type: "nvme"
+                    id: "%%ModelName#SerialName%%nvme"
+                  }
+                  device_type: DEVICETYPE_NVME_SSD
+                }
+              )pb")));
+}
+
 struct GetDeviceTypeTestCase {
   std::string test_name;
   std::string version_json;
@@ -272,6 +300,46 @@ TEST(HostBackend, GetStorageInfoShouldPropagateJsonParsingFailure) {
                        HasSubstr("Unable to parse text to json")));
 }
 
+TEST(HostBackend, GetStorageInfoShouldReportMissingIdentifier) {
+  auto mock_host = std::make_unique<MockHostAdapter>();
+  EXPECT_CALL(*mock_host, RunCommand)
+      .WillOnce(
+          Return(HostAdapter::CommandResult{.exit_code = 0, .stdout = R"json(
+            {"devices": [{"name": "/dev/sda", "type": "sat"}]}
+          )json"}))
+      .WillOnce(
+          Return(HostAdapter::CommandResult{.exit_code = 0, .stdout = R"json(
+            {"serial_number": "SerialName", "sata_version": {}}
+          )json"}));
+  HostBackend backend(EntityConfiguration{}, std::move(mock_host));
+  GetStorageInfoRequest req;
+  req.add_info_types(storage::InfoType::IDENTIFIER);
+
+  EXPECT_THAT(backend.GetStorageInfo(req),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("/dev/sda has no model_name")));
+}
+
+TEST(HostBackend, GetStorageInfoShouldReportMissingRotationRate) {
+  auto mock_host = std::make_unique<MockHostAdapter>();
+  EXPECT_CALL(*mock_host, RunCommand)
+      .WillOnce(
+          Return(HostAdapter::CommandResult{.exit_code = 0, .stdout = R"json(
+            {"devices": [{"name": "/dev/sda", "type": "sat"}]}
+          )json"}))
+      .WillOnce(
+          Return(HostAdapter::CommandResult{.exit_code = 0, .stdout = R"json(
+            {"model_name": "ModelName", "sata_version": {}}
+          )json"}));
+  HostBackend backend(EntityConfiguration{}, std::move(mock_host));
+  GetStorageInfoRequest req;
+  req.add_info_types(storage::InfoType::DEVICE_TYPE);
+
+  EXPECT_THAT(backend.GetStorageInfo(req),
+              StatusIs(absl::StatusCode::kInternal,
+                       HasSubstr("/dev/sda has no rotation_rate")));
+}
+
 struct CapabilityMappingTestCase {
   std::string test_name;
   std::string ata_smart_data_capabilities_json;
@@ -428,5 +496,48 @@ TEST(HostBackend, GetStorageInfoShouldReturnUnknownSecurityMode) {
               )pb")));
 }
 
+TEST(HostBackend, GetStorageInfoQueriesAllDevicesInOneBatch) {
+  auto mock_host = std::make_unique<MockHostAdapter>();
+  EXPECT_CALL(*mock_host, RunCommand(_, Contains("--scan")))
+      .WillOnce(
+          Return(HostAdapter::CommandResult{.exit_code = 0, .stdout = R"json(
+            {
+              "devices": [
+                {"name": "/dev/sda", "type": "sat"},
+                {"name": "/dev/sdb", "type": "sat"}
+              ]
+            })json"}));
+  // The batch runs each command through RunCommand() by default.
+  EXPECT_CALL(*mock_host, RunCommands(SizeIs(2), Gt(1)));
+  EXPECT_CALL(*mock_host, RunCommand(_, Contains("/dev/sda")))
+      .WillOnce(
+          Return(HostAdapter::CommandResult{.exit_code = 0, .stdout = R"json(
+            {"ata_security": {"enabled": true, "string": "ENABLED [SEC1]"}}
+          )json"}));
+  EXPECT_CALL(*mock_host, RunCommand(_, Contains("/dev/sdb")))
+      .WillOnce(
+          Return(HostAdapter::CommandResult{.exit_code = 0, .stdout = R"json(
+            {"ata_security": {"enabled": true, "string": "ENABLED [SEC5]"}}
+          )json"}));
+  HostBackend backend(EntityConfiguration{}, std::move(mock_host));
+  GetStorageInfoRequest req;
+  req.add_info_types(storage::InfoType::SECURITY_INFO);
+
+  EXPECT_THAT(backend.GetStorageInfo(req), IsOkAndHolds(EqualsProto(R"pb(
+                info {
+                  security_info {
+                    level: SECURITYLEVEL_SEC1
+                    mode: SECURITYMODE_ATA
+                  }
+                }
+                info {
+                  security_info {
+                    level: SECURITYLEVEL_SEC5
+                    mode: SECURITYMODE_ATA
+                  }
+                }
+              )pb")));
+}
+
 }  // namespace
 }  // namespace ocpdiag::hwinterface::internal
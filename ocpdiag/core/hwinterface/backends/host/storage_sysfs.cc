@@ -0,0 +1,128 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/host/storage_sysfs.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "ocpdiag/core/compat/status_macros.h"
+#include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
+#include "ocpdiag/core/hwinterface/storage.pb.h"
+
+namespace ocpdiag::hwinterface::internal {
+namespace {
+
+constexpr char kNvmeClassDir[] = "/sys/class/nvme";
+
+// The attributes of a device, by file name.
+using Attributes = absl::flat_hash_map<std::string, std::string>;
+
+std::string Attribute(const Attributes& attributes, absl::string_view name) {
+  auto it = attributes.find(name);
+  if (it == attributes.end()) return "";
+  return std::string(absl::StripAsciiWhitespace(it->second));
+}
+
+SysfsStorageDevice ScsiDevice(absl::string_view name,
+                              const Attributes& attributes) {
+  const std::string vendor = Attribute(attributes, "vendor");
+  SysfsStorageDevice device{.kernel_name = absl::StrCat("/dev/", name),
+                            .type = "scsi",
+                            .model = Attribute(attributes, "model")};
+  // Like smartctl, which reports the vendor and product of SCSI devices as
+  // their model.
+  if (!vendor.empty() && !device.model.empty()) {
+    device.model = absl::StrCat(vendor, " ", device.model);
+  }
+  auto vpd_pg80 = attributes.find("vpd_pg80");
+  if (vpd_pg80 != attributes.end()) {
+    device.serial_number = VpdUnitSerialNumber(vpd_pg80->second);
+  }
+
+  // smartctl only tells SSDs from HDDs for SATA devices.
+  const bool is_ata = vendor == "ATA";
+  if (is_ata) {
+    device.device_type = Attribute(attributes, "rotational") == "0"
+                             ? storage::DEVICETYPE_SSD
+                             : storage::DEVICETYPE_HDD;
+  }
+  // The model of a SATA device is cut to the 16 characters of the SCSI inquiry
+  // data that libata emulates, while smartctl reports the ATA model.
+  device.has_full_identity =
+      !is_ata && !device.model.empty() && !device.serial_number.empty();
+  return device;
+}
+
+SysfsStorageDevice NvmeDevice(absl::string_view name,
+                              const Attributes& attributes) {
+  SysfsStorageDevice device{.kernel_name = absl::StrCat("/dev/", name),
+                            .type = "nvme",
+                            .model = Attribute(attributes, "model"),
+                            .serial_number = Attribute(attributes, "serial"),
+                            .device_type = storage::DEVICETYPE_NVME_SSD};
+  device.has_full_identity =
+      !device.model.empty() && !device.serial_number.empty();
+  return device;
+}
+
+}  // namespace
+
+absl::StatusOr<std::vector<SysfsStorageDevice>> ReadSysfsStorageDevices(
+    HostAdapter& host) {
+  ASSIGN_OR_RETURN(std::vector<HostAdapter::GlobEntry> entries,
+                   host.ReadGlobs({
+                       "/sys/block/sd*/device/vendor",
+                       "/sys/block/sd*/device/model",
+                       "/sys/block/sd*/device/vpd_pg80",
+                       "/sys/block/sd*/queue/rotational",
+                       "/sys/class/nvme/nvme*/model",
+                       "/sys/class/nvme/nvme*/serial",
+                   }));
+
+  // The attributes of each device, by the directory of the device, e.g.
+  // /sys/block/sda or /sys/class/nvme/nvme0.
+  std::map<std::filesystem::path, Attributes> device_attributes;
+  for (const HostAdapter::GlobEntry& entry : entries) {
+    std::filesystem::path dir = entry.path.parent_path();
+    if (dir.parent_path() != kNvmeClassDir) dir = dir.parent_path();
+    Attributes& attributes = device_attributes[dir];
+    if (entry.content.ok()) {
+      attributes[entry.path.filename().string()] = *entry.content;
+    }
+  }
+
+  std::vector<SysfsStorageDevice> devices;
+  devices.reserve(device_attributes.size());
+  for (const auto& [dir, attributes] : device_attributes) {
+    const std::string name = dir.filename().string();
+    devices.push_back(dir.parent_path() == kNvmeClassDir
+                          ? NvmeDevice(name, attributes)
+                          : ScsiDevice(name, attributes));
+  }
+  return devices;
+}
+
+std::string VpdUnitSerialNumber(absl::string_view vpd_pg80) {
+  // A 4-byte header, ending with the big-endian length of the serial number.
+  if (vpd_pg80.size() < 4) return "";
+  const size_t length = static_cast<unsigned char>(vpd_pg80[2]) << 8 |
+                        static_cast<unsigned char>(vpd_pg80[3]);
+  absl::string_view serial = vpd_pg80.substr(4, length);
+  // The serial number is padded with spaces, or sometimes NULs.
+  serial = serial.substr(0, serial.find('\0'));
+  return std::string(absl::StripAsciiWhitespace(serial));
+}
+
+}  // namespace ocpdiag::hwinterface::internal
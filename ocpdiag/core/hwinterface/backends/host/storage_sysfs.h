@@ -0,0 +1,48 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_STORAGE_SYSFS_H_
+#define OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_STORAGE_SYSFS_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
+#include "ocpdiag/core/hwinterface/storage.pb.h"
+
+namespace ocpdiag::hwinterface::internal {
+
+// A storage device as described by sysfs, named the way smartctl names it.
+struct SysfsStorageDevice {
+  // For example "/dev/sda", or "/dev/nvme0" for the controller of an NVMe
+  // device, like `smartctl --scan`.
+  std::string kernel_name;
+  // "scsi" or "nvme", like `smartctl --scan`.
+  std::string type;
+  std::string model;
+  std::string serial_number;
+  storage::DeviceType device_type = storage::DEVICETYPE_UNKNOWN;
+  // Whether the model and serial number are the ones smartctl reports, which
+  // isn't the case for SATA devices.
+  bool has_full_identity = false;
+};
+
+// Reads the SCSI disks from /sys/block/sd* and the NVMe controllers from
+// /sys/class/nvme in a single HostAdapter::ReadGlobs() call, without running
+// any command. Returns an Unimplemented error if the adapter can't read
+// globs.
+absl::StatusOr<std::vector<SysfsStorageDevice>> ReadSysfsStorageDevices(
+    HostAdapter& host);
+
+// Returns the unit serial number from the content of a vpd_pg80 attribute,
+// the SCSI Unit Serial Number VPD page, or an empty string if there is none.
+std::string VpdUnitSerialNumber(absl::string_view vpd_pg80);
+
+}  // namespace ocpdiag::hwinterface::internal
+
+#endif  // OCPDIAG_CORE_HWINTERFACE_BACKENDS_HOST_STORAGE_SYSFS_H_
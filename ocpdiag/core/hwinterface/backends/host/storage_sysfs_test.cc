@@ -0,0 +1,120 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/host/storage_sysfs.h"
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/log/check.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "ocpdiag/core/hwinterface/backends/lib/fake_host_adapter.h"
+#include "ocpdiag/core/hwinterface/backends/lib/mock_host_adapter.h"
+#include "ocpdiag/core/hwinterface/storage.pb.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::hwinterface::internal {
+namespace {
+
+using ::ocpdiag::testing::IsOkAndHolds;
+using ::ocpdiag::testing::StatusIs;
+using ::testing::IsEmpty;
+using ::testing::SizeIs;
+
+// Returns the Unit Serial Number VPD page of `serial`.
+std::string VpdPage(const std::string& serial) {
+  std::string page = {'\0', '\x80', '\0', static_cast<char>(serial.size())};
+  return page + serial;
+}
+
+class ReadSysfsStorageDevicesTest : public ::testing::Test {
+ protected:
+  ReadSysfsStorageDevicesTest() {
+    CHECK_OK(host_.Write("/sys/block/sda/device/vendor", "ATA     \n"));
+    CHECK_OK(
+        host_.Write("/sys/block/sda/device/model", "SSD 860 EVO     \n"));
+    CHECK_OK(host_.Write("/sys/block/sda/device/vpd_pg80",
+                         VpdPage("      S3Z9NB0K123456")));
+    CHECK_OK(host_.Write("/sys/block/sda/queue/rotational", "0\n"));
+    CHECK_OK(host_.Write("/sys/block/sdb/device/vendor", "SEAGATE \n"));
+    CHECK_OK(
+        host_.Write("/sys/block/sdb/device/model", "ST4000NM0023    \n"));
+    CHECK_OK(
+        host_.Write("/sys/block/sdb/device/vpd_pg80", VpdPage("Z1Z0ABCD")));
+    CHECK_OK(host_.Write("/sys/block/sdb/queue/rotational", "1\n"));
+    CHECK_OK(host_.Write("/sys/class/nvme/nvme0/model",
+                         "SAMSUNG MZ1LB960HAJQ-00007\n"));
+    CHECK_OK(
+        host_.Write("/sys/class/nvme/nvme0/serial", "S435NA0M500123  \n"));
+  }
+
+  FakeHostAdapter host_;
+};
+
+TEST_F(ReadSysfsStorageDevicesTest, ReadsScsiAndNvmeDevices) {
+  absl::StatusOr<std::vector<SysfsStorageDevice>> devices =
+      ReadSysfsStorageDevices(host_);
+  ASSERT_OK(devices);
+  ASSERT_THAT(*devices, SizeIs(3));
+
+  EXPECT_EQ((*devices)[0].kernel_name, "/dev/sda");
+  EXPECT_EQ((*devices)[0].type, "scsi");
+  EXPECT_EQ((*devices)[0].model, "ATA SSD 860 EVO");
+  EXPECT_EQ((*devices)[0].serial_number, "S3Z9NB0K123456");
+  EXPECT_EQ((*devices)[0].device_type, storage::DEVICETYPE_SSD);
+  // sysfs only has the beginning of the model of SATA devices.
+  EXPECT_FALSE((*devices)[0].has_full_identity);
+
+  // Only SATA devices are told apart by their rotation.
+  EXPECT_EQ((*devices)[1].kernel_name, "/dev/sdb");
+  EXPECT_EQ((*devices)[1].model, "SEAGATE ST4000NM0023");
+  EXPECT_EQ((*devices)[1].serial_number, "Z1Z0ABCD");
+  EXPECT_EQ((*devices)[1].device_type, storage::DEVICETYPE_UNKNOWN);
+  EXPECT_TRUE((*devices)[1].has_full_identity);
+
+  EXPECT_EQ((*devices)[2].kernel_name, "/dev/nvme0");
+  EXPECT_EQ((*devices)[2].type, "nvme");
+  EXPECT_EQ((*devices)[2].model, "SAMSUNG MZ1LB960HAJQ-00007");
+  EXPECT_EQ((*devices)[2].serial_number, "S435NA0M500123");
+  EXPECT_EQ((*devices)[2].device_type, storage::DEVICETYPE_NVME_SSD);
+  EXPECT_TRUE((*devices)[2].has_full_identity);
+}
+
+TEST_F(ReadSysfsStorageDevicesTest, ToleratesMissingAttributes) {
+  CHECK_OK(host_.Write("/sys/block/sdc/queue/rotational", "1\n"));
+  absl::StatusOr<std::vector<SysfsStorageDevice>> devices =
+      ReadSysfsStorageDevices(host_);
+  ASSERT_OK(devices);
+  ASSERT_THAT(*devices, SizeIs(4));
+  EXPECT_EQ((*devices)[2].kernel_name, "/dev/sdc");
+  EXPECT_EQ((*devices)[2].device_type, storage::DEVICETYPE_UNKNOWN);
+  EXPECT_FALSE((*devices)[2].has_full_identity);
+}
+
+TEST(ReadSysfsStorageDevices, NoDevices) {
+  FakeHostAdapter host;
+  EXPECT_THAT(ReadSysfsStorageDevices(host), IsOkAndHolds(IsEmpty()));
+}
+
+TEST(ReadSysfsStorageDevices, GlobsNotSupported) {
+  MockHostAdapter host;
+  EXPECT_THAT(ReadSysfsStorageDevices(host),
+              StatusIs(absl::StatusCode::kUnimplemented));
+}
+
+TEST(VpdUnitSerialNumber, ParsesPage) {
+  EXPECT_EQ(VpdUnitSerialNumber(VpdPage("  ABC123")), "ABC123");
+  EXPECT_EQ(VpdUnitSerialNumber(VpdPage(std::string("ABC\0\0", 5))), "ABC");
+  EXPECT_EQ(VpdUnitSerialNumber(VpdPage("")), "");
+  EXPECT_EQ(VpdUnitSerialNumber(absl::string_view("\0\x80", 2)), "");
+}
+
+}  // namespace
+}  // namespace ocpdiag::hwinterface::internal
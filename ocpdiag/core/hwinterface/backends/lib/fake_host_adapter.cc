@@ -6,9 +6,16 @@
 
 #include "ocpdiag/core/hwinterface/backends/lib/fake_host_adapter.h"
 
+#include <fnmatch.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include "absl/log/log.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_join.h"
+#include "absl/synchronization/mutex.h"
 
 namespace ocpdiag::hwinterface {
 
@@ -16,11 +23,16 @@ FakeHostAdapter::~FakeHostAdapter() = default;
 
 absl::StatusOr<HostAdapter::CommandResult> FakeHostAdapter::RunCommand(
     absl::Duration timeout, const std::vector<std::string>& args) {
+  RunCommandFunction run_command_callback;
+  {
+    absl::MutexLock lock(&mutex_);
+    run_command_callback = run_command_callback_;
+  }
 
-  // If we were given a run function, then run that.
-  if (run_command_callback_) {
+  // If we were given a run function, then run that. It may use the adapter.
+  if (run_command_callback) {
     std::variant<absl::StatusCode, CommandResult> res =
-        run_command_callback_(timeout, args);
+        run_command_callback(timeout, args);
     if (res.index() == 0)
       return absl::Status(std::get<absl::StatusCode>(res), "Injected Error");
     return std::get<CommandResult>(res);
@@ -35,19 +47,44 @@ absl::StatusOr<HostAdapter::CommandResult> FakeHostAdapter::RunCommand(
 
 absl::StatusOr<std::string> FakeHostAdapter::Read(
     const std::filesystem::path& path) {
+  absl::ReaderMutexLock lock(&mutex_);
+  return ReadLocked(path);
+}
+
+absl::StatusOr<std::string> FakeHostAdapter::ReadLocked(
+    const std::filesystem::path& path) {
   auto iter = fake_filesystem_.find(path);
   if (iter == fake_filesystem_.end()) {
     // Return NotFound for any file that wasn't explicitly initialized.
     return absl::NotFoundError(path.string());
   }
-  FileInfo& info = iter->second;
+  const FileInfo& info = iter->second;
   if (info.read_error != absl::StatusCode::kOk)
     return absl::Status(info.read_error, "Injected Read Error");
   return info.contents;
 }
 
+absl::StatusOr<std::vector<HostAdapter::GlobEntry>>
+FakeHostAdapter::ReadGlob(absl::string_view pattern) {
+  const std::string pattern_str(pattern);
+  absl::ReaderMutexLock lock(&mutex_);
+  std::vector<std::string> matches;
+  for (const auto& [path, info] : fake_filesystem_) {
+    if (fnmatch(pattern_str.c_str(), path.c_str(), FNM_PATHNAME) == 0)
+      matches.push_back(path);
+  }
+  std::sort(matches.begin(), matches.end());
+
+  std::vector<GlobEntry> entries;
+  entries.reserve(matches.size());
+  for (const std::string& path : matches)
+    entries.push_back({.path = path, .content = ReadLocked(path)});
+  return entries;
+}
+
 absl::Status FakeHostAdapter::Write(const std::filesystem::path& path,
                                     absl::string_view data) {
+  absl::MutexLock lock(&mutex_);
   FileInfo& info = fake_filesystem_[path];
   if (info.write_error != absl::StatusCode::kOk)
     return absl::Status(info.write_error, "Injected Write Error");
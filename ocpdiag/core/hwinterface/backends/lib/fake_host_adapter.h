@@ -7,15 +7,23 @@
 #ifndef OCPDIAG_CORE_HWINTERFACE_BACKENDS_LIB_FAKE_HOST_ADAPTER_H_
 #define OCPDIAG_CORE_HWINTERFACE_BACKENDS_LIB_FAKE_HOST_ADAPTER_H_
 
+#include <functional>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
 #include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
 
 namespace ocpdiag::hwinterface {
 
 // Implements a fake HostAdapter object with a simplistic in-memory filesystem.
 // To customize RunCommand behavior, simply provide a callback.
+// This class is thread-safe.
 class FakeHostAdapter : public HostAdapter {
  public:
   // Function signature for RunCommand.
@@ -28,19 +36,23 @@ class FakeHostAdapter : public HostAdapter {
 
   // Set a custom callback to run instead of the default behavior.
   // By default, RunCommand simply returns a fake hostname.
-  void SetRunCommandCallback(const RunCommandFunction& callback) {
+  void SetRunCommandCallback(const RunCommandFunction& callback)
+      ABSL_LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock lock(&mutex_);
     run_command_callback_ = callback;
   }
 
   // Injects an error to subsequent calls to Read() at the given path.
   void SetReadError(const std::filesystem::path& path,
-                    absl::StatusCode error_code) {
+                    absl::StatusCode error_code) ABSL_LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock lock(&mutex_);
     fake_filesystem_[path].read_error = error_code;
   }
 
   // Injects an error to subsequent calls to Write() at the given path.
   void SetWriteError(const std::filesystem::path& path,
-                     absl::StatusCode error_code) {
+                     absl::StatusCode error_code) ABSL_LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock lock(&mutex_);
     fake_filesystem_[path].write_error = error_code;
   }
 
@@ -48,6 +60,8 @@ class FakeHostAdapter : public HostAdapter {
   absl::StatusOr<CommandResult> RunCommand(
       absl::Duration timeout, const std::vector<std::string>& args) override;
   absl::StatusOr<std::string> Read(const std::filesystem::path& path) override;
+  absl::StatusOr<std::vector<GlobEntry>> ReadGlob(
+      absl::string_view pattern) override;
   absl::Status Write(const std::filesystem::path& path,
                      absl::string_view data) override;
 
@@ -58,8 +72,13 @@ class FakeHostAdapter : public HostAdapter {
     absl::StatusCode write_error = absl::StatusCode::kOk;
   };
 
-  std::unordered_map<std::string, FileInfo> fake_filesystem_;
-  RunCommandFunction run_command_callback_;
+  absl::StatusOr<std::string> ReadLocked(const std::filesystem::path& path)
+      ABSL_SHARED_LOCKS_REQUIRED(mutex_);
+
+  absl::Mutex mutex_;
+  std::unordered_map<std::string, FileInfo> fake_filesystem_
+      ABSL_GUARDED_BY(mutex_);
+  RunCommandFunction run_command_callback_ ABSL_GUARDED_BY(mutex_);
 };
 
 }  // namespace ocpdiag::hwinterface
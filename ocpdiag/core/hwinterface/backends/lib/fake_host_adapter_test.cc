@@ -7,10 +7,12 @@
 #include "ocpdiag/core/hwinterface/backends/lib/fake_host_adapter.h"
 
 #include <string>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
 #include "absl/time/time.h"
 #include "absl/types/span.h"
 #include "ocpdiag/core/testing/status_matchers.h"
@@ -18,6 +20,8 @@
 namespace ocpdiag::hwinterface {
 namespace {
 
+using ::ocpdiag::testing::IsOkAndHolds;
+using ::ocpdiag::testing::StatusIs;
 using ::testing::ElementsAre;
 
 constexpr absl::string_view kPath = "/proc/sys/file";
@@ -48,6 +52,32 @@ TEST(FakeHostAdapterTest, WriteError) {
   EXPECT_FALSE(fake.Write(kPath, "").ok());
 }
 
+TEST(FakeHostAdapterTest, ReadMany) {
+  FakeHostAdapter fake;
+  ASSERT_OK(fake.Write(kPath, "HELLO"));
+
+  ASSERT_OK_AND_ASSIGN(std::vector<absl::StatusOr<std::string>> contents,
+                       fake.ReadMany({kPath, "/missing"}));
+  ASSERT_EQ(contents.size(), 2);
+  EXPECT_THAT(contents[0], IsOkAndHolds("HELLO"));
+  EXPECT_THAT(contents[1], StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST(FakeHostAdapterTest, ReadGlob) {
+  FakeHostAdapter fake;
+  ASSERT_OK(fake.Write("/sys/node1/cpulist", "2-3"));
+  ASSERT_OK(fake.Write("/sys/node0/cpulist", "0-1"));
+  ASSERT_OK(fake.Write("/sys/node0/sub/cpulist", "4"));
+
+  ASSERT_OK_AND_ASSIGN(std::vector<HostAdapter::GlobEntry> entries,
+                       fake.ReadGlob("/sys/node*/cpulist"));
+  ASSERT_EQ(entries.size(), 2);
+  EXPECT_EQ(entries[0].path, "/sys/node0/cpulist");
+  EXPECT_THAT(entries[0].content, IsOkAndHolds("0-1"));
+  EXPECT_EQ(entries[1].path, "/sys/node1/cpulist");
+  EXPECT_THAT(entries[1].content, IsOkAndHolds("2-3"));
+}
+
 TEST(FakeHostAdapterTest, RunCommand) {
   FakeHostAdapter fake;
   std::vector<std::string> got_args;
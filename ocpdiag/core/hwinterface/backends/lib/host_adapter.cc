@@ -7,144 +7,230 @@
 #include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
 
 #include <fcntl.h>
-#include <sys/types.h>
-#include <sys/wait.h>
+#include <glob.h>
 #include <unistd.h>
 
 #include <algorithm>
-#include <csignal>
+#include <atomic>
 #include <cstdint>
-#include <cstdlib>
 #include <filesystem>
+#include <iterator>
 #include <memory>
 #include <string>
+#include <thread>  //
+#include <utility>
+#include <vector>
 
 #include "absl/cleanup/cleanup.h"
 #include "absl/log/log.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/ascii.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
-#include "absl/time/clock.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_replace.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "ecclesia/lib/apifs/apifs.h"
 #include "ocpdiag/core/compat/status_macros.h"
+#include "ocpdiag/core/lib/compression/gzip.h"
 #include "ocpdiag/core/lib/off_dut_machine_interface/remote.h"
 #include "ocpdiag/core/lib/off_dut_machine_interface/remote_factory.h"
+#include "ocpdiag/core/lib/subprocess/subprocess.h"
 
 namespace ocpdiag::hwinterface {
 
-constexpr absl::Duration kPollChildInterval = absl::Milliseconds(100);
+constexpr absl::Duration kReadManyTimeout = absl::Minutes(1);
 
 namespace {
 
-// Helper to read the entire contents of a file
-absl::StatusOr<std::string> ReadLocalFile(FILE* file) {
-  std::fseek(file, 0, SEEK_END);
-  std::string out;
-  out.resize(std::ftell(file));
-  std::rewind(file);
-  size_t read = std::fread(out.data(), sizeof(char), out.size(), file);
-  if (read < out.size()) {
-    return absl::InternalError("Failed to read entirety of file.");
-  }
-  return out;
+// Converts a local subprocess result, reporting a command killed by signal N
+// with exit code 128+N like bash does.
+HostAdapter::CommandResult ToCommandResult(subprocess::Result result) {
+  return HostAdapter::CommandResult{
+      .exit_code = result.term_signal != 0 ? 128 + result.term_signal
+                                           : result.exit_code,
+      .stdout = std::move(result.stdout),
+      .stderr = std::move(result.stderr),
+  };
 }
 
-}  // namespace
+// Quotes `arg` so that a POSIX shell treats it as a single literal word.
+std::string ShellQuote(absl::string_view arg) {
+  return absl::StrCat("'", absl::StrReplaceAll(arg, {{"'", "'\\''"}}), "'");
+}
 
-absl::StatusOr<LocalHostAdapter::CommandResult> LocalHostAdapter::RunCommand(
-    absl::Duration timeout, const std::vector<std::string>& args) {
-  if (args.empty()) {
-    return absl::InvalidArgumentError("Empty args.");
-  }
+// The body of a shell loop over "$f" that prints each file in the format
+// parsed by ParseFileDump(). The content is copied to a temp file first so
+// that the size in the header matches the bytes that follow, even for sysfs
+// attributes whose value changes between reads.
+constexpr absl::string_view kFileDumpLoopBody =
+    "if cat -- \"$f\" >\"$t\" 2>/dev/null; then "
+    "printf 'OK %s %s\\n' \"$(wc -c <\"$t\")\" \"$f\"; cat \"$t\"; "
+    "elif [ -e \"$f\" ]; then printf 'ERR 0 %s\\n' \"$f\"; "
+    "else printf 'NOENT 0 %s\\n' \"$f\"; fi";
+
+// Returns a script that prints each file named by the shell `words`. The
+// `guard` runs first in each iteration and may skip the file.
+std::string FileDumpScriptOver(absl::string_view words,
+                               absl::string_view guard = "") {
+  return absl::StrCat("t=$(mktemp) || exit 1; for f in ", words, "; do ",
+                      guard, kFileDumpLoopBody, "; done; rm -f \"$t\"");
+}
 
-  LocalHostAdapter::CommandResult result;
+void SortByPath(std::vector<HostAdapter::GlobEntry>& entries) {
+  std::sort(entries.begin(), entries.end(),
+            [](const HostAdapter::GlobEntry& a,
+               const HostAdapter::GlobEntry& b) { return a.path < b.path; });
+}
 
-  // Prepare the stdout and stderr temp files.
-  FILE* fstdout = std::tmpfile();
-  FILE* fstderr = std::tmpfile();
-  if (fstdout == nullptr || fstderr == nullptr) {
-    return absl::InternalError("Failed to create tmpfile file.");
-  }
-  auto file_cleanup = absl::MakeCleanup([fstdout, fstderr]() {
-    std::fclose(fstdout);
-    std::fclose(fstderr);
-  });
+}  // namespace
 
-  pid_t pid = fork();
-  if (pid < 0) {
-    return absl::InternalError(
-        absl::StrFormat("Failed to fork the process: %s.", strerror(errno)));
-  }
+namespace internal {
+
+std::string FileDumpScript(absl::Span<const std::filesystem::path> paths) {
+  std::vector<std::string> quoted;
+  quoted.reserve(paths.size());
+  for (const std::filesystem::path& path : paths)
+    quoted.push_back(ShellQuote(path.string()));
+  return FileDumpScriptOver(absl::StrJoin(quoted, " "));
+}
 
-  // Child process, never returns.
-  if (pid == 0) {
-    if (dup2(fileno(fstdout), STDOUT_FILENO) == -1) {
-      std::_Exit(errno);
+std::string GlobDumpScript(absl::string_view pattern) {
+  // Expanding an unquoted variable applies pathname expansion, but unlike
+  // pasting the pattern into the script it can't run arbitrary commands.
+  // Without a match the pattern itself is left in place, hence the -e check.
+  return absl::StrCat("p=", ShellQuote(pattern), "; ",
+                      FileDumpScriptOver("$p", "[ -e \"$f\" ] || continue; "));
+}
+
+absl::StatusOr<std::vector<HostAdapter::GlobEntry>> ParseFileDump(
+    absl::string_view dump) {
+  std::vector<HostAdapter::GlobEntry> entries;
+  while (!dump.empty()) {
+    size_t header_end = dump.find('\n');
+    if (header_end == absl::string_view::npos) {
+      return absl::InternalError(
+          absl::StrCat("Truncated file dump header: ", dump));
     }
-    if (dup2(fileno(fstderr), STDERR_FILENO) == -1) {
-      std::_Exit(errno);
+    std::vector<absl::string_view> header = absl::StrSplit(
+        dump.substr(0, header_end), absl::MaxSplits(' ', 2));
+    dump.remove_prefix(header_end + 1);
+
+    uint64_t size = 0;
+    if (header.size() != 3 ||
+        !absl::SimpleAtoi(absl::StripAsciiWhitespace(header[1]), &size) ||
+        size > dump.size()) {
+      return absl::InternalError(absl::StrCat("Malformed file dump header: ",
+                                              absl::StrJoin(header, " ")));
     }
 
-    //  convert args to char* const[] required by execvp.
-    std::vector<std::string> vargs(args.size());
-    std::copy(args.begin(), args.end(), vargs.begin());
-
-    std::vector<char*> pargs(args.size() + 1, nullptr);
-    for (std::size_t i = 0; i < vargs.size(); ++i) {
-      pargs[i] = const_cast<char*>(vargs[i].c_str());
+    HostAdapter::GlobEntry& entry = entries.emplace_back();
+    entry.path = std::string(header[2]);
+    if (header[0] == "OK") {
+      entry.content = std::string(dump.substr(0, size));
+    } else if (header[0] == "NOENT") {
+      entry.content = absl::NotFoundError(
+          absl::StrCat("No such file: ", entry.path.string()));
+    } else {
+      entry.content = absl::InternalError(
+          absl::StrCat("Failed to read file: ", entry.path.string()));
     }
-    execvp(pargs.data()[0], pargs.data());
-    // If a command is not found, the child process created to execute it
-    // returns 127. If a command is found but is not executable, return 126.
-    std::_Exit((errno == ENOENT) ? 127 : 126);
+    dump.remove_prefix(size);
   }
+  return entries;
+}
 
-  // Below is the parent process code.
-  // Wait for the child process to finish, or kill the command if it times out.
-  absl::Time deadline = absl::Now() + timeout;
-  while (absl::Now() < deadline) {
-    int status = 0;
+void SortAndDedupByPath(std::vector<HostAdapter::GlobEntry>& entries) {
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const HostAdapter::GlobEntry& a,
+                      const HostAdapter::GlobEntry& b) {
+                     return a.path < b.path;
+                   });
+  entries.erase(std::unique(entries.begin(), entries.end(),
+                            [](const HostAdapter::GlobEntry& a,
+                               const HostAdapter::GlobEntry& b) {
+                              return a.path == b.path;
+                            }),
+                entries.end());
+}
 
-    pid_t w = waitpid(pid, &status, WNOHANG);
+}  // namespace internal
 
-    if (w == 0) {
-      absl::SleepFor(kPollChildInterval);
-      continue;
-    }
-    if (w != pid) {
-      return absl::InternalError(absl::StrCat(
-          "Failed to wait for the child process.: ", strerror(errno)));
-    }
+absl::StatusOr<std::vector<absl::StatusOr<std::string>>> HostAdapter::ReadMany(
+    absl::Span<const std::filesystem::path> paths) {
+  std::vector<absl::StatusOr<std::string>> contents;
+  contents.reserve(paths.size());
+  for (const std::filesystem::path& path : paths)
+    contents.push_back(Read(path));
+  return contents;
+}
 
-    // Command finishes successfully. Populate the result.
-    HostAdapter::CommandResult result;
-    if (WIFEXITED(status)) {
-      result.exit_code = WEXITSTATUS(status);
-    } else if (WIFSIGNALED(status)) {
-      // When a command terminates on a fatal signal whose number is N, Bash
-      // uses the value 128+N as the exit status.
-      result.exit_code = 128 + WTERMSIG(status);
-    } else {
-      return absl::InternalError(absl::StrCat(
-          "Unexpected state: waitpid returned when subprocess neither exited "
-          "nor terminated by signal. status=",
-          status));
-    }
+absl::StatusOr<std::vector<HostAdapter::GlobEntry>> HostAdapter::ReadGlob(
+    absl::string_view pattern) {
+  return absl::UnimplementedError(
+      absl::StrCat("ReadGlob is not supported by this adapter: ", pattern));
+}
 
-    // Copy stdout and stderr to the result.
-    ASSIGN_OR_RETURN(result.stdout, ReadLocalFile(fstdout));
-    ASSIGN_OR_RETURN(result.stderr, ReadLocalFile(fstderr));
-    return result;
+absl::StatusOr<std::vector<absl::StatusOr<std::string>>> HostAdapter::Sample(
+    absl::Span<const std::filesystem::path> paths) {
+  return ReadMany(paths);
+}
+
+absl::StatusOr<std::vector<HostAdapter::GlobEntry>> HostAdapter::ReadGlobs(
+    absl::Span<const std::string> patterns) {
+  std::vector<GlobEntry> entries;
+  for (const std::string& pattern : patterns) {
+    ASSIGN_OR_RETURN(std::vector<GlobEntry> matches, ReadGlob(pattern));
+    entries.insert(entries.end(), std::make_move_iterator(matches.begin()),
+                   std::make_move_iterator(matches.end()));
   }
+  internal::SortAndDedupByPath(entries);
+  return entries;
+}
 
-  // Timeout, kill the command and return.
-  kill(pid, SIGKILL);
-  return absl::DeadlineExceededError(absl::StrFormat(
-      "Command failed to finish in %s.", absl::FormatDuration(timeout)));
+absl::StatusOr<std::vector<absl::StatusOr<HostAdapter::CommandResult>>>
+HostAdapter::RunCommands(absl::Span<const Command> commands,
+                         int max_concurrency) {
+  std::vector<absl::StatusOr<CommandResult>> results;
+  results.reserve(commands.size());
+  for (const Command& command : commands)
+    results.push_back(RunCommand(command.timeout, command.args));
+  return results;
+}
 
-  return result;
+absl::StatusOr<LocalHostAdapter::CommandResult> LocalHostAdapter::RunCommand(
+    absl::Duration timeout, const std::vector<std::string>& args) {
+  ASSIGN_OR_RETURN(
+      subprocess::Result result,
+      subprocess::RunCommand({.args = args, .timeout = timeout}));
+  return ToCommandResult(std::move(result));
+}
+
+absl::StatusOr<std::vector<absl::StatusOr<HostAdapter::CommandResult>>>
+LocalHostAdapter::RunCommands(absl::Span<const Command> commands,
+                              int max_concurrency) {
+  std::vector<subprocess::Command> subprocess_commands;
+  subprocess_commands.reserve(commands.size());
+  for (const Command& command : commands) {
+    subprocess_commands.push_back(
+        {.args = command.args, .timeout = command.timeout});
+  }
+  std::vector<absl::StatusOr<CommandResult>> results;
+  results.reserve(commands.size());
+  for (absl::StatusOr<subprocess::Result>& result :
+       subprocess::RunCommands(subprocess_commands, max_concurrency)) {
+    if (result.ok()) {
+      results.push_back(ToCommandResult(*std::move(result)));
+    } else {
+      results.push_back(result.status());
+    }
+  }
+  return results;
 }
 
 absl::StatusOr<std::string> LocalHostAdapter::Read(
@@ -153,8 +239,38 @@ absl::StatusOr<std::string> LocalHostAdapter::Read(
   return file.Read();
 }
 
+absl::StatusOr<std::vector<absl::StatusOr<std::string>>>
+LocalHostAdapter::Sample(absl::Span<const std::filesystem::path> paths) {
+  return open_files_.ReadMany(paths);
+}
+
+absl::StatusOr<std::vector<HostAdapter::GlobEntry>>
+LocalHostAdapter::ReadGlob(absl::string_view pattern) {
+  glob_t matches;
+  int ret = glob(std::string(pattern).c_str(), 0, nullptr, &matches);
+  absl::Cleanup matches_cleanup = [&matches] { globfree(&matches); };
+  if (ret == GLOB_NOMATCH) return std::vector<GlobEntry>();
+  if (ret != 0) {
+    return absl::InternalError(
+        absl::StrCat("Failed to expand pattern: ", pattern));
+  }
+
+  std::vector<std::filesystem::path> paths(
+      matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+  ASSIGN_OR_RETURN(std::vector<absl::StatusOr<std::string>> contents,
+                   ReadMany(paths));
+  std::vector<GlobEntry> entries;
+  entries.reserve(paths.size());
+  for (size_t i = 0; i < paths.size(); ++i)
+    entries.push_back({std::move(paths[i]), std::move(contents[i])});
+  SortByPath(entries);
+  return entries;
+}
+
 absl::Status LocalHostAdapter::Write(const std::filesystem::path& path,
                                      absl::string_view data) {
+  // The file may be recreated below.
+  open_files_.Evict(path);
   ecclesia::ApifsFile file(path.string());
   if (!file.Exists()) {
     close(creat(path.c_str(), 0777));
@@ -176,9 +292,15 @@ absl::StatusOr<std::unique_ptr<RemoteHostAdapter>> RemoteHostAdapter::Create(
 
 absl::StatusOr<HostAdapter::CommandResult> RemoteHostAdapter::RunCommand(
     absl::Duration timeout, const std::vector<std::string>& args) {
-  ASSIGN_OR_RETURN(remote::ConnInterface::CommandResult result,
-                   connection_->RunCommand(
-                       timeout, args, remote::ConnInterface::CommandOption()));
+  // The connection joins the args into a remote shell command line, so each is
+  // quoted to reach the command as is, as LocalHostAdapter passes it.
+  std::vector<std::string> quoted;
+  quoted.reserve(args.size());
+  for (const std::string& arg : args) quoted.push_back(ShellQuote(arg));
+  ASSIGN_OR_RETURN(
+      remote::ConnInterface::CommandResult result,
+      connection_->RunCommand(timeout, quoted,
+                              remote::ConnInterface::CommandOption()));
 
   return HostAdapter::CommandResult{
       .exit_code = result.exit_code,
@@ -187,12 +309,117 @@ absl::StatusOr<HostAdapter::CommandResult> RemoteHostAdapter::RunCommand(
   };
 }
 
+absl::StatusOr<std::vector<absl::StatusOr<HostAdapter::CommandResult>>>
+RemoteHostAdapter::RunCommands(absl::Span<const Command> commands,
+                               int max_concurrency) {
+  std::vector<absl::StatusOr<CommandResult>> results(
+      commands.size(), absl::InternalError("The command was not run."));
+  size_t num_threads = commands.size();
+  if (max_concurrency > 0)
+    num_threads = std::min<size_t>(num_threads, max_concurrency);
+
+  // Each command blocks its thread for a full round trip, so the threads take
+  // the next command from a shared index until none are left.
+  std::atomic<size_t> next_command = 0;
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads.emplace_back([&] {
+      for (size_t index = next_command++; index < commands.size();
+           index = next_command++) {
+        results[index] =
+            RunCommand(commands[index].timeout, commands[index].args);
+      }
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  return results;
+}
+
 absl::StatusOr<std::string> RemoteHostAdapter::Read(
     const std::filesystem::path& path) {
   ASSIGN_OR_RETURN(absl::Cord result, connection_->ReadFile(path.string()));
   return std::string(result);
 }
 
+absl::StatusOr<std::vector<HostAdapter::GlobEntry>>
+RemoteHostAdapter::RunFileDumpScript(const std::string& script,
+                                     bool compress) {
+  // The exit status of a pipeline is that of gzip, so a failing script kills
+  // the shell instead.
+  std::string command =
+      compress ? absl::StrCat("{ (", script, ") || kill $$; } | gzip -1 -c")
+               : script;
+  ASSIGN_OR_RETURN(
+      remote::ConnInterface::CommandResult result,
+      connection_->RunCommand(kReadManyTimeout, {command},
+                              remote::ConnInterface::CommandOption()));
+  if (result.exit_code != EXIT_SUCCESS) {
+    return absl::InternalError(absl::StrFormat(
+        "Failed to read remote files. Exit code: %d. Stderr: %s",
+        result.exit_code, result.stderr));
+  }
+  if (!compress) return internal::ParseFileDump(result.stdout);
+  ASSIGN_OR_RETURN(absl::Cord dump,
+                   compression::GzipDecompress(result.stdout));
+  return internal::ParseFileDump(std::string(dump));
+}
+
+absl::StatusOr<std::vector<absl::StatusOr<std::string>>>
+RemoteHostAdapter::ReadMany(absl::Span<const std::filesystem::path> paths) {
+  std::vector<absl::StatusOr<std::string>> contents;
+  contents.reserve(paths.size());
+  // The part of the script that doesn't depend on the paths.
+  const size_t script_overhead = internal::FileDumpScript({}).size();
+  while (!paths.empty()) {
+    // Take as many paths as fit in one script, but at least one. Each path is
+    // added quoted, followed by a space.
+    size_t batch_size = 0;
+    size_t script_size = script_overhead;
+    while (batch_size < paths.size()) {
+      size_t path_size = ShellQuote(paths[batch_size].string()).size() + 1;
+      if (batch_size > 0 &&
+          script_size + path_size > internal::kMaxFileDumpScriptSize) {
+        break;
+      }
+      script_size += path_size;
+      ++batch_size;
+    }
+    absl::Span<const std::filesystem::path> batch = paths.first(batch_size);
+    paths.remove_prefix(batch_size);
+
+    ASSIGN_OR_RETURN(std::vector<GlobEntry> entries,
+                     RunFileDumpScript(internal::FileDumpScript(batch)));
+    if (entries.size() != batch.size()) {
+      return absl::InternalError(
+          absl::StrFormat("Expected %d files from the remote host, got %d",
+                          batch.size(), entries.size()));
+    }
+    for (GlobEntry& entry : entries)
+      contents.push_back(std::move(entry.content));
+  }
+  return contents;
+}
+
+absl::StatusOr<std::vector<HostAdapter::GlobEntry>> RemoteHostAdapter::ReadGlob(
+    absl::string_view pattern) {
+  ASSIGN_OR_RETURN(std::vector<GlobEntry> entries,
+                   RunFileDumpScript(internal::GlobDumpScript(pattern)));
+  SortByPath(entries);
+  return entries;
+}
+
+absl::StatusOr<std::vector<HostAdapter::GlobEntry>>
+RemoteHostAdapter::ReadGlobs(absl::Span<const std::string> patterns) {
+  // Field splitting of the unquoted pattern variable separates the patterns.
+  ASSIGN_OR_RETURN(std::vector<GlobEntry> entries,
+                   RunFileDumpScript(
+                       internal::GlobDumpScript(absl::StrJoin(patterns, " ")),
+                       /*compress=*/true));
+  internal::SortAndDedupByPath(entries);
+  return entries;
+}
+
 absl::Status RemoteHostAdapter::Write(const std::filesystem::path& path,
                                       absl::string_view data) {
   return connection_->WriteFile(path.string(), data);
@@ -8,16 +8,26 @@
 #define OCPDIAG_CORE_HWINTERFACE_BACKENDS_LIB_HOST_ADAPTER_H_
 
 #include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
 
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "ocpdiag/core/hwinterface/backends/lib/open_file_cache.h"
 #include "ocpdiag/core/lib/off_dut_machine_interface/remote.h"
 
 namespace ocpdiag::hwinterface {
 
 // HostAdapter helps program to manipulate  localhost / remote host,
 // and increases testability by faking or mocking the adapter.
+//
+// Implementations must be thread-safe: backends call them from several threads
+// at once, e.g. HostBackend::GetNodeInfo() enumerates storage devices and PCIe
+// cards in the background.
 class HostAdapter {
  public:
   // If the address is empty, creates a LocalHostAdapter, otherwise creates a
@@ -45,10 +55,76 @@ class HostAdapter {
   virtual absl::StatusOr<CommandResult> RunCommand(
       absl::Duration timeout, const std::vector<std::string>& args) = 0;
 
+  // A command for RunCommands(), and how long it may run before it is killed.
+  struct Command {
+    std::vector<std::string> args;
+    absl::Duration timeout;
+  };
+
+  // Runs every command in `commands`, returning one result per command in the
+  // same order. At most `max_concurrency` commands run at a time, or all of
+  // them if it is zero. Each command succeeds, fails or times out on its own;
+  // an error is only returned if the host could not be queried at all.
+  //
+  // The default implementation calls RunCommand() for each command in turn.
+  // LocalHostAdapter and RemoteHostAdapter run the commands concurrently, so
+  // prefer this over repeated RunCommand() calls for independent commands,
+  // e.g. one per device.
+  virtual absl::StatusOr<std::vector<absl::StatusOr<CommandResult>>>
+  RunCommands(absl::Span<const Command> commands, int max_concurrency);
+
   // Read file content form `path`
   virtual absl::StatusOr<std::string> Read(
       const std::filesystem::path& path) = 0;
 
+  // Reads the content of every file in `paths`, returning one result per path
+  // in the same order. Each file succeeds or fails on its own, e.g. a missing
+  // file gets a NotFound result without affecting the others. An error is only
+  // returned if the host could not be queried at all.
+  //
+  // The default implementation calls Read() for each path. Adapters where each
+  // call is expensive, like RemoteHostAdapter, read all the files in a single
+  // round trip instead, so prefer this over repeated Read() calls when the
+  // paths are known up front.
+  virtual absl::StatusOr<std::vector<absl::StatusOr<std::string>>> ReadMany(
+      absl::Span<const std::filesystem::path> paths);
+
+  // Like ReadMany(), for attributes that are read over and over, e.g. sysfs
+  // counters or sensors sampled in a loop. Results are never cached, only the
+  // means to read them are.
+  //
+  // The default implementation calls ReadMany(). LocalHostAdapter keeps the
+  // files open between calls, so that sampling an attribute again is a single
+  // pread().
+  virtual absl::StatusOr<std::vector<absl::StatusOr<std::string>>> Sample(
+      absl::Span<const std::filesystem::path> paths);
+
+  // A file matched by ReadGlob(), along with the result of reading it.
+  struct GlobEntry {
+    std::filesystem::path path;
+    absl::StatusOr<std::string> content;
+  };
+
+  // Reads every file matching the shell wildcard `pattern`, e.g.
+  // "/sys/devices/system/node/node*/cpulist", in a single call. The matches
+  // are returned sorted by path; no match is not an error. The pattern must
+  // not contain whitespace.
+  //
+  // The default implementation returns an Unimplemented error.
+  virtual absl::StatusOr<std::vector<GlobEntry>> ReadGlob(
+      absl::string_view pattern);
+
+  // Reads every file matching any of the wildcard `patterns` in a single call,
+  // e.g. to capture several sysfs trees at once. The matches are returned
+  // sorted by path, without duplicates. The patterns must not contain
+  // whitespace.
+  //
+  // The default implementation calls ReadGlob() for each pattern.
+  // RemoteHostAdapter reads all the files with a single remote command, and
+  // compresses them on the wire.
+  virtual absl::StatusOr<std::vector<GlobEntry>> ReadGlobs(
+      absl::Span<const std::string> patterns);
+
   // Writes data to file `path`.
   // If file is exists, truncates and rewrites it.
   // If file does not exist, creates and writes it.
@@ -61,18 +137,34 @@ class HostAdapter {
 };
 
 // LocalHostAdapter is for local host
+// This class is thread-safe.
 class LocalHostAdapter final : public HostAdapter {
  public:
   absl::StatusOr<CommandResult> RunCommand(
       absl::Duration timeout, const std::vector<std::string>& args) override;
 
+  // Runs the commands as concurrent subprocesses driven by a single thread.
+  absl::StatusOr<std::vector<absl::StatusOr<CommandResult>>> RunCommands(
+      absl::Span<const Command> commands, int max_concurrency) override;
+
   absl::StatusOr<std::string> Read(const std::filesystem::path& path) override;
 
+  // Reads the files through a cache of open files.
+  absl::StatusOr<std::vector<absl::StatusOr<std::string>>> Sample(
+      absl::Span<const std::filesystem::path> paths) override;
+
+  absl::StatusOr<std::vector<GlobEntry>> ReadGlob(
+      absl::string_view pattern) override;
+
   absl::Status Write(const std::filesystem::path& path,
                      absl::string_view data) override;
+
+ private:
+  OpenFileCache open_files_;
 };
 
 // RemoteHostAdapter is adapter for off dut machine interface.
+// This class is thread-safe.
 class RemoteHostAdapter final : public HostAdapter {
  public:
   explicit RemoteHostAdapter(std::unique_ptr<remote::ConnInterface> connection)
@@ -81,19 +173,71 @@ class RemoteHostAdapter final : public HostAdapter {
   static absl::StatusOr<std::unique_ptr<RemoteHostAdapter>> Create(
       absl::string_view remote_host_address);
 
+  // Quotes each of `args` for the remote shell, so that they reach the command
+  // unchanged, shell syntax included, as with LocalHostAdapter.
   absl::StatusOr<CommandResult> RunCommand(
       absl::Duration timeout, const std::vector<std::string>& args) override;
 
+  // Runs the commands over the connection from a pool of threads.
+  absl::StatusOr<std::vector<absl::StatusOr<CommandResult>>> RunCommands(
+      absl::Span<const Command> commands, int max_concurrency) override;
+
   absl::StatusOr<std::string> Read(const std::filesystem::path& path) override;
 
+  // Reads all the files with a single remote command.
+  absl::StatusOr<std::vector<absl::StatusOr<std::string>>> ReadMany(
+      absl::Span<const std::filesystem::path> paths) override;
+
+  // Expands the pattern and reads the matches with a single remote command.
+  absl::StatusOr<std::vector<GlobEntry>> ReadGlob(
+      absl::string_view pattern) override;
+
+  // Expands the patterns and reads the matches with a single remote command,
+  // whose output is compressed with gzip.
+  absl::StatusOr<std::vector<GlobEntry>> ReadGlobs(
+      absl::Span<const std::string> patterns) override;
+
   absl::Status Write(const std::filesystem::path& path,
                      absl::string_view data) override;
 
  private:
+  // Runs a shell script that prints files in the format parsed by
+  // internal::ParseFileDump(), compressing its output if `compress` is true.
+  absl::StatusOr<std::vector<GlobEntry>> RunFileDumpScript(
+      const std::string& script, bool compress = false);
+
   // Machine node connection.
   std::unique_ptr<remote::ConnInterface> connection_;
 };
 
+namespace internal {
+
+// The largest script RemoteHostAdapter::ReadMany() runs in one command, which
+// keeps it well below the remote command line length limit. Exposed for
+// testing.
+inline constexpr size_t kMaxFileDumpScriptSize = 64 * 1024;
+
+// Returns a POSIX shell script that prints every file in `paths` in the format
+// parsed by ParseFileDump(). Exposed for testing.
+std::string FileDumpScript(absl::Span<const std::filesystem::path> paths);
+
+// Returns a POSIX shell script that prints every file matching the wildcard
+// `pattern` in the format parsed by ParseFileDump(). Exposed for testing.
+std::string GlobDumpScript(absl::string_view pattern);
+
+// Parses the output of the scripts above. Each file is framed by a header line
+// "<status> <size> <path>", where status is one of OK, NOENT or ERR, followed
+// by exactly <size> bytes of content.
+absl::StatusOr<std::vector<HostAdapter::GlobEntry>> ParseFileDump(
+    absl::string_view dump);
+
+// Sorts `entries` by path and drops the entries matched by more than one
+// pattern, keeping the first of each. Shared by the ReadGlobs()
+// implementations.
+void SortAndDedupByPath(std::vector<HostAdapter::GlobEntry>& entries);
+
+}  // namespace internal
+
 }  // namespace ocpdiag::hwinterface
 
 #endif  // OCPDIAG_CORE_HWINTERFACE_BACKENDS_LIB_HOST_INTERFACE_H_
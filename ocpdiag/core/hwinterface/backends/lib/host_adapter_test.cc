@@ -6,18 +6,27 @@
 
 #include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
 
+#include <atomic>
 #include <filesystem>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/log/check.h"
 #include "absl/status/status.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/cord.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "absl/types/span.h"
 #include "ecclesia/lib/file/test_filesystem.h"
+#include "ocpdiag/core/compat/status_macros.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/agent/agent_conn.h"
 #include "ocpdiag/core/lib/off_dut_machine_interface/mock_remote.h"
 #include "ocpdiag/core/lib/off_dut_machine_interface/remote.h"
 #include "ocpdiag/core/testing/status_matchers.h"
@@ -29,10 +38,43 @@ namespace {
 using ::ocpdiag::testing::IsOkAndHolds;
 using ::ocpdiag::testing::StatusIs;
 using ::testing::_;
+using ::testing::ElementsAre;
 using ::testing::Eq;
+using ::testing::Field;
 using ::testing::HasSubstr;
+using ::testing::IsEmpty;
 using ::testing::Return;
 
+// Runs the remote command through the local shell, joined like ssh does, as
+// ssh would on the remote host.
+absl::StatusOr<remote::ConnInterface::CommandResult> RunInLocalShell(
+    absl::Duration timeout, const std::vector<std::string>& args,
+    const remote::ConnInterface::CommandOption&) {
+  LocalHostAdapter local;
+  ASSIGN_OR_RETURN(
+      HostAdapter::CommandResult result,
+      local.RunCommand(timeout, {"/bin/sh", "-c", absl::StrJoin(args, " ")}));
+  return remote::ConnInterface::CommandResult{.exit_code = result.exit_code,
+                                              .stdout = result.stdout,
+                                              .stderr = result.stderr};
+}
+
+// Creates a fresh temp directory holding the files "a", "b" and "c.txt".
+std::filesystem::path MakeTestDir(absl::string_view name) {
+  std::filesystem::path dir = ecclesia::GetTestTempdirPath(name);
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  LocalHostAdapter local;
+  CHECK_OK(local.Write(dir / "a", "content a"));
+  CHECK_OK(local.Write(dir / "b", std::string("with\0nul\n", 9)));
+  CHECK_OK(local.Write(dir / "c.txt", ""));
+  return dir;
+}
+
+auto PathIs(const std::filesystem::path& path) {
+  return Field(&HostAdapter::GlobEntry::path, path);
+}
+
 TEST(LocalHostAdapter, RunCommandSuccessed) {
   LocalHostAdapter local;
 
@@ -95,6 +137,27 @@ TEST(LocalHostAdapter, RunCommandEmpty) {
       << result.status();
 }
 
+TEST(LocalHostAdapter, RunCommands) {
+  LocalHostAdapter local;
+
+  std::vector<HostAdapter::Command> commands = {
+      {.args = {"sh", "-c", "echo a"}, .timeout = absl::Seconds(10)},
+      {.args = {"sleep", "3"}, .timeout = absl::Milliseconds(100)},
+      {.args = {"sh", "-c", "kill -9 $$"}, .timeout = absl::Seconds(10)},
+      {.args = {}, .timeout = absl::Seconds(10)},
+  };
+  absl::StatusOr<std::vector<absl::StatusOr<HostAdapter::CommandResult>>>
+      results = local.RunCommands(commands, /*max_concurrency=*/2);
+  ASSERT_OK(results);
+  ASSERT_EQ(results->size(), 4);
+  ASSERT_OK((*results)[0]);
+  EXPECT_EQ((*results)[0]->stdout, "a\n");
+  EXPECT_THAT((*results)[1], StatusIs(absl::StatusCode::kDeadlineExceeded));
+  ASSERT_OK((*results)[2]);
+  EXPECT_EQ((*results)[2]->exit_code, 128 + 9);
+  EXPECT_THAT((*results)[3], StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
 TEST(LocalHostAdapter, FileReadWrite) {
   LocalHostAdapter local;
   std::string test_file =
@@ -105,6 +168,33 @@ TEST(LocalHostAdapter, FileReadWrite) {
   EXPECT_THAT(local.Read(test_file), IsOkAndHolds(Eq(kTestData)));
 }
 
+TEST(LocalHostAdapter, ReadMany) {
+  LocalHostAdapter local;
+  std::filesystem::path dir = MakeTestDir("local_read_many");
+
+  absl::StatusOr<std::vector<absl::StatusOr<std::string>>> contents =
+      local.ReadMany({dir / "a", dir / "missing", dir / "b"});
+  ASSERT_OK(contents);
+  ASSERT_EQ(contents->size(), 3);
+  EXPECT_THAT((*contents)[0], IsOkAndHolds("content a"));
+  EXPECT_FALSE((*contents)[1].ok());
+  EXPECT_THAT((*contents)[2], IsOkAndHolds(std::string("with\0nul\n", 9)));
+}
+
+TEST(LocalHostAdapter, ReadGlob) {
+  LocalHostAdapter local;
+  std::filesystem::path dir = MakeTestDir("local_read_glob");
+
+  absl::StatusOr<std::vector<HostAdapter::GlobEntry>> entries =
+      local.ReadGlob((dir / "[ab]").string());
+  ASSERT_OK(entries);
+  EXPECT_THAT(*entries, ElementsAre(PathIs(dir / "a"), PathIs(dir / "b")));
+  EXPECT_THAT((*entries)[0].content, IsOkAndHolds("content a"));
+
+  EXPECT_THAT(local.ReadGlob((dir / "*.none").string()),
+              IsOkAndHolds(IsEmpty()));
+}
+
 TEST(RemoteHostAdapter, CreateRemoteHostAdapter) {
   EXPECT_OK(RemoteHostAdapter::Create("127.0.0.1"));
 }
@@ -140,6 +230,69 @@ TEST(RemoteHostAdapter, RunCommandTimeout) {
               StatusIs(absl::StatusCode::kDeadlineExceeded));
 }
 
+TEST(RemoteHostAdapter, RunCommandsRunsConcurrently) {
+  auto conn = std::make_unique<remote::MockConnInterface>();
+  std::atomic<int> in_flight = 0;
+  std::atomic<int> max_in_flight = 0;
+  EXPECT_CALL(*conn, RunCommand)
+      .Times(5)
+      .WillRepeatedly([&](absl::Duration timeout,
+                          const std::vector<std::string>& args,
+                          const remote::ConnInterface::CommandOption&) {
+        int now = ++in_flight;
+        int max = max_in_flight;
+        while (now > max && !max_in_flight.compare_exchange_weak(max, now)) {
+        }
+        absl::SleepFor(absl::Milliseconds(50));
+        --in_flight;
+        return remote::ConnInterface::CommandResult{.stdout = args[0]};
+      });
+
+  RemoteHostAdapter remote(std::move(conn));
+
+  std::vector<HostAdapter::Command> commands;
+  for (int i = 0; i < 5; ++i) {
+    commands.push_back(
+        {.args = {absl::StrCat(i)}, .timeout = absl::Minutes(1)});
+  }
+  absl::StatusOr<std::vector<absl::StatusOr<HostAdapter::CommandResult>>>
+      results = remote.RunCommands(commands, /*max_concurrency=*/2);
+  ASSERT_OK(results);
+  ASSERT_EQ(results->size(), 5);
+  for (int i = 0; i < 5; ++i) {
+    ASSERT_OK((*results)[i]);
+    EXPECT_EQ((*results)[i]->stdout, absl::StrCat("'", i, "'"));
+  }
+  EXPECT_EQ(max_in_flight, 2);
+}
+
+TEST(RemoteHostAdapter, RunCommandQuotesArgs) {
+  auto conn = std::make_unique<remote::MockConnInterface>();
+  EXPECT_CALL(*conn, RunCommand(_,
+                                ElementsAre("'sqlite3'",
+                                            R"('SELECT '\''a'\'';')"),
+                                _))
+      .WillOnce(Return(remote::ConnInterface::CommandResult{.exit_code = 0}));
+
+  RemoteHostAdapter remote(std::move(conn));
+
+  EXPECT_OK(remote.RunCommand(absl::Minutes(1), {"sqlite3", "SELECT 'a';"}));
+}
+
+TEST(RemoteHostAdapter, RunCommandPassesShellSyntaxThrough) {
+  auto conn = std::make_unique<remote::MockConnInterface>();
+  EXPECT_CALL(*conn, RunCommand).WillOnce(RunInLocalShell);
+
+  RemoteHostAdapter remote(std::move(conn));
+
+  const std::string arg = "a || (b); 'c' $d";
+  absl::StatusOr<HostAdapter::CommandResult> result =
+      remote.RunCommand(absl::Minutes(1), {"printf", "%s", arg});
+  ASSERT_OK(result);
+  EXPECT_EQ(result->exit_code, 0);
+  EXPECT_EQ(result->stdout, arg);
+}
+
 TEST(RemoteHostAdapter, ReadFileSuccess) {
   auto conn = std::make_unique<remote::MockConnInterface>();
   EXPECT_CALL(*conn, ReadFile(_)).WillOnce(Return(absl::Cord("content")));
@@ -181,6 +334,222 @@ TEST(RemoteHostAdapter, WriteFileError) {
               StatusIs(absl::StatusCode::kInternal));
 }
 
+TEST(RemoteHostAdapter, ReadManyUsesOneCommand) {
+  std::filesystem::path dir = MakeTestDir("remote_read_many");
+  auto conn = std::make_unique<remote::MockConnInterface>();
+  EXPECT_CALL(*conn, RunCommand).WillOnce(RunInLocalShell);
+  EXPECT_CALL(*conn, ReadFile).Times(0);
+
+  RemoteHostAdapter remote(std::move(conn));
+
+  absl::StatusOr<std::vector<absl::StatusOr<std::string>>> contents =
+      remote.ReadMany({dir / "a", dir / "missing", dir, dir / "b"});
+  ASSERT_OK(contents);
+  ASSERT_EQ(contents->size(), 4);
+  EXPECT_THAT((*contents)[0], IsOkAndHolds("content a"));
+  EXPECT_THAT((*contents)[1], StatusIs(absl::StatusCode::kNotFound));
+  EXPECT_THAT((*contents)[2], StatusIs(absl::StatusCode::kInternal));
+  EXPECT_THAT((*contents)[3], IsOkAndHolds(std::string("with\0nul\n", 9)));
+}
+
+TEST(RemoteHostAdapter, ReadManyQuotesPaths) {
+  std::filesystem::path dir = MakeTestDir("remote_read_many_quotes");
+  std::filesystem::path odd_path = dir / "it's a $(file)";
+  ASSERT_OK(LocalHostAdapter().Write(odd_path, "odd"));
+  auto conn = std::make_unique<remote::MockConnInterface>();
+  EXPECT_CALL(*conn, RunCommand).WillOnce(RunInLocalShell);
+
+  RemoteHostAdapter remote(std::move(conn));
+
+  absl::StatusOr<std::vector<absl::StatusOr<std::string>>> contents =
+      remote.ReadMany({odd_path});
+  ASSERT_OK(contents);
+  ASSERT_EQ(contents->size(), 1);
+  EXPECT_THAT((*contents)[0], IsOkAndHolds("odd"));
+}
+
+TEST(RemoteHostAdapter, ReadManySplitsOnQuotedScriptSize) {
+  // Every quote in a path takes four bytes once quoted, so the paths fit in
+  // one script unquoted, but not quoted.
+  std::vector<std::filesystem::path> paths;
+  for (int i = 0; i < 100; ++i) {
+    paths.push_back(absl::StrCat("/nonexistent/", i, std::string(200, '\'')));
+  }
+  std::vector<size_t> script_sizes;
+  auto conn = std::make_unique<remote::MockConnInterface>();
+  EXPECT_CALL(*conn, RunCommand)
+      .WillRepeatedly([&](absl::Duration timeout,
+                          const std::vector<std::string>& args,
+                          const remote::ConnInterface::CommandOption& option) {
+        script_sizes.push_back(absl::StrJoin(args, " ").size());
+        return RunInLocalShell(timeout, args, option);
+      });
+
+  RemoteHostAdapter remote(std::move(conn));
+
+  absl::StatusOr<std::vector<absl::StatusOr<std::string>>> contents =
+      remote.ReadMany(paths);
+  ASSERT_OK(contents);
+  ASSERT_EQ(contents->size(), paths.size());
+  for (const absl::StatusOr<std::string>& content : *contents) {
+    EXPECT_THAT(content, StatusIs(absl::StatusCode::kNotFound));
+  }
+  ASSERT_EQ(script_sizes.size(), 2);
+  // The first batch is filled up to the limit.
+  EXPECT_LE(script_sizes[0], internal::kMaxFileDumpScriptSize);
+  EXPECT_GT(script_sizes[0], internal::kMaxFileDumpScriptSize - 1024);
+  EXPECT_LE(script_sizes[1], internal::kMaxFileDumpScriptSize);
+}
+
+TEST(RemoteHostAdapter, ReadManyCommandFailure) {
+  auto conn = std::make_unique<remote::MockConnInterface>();
+  EXPECT_CALL(*conn, RunCommand)
+      .WillOnce(Return(remote::ConnInterface::CommandResult{.exit_code = 255}));
+
+  RemoteHostAdapter remote(std::move(conn));
+
+  EXPECT_THAT(remote.ReadMany({"/a", "/b"}),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST(RemoteHostAdapter, ReadGlob) {
+  std::filesystem::path dir = MakeTestDir("remote_read_glob");
+  auto conn = std::make_unique<remote::MockConnInterface>();
+  EXPECT_CALL(*conn, RunCommand).Times(2).WillRepeatedly(RunInLocalShell);
+
+  RemoteHostAdapter remote(std::move(conn));
+
+  absl::StatusOr<std::vector<HostAdapter::GlobEntry>> entries =
+      remote.ReadGlob((dir / "*").string());
+  ASSERT_OK(entries);
+  EXPECT_THAT(*entries,
+              ElementsAre(PathIs(dir / "a"), PathIs(dir / "b"),
+                          PathIs(dir / "c.txt")));
+  EXPECT_THAT((*entries)[2].content, IsOkAndHolds(""));
+
+  EXPECT_THAT(remote.ReadGlob((dir / "*.none").string()),
+              IsOkAndHolds(IsEmpty()));
+}
+
+TEST(LocalHostAdapter, ReadGlobs) {
+  std::filesystem::path dir = MakeTestDir("local_read_globs");
+  LocalHostAdapter local;
+
+  absl::StatusOr<std::vector<HostAdapter::GlobEntry>> entries =
+      local.ReadGlobs({(dir / "*.txt").string(), (dir / "*").string()});
+  ASSERT_OK(entries);
+  EXPECT_THAT(*entries,
+              ElementsAre(PathIs(dir / "a"), PathIs(dir / "b"),
+                          PathIs(dir / "c.txt")));
+}
+
+TEST(LocalHostAdapter, Sample) {
+  std::filesystem::path dir = MakeTestDir("local_sample");
+  LocalHostAdapter local;
+  std::vector<std::filesystem::path> paths = {dir / "a", dir / "none"};
+
+  absl::StatusOr<std::vector<absl::StatusOr<std::string>>> contents =
+      local.Sample(paths);
+  ASSERT_OK(contents);
+  EXPECT_THAT(*contents, ElementsAre(IsOkAndHolds("content a"),
+                                     StatusIs(absl::StatusCode::kNotFound)));
+
+  ASSERT_OK(local.Write(dir / "a", "new"));
+  contents = local.Sample(paths);
+  ASSERT_OK(contents);
+  EXPECT_THAT(*contents, ElementsAre(IsOkAndHolds("new"),
+                                     StatusIs(absl::StatusCode::kNotFound)));
+}
+
+TEST(RemoteHostAdapter, ReadGlobsInOneCompressedCommand) {
+  std::filesystem::path dir = MakeTestDir("remote_read_globs");
+  auto conn = std::make_unique<remote::MockConnInterface>();
+  EXPECT_CALL(*conn, RunCommand(_, ElementsAre(HasSubstr("gzip")), _))
+      .WillOnce(RunInLocalShell);
+
+  RemoteHostAdapter remote(std::move(conn));
+
+  absl::StatusOr<std::vector<HostAdapter::GlobEntry>> entries =
+      remote.ReadGlobs({(dir / "b").string(), (dir / "*").string(),
+                        (dir / "none*").string()});
+  ASSERT_OK(entries);
+  EXPECT_THAT(*entries,
+              ElementsAre(PathIs(dir / "a"), PathIs(dir / "b"),
+                          PathIs(dir / "c.txt")));
+  EXPECT_THAT((*entries)[1].content,
+              IsOkAndHolds(std::string("with\0nul\n", 9)));
+}
+
+TEST(RemoteHostAdapter, ReadsFilesThroughAgent) {
+  std::filesystem::path dir = MakeTestDir("remote_agent_read");
+  absl::StatusOr<std::unique_ptr<remote::LoopbackTransport>> transport =
+      remote::LoopbackTransport::Create();
+  ASSERT_OK(transport);
+  RemoteHostAdapter remote(
+      std::make_unique<remote::AgentConnInterface>(*std::move(transport)));
+
+  absl::StatusOr<std::vector<absl::StatusOr<std::string>>> contents =
+      remote.ReadMany({dir / "a", dir / "missing"});
+  ASSERT_OK(contents);
+  EXPECT_THAT(*contents, ElementsAre(IsOkAndHolds("content a"),
+                                     StatusIs(absl::StatusCode::kNotFound)));
+
+  absl::StatusOr<std::vector<HostAdapter::GlobEntry>> entries =
+      remote.ReadGlobs({(dir / "*").string()});
+  ASSERT_OK(entries);
+  EXPECT_THAT(*entries,
+              ElementsAre(PathIs(dir / "a"), PathIs(dir / "b"),
+                          PathIs(dir / "c.txt")));
+  EXPECT_THAT((*entries)[1].content,
+              IsOkAndHolds(std::string("with\0nul\n", 9)));
+}
+
+TEST(RemoteHostAdapter, ReadGlobsCommandFailure) {
+  auto conn = std::make_unique<remote::MockConnInterface>();
+  // The dump script fails when it can't create its temp file.
+  EXPECT_CALL(*conn, RunCommand)
+      .WillOnce([](absl::Duration timeout, const std::vector<std::string>& args,
+                   const remote::ConnInterface::CommandOption& options) {
+        return RunInLocalShell(
+            timeout, {absl::StrCat("mktemp() { return 1; }; ", args[0])},
+            options);
+      });
+
+  RemoteHostAdapter remote(std::move(conn));
+
+  EXPECT_THAT(remote.ReadGlobs({"/a*"}),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST(ParseFileDump, MalformedHeader) {
+  EXPECT_THAT(internal::ParseFileDump("OK 5 /a\nabc"),
+              StatusIs(absl::StatusCode::kInternal));
+  EXPECT_THAT(internal::ParseFileDump("OK /a\n"),
+              StatusIs(absl::StatusCode::kInternal));
+  EXPECT_THAT(internal::ParseFileDump("OK 0 /a"),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST(ParseFileDump, PathsWithSpaces) {
+  absl::StatusOr<std::vector<HostAdapter::GlobEntry>> entries =
+      internal::ParseFileDump("OK 3 /a b\nabcNOENT 0 /c d\n");
+  ASSERT_OK(entries);
+  EXPECT_THAT(*entries, ElementsAre(PathIs("/a b"), PathIs("/c d")));
+  EXPECT_THAT((*entries)[0].content, IsOkAndHolds("abc"));
+  EXPECT_THAT((*entries)[1].content, StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST(SortAndDedupByPath, KeepsFirstEntryForEachPath) {
+  std::vector<HostAdapter::GlobEntry> entries = {
+      {.path = "/b", .content = "first b"},
+      {.path = "/a", .content = "a"},
+      {.path = "/b", .content = "second b"},
+  };
+  internal::SortAndDedupByPath(entries);
+  EXPECT_THAT(entries, ElementsAre(PathIs("/a"), PathIs("/b")));
+  EXPECT_THAT(entries[1].content, IsOkAndHolds("first b"));
+}
+
 TEST(HostAdapter, GetHostnameSuccess) {
   auto conn = std::make_unique<remote::MockConnInterface>();
   EXPECT_CALL(*conn, RunCommand)
@@ -11,6 +11,7 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
 
 namespace ocpdiag::hwinterface {
@@ -21,6 +22,31 @@ class MockHostAdapter final : public HostAdapter {
   MockHostAdapter() {
     ON_CALL(*this, Read)
         .WillByDefault(::testing::Return(absl::StatusOr<std::string>("")));
+    // Batched reads go through Read() by default, so tests only need to set
+    // expectations on Read().
+    ON_CALL(*this, ReadMany)
+        .WillByDefault([this](absl::Span<const std::filesystem::path> paths) {
+          return HostAdapter::ReadMany(paths);
+        });
+    ON_CALL(*this, Sample)
+        .WillByDefault([this](absl::Span<const std::filesystem::path> paths) {
+          return HostAdapter::Sample(paths);
+        });
+    // Like the base class, globs aren't supported unless a test expects them.
+    ON_CALL(*this, ReadGlob)
+        .WillByDefault([this](absl::string_view pattern) {
+          return HostAdapter::ReadGlob(pattern);
+        });
+    ON_CALL(*this, ReadGlobs)
+        .WillByDefault([this](absl::Span<const std::string> patterns) {
+          return HostAdapter::ReadGlobs(patterns);
+        });
+    // Likewise, batched commands go through RunCommand() by default.
+    ON_CALL(*this, RunCommands)
+        .WillByDefault(
+            [this](absl::Span<const Command> commands, int max_concurrency) {
+              return HostAdapter::RunCommands(commands, max_concurrency);
+            });
 
     // Set up the default command to return the hostname, so that GetHostname()
     // works by default.
@@ -32,12 +58,26 @@ class MockHostAdapter final : public HostAdapter {
 
   MOCK_METHOD(absl::StatusOr<std::string>, Read,
               (const std::filesystem::path& path), (override));
+  MOCK_METHOD(absl::StatusOr<std::vector<absl::StatusOr<std::string>>>,
+              ReadMany, (absl::Span<const std::filesystem::path> paths),
+              (override));
+  MOCK_METHOD(absl::StatusOr<std::vector<absl::StatusOr<std::string>>>,
+              Sample, (absl::Span<const std::filesystem::path> paths),
+              (override));
+  MOCK_METHOD(absl::StatusOr<std::vector<GlobEntry>>, ReadGlob,
+              (absl::string_view pattern), (override));
+  MOCK_METHOD(absl::StatusOr<std::vector<GlobEntry>>, ReadGlobs,
+              (absl::Span<const std::string> patterns), (override));
   MOCK_METHOD(absl::Status, Write,
               (const std::filesystem::path& path, absl::string_view data),
               (override));
   MOCK_METHOD(absl::StatusOr<CommandResult>, RunCommand,
               (absl::Duration timeout, const std::vector<std::string>& args),
               (override));
+  MOCK_METHOD(absl::StatusOr<std::vector<absl::StatusOr<CommandResult>>>,
+              RunCommands,
+              (absl::Span<const Command> commands, int max_concurrency),
+              (override));
 };
 
 }  // namespace ocpdiag::hwinterface
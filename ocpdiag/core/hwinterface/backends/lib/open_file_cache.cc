@@ -0,0 +1,139 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/lib/open_file_cache.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+
+namespace ocpdiag::hwinterface {
+
+namespace {
+
+// sysfs attributes are at most a page, so they are read in one call, and the
+// next one returns 0 at the end of the file.
+constexpr size_t kReadSize = 4096;
+
+absl::Status ErrnoToStatus(int error, absl::string_view message) {
+  return absl::Status(absl::ErrnoToStatusCode(error),
+                      absl::StrCat(message, ": ", strerror(error)));
+}
+
+}  // namespace
+
+OpenFileCache::~OpenFileCache() { Clear(); }
+
+absl::StatusOr<std::string> OpenFileCache::Read(
+    const std::filesystem::path& path) {
+  absl::MutexLock lock(&mutex_);
+  return ReadLocked(path);
+}
+
+std::vector<absl::StatusOr<std::string>> OpenFileCache::ReadMany(
+    absl::Span<const std::filesystem::path> paths) {
+  std::vector<absl::StatusOr<std::string>> contents;
+  contents.reserve(paths.size());
+  absl::MutexLock lock(&mutex_);
+  for (const std::filesystem::path& path : paths) {
+    contents.push_back(ReadLocked(path));
+  }
+  return contents;
+}
+
+void OpenFileCache::Evict(const std::filesystem::path& path) {
+  absl::MutexLock lock(&mutex_);
+  Close(path.native());
+}
+
+void OpenFileCache::Clear() {
+  absl::MutexLock lock(&mutex_);
+  for (const OpenFile& file : files_) close(file.fd);
+  files_.clear();
+  index_.clear();
+}
+
+size_t OpenFileCache::size() const {
+  absl::MutexLock lock(&mutex_);
+  return files_.size();
+}
+
+absl::StatusOr<int> OpenFileCache::GetFd(const std::string& path) {
+  if (auto it = index_.find(path); it != index_.end()) {
+    files_.splice(files_.begin(), files_, it->second);
+    return it->second->fd;
+  }
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return ErrnoToStatus(errno, absl::StrCat("Failed to open ", path));
+  }
+  if (capacity_ == 0) {
+    // Nothing is cached; the caller closes the file once read.
+    return fd;
+  }
+  while (files_.size() >= capacity_) Close(files_.back().path);
+  files_.push_front({.path = path, .fd = fd});
+  index_[path] = files_.begin();
+  return fd;
+}
+
+void OpenFileCache::Close(const std::string& path) {
+  auto it = index_.find(path);
+  if (it == index_.end()) return;
+  close(it->second->fd);
+  files_.erase(it->second);
+  index_.erase(it);
+}
+
+absl::StatusOr<std::string> OpenFileCache::ReadLocked(
+    const std::filesystem::path& path) {
+  const std::string& path_str = path.native();
+  absl::StatusOr<int> fd = GetFd(path_str);
+  if (!fd.ok()) return fd.status();
+
+  std::string content;
+  absl::Status status;
+  while (true) {
+    size_t size = content.size();
+    content.resize(size + kReadSize);
+    ssize_t count = pread(*fd, content.data() + size, kReadSize, size);
+    if (count < 0 && errno == EINTR) {
+      content.resize(size);
+      continue;
+    }
+    if (count < 0) {
+      status = ErrnoToStatus(errno, absl::StrCat("Failed to read ", path_str));
+      break;
+    }
+    content.resize(size + count);
+    // Only 0 means the end of the file: procfs seq_files, like /proc/meminfo,
+    // return short reads of up to a page until then.
+    if (count == 0) break;
+  }
+
+  if (capacity_ == 0) {
+    close(*fd);
+  } else if (!status.ok()) {
+    // e.g. the device behind the attribute is gone.
+    Close(path_str);
+  }
+  if (!status.ok()) return status;
+  return content;
+}
+
+}  // namespace ocpdiag::hwinterface
@@ -0,0 +1,86 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_HWINTERFACE_BACKENDS_LIB_OPEN_FILE_CACHE_H_
+#define OCPDIAG_CORE_HWINTERFACE_BACKENDS_LIB_OPEN_FILE_CACHE_H_
+
+#include <cstddef>
+#include <filesystem>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+
+namespace ocpdiag::hwinterface {
+
+// OpenFileCache reads files through descriptors that it keeps open between
+// reads, so that an attribute sampled over and over, like a sysfs counter or
+// an hwmon sensor, costs a pread() from offset 0, and one more that hits the
+// end of the file, instead of an open(), read() and close(). The least
+// recently read files are closed once more than `capacity` are open.
+//
+// It is meant for sysfs and procfs attributes, which are never replaced. A
+// regular file that is replaced by renaming another over it keeps being read
+// from the old file until it is evicted.
+//
+// This class is thread-safe.
+class OpenFileCache {
+ public:
+  static constexpr size_t kDefaultCapacity = 512;
+
+  explicit OpenFileCache(size_t capacity = kDefaultCapacity)
+      : capacity_(capacity) {}
+  OpenFileCache(const OpenFileCache&) = delete;
+  OpenFileCache& operator=(const OpenFileCache&) = delete;
+  ~OpenFileCache();
+
+  // Returns the current content of `path`. A file that fails to read is
+  // closed, so that it is opened again on the next read.
+  absl::StatusOr<std::string> Read(const std::filesystem::path& path);
+
+  // Returns the current content of each of `paths`, in order.
+  std::vector<absl::StatusOr<std::string>> ReadMany(
+      absl::Span<const std::filesystem::path> paths);
+
+  // Closes `path` if it is open, e.g. because it was recreated.
+  void Evict(const std::filesystem::path& path);
+
+  // Closes all the files.
+  void Clear();
+
+  // The number of open files.
+  size_t size() const;
+
+ private:
+  struct OpenFile {
+    std::string path;
+    int fd;
+  };
+
+  // Returns the descriptor of `path`, opening it if needed, and marks it as
+  // the most recently used.
+  absl::StatusOr<int> GetFd(const std::string& path)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void Close(const std::string& path) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  absl::StatusOr<std::string> ReadLocked(const std::filesystem::path& path)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const size_t capacity_;
+  mutable absl::Mutex mutex_;
+  // The most recently used file first.
+  std::list<OpenFile> files_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<std::string, std::list<OpenFile>::iterator> index_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace ocpdiag::hwinterface
+
+#endif  // OCPDIAG_CORE_HWINTERFACE_BACKENDS_LIB_OPEN_FILE_CACHE_H_
@@ -0,0 +1,135 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/lib/open_file_cache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_split.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::hwinterface {
+namespace {
+
+using ::ocpdiag::testing::IsOkAndHolds;
+using ::ocpdiag::testing::StatusIs;
+using ::testing::ElementsAre;
+using ::testing::StartsWith;
+
+class OpenFileCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = std::filesystem::path(::testing::TempDir()) /
+           ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    std::filesystem::remove_all(dir_);
+    std::filesystem::create_directories(dir_);
+  }
+
+  // Truncates and rewrites the file in place, as the kernel updates a sysfs
+  // attribute, or creates it.
+  std::filesystem::path WriteFile(const std::string& name,
+                                  const std::string& content) {
+    std::filesystem::path path = dir_ / name;
+    std::ofstream(path) << content;
+    return path;
+  }
+
+  std::filesystem::path dir_;
+};
+
+TEST_F(OpenFileCacheTest, ReadsCurrentContent) {
+  OpenFileCache cache;
+  std::filesystem::path path = WriteFile("counter", "1\n");
+  EXPECT_THAT(cache.Read(path), IsOkAndHolds("1\n"));
+  WriteFile("counter", "22\n");
+  EXPECT_THAT(cache.Read(path), IsOkAndHolds("22\n"));
+  WriteFile("counter", "3\n");
+  EXPECT_THAT(cache.Read(path), IsOkAndHolds("3\n"));
+  EXPECT_EQ(cache.size(), 1);
+}
+
+TEST_F(OpenFileCacheTest, ReadsFilesLargerThanAPage) {
+  OpenFileCache cache;
+  std::string content(10000, 'x');
+  EXPECT_THAT(cache.Read(WriteFile("large", content)), IsOkAndHolds(content));
+}
+
+TEST_F(OpenFileCacheTest, ReadsProcfsFilesReturnedInSeveralReads) {
+  // smaps is generated a few mappings per read, in reads shorter than a page.
+  OpenFileCache cache;
+  absl::StatusOr<std::string> smaps = cache.Read("/proc/self/smaps");
+  ASSERT_OK(smaps);
+  EXPECT_GT(smaps->size(), 3 * 4096);
+  std::vector<std::string> lines =
+      absl::StrSplit(*smaps, '\n', absl::SkipEmpty());
+  EXPECT_THAT(lines.back(), StartsWith("VmFlags:"));
+}
+
+TEST_F(OpenFileCacheTest, MissingFileIsNotFound) {
+  OpenFileCache cache;
+  EXPECT_THAT(cache.Read(dir_ / "missing"),
+              StatusIs(absl::StatusCode::kNotFound));
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST_F(OpenFileCacheTest, ClosesLeastRecentlyReadFiles) {
+  OpenFileCache cache(/*capacity=*/2);
+  std::filesystem::path a = WriteFile("a", "a");
+  std::filesystem::path b = WriteFile("b", "b");
+  std::filesystem::path c = WriteFile("c", "c");
+  ASSERT_OK(cache.Read(a));
+  ASSERT_OK(cache.Read(b));
+  ASSERT_OK(cache.Read(a));
+  ASSERT_OK(cache.Read(c));
+  EXPECT_EQ(cache.size(), 2);
+
+  // b was closed, so the file now at its path is read; a is still open on the
+  // file it was opened on.
+  std::filesystem::remove(a);
+  std::filesystem::remove(b);
+  WriteFile("b", "new b");
+  EXPECT_THAT(cache.Read(a), IsOkAndHolds("a"));
+  EXPECT_THAT(cache.Read(b), IsOkAndHolds("new b"));
+}
+
+TEST_F(OpenFileCacheTest, EvictReopens) {
+  OpenFileCache cache;
+  std::filesystem::path path = WriteFile("file", "old");
+  ASSERT_OK(cache.Read(path));
+  std::filesystem::remove(path);
+  WriteFile("file", "new");
+  cache.Evict(path);
+  EXPECT_THAT(cache.Read(path), IsOkAndHolds("new"));
+}
+
+TEST_F(OpenFileCacheTest, WorksWithoutCapacity) {
+  OpenFileCache cache(/*capacity=*/0);
+  std::filesystem::path path = WriteFile("file", "content");
+  EXPECT_THAT(cache.Read(path), IsOkAndHolds("content"));
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST_F(OpenFileCacheTest, ReadMany) {
+  OpenFileCache cache;
+  std::vector<std::filesystem::path> paths = {
+      WriteFile("a", "a"), dir_ / "missing", WriteFile("b", "b")};
+  EXPECT_THAT(cache.ReadMany(paths),
+              ElementsAre(IsOkAndHolds("a"),
+                          StatusIs(absl::StatusCode::kNotFound),
+                          IsOkAndHolds("b")));
+  cache.Clear();
+  EXPECT_EQ(cache.size(), 0);
+}
+
+}  // namespace
+}  // namespace ocpdiag::hwinterface
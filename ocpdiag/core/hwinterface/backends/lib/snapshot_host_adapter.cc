@@ -0,0 +1,361 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/lib/snapshot_host_adapter.h"
+
+#include <fnmatch.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "ocpdiag/core/compat/status_macros.h"
+#include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
+#include "ocpdiag/core/lib/compression/gzip.h"
+
+namespace ocpdiag::hwinterface {
+
+namespace {
+
+// The first line of a saved snapshot. It is followed by one "TREE <max age>
+// <pattern>" line per tree, then by the captured files in the format parsed
+// by internal::ParseFileDump().
+constexpr absl::string_view kSnapshotMagic = "OCPDIAG_HOST_SNAPSHOT 1\n";
+constexpr absl::string_view kTreePrefix = "TREE ";
+
+// Whether the shell wildcard `pattern` matches `path`, the way ReadGlob()
+// expands it.
+bool Matches(absl::string_view pattern, const std::filesystem::path& path) {
+  return fnmatch(std::string(pattern).c_str(), path.c_str(),
+                 FNM_PATHNAME | FNM_PERIOD) == 0;
+}
+
+absl::Status NoHostError() {
+  return absl::FailedPreconditionError(
+      "The snapshot was loaded without a host.");
+}
+
+// Appends `entry` to `dump` in the format parsed by internal::ParseFileDump().
+void AppendToFileDump(const HostAdapter::GlobEntry& entry, std::string& dump) {
+  if (entry.content.ok()) {
+    absl::StrAppend(&dump, "OK ", entry.content->size(), " ",
+                    entry.path.string(), "\n", *entry.content);
+  } else if (absl::IsNotFound(entry.content.status())) {
+    absl::StrAppend(&dump, "NOENT 0 ", entry.path.string(), "\n");
+  } else {
+    absl::StrAppend(&dump, "ERR 0 ", entry.path.string(), "\n");
+  }
+}
+
+}  // namespace
+
+std::vector<SnapshotHostAdapter::Tree> SnapshotHostAdapter::InventoryTrees() {
+  return {
+      {.pattern = "/proc/cpuinfo"},
+      {.pattern = "/sys/devices/system/cpu/cpu*/topology/*"},
+      {.pattern = "/sys/devices/system/node/online"},
+      {.pattern = "/sys/devices/system/node/node*/cpulist"},
+      {.pattern = "/sys/firmware/dmi/tables/*"},
+  };
+}
+
+SnapshotHostAdapter::SnapshotHostAdapter(std::unique_ptr<HostAdapter> host,
+                                         std::vector<Tree> trees)
+    : host_(std::move(host)) {
+  for (Tree& tree : trees) snapshots_.push_back({.tree = std::move(tree)});
+}
+
+absl::StatusOr<std::unique_ptr<SnapshotHostAdapter>> SnapshotHostAdapter::Load(
+    const std::filesystem::path& path, std::unique_ptr<HostAdapter> host) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return absl::NotFoundError(
+        absl::StrCat("Failed to open the snapshot: ", path.string()));
+  }
+  std::stringstream compressed;
+  compressed << file.rdbuf();
+  ASSIGN_OR_RETURN(absl::Cord decompressed,
+                   compression::GzipDecompress(compressed.str()));
+  std::string content(decompressed);
+
+  absl::string_view remaining = content;
+  if (!absl::ConsumePrefix(&remaining, kSnapshotMagic)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Not a host snapshot: ", path.string()));
+  }
+  std::vector<Tree> trees;
+  while (absl::ConsumePrefix(&remaining, kTreePrefix)) {
+    size_t line_end = remaining.find('\n');
+    std::vector<absl::string_view> fields = absl::StrSplit(
+        remaining.substr(0, line_end), absl::MaxSplits(' ', 1));
+    Tree& tree = trees.emplace_back();
+    if (line_end == absl::string_view::npos || fields.size() != 2 ||
+        !absl::ParseDuration(fields[0], &tree.max_age)) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Malformed tree in the snapshot: ", path.string()));
+    }
+    tree.pattern = std::string(fields[1]);
+    remaining.remove_prefix(line_end + 1);
+  }
+  ASSIGN_OR_RETURN(std::vector<GlobEntry> entries,
+                   internal::ParseFileDump(remaining));
+
+  auto adapter =
+      std::make_unique<SnapshotHostAdapter>(std::move(host), std::move(trees));
+  absl::MutexLock lock(&adapter->mutex_);
+  const absl::Time now = absl::Now();
+  for (TreeSnapshot& snapshot : adapter->snapshots_) {
+    snapshot.captured_at = now;
+    for (const GlobEntry& entry : entries) {
+      if (Matches(snapshot.tree.pattern, entry.path)) {
+        snapshot.entries.push_back(entry);
+      }
+    }
+    internal::SortAndDedupByPath(snapshot.entries);
+  }
+  return adapter;
+}
+
+absl::Status SnapshotHostAdapter::Capture() {
+  absl::MutexLock lock(&mutex_);
+  return CaptureLocked(/*all=*/true);
+}
+
+void SnapshotHostAdapter::Invalidate() {
+  absl::MutexLock lock(&mutex_);
+  for (TreeSnapshot& snapshot : snapshots_) {
+    snapshot.captured_at = absl::InfinitePast();
+  }
+}
+
+void SnapshotHostAdapter::Invalidate(const std::filesystem::path& path) {
+  absl::MutexLock lock(&mutex_);
+  for (TreeSnapshot& snapshot : snapshots_) {
+    if (Matches(snapshot.tree.pattern, path)) {
+      snapshot.captured_at = absl::InfinitePast();
+    }
+  }
+}
+
+absl::Status SnapshotHostAdapter::Save(const std::filesystem::path& path) {
+  std::string content(kSnapshotMagic);
+  {
+    absl::MutexLock lock(&mutex_);
+    RETURN_IF_ERROR(CaptureLocked(/*all=*/false));
+    for (const TreeSnapshot& snapshot : snapshots_) {
+      absl::StrAppend(&content, kTreePrefix,
+                      absl::FormatDuration(snapshot.tree.max_age), " ",
+                      snapshot.tree.pattern, "\n");
+    }
+    for (const TreeSnapshot& snapshot : snapshots_) {
+      for (const GlobEntry& entry : snapshot.entries) {
+        AppendToFileDump(entry, content);
+      }
+    }
+  }
+  ASSIGN_OR_RETURN(std::string compressed,
+                   compression::GzipCompress(absl::Cord(std::move(content))));
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file << compressed;
+  file.close();
+  if (!file) {
+    return absl::InternalError(
+        absl::StrCat("Failed to write the snapshot: ", path.string()));
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<HostAdapter::CommandResult> SnapshotHostAdapter::RunCommand(
+    absl::Duration timeout, const std::vector<std::string>& args) {
+  if (host_ == nullptr) return NoHostError();
+  return host_->RunCommand(timeout, args);
+}
+
+absl::StatusOr<std::vector<absl::StatusOr<HostAdapter::CommandResult>>>
+SnapshotHostAdapter::RunCommands(absl::Span<const Command> commands,
+                                 int max_concurrency) {
+  if (host_ == nullptr) return NoHostError();
+  return host_->RunCommands(commands, max_concurrency);
+}
+
+absl::StatusOr<std::string> SnapshotHostAdapter::Read(
+    const std::filesystem::path& path) {
+  {
+    absl::MutexLock lock(&mutex_);
+    if (TreeSnapshot* snapshot = FindTree(path); snapshot != nullptr) {
+      if (IsStale(*snapshot, absl::Now())) {
+        RETURN_IF_ERROR(CaptureLocked(/*all=*/false));
+      }
+      return Lookup(*snapshot, path);
+    }
+  }
+  if (host_ == nullptr) {
+    return absl::NotFoundError(
+        absl::StrCat("Not in the snapshot: ", path.string()));
+  }
+  return host_->Read(path);
+}
+
+absl::StatusOr<std::vector<absl::StatusOr<std::string>>>
+SnapshotHostAdapter::ReadMany(absl::Span<const std::filesystem::path> paths) {
+  std::vector<absl::StatusOr<std::string>> contents(
+      paths.size(), absl::UnknownError("Not read."));
+  // The paths outside of the snapshot, and where their contents go.
+  std::vector<std::filesystem::path> host_paths;
+  std::vector<size_t> host_indices;
+  {
+    absl::MutexLock lock(&mutex_);
+    const absl::Time now = absl::Now();
+    std::vector<TreeSnapshot*> trees(paths.size());
+    bool stale = false;
+    for (size_t i = 0; i < paths.size(); ++i) {
+      trees[i] = FindTree(paths[i]);
+      if (trees[i] == nullptr) {
+        host_paths.push_back(paths[i]);
+        host_indices.push_back(i);
+      } else {
+        stale = stale || IsStale(*trees[i], now);
+      }
+    }
+    if (stale) RETURN_IF_ERROR(CaptureLocked(/*all=*/false));
+    for (size_t i = 0; i < paths.size(); ++i) {
+      if (trees[i] != nullptr) contents[i] = Lookup(*trees[i], paths[i]);
+    }
+  }
+  if (host_paths.empty()) return contents;
+
+  if (host_ == nullptr) {
+    for (size_t i : host_indices) {
+      contents[i] = absl::NotFoundError(
+          absl::StrCat("Not in the snapshot: ", paths[i].string()));
+    }
+    return contents;
+  }
+  ASSIGN_OR_RETURN(std::vector<absl::StatusOr<std::string>> host_contents,
+                   host_->ReadMany(host_paths));
+  if (host_contents.size() != host_paths.size()) {
+    return absl::InternalError(absl::StrCat("Read ", host_contents.size(),
+                                            " files, expected ",
+                                            host_paths.size()));
+  }
+  for (size_t i = 0; i < host_indices.size(); ++i) {
+    contents[host_indices[i]] = std::move(host_contents[i]);
+  }
+  return contents;
+}
+
+absl::StatusOr<std::vector<absl::StatusOr<std::string>>>
+SnapshotHostAdapter::Sample(absl::Span<const std::filesystem::path> paths) {
+  if (host_ == nullptr) return ReadMany(paths);
+  return host_->Sample(paths);
+}
+
+absl::StatusOr<std::vector<HostAdapter::GlobEntry>>
+SnapshotHostAdapter::ReadGlob(absl::string_view pattern) {
+  {
+    absl::MutexLock lock(&mutex_);
+    for (TreeSnapshot& snapshot : snapshots_) {
+      if (snapshot.tree.pattern != pattern) continue;
+      if (IsStale(snapshot, absl::Now())) {
+        RETURN_IF_ERROR(CaptureLocked(/*all=*/false));
+      }
+      return snapshot.entries;
+    }
+    // Offline, the snapshot is all there is.
+    if (host_ == nullptr) {
+      std::vector<GlobEntry> entries;
+      for (const TreeSnapshot& snapshot : snapshots_) {
+        for (const GlobEntry& entry : snapshot.entries) {
+          if (Matches(pattern, entry.path)) entries.push_back(entry);
+        }
+      }
+      internal::SortAndDedupByPath(entries);
+      return entries;
+    }
+  }
+  return host_->ReadGlob(pattern);
+}
+
+absl::Status SnapshotHostAdapter::Write(const std::filesystem::path& path,
+                                        absl::string_view data) {
+  if (host_ == nullptr) return NoHostError();
+  absl::Status status = host_->Write(path, data);
+  Invalidate(path);
+  return status;
+}
+
+SnapshotHostAdapter::TreeSnapshot* SnapshotHostAdapter::FindTree(
+    const std::filesystem::path& path) {
+  for (TreeSnapshot& snapshot : snapshots_) {
+    if (Matches(snapshot.tree.pattern, path)) return &snapshot;
+  }
+  return nullptr;
+}
+
+bool SnapshotHostAdapter::IsStale(const TreeSnapshot& snapshot,
+                                  absl::Time now) const {
+  // Without a host, there is nothing to refresh the snapshot from.
+  if (host_ == nullptr) return false;
+  return snapshot.captured_at == absl::InfinitePast() ||
+         now - snapshot.captured_at >= snapshot.tree.max_age;
+}
+
+absl::Status SnapshotHostAdapter::CaptureLocked(bool all) {
+  if (host_ == nullptr) return all ? NoHostError() : absl::OkStatus();
+  const absl::Time now = absl::Now();
+  std::vector<TreeSnapshot*> stale;
+  std::vector<std::string> patterns;
+  for (TreeSnapshot& snapshot : snapshots_) {
+    if (all || IsStale(snapshot, now)) {
+      stale.push_back(&snapshot);
+      patterns.push_back(snapshot.tree.pattern);
+    }
+  }
+  if (stale.empty()) return absl::OkStatus();
+
+  ASSIGN_OR_RETURN(std::vector<GlobEntry> entries, host_->ReadGlobs(patterns));
+  for (TreeSnapshot* snapshot : stale) {
+    snapshot->captured_at = now;
+    snapshot->entries.clear();
+    for (const GlobEntry& entry : entries) {
+      if (Matches(snapshot->tree.pattern, entry.path)) {
+        snapshot->entries.push_back(entry);
+      }
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::string> SnapshotHostAdapter::Lookup(
+    const TreeSnapshot& snapshot, const std::filesystem::path& path) {
+  auto it = std::lower_bound(
+      snapshot.entries.begin(), snapshot.entries.end(), path,
+      [](const GlobEntry& entry, const std::filesystem::path& path) {
+        return entry.path < path;
+      });
+  if (it == snapshot.entries.end() || it->path != path) {
+    return absl::NotFoundError(absl::StrCat("No such file: ", path.string()));
+  }
+  return it->content;
+}
+
+}  // namespace ocpdiag::hwinterface
@@ -0,0 +1,134 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_HWINTERFACE_BACKENDS_LIB_SNAPSHOT_HOST_ADAPTER_H_
+#define OCPDIAG_CORE_HWINTERFACE_BACKENDS_LIB_SNAPSHOT_HOST_ADAPTER_H_
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
+
+namespace ocpdiag::hwinterface {
+
+// SnapshotHostAdapter serves reads of a declared set of files, e.g. the sysfs
+// and procfs trees read while gathering the inventory, from an in-memory
+// snapshot of another adapter. All the stale trees are captured together with
+// a single ReadGlobs() call, which is one compressed transfer for a
+// RemoteHostAdapter, instead of one round trip per read. Everything else,
+// including commands and writes, is passed through.
+//
+// A snapshot can be saved to a file and loaded later, e.g. to reproduce an
+// issue seen on a machine without access to it.
+//
+// This class is thread-safe.
+class SnapshotHostAdapter final : public HostAdapter {
+ public:
+  // A set of files captured in the snapshot.
+  struct Tree {
+    // The files, as a shell wildcard without whitespace, as for ReadGlob().
+    // For example "/sys/devices/system/cpu/cpu*/topology/*".
+    std::string pattern;
+    // How long the captured files are served before they are captured again.
+    // Files that change, like counters, need a short age or no tree at all.
+    absl::Duration max_age = absl::InfiniteDuration();
+  };
+
+  // The trees read by HostBackend to gather the CPU, NUMA and SMBIOS
+  // inventory, which don't change while the machine is up.
+  static std::vector<Tree> InventoryTrees();
+
+  // Serves the files matching `trees` from a snapshot of `host`, captured on
+  // first use.
+  SnapshotHostAdapter(std::unique_ptr<HostAdapter> host,
+                      std::vector<Tree> trees);
+
+  // Loads a snapshot saved by Save(). Without a `host`, reads outside of the
+  // snapshot return NotFound, commands and writes fail, and the snapshot
+  // never goes stale. With one, the loaded trees age from now on.
+  static absl::StatusOr<std::unique_ptr<SnapshotHostAdapter>> Load(
+      const std::filesystem::path& path,
+      std::unique_ptr<HostAdapter> host = nullptr);
+
+  // Captures all the trees now, in a single ReadGlobs() call.
+  absl::Status Capture();
+
+  // Drops the whole snapshot. The trees are captured again on the next read.
+  void Invalidate();
+
+  // Drops the trees that `path` belongs to, e.g. after it was changed behind
+  // the adapter's back. Writes through the adapter do this on their own.
+  void Invalidate(const std::filesystem::path& path);
+
+  // Saves the snapshot, capturing any stale tree first, to a gzip-compressed
+  // file that Load() reads back.
+  absl::Status Save(const std::filesystem::path& path);
+
+  // Commands always run on the host.
+  absl::StatusOr<CommandResult> RunCommand(
+      absl::Duration timeout, const std::vector<std::string>& args) override;
+  absl::StatusOr<std::vector<absl::StatusOr<CommandResult>>> RunCommands(
+      absl::Span<const Command> commands, int max_concurrency) override;
+
+  // Files in a tree are served from the snapshot. A file that was not
+  // captured doesn't exist.
+  absl::StatusOr<std::string> Read(const std::filesystem::path& path) override;
+
+  // Reads the files outside of the snapshot in a single batch.
+  absl::StatusOr<std::vector<absl::StatusOr<std::string>>> ReadMany(
+      absl::Span<const std::filesystem::path> paths) override;
+
+  // Samples are always read from the host, or from the snapshot if there is
+  // none.
+  absl::StatusOr<std::vector<absl::StatusOr<std::string>>> Sample(
+      absl::Span<const std::filesystem::path> paths) override;
+
+  // A pattern that is the pattern of a tree is served from the snapshot.
+  absl::StatusOr<std::vector<GlobEntry>> ReadGlob(
+      absl::string_view pattern) override;
+
+  absl::Status Write(const std::filesystem::path& path,
+                     absl::string_view data) override;
+
+ private:
+  struct TreeSnapshot {
+    Tree tree;
+    // Never captured if InfinitePast().
+    absl::Time captured_at = absl::InfinitePast();
+    // Sorted by path.
+    std::vector<GlobEntry> entries;
+  };
+
+  // Returns the first tree that `path` belongs to, or nullptr.
+  TreeSnapshot* FindTree(const std::filesystem::path& path)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  bool IsStale(const TreeSnapshot& snapshot, absl::Time now) const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Captures the trees that are stale, or all of them if `all` is true.
+  absl::Status CaptureLocked(bool all) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Returns the captured content of `path`, which belongs to `snapshot`.
+  static absl::StatusOr<std::string> Lookup(const TreeSnapshot& snapshot,
+                                            const std::filesystem::path& path);
+
+  // May be null for a loaded snapshot.
+  const std::unique_ptr<HostAdapter> host_;
+
+  absl::Mutex mutex_;
+  std::vector<TreeSnapshot> snapshots_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace ocpdiag::hwinterface
+
+#endif  // OCPDIAG_CORE_HWINTERFACE_BACKENDS_LIB_SNAPSHOT_HOST_ADAPTER_H_
@@ -0,0 +1,166 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/backends/lib/snapshot_host_adapter.h"
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/log/check.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "ocpdiag/core/hwinterface/backends/lib/fake_host_adapter.h"
+#include "ocpdiag/core/hwinterface/backends/lib/host_adapter.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::hwinterface {
+namespace {
+
+using ::ocpdiag::testing::IsOkAndHolds;
+using ::ocpdiag::testing::StatusIs;
+using ::testing::ElementsAre;
+using ::testing::Field;
+using ::testing::SizeIs;
+
+// A FakeHostAdapter that records the ReadGlobs() calls, which are the
+// captures of the snapshot.
+class RecordingHostAdapter : public FakeHostAdapter {
+ public:
+  absl::StatusOr<std::vector<GlobEntry>> ReadGlobs(
+      absl::Span<const std::string> patterns) override {
+    captures.emplace_back(patterns.begin(), patterns.end());
+    return HostAdapter::ReadGlobs(patterns);
+  }
+
+  std::vector<std::vector<std::string>> captures;
+};
+
+class SnapshotHostAdapterTest : public ::testing::Test {
+ protected:
+  SnapshotHostAdapterTest() {
+    auto host = std::make_unique<RecordingHostAdapter>();
+    host_ = host.get();
+    CHECK_OK(host_->Write("/sys/cpu/cpu0/id", "0"));
+    CHECK_OK(host_->Write("/sys/cpu/cpu1/id", "1"));
+    CHECK_OK(host_->Write("/proc/cpuinfo", "cpuinfo"));
+    CHECK_OK(host_->Write("/proc/uptime", "1"));
+    snapshot_ = std::make_unique<SnapshotHostAdapter>(
+        std::move(host),
+        std::vector<SnapshotHostAdapter::Tree>{{.pattern = "/sys/cpu/cpu*/id"},
+                                               {.pattern = "/proc/cpuinfo"}});
+  }
+
+  RecordingHostAdapter* host_;
+  std::unique_ptr<SnapshotHostAdapter> snapshot_;
+};
+
+TEST_F(SnapshotHostAdapterTest, CapturesAllTreesAtOnce) {
+  EXPECT_THAT(snapshot_->Read("/sys/cpu/cpu1/id"), IsOkAndHolds("1"));
+  EXPECT_THAT(snapshot_->Read("/proc/cpuinfo"), IsOkAndHolds("cpuinfo"));
+  EXPECT_THAT(snapshot_->Read("/sys/cpu/cpu0/id"), IsOkAndHolds("0"));
+  EXPECT_THAT(host_->captures,
+              ElementsAre(ElementsAre("/sys/cpu/cpu*/id", "/proc/cpuinfo")));
+}
+
+TEST_F(SnapshotHostAdapterTest, FileMissingFromTreeIsNotFound) {
+  EXPECT_THAT(snapshot_->Read("/sys/cpu/cpu2/id"),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST_F(SnapshotHostAdapterTest, ReadsOtherFilesFromHost) {
+  ASSERT_OK(snapshot_->Capture());
+  EXPECT_THAT(snapshot_->Read("/proc/uptime"), IsOkAndHolds("1"));
+
+  absl::StatusOr<std::vector<absl::StatusOr<std::string>>> contents =
+      snapshot_->ReadMany({"/sys/cpu/cpu0/id", "/proc/uptime", "/missing"});
+  ASSERT_OK(contents);
+  EXPECT_THAT(*contents, ElementsAre(IsOkAndHolds("0"), IsOkAndHolds("1"),
+                                     StatusIs(absl::StatusCode::kNotFound)));
+  EXPECT_EQ(host_->captures.size(), 1);
+}
+
+TEST_F(SnapshotHostAdapterTest, ServesTreePatternFromSnapshot) {
+  absl::StatusOr<std::vector<HostAdapter::GlobEntry>> entries =
+      snapshot_->ReadGlob("/sys/cpu/cpu*/id");
+  ASSERT_OK(entries);
+  EXPECT_THAT(*entries, ElementsAre(Field(&HostAdapter::GlobEntry::path,
+                                          "/sys/cpu/cpu0/id"),
+                                    Field(&HostAdapter::GlobEntry::path,
+                                          "/sys/cpu/cpu1/id")));
+  ASSERT_OK(snapshot_->ReadGlob("/sys/cpu/cpu*/id"));
+  EXPECT_EQ(host_->captures.size(), 1);
+}
+
+TEST_F(SnapshotHostAdapterTest, InvalidateRecaptures) {
+  ASSERT_OK(snapshot_->Capture());
+  ASSERT_OK(host_->Write("/sys/cpu/cpu0/id", "changed"));
+  EXPECT_THAT(snapshot_->Read("/sys/cpu/cpu0/id"), IsOkAndHolds("0"));
+
+  snapshot_->Invalidate("/sys/cpu/cpu0/id");
+  EXPECT_THAT(snapshot_->Read("/sys/cpu/cpu0/id"), IsOkAndHolds("changed"));
+  // Only the tree of the invalidated path was captured again.
+  EXPECT_THAT(host_->captures.back(), ElementsAre("/sys/cpu/cpu*/id"));
+
+  snapshot_->Invalidate();
+  ASSERT_OK(snapshot_->Read("/proc/cpuinfo"));
+  EXPECT_THAT(host_->captures.back(),
+              ElementsAre("/sys/cpu/cpu*/id", "/proc/cpuinfo"));
+}
+
+TEST_F(SnapshotHostAdapterTest, WriteInvalidates) {
+  ASSERT_OK(snapshot_->Capture());
+  ASSERT_OK(snapshot_->Write("/proc/cpuinfo", "new"));
+  EXPECT_THAT(snapshot_->Read("/proc/cpuinfo"), IsOkAndHolds("new"));
+}
+
+TEST(SnapshotHostAdapter, RecapturesTreesOlderThanMaxAge) {
+  auto host = std::make_unique<FakeHostAdapter>();
+  FakeHostAdapter* fake = host.get();
+  ASSERT_OK(fake->Write("/sys/counter", "1"));
+  SnapshotHostAdapter snapshot(
+      std::move(host),
+      {{.pattern = "/sys/counter", .max_age = absl::ZeroDuration()}});
+  EXPECT_THAT(snapshot.Read("/sys/counter"), IsOkAndHolds("1"));
+  ASSERT_OK(fake->Write("/sys/counter", "2"));
+  EXPECT_THAT(snapshot.Read("/sys/counter"), IsOkAndHolds("2"));
+}
+
+TEST_F(SnapshotHostAdapterTest, SavesAndLoads) {
+  std::filesystem::path path =
+      std::filesystem::path(::testing::TempDir()) / "host_snapshot.gz";
+  ASSERT_OK(snapshot_->Save(path));
+
+  absl::StatusOr<std::unique_ptr<SnapshotHostAdapter>> loaded =
+      SnapshotHostAdapter::Load(path);
+  ASSERT_OK(loaded);
+  EXPECT_THAT((*loaded)->Read("/sys/cpu/cpu1/id"), IsOkAndHolds("1"));
+  EXPECT_THAT((*loaded)->Read("/proc/cpuinfo"), IsOkAndHolds("cpuinfo"));
+  EXPECT_THAT((*loaded)->ReadGlob("/sys/cpu/*/id"),
+              IsOkAndHolds(SizeIs(2)));
+
+  // There is no host behind a loaded snapshot.
+  EXPECT_THAT((*loaded)->Read("/proc/uptime"),
+              StatusIs(absl::StatusCode::kNotFound));
+  EXPECT_THAT((*loaded)->RunCommand(absl::Seconds(1), {"true"}),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  EXPECT_THAT((*loaded)->Write("/proc/cpuinfo", ""),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
+TEST(SnapshotHostAdapter, LoadRejectsOtherFiles) {
+  EXPECT_THAT(SnapshotHostAdapter::Load("/no/such/snapshot"),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+}  // namespace
+}  // namespace ocpdiag::hwinterface
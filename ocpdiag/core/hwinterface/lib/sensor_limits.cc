@@ -0,0 +1,184 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/lib/sensor_limits.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "google/protobuf/repeated_field.h"
+#include "absl/algorithm/container.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "ocpdiag/core/hwinterface/identifier.pb.h"
+#include "ocpdiag/core/hwinterface/sensor.pb.h"
+#include "ocpdiag/core/hwinterface/service.pb.h"
+#include "ocpdiag/core/results/data_model/input_model.h"
+
+namespace ocpdiag::hwinterface {
+namespace {
+
+constexpr double kInfinity = std::numeric_limits<double>::infinity();
+
+// Returns the bits of the first `n` readings, at most 64, that are below `low`
+// or above `high`.
+uint64_t CrossedWord(const double* reading, const double* low,
+                     const double* high, size_t n) {
+  uint64_t crossed = 0;
+  size_t i = 0;
+  // Two readings per compare. The compares are ordered, so NaN crosses
+  // nothing, as in the scalar loop below.
+#if defined(__SSE2__)
+  for (; i + 2 <= n; i += 2) {
+    const __m128d r = _mm_loadu_pd(reading + i);
+    const __m128d out = _mm_or_pd(_mm_cmplt_pd(r, _mm_loadu_pd(low + i)),
+                                  _mm_cmpgt_pd(r, _mm_loadu_pd(high + i)));
+    crossed |= static_cast<uint64_t>(_mm_movemask_pd(out)) << i;
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  for (; i + 2 <= n; i += 2) {
+    const float64x2_t r = vld1q_f64(reading + i);
+    const uint64x2_t out = vorrq_u64(vcltq_f64(r, vld1q_f64(low + i)),
+                                     vcgtq_f64(r, vld1q_f64(high + i)));
+    crossed |= (vgetq_lane_u64(out, 0) & 1) << i |
+               (vgetq_lane_u64(out, 1) & 1) << (i + 1);
+  }
+#endif
+  for (; i < n; ++i) {
+    crossed |= static_cast<uint64_t>((reading[i] < low[i]) |
+                                     (reading[i] > high[i]))
+               << i;
+  }
+  return crossed;
+}
+
+// Sets the bits of the readings below `lower` or above `upper`.
+void CrossedLimits(absl::Span<const double> readings,
+                   const std::vector<double>& lower,
+                   const std::vector<double>& upper,
+                   std::vector<uint64_t>& bits) {
+  for (size_t word = 0; word < bits.size(); ++word) {
+    const size_t begin = word * 64;
+    bits[word] = CrossedWord(readings.data() + begin, lower.data() + begin,
+                             upper.data() + begin,
+                             std::min<size_t>(64, readings.size() - begin));
+  }
+}
+
+}  // namespace
+
+bool LimitViolations::Any() const {
+  return absl::c_any_of(critical, [](uint64_t word) { return word != 0; }) ||
+         absl::c_any_of(noncritical, [](uint64_t word) { return word != 0; });
+}
+
+SensorLimits::SensorLimits(
+    const google::protobuf::RepeatedPtrField<sensor::Info>& sensors) {
+  ids_.reserve(sensors.size());
+  lower_critical_.reserve(sensors.size());
+  lower_noncritical_.reserve(sensors.size());
+  upper_noncritical_.reserve(sensors.size());
+  upper_critical_.reserve(sensors.size());
+  for (const sensor::Info& sensor : sensors) Add(sensor);
+}
+
+void SensorLimits::Add(const sensor::Info& sensor) {
+  const sensor::Limits& limits = sensor.limits();
+  ids_.push_back(sensor.id());
+  lower_critical_.push_back(limits.has_lower_critical()
+                                ? limits.lower_critical().limit()
+                                : -kInfinity);
+  lower_noncritical_.push_back(limits.has_lower_noncritical()
+                                   ? limits.lower_noncritical().limit()
+                                   : -kInfinity);
+  upper_noncritical_.push_back(limits.has_upper_noncritical()
+                                   ? limits.upper_noncritical().limit()
+                                   : kInfinity);
+  upper_critical_.push_back(limits.has_upper_critical()
+                                ? limits.upper_critical().limit()
+                                : kInfinity);
+}
+
+absl::StatusOr<LimitViolations> SensorLimits::Evaluate(
+    absl::Span<const double> readings) const {
+  if (readings.size() != size()) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Got %d readings for %d sensors", readings.size(),
+                        size()));
+  }
+  const size_t words = (size() + 63) / 64;
+  LimitViolations violations{.size = size(),
+                             .critical = std::vector<uint64_t>(words),
+                             .noncritical = std::vector<uint64_t>(words)};
+  CrossedLimits(readings, lower_critical_, upper_critical_,
+                violations.critical);
+  CrossedLimits(readings, lower_noncritical_, upper_noncritical_,
+                violations.noncritical);
+  return violations;
+}
+
+std::vector<results::Diagnosis> SensorLimits::Diagnose(
+    const LimitViolations& violations,
+    absl::Span<const double> readings) const {
+  std::vector<results::Diagnosis> diagnoses;
+  for (size_t i = 0; i < violations.size && i < readings.size(); ++i) {
+    const bool critical = violations.Critical(i);
+    if (!critical && !violations.Noncritical(i)) continue;
+    const bool lower = critical ? readings[i] < lower_critical_[i]
+                                : readings[i] < lower_noncritical_[i];
+    const double limit = critical ? (lower ? lower_critical_[i]
+                                           : upper_critical_[i])
+                                  : (lower ? lower_noncritical_[i]
+                                           : upper_noncritical_[i]);
+    const absl::string_view severity = critical ? "critical" : "noncritical";
+    diagnoses.push_back(
+        {.verdict = absl::StrFormat("sensor-%s-limit-crossed", severity),
+         .type = results::DiagnosisType::kFail,
+         .message = absl::StrFormat(
+             "Sensor %s reads %g, %s its %s %s limit of %g", ids_[i].id(),
+             readings[i], lower ? "below" : "above",
+             lower ? "lower" : "upper", severity, limit),
+         .subcomponent = results::Subcomponent{
+             .name = ids_[i].name(), .location = ids_[i].devpath()}});
+  }
+  return diagnoses;
+}
+
+std::vector<double> SensorReadings(const GetSensorsResponse& resp) {
+  std::vector<double> readings;
+  readings.reserve(resp.sensors_size());
+  for (const sensor::Info& sensor : resp.sensors()) {
+    readings.push_back(sensor.has_reading()
+                           ? sensor.reading().reading()
+                           : std::numeric_limits<double>::quiet_NaN());
+  }
+  return readings;
+}
+
+std::vector<double> SensorReadings(
+    absl::Span<const absl::StatusOr<double>> samples) {
+  std::vector<double> readings;
+  readings.reserve(samples.size());
+  for (const absl::StatusOr<double>& sample : samples) {
+    readings.push_back(sample.ok() ? *sample
+                                   : std::numeric_limits<double>::quiet_NaN());
+  }
+  return readings;
+}
+
+}  // namespace ocpdiag::hwinterface
@@ -0,0 +1,100 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_HWINTERFACE_LIB_SENSOR_LIMITS_H_
+#define OCPDIAG_CORE_HWINTERFACE_LIB_SENSOR_LIMITS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "google/protobuf/repeated_field.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "ocpdiag/core/hwinterface/identifier.pb.h"
+#include "ocpdiag/core/hwinterface/sensor.pb.h"
+#include "ocpdiag/core/hwinterface/service.pb.h"
+#include "ocpdiag/core/results/data_model/input_model.h"
+
+namespace ocpdiag::hwinterface {
+
+// The sensors whose readings crossed their limits, as bitmaps: sensor i is
+// bit i % 64 of word i / 64. The critical and noncritical limits are reported
+// apart, so a reading beyond both sets both bits.
+struct LimitViolations {
+  size_t size = 0;
+  std::vector<uint64_t> critical;
+  std::vector<uint64_t> noncritical;
+
+  bool Critical(size_t i) const { return critical[i / 64] >> (i % 64) & 1; }
+  bool Noncritical(size_t i) const {
+    return noncritical[i / 64] >> (i % 64) & 1;
+  }
+  // Whether any sensor crossed any limit.
+  bool Any() const;
+};
+
+// SensorLimits evaluates the readings of a fixed set of sensors against their
+// limits, e.g. every sample of a HwmonSampler, or the responses of repeated
+// GetSensors() calls.
+//
+// The limits are laid out as an array per kind of limit, with the missing ones
+// at infinity, so a batch of readings is checked with SIMD compares over
+// contiguous doubles, SSE2 on x86-64 and NEON on AArch64, 64 sensors per
+// bitmap word, instead of walking sensor::Info messages one by one.
+//
+// Example:
+//   SensorLimits limits(resp.sensors());
+//   std::vector<double> readings = SensorReadings(resp);
+//   ASSIGN_OR_RETURN(LimitViolations violations, limits.Evaluate(readings));
+//   for (const results::Diagnosis& diagnosis :
+//        limits.Diagnose(violations, readings)) {
+//     step.AddDiagnosis(diagnosis);
+//   }
+class SensorLimits {
+ public:
+  SensorLimits() = default;
+  explicit SensorLimits(
+      const google::protobuf::RepeatedPtrField<sensor::Info>& sensors);
+
+  // Appends a sensor, which needs its identifier for Diagnose().
+  void Add(const sensor::Info& sensor);
+
+  size_t size() const { return ids_.size(); }
+
+  // Evaluates the readings of the sensors, in the order they were added. A NaN
+  // reading, e.g. of a sensor that couldn't be read, crosses no limit. Fails if
+  // there isn't a reading per sensor.
+  absl::StatusOr<LimitViolations> Evaluate(
+      absl::Span<const double> readings) const;
+
+  // Returns a failing diagnosis per sensor in `violations`, with the
+  // subcomponent named after its identifier, and the reading and the limit it
+  // crossed in the message. `readings` are those that were evaluated.
+  std::vector<results::Diagnosis> Diagnose(
+      const LimitViolations& violations,
+      absl::Span<const double> readings) const;
+
+ private:
+  std::vector<Identifier> ids_;
+  std::vector<double> lower_critical_;
+  std::vector<double> lower_noncritical_;
+  std::vector<double> upper_noncritical_;
+  std::vector<double> upper_critical_;
+};
+
+// Returns the readings of the sensors of `resp`, with NaN for those without a
+// reading.
+std::vector<double> SensorReadings(const GetSensorsResponse& resp);
+
+// Returns the sampled readings, e.g. of HwmonSampler::Sample(), with NaN for
+// those that failed.
+std::vector<double> SensorReadings(
+    absl::Span<const absl::StatusOr<double>> samples);
+
+}  // namespace ocpdiag::hwinterface
+
+#endif  // OCPDIAG_CORE_HWINTERFACE_LIB_SENSOR_LIMITS_H_
@@ -0,0 +1,182 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/hwinterface/lib/sensor_limits.h"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "ocpdiag/core/hwinterface/service.pb.h"
+#include "ocpdiag/core/results/data_model/input_model.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::hwinterface {
+
+namespace {
+
+using ::ocpdiag::testing::StatusIs;
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+GetSensorsResponse Response() {
+  GetSensorsResponse resp;
+  google::protobuf::TextFormat::ParseFromString(R"pb(
+    sensors {
+      id { id: "cpu0" name: "Package id 0" devpath: "/hwmon0/temp1" }
+      reading { reading: 45 }
+      limits {
+        upper_critical { limit: 100 }
+        upper_noncritical { limit: 80 }
+      }
+    }
+    sensors {
+      id { id: "fan1" name: "fan1" devpath: "/hwmon1/fan1" }
+      reading { reading: 1200 }
+      limits { lower_noncritical { limit: 300 } }
+    }
+    sensors {
+      id { id: "vin" name: "in0" devpath: "/hwmon1/in0" }
+      reading { reading: 12 }
+    }
+  )pb", &resp);
+  return resp;
+}
+
+TEST(SensorLimits, NoViolations) {
+  GetSensorsResponse resp = Response();
+  SensorLimits limits(resp.sensors());
+  ASSERT_EQ(limits.size(), 3);
+  absl::StatusOr<LimitViolations> violations =
+      limits.Evaluate(SensorReadings(resp));
+  ASSERT_OK(violations);
+  EXPECT_FALSE(violations->Any());
+  EXPECT_THAT(violations->critical, ElementsAre(0));
+  EXPECT_THAT(violations->noncritical, ElementsAre(0));
+  EXPECT_THAT(limits.Diagnose(*violations, SensorReadings(resp)), IsEmpty());
+}
+
+TEST(SensorLimits, ReportsViolations) {
+  SensorLimits limits(Response().sensors());
+  std::vector<double> readings = {105, 250, 1e6};
+  absl::StatusOr<LimitViolations> violations = limits.Evaluate(readings);
+  ASSERT_OK(violations);
+  EXPECT_TRUE(violations->Any());
+  EXPECT_THAT(violations->critical, ElementsAre(0b001));
+  EXPECT_THAT(violations->noncritical, ElementsAre(0b011));
+
+  std::vector<results::Diagnosis> diagnoses =
+      limits.Diagnose(*violations, readings);
+  ASSERT_EQ(diagnoses.size(), 2);
+  EXPECT_EQ(diagnoses[0].verdict, "sensor-critical-limit-crossed");
+  EXPECT_EQ(diagnoses[0].type, results::DiagnosisType::kFail);
+  EXPECT_EQ(diagnoses[0].message,
+            "Sensor cpu0 reads 105, above its upper critical limit of 100");
+  ASSERT_TRUE(diagnoses[0].subcomponent.has_value());
+  EXPECT_EQ(diagnoses[0].subcomponent->name, "Package id 0");
+  EXPECT_EQ(diagnoses[0].subcomponent->location, "/hwmon0/temp1");
+  EXPECT_EQ(diagnoses[1].verdict, "sensor-noncritical-limit-crossed");
+  EXPECT_EQ(diagnoses[1].message,
+            "Sensor fan1 reads 250, below its lower noncritical limit of 300");
+}
+
+TEST(SensorLimits, SpansBitmapWords) {
+  SensorLimits limits;
+  sensor::Info sensor;
+  sensor.mutable_limits()->mutable_upper_critical()->set_limit(1);
+  for (int i = 0; i < 130; ++i) limits.Add(sensor);
+
+  std::vector<double> readings(130, 0);
+  readings[0] = 2;
+  readings[64] = 2;
+  readings[129] = 2;
+  absl::StatusOr<LimitViolations> violations = limits.Evaluate(readings);
+  ASSERT_OK(violations);
+  EXPECT_EQ(violations->size, 130);
+  EXPECT_THAT(violations->critical, ElementsAre(1, 1, 0b10));
+  EXPECT_TRUE(violations->Critical(129));
+  EXPECT_FALSE(violations->Critical(128));
+}
+
+TEST(SensorLimits, MatchesPerSensorComparison) {
+  // Every count of sensors up to three bitmap words, each reading cycling
+  // through below, between, on and above its limits, NaN and infinities.
+  const std::vector<double> kReadings = {
+      -std::numeric_limits<double>::infinity(),
+      -1,
+      0,
+      1,
+      5,
+      10,
+      11,
+      std::numeric_limits<double>::infinity(),
+      std::numeric_limits<double>::quiet_NaN()};
+  for (int n = 0; n <= 192; ++n) {
+    SensorLimits limits;
+    std::vector<double> readings;
+    for (int i = 0; i < n; ++i) {
+      sensor::Info sensor;
+      if (i % 2 == 0) {
+        sensor.mutable_limits()->mutable_lower_critical()->set_limit(0);
+      }
+      if (i % 3 != 0) {
+        sensor.mutable_limits()->mutable_upper_critical()->set_limit(10);
+      }
+      limits.Add(sensor);
+      readings.push_back(kReadings[(i * 7 + n) % kReadings.size()]);
+    }
+    absl::StatusOr<LimitViolations> violations = limits.Evaluate(readings);
+    ASSERT_OK(violations);
+    for (int i = 0; i < n; ++i) {
+      const bool crossed = (i % 2 == 0 && readings[i] < 0) ||
+                           (i % 3 != 0 && readings[i] > 10);
+      EXPECT_EQ(violations->Critical(i), crossed)
+          << "sensor " << i << " of " << n << " reads " << readings[i];
+      EXPECT_FALSE(violations->Noncritical(i));
+    }
+  }
+}
+
+TEST(SensorLimits, FailedReadingsCrossNothing) {
+  SensorLimits limits(Response().sensors());
+  std::vector<absl::StatusOr<double>> samples = {
+      absl::UnavailableError("no sensor"), 0.0, 12.0};
+  std::vector<double> readings = SensorReadings(samples);
+  EXPECT_TRUE(std::isnan(readings[0]));
+  absl::StatusOr<LimitViolations> violations = limits.Evaluate(readings);
+  ASSERT_OK(violations);
+  EXPECT_THAT(violations->critical, ElementsAre(0));
+  EXPECT_THAT(violations->noncritical, ElementsAre(0b010));
+}
+
+TEST(SensorLimits, MissingReadingsCrossNothing) {
+  GetSensorsResponse resp = Response();
+  // A reading of 0 would cross the lower limit of the fan.
+  resp.mutable_sensors(1)->clear_reading();
+  SensorLimits limits(resp.sensors());
+  std::vector<double> readings = SensorReadings(resp);
+  ASSERT_EQ(readings.size(), 3);
+  EXPECT_EQ(readings[0], 45);
+  EXPECT_TRUE(std::isnan(readings[1]));
+  absl::StatusOr<LimitViolations> violations = limits.Evaluate(readings);
+  ASSERT_OK(violations);
+  EXPECT_FALSE(violations->Any());
+}
+
+TEST(SensorLimits, ReadingsMismatch) {
+  SensorLimits limits(Response().sensors());
+  EXPECT_THAT(limits.Evaluate(std::vector<double>{1, 2}),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+
+}  // namespace ocpdiag::hwinterface
@@ -0,0 +1,81 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/lib/compression/gzip.h"
+
+#include <zlib.h>
+
+#include <string>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/string_view.h"
+
+namespace ocpdiag::compression {
+
+namespace {
+
+// Tells zlib to use the gzip format, with the largest window.
+constexpr int kGzipWindowBits = 16 + 15;
+
+Bytef* ToBytef(const char* data) {
+  return reinterpret_cast<Bytef*>(const_cast<char*>(data));
+}
+
+}  // namespace
+
+absl::StatusOr<std::string> GzipCompress(const absl::Cord& data, int level) {
+  z_stream stream = {};
+  if (deflateInit2(&stream, level, Z_DEFLATED, kGzipWindowBits,
+                   /*memLevel=*/8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    return absl::InternalError("Failed to initialize zlib.");
+  }
+  // The bound is for compressing in one call, so it holds for all the chunks.
+  std::string compressed(deflateBound(&stream, data.size()), '\0');
+  stream.next_out = ToBytef(compressed.data());
+  stream.avail_out = compressed.size();
+  for (absl::string_view chunk : data.Chunks()) {
+    stream.next_in = ToBytef(chunk.data());
+    stream.avail_in = chunk.size();
+    deflate(&stream, Z_NO_FLUSH);
+  }
+  int result = deflate(&stream, Z_FINISH);
+  compressed.resize(stream.total_out);
+  deflateEnd(&stream);
+  if (result != Z_STREAM_END) {
+    return absl::InternalError("Failed to compress the data.");
+  }
+  return compressed;
+}
+
+absl::StatusOr<absl::Cord> GzipDecompress(absl::string_view compressed) {
+  z_stream stream = {};
+  if (inflateInit2(&stream, kGzipWindowBits) != Z_OK) {
+    return absl::InternalError("Failed to initialize zlib.");
+  }
+  stream.next_in = ToBytef(compressed.data());
+  stream.avail_in = compressed.size();
+  absl::Cord data;
+  int result = Z_OK;
+  while (result == Z_OK) {
+    std::string buffer(1 << 16, '\0');
+    stream.next_out = ToBytef(buffer.data());
+    stream.avail_out = buffer.size();
+    result = inflate(&stream, Z_NO_FLUSH);
+    buffer.resize(buffer.size() - stream.avail_out);
+    data.Append(std::move(buffer));
+  }
+  inflateEnd(&stream);
+  // inflate() checks the CRC and the size recorded by gzip.
+  if (result != Z_STREAM_END) {
+    return absl::DataLossError("Failed to decompress the data.");
+  }
+  return data;
+}
+
+}  // namespace ocpdiag::compression
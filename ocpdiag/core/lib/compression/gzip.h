@@ -0,0 +1,30 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_LIB_COMPRESSION_GZIP_H_
+#define OCPDIAG_CORE_LIB_COMPRESSION_GZIP_H_
+
+#include <string>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/string_view.h"
+
+namespace ocpdiag::compression {
+
+// Compresses `data` in the gzip format, so that it can be decompressed with
+// the gzip tool, e.g. on a remote machine. Level 1 is the fastest; data sent
+// to or from a machine node is usually compressed once and read once.
+absl::StatusOr<std::string> GzipCompress(const absl::Cord& data,
+                                         int level = 1);
+
+// Decompresses data in the gzip format. Returns a DataLoss error if the data
+// is truncated or doesn't match the CRC recorded by gzip.
+absl::StatusOr<absl::Cord> GzipDecompress(absl::string_view compressed);
+
+}  // namespace ocpdiag::compression
+
+#endif  // OCPDIAG_CORE_LIB_COMPRESSION_GZIP_H_
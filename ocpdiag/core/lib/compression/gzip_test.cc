@@ -0,0 +1,85 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/lib/compression/gzip.h"
+
+#include <string>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/str_cat.h"
+#include "ocpdiag/core/lib/subprocess/subprocess.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::compression {
+namespace {
+
+using ::ocpdiag::testing::StatusIs;
+
+std::string TestData() {
+  std::string data;
+  for (int i = 0; i < 100000; ++i) absl::StrAppend(&data, "line ", i, "\n");
+  return data;
+}
+
+TEST(GzipTest, RoundTrips) {
+  std::string data = TestData();
+  absl::StatusOr<std::string> compressed = GzipCompress(absl::Cord(data));
+  ASSERT_OK(compressed);
+  EXPECT_LT(compressed->size(), data.size() / 2);
+  absl::StatusOr<absl::Cord> decompressed = GzipDecompress(*compressed);
+  ASSERT_OK(decompressed);
+  EXPECT_EQ(std::string(*decompressed), data);
+}
+
+TEST(GzipTest, RoundTripsEmptyData) {
+  absl::StatusOr<std::string> compressed = GzipCompress(absl::Cord());
+  ASSERT_OK(compressed);
+  absl::StatusOr<absl::Cord> decompressed = GzipDecompress(*compressed);
+  ASSERT_OK(decompressed);
+  EXPECT_TRUE(decompressed->empty());
+}
+
+TEST(GzipTest, CompatibleWithGzipTool) {
+  std::string data = TestData();
+  absl::StatusOr<std::string> compressed = GzipCompress(absl::Cord(data));
+  ASSERT_OK(compressed);
+  absl::StatusOr<subprocess::Result> gunzip = subprocess::RunCommand(
+      {.args = {"gzip", "-d", "-c"}, .stdin_data = *compressed});
+  ASSERT_OK(gunzip);
+  EXPECT_EQ(gunzip->stdout, data);
+
+  absl::StatusOr<subprocess::Result> gzip = subprocess::RunCommand(
+      {.args = {"gzip", "-1", "-c"}, .stdin_data = data});
+  ASSERT_OK(gzip);
+  absl::StatusOr<absl::Cord> decompressed = GzipDecompress(gzip->stdout);
+  ASSERT_OK(decompressed);
+  EXPECT_EQ(std::string(*decompressed), data);
+}
+
+TEST(GzipTest, DetectsTruncatedData) {
+  absl::StatusOr<std::string> compressed =
+      GzipCompress(absl::Cord(TestData()));
+  ASSERT_OK(compressed);
+  compressed->resize(compressed->size() - 4);
+  EXPECT_THAT(GzipDecompress(*compressed),
+              StatusIs(absl::StatusCode::kDataLoss));
+}
+
+TEST(GzipTest, DetectsCorruptedData) {
+  absl::StatusOr<std::string> compressed = GzipCompress(absl::Cord("data"));
+  ASSERT_OK(compressed);
+  // Flip a bit of the CRC in the trailer.
+  (*compressed)[compressed->size() - 8] ^= 1;
+  EXPECT_THAT(GzipDecompress(*compressed),
+              StatusIs(absl::StatusCode::kDataLoss));
+}
+
+}  // namespace
+}  // namespace ocpdiag::compression
@@ -0,0 +1,349 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/lib/off_dut_machine_interface/agent/agent_conn.h"
+
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>  //
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "ocpdiag/core/compat/status_macros.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/agent/agent.pb.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/agent/agent_server.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/agent/protocol.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/remote.h"
+
+namespace ocpdiag::hwinterface::remote {
+
+namespace {
+
+constexpr absl::Duration kRWTimeout = absl::Minutes(15);
+// Extra time given to a command's response, on top of its own timeout which
+// the agent enforces.
+constexpr absl::Duration kCommandResponseGrace = absl::Seconds(30);
+// How long Shutdown() waits for the agent to exit before killing it.
+constexpr absl::Duration kShutdownTimeout = absl::Seconds(10);
+
+absl::StatusOr<std::pair<int, int>> MakeSocketPair() {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+    return absl::InternalError(absl::StrCat(
+        "Failed to create the agent socket pair: ", strerror(errno)));
+  }
+  return std::make_pair(fds[0], fds[1]);
+}
+
+int OpenPidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+  return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+absl::Status ResponseStatus(const agent::Response& response) {
+  return absl::Status(static_cast<absl::StatusCode>(response.status_code()),
+                      response.status_message());
+}
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<CommandTransport>> CommandTransport::Create(
+    const std::vector<std::string>& args) {
+  if (args.empty())
+    return absl::InvalidArgumentError("Agent command must not be empty");
+  std::vector<char*> argv;
+  for (const std::string& arg : args)
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  argv.push_back(nullptr);
+
+  ASSIGN_OR_RETURN(auto fds, MakeSocketPair());
+  auto [parent_fd, child_fd] = fds;
+  pid_t pid = fork();
+  if (pid == 0) {
+    // dup2() clears close-on-exec on the duplicates.
+    dup2(child_fd, STDIN_FILENO);
+    dup2(child_fd, STDOUT_FILENO);
+    execvp(argv[0], argv.data());
+    _exit(127);
+  }
+  int fork_errno = errno;
+  close(child_fd);
+  if (pid < 0) {
+    close(parent_fd);
+    return absl::InternalError(absl::StrCat("Failed to start the agent: ",
+                                            strerror(fork_errno)));
+  }
+  return absl::WrapUnique(new CommandTransport(pid, parent_fd, parent_fd));
+}
+
+void CommandTransport::Shutdown() {
+  if (pid_ < 0) return;
+  // The agent exits once its input is closed.
+  shutdown(write_fd_, SHUT_WR);
+  // Without pidfds, trust the agent to exit, and just wait for it.
+  int pidfd = OpenPidfd(pid_);
+  if (pidfd >= 0) {
+    pollfd exited{.fd = pidfd, .events = POLLIN};
+    int ready;
+    do {
+      ready = poll(&exited, 1, absl::ToInt64Milliseconds(kShutdownTimeout));
+    } while (ready < 0 && errno == EINTR);
+    if (ready == 0) kill(pid_, SIGKILL);
+    close(pidfd);
+  }
+  int status;
+  while (waitpid(pid_, &status, 0) < 0 && errno == EINTR) {
+  }
+  pid_ = -1;
+}
+
+CommandTransport::~CommandTransport() {
+  Shutdown();
+  close(write_fd_);
+}
+
+absl::StatusOr<std::unique_ptr<LoopbackTransport>> LoopbackTransport::Create(
+    int max_running_commands) {
+  ASSIGN_OR_RETURN(auto fds, MakeSocketPair());
+  return absl::WrapUnique(
+      new LoopbackTransport(fds.first, fds.second, max_running_commands));
+}
+
+LoopbackTransport::LoopbackTransport(int client_fd, int server_fd,
+                                     int max_running_commands)
+    : client_fd_(client_fd), server_fd_(server_fd) {
+  server_thread_ = std::thread([this, max_running_commands] {
+    agent::AgentServer(server_fd_, server_fd_, max_running_commands)
+        .Serve()
+        .IgnoreError();
+    // Let the client see the end of the response stream.
+    shutdown(server_fd_, SHUT_WR);
+  });
+}
+
+void LoopbackTransport::Shutdown() {
+  if (!server_thread_.joinable()) return;
+  shutdown(client_fd_, SHUT_WR);
+  server_thread_.join();
+}
+
+LoopbackTransport::~LoopbackTransport() {
+  Shutdown();
+  close(client_fd_);
+  close(server_fd_);
+}
+
+bool AgentConnInterface::FileStat::is_directory() const {
+  return S_ISDIR(mode);
+}
+
+AgentConnInterface::AgentConnInterface(
+    std::unique_ptr<AgentTransport> transport)
+    : transport_(std::move(transport)),
+      reader_thread_(&AgentConnInterface::ReadResponses, this) {}
+
+AgentConnInterface::~AgentConnInterface() {
+  transport_->Shutdown();
+  reader_thread_.join();
+}
+
+void AgentConnInterface::ReadResponses() {
+  while (true) {
+    agent::Response response;
+    absl::Status status = agent::ReadFrame(transport_->read_fd(), response);
+    if (!status.ok()) {
+      if (absl::IsOutOfRange(status)) {
+        status = absl::UnavailableError("The remote agent closed the stream");
+      }
+      absl::MutexLock lock(&mutex_);
+      stream_status_ = status;
+      for (auto& [id, call] : pending_) {
+        call->response.set_status_code(static_cast<int>(status.code()));
+        call->response.set_status_message(std::string(status.message()));
+        call->done.Notify();
+      }
+      pending_.clear();
+      return;
+    }
+
+    std::shared_ptr<PendingCall> call;
+    {
+      absl::MutexLock lock(&mutex_);
+      auto it = pending_.find(response.request_id());
+      // The caller may have timed out and stopped waiting.
+      if (it == pending_.end()) continue;
+      call = std::move(it->second);
+      pending_.erase(it);
+    }
+    call->response = std::move(response);
+    call->done.Notify();
+  }
+}
+
+absl::StatusOr<std::shared_ptr<AgentConnInterface::PendingCall>>
+AgentConnInterface::Send(agent::Request request) {
+  auto call = std::make_shared<PendingCall>();
+  {
+    absl::MutexLock lock(&mutex_);
+    RETURN_IF_ERROR(stream_status_);
+    call->request_id = next_request_id_++;
+    request.set_request_id(call->request_id);
+    pending_[call->request_id] = call;
+  }
+
+  absl::Status status;
+  {
+    absl::MutexLock lock(&write_mutex_);
+    status = agent::WriteFrame(transport_->write_fd(), request);
+  }
+  if (!status.ok()) {
+    absl::MutexLock lock(&mutex_);
+    pending_.erase(call->request_id);
+    return absl::UnavailableError(absl::StrCat(
+        "Failed to send a request to the remote agent: ", status.message()));
+  }
+  return call;
+}
+
+absl::StatusOr<agent::Response> AgentConnInterface::Wait(
+    PendingCall& call, absl::Duration timeout) {
+  if (!call.done.WaitForNotificationWithTimeout(timeout)) {
+    absl::MutexLock lock(&mutex_);
+    // The response may have arrived just after the timeout.
+    if (pending_.erase(call.request_id) > 0) {
+      return absl::DeadlineExceededError(
+          absl::StrCat("No response from the remote agent within ",
+                       absl::FormatDuration(timeout)));
+    }
+  }
+  call.done.WaitForNotification();
+  RETURN_IF_ERROR(ResponseStatus(call.response));
+  return std::move(call.response);
+}
+
+absl::StatusOr<agent::Response> AgentConnInterface::Call(
+    agent::Request request, absl::Duration timeout) {
+  ASSIGN_OR_RETURN(std::shared_ptr<PendingCall> call,
+                   Send(std::move(request)));
+  return Wait(*call, timeout);
+}
+
+absl::StatusOr<absl::Cord> AgentConnInterface::ReadFile(
+    absl::string_view file_name) {
+  agent::Request request;
+  request.mutable_read_file()->set_path(std::string(file_name));
+  ASSIGN_OR_RETURN(agent::Response response,
+                   Call(std::move(request), kRWTimeout));
+  return absl::Cord(
+      std::move(*response.mutable_read_file()->mutable_content()));
+}
+
+std::vector<absl::StatusOr<absl::Cord>> AgentConnInterface::ReadFiles(
+    absl::Span<const std::string> file_names) {
+  std::vector<absl::StatusOr<std::shared_ptr<PendingCall>>> calls;
+  calls.reserve(file_names.size());
+  for (const std::string& file_name : file_names) {
+    agent::Request request;
+    request.mutable_read_file()->set_path(file_name);
+    calls.push_back(Send(std::move(request)));
+  }
+
+  std::vector<absl::StatusOr<absl::Cord>> contents;
+  contents.reserve(calls.size());
+  for (absl::StatusOr<std::shared_ptr<PendingCall>>& call : calls) {
+    if (!call.ok()) {
+      contents.push_back(call.status());
+      continue;
+    }
+    absl::StatusOr<agent::Response> response = Wait(**call, kRWTimeout);
+    if (!response.ok()) {
+      contents.push_back(response.status());
+      continue;
+    }
+    contents.push_back(absl::Cord(
+        std::move(*response->mutable_read_file()->mutable_content())));
+  }
+  return contents;
+}
+
+absl::Status AgentConnInterface::WriteFile(absl::string_view file_name,
+                                           absl::string_view data) {
+  agent::Request request;
+  request.mutable_write_file()->set_path(std::string(file_name));
+  request.mutable_write_file()->set_data(std::string(data));
+  return Call(std::move(request), kRWTimeout).status();
+}
+
+absl::StatusOr<ConnInterface::CommandResult> AgentConnInterface::RunCommand(
+    absl::Duration timeout, const std::vector<std::string>& args,
+    const ConnInterface::CommandOption& options) {
+  if (!options.stdout_file.empty() || !options.stderr_file.empty()) {
+    return absl::UnimplementedError(
+        "Stdout/stderr redirection is requested but not yet implemented.");
+  }
+
+  agent::Request request;
+  agent::RunCommandRequest& command = *request.mutable_run_command();
+  command.mutable_args()->Add(args.begin(), args.end());
+  if (timeout != absl::InfiniteDuration())
+    command.set_timeout_ms(absl::ToInt64Milliseconds(timeout));
+  ASSIGN_OR_RETURN(agent::Response response,
+                   Call(std::move(request), timeout + kCommandResponseGrace));
+
+  agent::RunCommandResponse& result = *response.mutable_run_command();
+  return CommandResult{.exit_code = result.exit_code(),
+                       .stdout = std::move(*result.mutable_stdout()),
+                       .stderr = std::move(*result.mutable_stderr())};
+}
+
+absl::StatusOr<AgentConnInterface::FileStat> AgentConnInterface::Stat(
+    absl::string_view file_name) {
+  agent::Request request;
+  request.mutable_stat()->set_path(std::string(file_name));
+  ASSIGN_OR_RETURN(agent::Response response,
+                   Call(std::move(request), kRWTimeout));
+  return FileStat{.size = response.stat().size(),
+                  .mode = response.stat().mode(),
+                  .modification_time = absl::FromUnixNanos(
+                      response.stat().modification_time_ns())};
+}
+
+absl::StatusOr<std::vector<std::string>> AgentConnInterface::ListDirectory(
+    absl::string_view directory) {
+  agent::Request request;
+  request.mutable_list_directory()->set_path(std::string(directory));
+  ASSIGN_OR_RETURN(agent::Response response,
+                   Call(std::move(request), kRWTimeout));
+  return std::vector<std::string>(response.list_directory().names().begin(),
+                                  response.list_directory().names().end());
+}
+
+}  // namespace ocpdiag::hwinterface::remote
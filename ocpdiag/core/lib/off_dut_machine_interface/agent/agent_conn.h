@@ -0,0 +1,171 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_LIB_OFF_DUT_MACHINE_INTERFACE_AGENT_AGENT_CONN_H_
+#define OCPDIAG_CORE_LIB_OFF_DUT_MACHINE_INTERFACE_AGENT_AGENT_CONN_H_
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>  //
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/agent/agent.pb.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/agent/agent_server.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/remote.h"
+
+namespace ocpdiag::hwinterface::remote {
+
+// A bidirectional byte stream to a running remote agent.
+class AgentTransport {
+ public:
+  virtual ~AgentTransport() = default;
+
+  // The fd that requests are written to.
+  virtual int write_fd() const = 0;
+  // The fd that responses are read from.
+  virtual int read_fd() const = 0;
+
+  // Closes the request stream, which makes the agent exit once its pending
+  // requests are answered, and waits for it to do so. The response stream
+  // stays open until the transport is destroyed.
+  virtual void Shutdown() = 0;
+};
+
+// Runs the agent as a local child process and talks to it over its stdin and
+// stdout. To reach a machine node, `args` runs the agent binary through ssh,
+// so that a single ssh session carries every request.
+class CommandTransport final : public AgentTransport {
+ public:
+  static absl::StatusOr<std::unique_ptr<CommandTransport>> Create(
+      const std::vector<std::string>& args);
+  ~CommandTransport() override;
+
+  int write_fd() const override { return write_fd_; }
+  int read_fd() const override { return read_fd_; }
+  void Shutdown() override;
+
+ private:
+  CommandTransport(pid_t pid, int write_fd, int read_fd)
+      : pid_(pid), write_fd_(write_fd), read_fd_(read_fd) {}
+
+  pid_t pid_;
+  int write_fd_;
+  int read_fd_;
+};
+
+// Serves requests with an agent::AgentServer running on a thread of this
+// process. The protocol can be exercised without a machine node, with the
+// local machine standing in for it.
+class LoopbackTransport final : public AgentTransport {
+ public:
+  static absl::StatusOr<std::unique_ptr<LoopbackTransport>> Create(
+      int max_running_commands =
+          agent::AgentServer::kDefaultMaxRunningCommands);
+  ~LoopbackTransport() override;
+
+  int write_fd() const override { return client_fd_; }
+  int read_fd() const override { return client_fd_; }
+  void Shutdown() override;
+
+ private:
+  LoopbackTransport(int client_fd, int server_fd, int max_running_commands);
+
+  int client_fd_;
+  int server_fd_;
+  std::thread server_thread_;
+};
+
+// AgentConnInterface implements ConnInterface defined in
+// ocpdiag/core/lib/off_dut_machine_interface/remote.h by sending requests to a
+// long-lived agent over a transport, rather than starting a new connection for
+// each operation. Requests from any number of threads are pipelined over the
+// transport and matched to their responses by request ID.
+class AgentConnInterface : public ConnInterface {
+ public:
+  // Metadata of a file on the machine node.
+  struct FileStat {
+    int64_t size = 0;
+    // The st_mode field of stat(2).
+    uint32_t mode = 0;
+    absl::Time modification_time;
+
+    bool is_directory() const;
+  };
+
+  explicit AgentConnInterface(std::unique_ptr<AgentTransport> transport);
+  ~AgentConnInterface() override;
+
+  // ReadFile reads the given file.
+  absl::StatusOr<absl::Cord> ReadFile(absl::string_view file_name) override;
+
+  // WriteFile writes data to the given file.
+  absl::Status WriteFile(absl::string_view file_name,
+                         absl::string_view data) override;
+
+  // RunCommand runs the specified command on the given machine node.
+  absl::StatusOr<CommandResult> RunCommand(
+      absl::Duration timeout, const std::vector<std::string>& args,
+      const CommandOption& options) override;
+
+  // Returns the metadata of the given file.
+  absl::StatusOr<FileStat> Stat(absl::string_view file_name);
+
+  // Returns the sorted names of the entries in the given directory, excluding
+  // "." and "..".
+  absl::StatusOr<std::vector<std::string>> ListDirectory(
+      absl::string_view directory);
+
+  // Reads all the given files, returning one result per file. Every request is
+  // sent before waiting for the first response, so the whole batch costs about
+  // one round trip.
+  std::vector<absl::StatusOr<absl::Cord>> ReadFiles(
+      absl::Span<const std::string> file_names);
+
+ private:
+  // A request waiting for its response.
+  struct PendingCall {
+    uint64_t request_id = 0;
+    absl::Notification done;
+    agent::Response response;
+  };
+
+  // Sends `request` under a new request ID.
+  absl::StatusOr<std::shared_ptr<PendingCall>> Send(agent::Request request);
+  // Waits for the response to a sent request, returning its status.
+  absl::StatusOr<agent::Response> Wait(PendingCall& call,
+                                       absl::Duration timeout);
+  absl::StatusOr<agent::Response> Call(agent::Request request,
+                                       absl::Duration timeout);
+  // Runs on reader_thread_, dispatching responses until the stream ends.
+  void ReadResponses();
+
+  std::unique_ptr<AgentTransport> transport_;
+  absl::Mutex write_mutex_;
+  absl::Mutex mutex_;
+  uint64_t next_request_id_ ABSL_GUARDED_BY(mutex_) = 1;
+  absl::flat_hash_map<uint64_t, std::shared_ptr<PendingCall>> pending_
+      ABSL_GUARDED_BY(mutex_);
+  // Set once the response stream fails; every later call fails with it.
+  absl::Status stream_status_ ABSL_GUARDED_BY(mutex_);
+  std::thread reader_thread_;
+};
+
+}  // namespace ocpdiag::hwinterface::remote
+
+#endif  // OCPDIAG_CORE_LIB_OFF_DUT_MACHINE_INTERFACE_AGENT_AGENT_CONN_H_
@@ -0,0 +1,247 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/lib/off_dut_machine_interface/agent/agent_conn.h"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>  //
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/remote.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::hwinterface::remote {
+namespace {
+
+using ::ocpdiag::testing::IsOkAndHolds;
+using ::ocpdiag::testing::StatusIs;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+
+class AgentConnTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = std::filesystem::temp_directory_path() /
+           absl::StrCat("agent_conn_test_", getpid(), "_",
+                        ::testing::UnitTest::GetInstance()
+                            ->current_test_info()
+                            ->name());
+    std::filesystem::remove_all(dir_);
+    std::filesystem::create_directories(dir_);
+
+    ASSERT_OK_AND_ASSIGN(std::unique_ptr<LoopbackTransport> transport,
+                         LoopbackTransport::Create());
+    conn_ = std::make_unique<AgentConnInterface>(std::move(transport));
+  }
+
+  void TearDown() override { std::filesystem::remove_all(dir_); }
+
+  std::string Path(const std::string& name) { return dir_ / name; }
+
+  std::filesystem::path dir_;
+  std::unique_ptr<AgentConnInterface> conn_;
+};
+
+TEST_F(AgentConnTest, WriteThenReadFile) {
+  const std::string content("binary\0content\n", 15);
+  ASSERT_OK(conn_->WriteFile(Path("file"), content));
+  EXPECT_THAT(conn_->ReadFile(Path("file")), IsOkAndHolds(absl::Cord(content)));
+}
+
+TEST_F(AgentConnTest, ReadMissingFileIsNotFound) {
+  EXPECT_THAT(conn_->ReadFile(Path("missing")),
+              StatusIs(absl::StatusCode::kNotFound, HasSubstr("missing")));
+}
+
+TEST_F(AgentConnTest, RunCommand) {
+  absl::StatusOr<ConnInterface::CommandResult> result = conn_->RunCommand(
+      absl::Minutes(1), {"echo out; echo err >&2; exit 3"},
+      ConnInterface::CommandOption());
+  ASSERT_OK(result);
+  EXPECT_EQ(result->exit_code, 3);
+  EXPECT_EQ(result->stdout, "out\n");
+  EXPECT_EQ(result->stderr, "err\n");
+}
+
+TEST_F(AgentConnTest, RunCommandJoinsArgsIntoShellCommandLine) {
+  absl::StatusOr<ConnInterface::CommandResult> result = conn_->RunCommand(
+      absl::Minutes(1), {"echo", "a   b", "|", "tr", "ab", "AB"},
+      ConnInterface::CommandOption());
+  ASSERT_OK(result);
+  EXPECT_EQ(result->exit_code, 0);
+  EXPECT_EQ(result->stdout, "A B\n");
+}
+
+TEST_F(AgentConnTest, RunCommandRunsScriptWithPipes) {
+  // As HostAdapter sends file dumps: a script whose output is compressed.
+  absl::StatusOr<ConnInterface::CommandResult> result = conn_->RunCommand(
+      absl::Minutes(1),
+      {"{ (printf 'sysfs\\n' && echo ok >&2) || kill $$; } | gzip -1 -c | "
+       "gzip -d -c"},
+      ConnInterface::CommandOption());
+  ASSERT_OK(result);
+  EXPECT_EQ(result->exit_code, 0);
+  EXPECT_EQ(result->stdout, "sysfs\n");
+  EXPECT_EQ(result->stderr, "ok\n");
+}
+
+TEST_F(AgentConnTest, RunCommandNotFound) {
+  absl::StatusOr<ConnInterface::CommandResult> result =
+      conn_->RunCommand(absl::Minutes(1), {"no-such-command"},
+                        ConnInterface::CommandOption());
+  ASSERT_OK(result);
+  EXPECT_EQ(result->exit_code, 127);
+}
+
+TEST_F(AgentConnTest, RunCommandTimeout) {
+  EXPECT_THAT(conn_->RunCommand(absl::Milliseconds(200), {"sleep", "10"},
+                                ConnInterface::CommandOption()),
+              StatusIs(absl::StatusCode::kDeadlineExceeded));
+}
+
+TEST_F(AgentConnTest, RunCommandRedirectionIsUnimplemented) {
+  EXPECT_THAT(conn_->RunCommand(absl::Minutes(1), {"true"},
+                                {.stdout_file = Path("out")}),
+              StatusIs(absl::StatusCode::kUnimplemented));
+}
+
+TEST_F(AgentConnTest, StatAndListDirectory) {
+  ASSERT_OK(conn_->WriteFile(Path("b"), "12345"));
+  ASSERT_OK(conn_->WriteFile(Path("a"), ""));
+  std::filesystem::create_directory(dir_ / "subdir");
+
+  ASSERT_OK_AND_ASSIGN(AgentConnInterface::FileStat file_stat,
+                       conn_->Stat(Path("b")));
+  EXPECT_EQ(file_stat.size, 5);
+  EXPECT_FALSE(file_stat.is_directory());
+  EXPECT_LT(absl::Now() - file_stat.modification_time, absl::Minutes(1));
+
+  ASSERT_OK_AND_ASSIGN(file_stat, conn_->Stat(Path("subdir")));
+  EXPECT_TRUE(file_stat.is_directory());
+
+  EXPECT_THAT(conn_->ListDirectory(dir_.string()),
+              IsOkAndHolds(ElementsAre("a", "b", "subdir")));
+  EXPECT_THAT(conn_->Stat(Path("missing")),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST_F(AgentConnTest, ReadFilesIsPipelined) {
+  std::vector<std::string> paths;
+  for (int i = 0; i < 100; ++i) {
+    paths.push_back(Path(absl::StrCat("file", i)));
+    if (i != 50) std::ofstream(paths.back()) << i;
+  }
+
+  std::vector<absl::StatusOr<absl::Cord>> contents = conn_->ReadFiles(paths);
+  ASSERT_EQ(contents.size(), paths.size());
+  for (int i = 0; i < 100; ++i) {
+    if (i == 50) {
+      EXPECT_THAT(contents[i], StatusIs(absl::StatusCode::kNotFound));
+    } else {
+      EXPECT_THAT(contents[i], IsOkAndHolds(absl::Cord(absl::StrCat(i))));
+    }
+  }
+}
+
+TEST_F(AgentConnTest, ConcurrentCallsGetTheirOwnResponses) {
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([this, t] {
+      std::string path = Path(absl::StrCat("thread", t));
+      for (int i = 0; i < 20; ++i) {
+        std::string content = absl::StrCat(t, ":", i);
+        ASSERT_OK(conn_->WriteFile(path, content));
+        EXPECT_THAT(conn_->ReadFile(path), IsOkAndHolds(absl::Cord(content)));
+      }
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+}
+
+TEST_F(AgentConnTest, LongCommandDoesNotBlockOtherRequests) {
+  ASSERT_OK(conn_->WriteFile(Path("file"), "content"));
+  absl::Notification command_done;
+  std::thread command([&] {
+    EXPECT_OK(conn_->RunCommand(absl::Minutes(1), {"sleep", "2"},
+                                ConnInterface::CommandOption()));
+    command_done.Notify();
+  });
+
+  // Give the command request a head start on the read.
+  absl::SleepFor(absl::Milliseconds(100));
+  EXPECT_THAT(conn_->ReadFile(Path("file")),
+              IsOkAndHolds(absl::Cord("content")));
+  EXPECT_FALSE(command_done.HasBeenNotified());
+  command.join();
+}
+
+TEST(LoopbackTransportTest, RunningCommandsAreBounded) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<LoopbackTransport> transport,
+                       LoopbackTransport::Create(/*max_running_commands=*/2));
+  AgentConnInterface conn(std::move(transport));
+
+  // Four commands, two at a time, take two rounds.
+  absl::Time start = absl::Now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&conn] {
+      EXPECT_OK(conn.RunCommand(absl::Minutes(1), {"sleep", "0.5"},
+                                ConnInterface::CommandOption()));
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  EXPECT_GE(absl::Now() - start, absl::Seconds(1));
+}
+
+TEST(LoopbackTransportTest, ManyCommandsAllComplete) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<LoopbackTransport> transport,
+                       LoopbackTransport::Create(/*max_running_commands=*/2));
+  AgentConnInterface conn(std::move(transport));
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&conn, t] {
+      for (int i = 0; i < 10; ++i) {
+        std::string output = absl::StrCat(t, ":", i);
+        absl::StatusOr<ConnInterface::CommandResult> result = conn.RunCommand(
+            absl::Minutes(1), {"echo", "-n", output},
+            ConnInterface::CommandOption());
+        ASSERT_OK(result);
+        EXPECT_EQ(result->stdout, output);
+      }
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+}
+
+TEST(CommandTransportTest, AgentExitFailsCalls) {
+  ASSERT_OK_AND_ASSIGN(std::unique_ptr<CommandTransport> transport,
+                       CommandTransport::Create({"true"}));
+  AgentConnInterface conn(std::move(transport));
+
+  EXPECT_THAT(conn.ReadFile("/etc/hostname"),
+              StatusIs(absl::StatusCode::kUnavailable));
+}
+
+TEST(CommandTransportTest, EmptyCommandIsRejected) {
+  EXPECT_THAT(CommandTransport::Create({}),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace ocpdiag::hwinterface::remote
@@ -0,0 +1,29 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+// The remote agent. Install it on the machine node and select it with
+// --mi_connection_type=ssh_agent: it serves requests read from stdin and
+// writes the responses to stdout until stdin is closed.
+
+#include <unistd.h>
+
+#include <cstdlib>
+#include <iostream>
+
+#include "absl/status/status.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/agent/agent_server.h"
+
+int main(int argc, char* argv[]) {
+  absl::Status status =
+      ocpdiag::hwinterface::remote::agent::AgentServer(STDIN_FILENO,
+                                                       STDOUT_FILENO)
+          .Serve();
+  if (!status.ok()) {
+    std::cerr << "Remote agent failed: " << status << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,261 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/lib/off_dut_machine_interface/agent/agent_server.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <deque>
+#include <string>
+#include <thread>  //
+#include <utility>
+#include <vector>
+
+#include "absl/cleanup/cleanup.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/compat/status_macros.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/agent/agent.pb.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/agent/protocol.h"
+#include "ocpdiag/core/lib/subprocess/subprocess.h"
+
+namespace ocpdiag::hwinterface::remote::agent {
+
+namespace {
+
+constexpr size_t kReadChunkSize = 64 * 1024;
+
+absl::Status ErrnoError(absl::string_view message, absl::string_view path) {
+  return absl::Status(absl::ErrnoToStatusCode(errno),
+                      absl::StrCat(message, " ", path, ": ", strerror(errno)));
+}
+
+absl::StatusOr<std::string> ReadLocalFile(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return ErrnoError("Failed to open", path);
+  absl::Cleanup close_fd = [fd] { close(fd); };
+
+  // Files under sysfs and procfs report a size unrelated to their content, so
+  // read until the end of the file.
+  std::string content;
+  char buffer[kReadChunkSize];
+  while (true) {
+    ssize_t got = read(fd, buffer, sizeof(buffer));
+    if (got < 0) {
+      if (errno == EINTR) continue;
+      return ErrnoError("Failed to read", path);
+    }
+    if (got == 0) break;
+    content.append(buffer, got);
+  }
+  return content;
+}
+
+absl::Status WriteLocalFile(const std::string& path, absl::string_view data) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) return ErrnoError("Failed to open", path);
+  absl::Cleanup close_fd = [fd] { close(fd); };
+
+  while (!data.empty()) {
+    ssize_t written = write(fd, data.data(), data.size());
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return ErrnoError("Failed to write", path);
+    }
+    data.remove_prefix(written);
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<StatResponse> StatLocalFile(const std::string& path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) return ErrnoError("Failed to stat", path);
+  StatResponse response;
+  response.set_size(st.st_size);
+  response.set_mode(st.st_mode);
+  response.set_modification_time_ns(absl::ToUnixNanos(
+      absl::TimeFromTimespec(st.st_mtim)));
+  return response;
+}
+
+absl::StatusOr<ListDirectoryResponse> ListLocalDirectory(
+    const std::string& path) {
+  DIR* dir = opendir(path.c_str());
+  if (dir == nullptr) return ErrnoError("Failed to open directory", path);
+  absl::Cleanup close_dir = [dir] { closedir(dir); };
+
+  std::vector<std::string> names;
+  while (struct dirent* entry = readdir(dir)) {
+    absl::string_view name = entry->d_name;
+    if (name != "." && name != "..") names.push_back(std::string(name));
+  }
+  std::sort(names.begin(), names.end());
+
+  ListDirectoryResponse response;
+  for (std::string& name : names) response.add_names(std::move(name));
+  return response;
+}
+
+void SetStatus(const absl::Status& status, Response& response) {
+  response.set_status_code(static_cast<int>(status.code()));
+  response.set_status_message(std::string(status.message()));
+}
+
+}  // namespace
+
+absl::StatusOr<RunCommandResponse> RunLocalCommand(
+    const std::vector<std::string>& args, absl::Duration timeout) {
+  if (args.empty()) return absl::InvalidArgumentError("Empty command");
+  // Like sshd, which hands the command line to the login shell.
+  ASSIGN_OR_RETURN(subprocess::Result result,
+                   subprocess::RunCommand(
+                       {.args = {"/bin/sh", "-c", absl::StrJoin(args, " ")},
+                        .timeout = timeout}));
+
+  RunCommandResponse response;
+  // Exit code is negative when subprocess is terminated by signal.
+  response.set_exit_code(result.term_signal != 0 ? -result.term_signal
+                                                 : result.exit_code);
+  *response.mutable_stdout() = std::move(result.stdout);
+  *response.mutable_stderr() = std::move(result.stderr);
+  return response;
+}
+
+Response AgentServer::Handle(const Request& request) {
+  Response response;
+  response.set_request_id(request.request_id());
+  absl::Status status;
+  switch (request.op_case()) {
+    case Request::kReadFile: {
+      absl::StatusOr<std::string> content =
+          ReadLocalFile(request.read_file().path());
+      status = content.status();
+      if (content.ok())
+        response.mutable_read_file()->set_content(*std::move(content));
+      break;
+    }
+    case Request::kWriteFile:
+      status = WriteLocalFile(request.write_file().path(),
+                              request.write_file().data());
+      if (status.ok()) response.mutable_write_file();
+      break;
+    case Request::kRunCommand: {
+      const RunCommandRequest& command = request.run_command();
+      absl::Duration timeout = command.timeout_ms() > 0
+                                   ? absl::Milliseconds(command.timeout_ms())
+                                   : absl::InfiniteDuration();
+      absl::StatusOr<RunCommandResponse> result = RunLocalCommand(
+          {command.args().begin(), command.args().end()}, timeout);
+      status = result.status();
+      if (result.ok()) *response.mutable_run_command() = *std::move(result);
+      break;
+    }
+    case Request::kStat: {
+      absl::StatusOr<StatResponse> result =
+          StatLocalFile(request.stat().path());
+      status = result.status();
+      if (result.ok()) *response.mutable_stat() = *std::move(result);
+      break;
+    }
+    case Request::kListDirectory: {
+      absl::StatusOr<ListDirectoryResponse> result =
+          ListLocalDirectory(request.list_directory().path());
+      status = result.status();
+      if (result.ok()) *response.mutable_list_directory() = *std::move(result);
+      break;
+    }
+    default:
+      status = absl::InvalidArgumentError("Unknown agent request");
+      break;
+  }
+  SetStatus(status, response);
+  return response;
+}
+
+absl::Status AgentServer::SendResponse(const Response& response) {
+  absl::MutexLock lock(&output_mutex_);
+  RETURN_IF_ERROR(output_status_);
+  output_status_ = WriteFrame(output_fd_, response);
+  return output_status_;
+}
+
+bool AgentServer::HasQueuedCommandOrClosed() const {
+  return !queued_commands_.empty() || input_closed_;
+}
+
+bool AgentServer::CanQueueCommand() const {
+  return pending_commands_ < max_running_commands_;
+}
+
+void AgentServer::RunCommands() {
+  while (true) {
+    Request request;
+    {
+      absl::MutexLock lock(&commands_mutex_);
+      commands_mutex_.Await(
+          absl::Condition(this, &AgentServer::HasQueuedCommandOrClosed));
+      if (queued_commands_.empty()) return;
+      request = std::move(queued_commands_.front());
+      queued_commands_.pop_front();
+    }
+    SendResponse(Handle(request)).IgnoreError();
+    absl::MutexLock lock(&commands_mutex_);
+    --pending_commands_;
+  }
+}
+
+absl::Status AgentServer::Serve() {
+  // Workers are only started when all of them are busy, so there are never
+  // more than `max_running_commands_`.
+  std::vector<std::thread> workers;
+  absl::Cleanup join_workers = [this, &workers] {
+    {
+      absl::MutexLock lock(&commands_mutex_);
+      input_closed_ = true;
+    }
+    for (std::thread& worker : workers) worker.join();
+  };
+
+  while (true) {
+    Request request;
+    absl::Status status = ReadFrame(input_fd_, request);
+    if (absl::IsOutOfRange(status)) break;
+    RETURN_IF_ERROR(status);
+
+    if (request.op_case() != Request::kRunCommand) {
+      RETURN_IF_ERROR(SendResponse(Handle(request)));
+      continue;
+    }
+    absl::MutexLock lock(&commands_mutex_);
+    // Stop reading requests until a command finishes, so that a flood of
+    // commands waits in the input rather than in memory.
+    commands_mutex_.Await(
+        absl::Condition(this, &AgentServer::CanQueueCommand));
+    queued_commands_.push_back(std::move(request));
+    ++pending_commands_;
+    if (workers.size() < static_cast<size_t>(pending_commands_)) {
+      workers.emplace_back(&AgentServer::RunCommands, this);
+    }
+  }
+
+  std::move(join_workers).Invoke();
+  absl::MutexLock lock(&output_mutex_);
+  return output_status_;
+}
+
+}  // namespace ocpdiag::hwinterface::remote::agent
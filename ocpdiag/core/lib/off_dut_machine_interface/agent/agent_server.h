@@ -0,0 +1,82 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_LIB_OFF_DUT_MACHINE_INTERFACE_AGENT_AGENT_SERVER_H_
+#define OCPDIAG_CORE_LIB_OFF_DUT_MACHINE_INTERFACE_AGENT_AGENT_SERVER_H_
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/agent/agent.pb.h"
+
+namespace ocpdiag::hwinterface::remote::agent {
+
+// AgentServer is the remote agent: it runs on the machine node, reads
+// requests from `input_fd` and writes a response for each to `output_fd`.
+// File operations are answered in order; commands run on a pool of worker
+// threads so that a long command doesn't hold up the requests pipelined behind
+// it. At most `max_running_commands` commands run at once: when that many are
+// running, no more requests are read until one of them finishes.
+class AgentServer {
+ public:
+  static constexpr int kDefaultMaxRunningCommands = 16;
+
+  AgentServer(int input_fd, int output_fd,
+              int max_running_commands = kDefaultMaxRunningCommands)
+      : input_fd_(input_fd),
+        output_fd_(output_fd),
+        max_running_commands_(max_running_commands) {}
+
+  AgentServer(const AgentServer&) = delete;
+  AgentServer& operator=(const AgentServer&) = delete;
+
+  // Serves requests until the input is closed, then waits for any running
+  // commands to finish. Returns an error if the input or output fails.
+  absl::Status Serve();
+
+  // Handles a single request. Exposed for testing.
+  static Response Handle(const Request& request);
+
+ private:
+  absl::Status SendResponse(const Response& response);
+
+  // Runs queued commands until the input is closed and the queue is empty.
+  void RunCommands();
+  bool HasQueuedCommandOrClosed() const
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(commands_mutex_);
+  bool CanQueueCommand() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(commands_mutex_);
+
+  int input_fd_;
+  int output_fd_;
+  const int max_running_commands_;
+  absl::Mutex output_mutex_;
+  absl::Status output_status_ ABSL_GUARDED_BY(output_mutex_);
+
+  absl::Mutex commands_mutex_;
+  // The commands waiting for a worker.
+  std::deque<Request> queued_commands_ ABSL_GUARDED_BY(commands_mutex_);
+  // The commands that are queued or running.
+  int pending_commands_ ABSL_GUARDED_BY(commands_mutex_) = 0;
+  bool input_closed_ ABSL_GUARDED_BY(commands_mutex_) = false;
+};
+
+// Runs `args`, joined with spaces, as a /bin/sh command line with stdin
+// redirected from /dev/null, collecting its exit code and output. This is what
+// ssh does with a remote command, so the same argv works over both transports,
+// e.g. a single shell script with pipes. The command is killed if it runs
+// longer than `timeout`.
+absl::StatusOr<RunCommandResponse> RunLocalCommand(
+    const std::vector<std::string>& args, absl::Duration timeout);
+
+}  // namespace ocpdiag::hwinterface::remote::agent
+
+#endif  // OCPDIAG_CORE_LIB_OFF_DUT_MACHINE_INTERFACE_AGENT_AGENT_SERVER_H_
@@ -0,0 +1,109 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/lib/off_dut_machine_interface/agent/protocol.h"
+
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "google/protobuf/message_lite.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "ocpdiag/core/compat/status_macros.h"
+
+namespace ocpdiag::hwinterface::remote::agent {
+
+namespace {
+
+constexpr size_t kHeaderSize = sizeof(uint32_t);
+
+absl::Status ErrnoError(absl::string_view message) {
+  return absl::Status(absl::ErrnoToStatusCode(errno),
+                      absl::StrCat(message, ": ", strerror(errno)));
+}
+
+absl::Status WriteAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    // send() can suppress SIGPIPE; fall back to write() for pipes.
+    ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+    if (written < 0 && errno == ENOTSOCK) written = write(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return ErrnoError("Failed to write agent frame");
+    }
+    data += written;
+    size -= written;
+  }
+  return absl::OkStatus();
+}
+
+// Reads exactly `size` bytes, returning the number of bytes read before the
+// end of the stream, if it ended early.
+absl::StatusOr<size_t> ReadAll(int fd, char* data, size_t size) {
+  size_t total = 0;
+  while (total < size) {
+    ssize_t got = read(fd, data + total, size - total);
+    if (got < 0) {
+      if (errno == EINTR) continue;
+      return ErrnoError("Failed to read agent frame");
+    }
+    if (got == 0) break;
+    total += got;
+  }
+  return total;
+}
+
+}  // namespace
+
+absl::Status WriteFrame(int fd, const google::protobuf::MessageLite& message) {
+  size_t size = message.ByteSizeLong();
+  if (size > kMaxFrameSize) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Agent message of ", size, " bytes is too large"));
+  }
+
+  std::string frame(kHeaderSize, '\0');
+  for (size_t i = 0; i < kHeaderSize; ++i)
+    frame[i] = static_cast<char>((size >> (8 * i)) & 0xff);
+  if (!message.AppendToString(&frame))
+    return absl::InternalError("Failed to serialize agent message");
+  return WriteAll(fd, frame.data(), frame.size());
+}
+
+absl::Status ReadFrame(int fd, google::protobuf::MessageLite& message) {
+  unsigned char header[kHeaderSize];
+  ASSIGN_OR_RETURN(size_t header_read,
+                   ReadAll(fd, reinterpret_cast<char*>(header), kHeaderSize));
+  if (header_read == 0) return absl::OutOfRangeError("End of agent stream");
+  if (header_read < kHeaderSize)
+    return absl::DataLossError("Agent stream ended inside a frame header");
+
+  uint32_t size = 0;
+  for (size_t i = 0; i < kHeaderSize; ++i)
+    size |= static_cast<uint32_t>(header[i]) << (8 * i);
+  if (size > kMaxFrameSize) {
+    return absl::DataLossError(
+        absl::StrCat("Agent frame of ", size, " bytes is too large"));
+  }
+
+  std::string payload(size, '\0');
+  ASSIGN_OR_RETURN(size_t payload_read, ReadAll(fd, payload.data(), size));
+  if (payload_read < size)
+    return absl::DataLossError("Agent stream ended inside a frame");
+  if (!message.ParseFromString(payload))
+    return absl::DataLossError("Failed to parse agent message");
+  return absl::OkStatus();
+}
+
+}  // namespace ocpdiag::hwinterface::remote::agent
@@ -0,0 +1,32 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_LIB_OFF_DUT_MACHINE_INTERFACE_AGENT_PROTOCOL_H_
+#define OCPDIAG_CORE_LIB_OFF_DUT_MACHINE_INTERFACE_AGENT_PROTOCOL_H_
+
+#include <cstdint>
+
+#include "google/protobuf/message_lite.h"
+#include "absl/status/status.h"
+
+namespace ocpdiag::hwinterface::remote::agent {
+
+// Messages larger than this are rejected, so that a corrupt length prefix
+// can't make the reader allocate unbounded memory.
+constexpr uint32_t kMaxFrameSize = 1 << 30;
+
+// Writes `message` to `fd` as a little-endian uint32 length followed by the
+// serialized message. Writing to a closed socket returns an error instead of
+// raising SIGPIPE.
+absl::Status WriteFrame(int fd, const google::protobuf::MessageLite& message);
+
+// Reads one frame written by WriteFrame() from `fd` into `message`. Returns
+// an OutOfRange error if the stream ends cleanly before the frame starts.
+absl::Status ReadFrame(int fd, google::protobuf::MessageLite& message);
+
+}  // namespace ocpdiag::hwinterface::remote::agent
+
+#endif  // OCPDIAG_CORE_LIB_OFF_DUT_MACHINE_INTERFACE_AGENT_PROTOCOL_H_
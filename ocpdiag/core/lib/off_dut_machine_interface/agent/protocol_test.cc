@@ -0,0 +1,95 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/lib/off_dut_machine_interface/agent/protocol.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/agent/agent.pb.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::hwinterface::remote::agent {
+namespace {
+
+using ::ocpdiag::testing::StatusIs;
+
+class ProtocolTest : public ::testing::Test {
+ protected:
+  ProtocolTest() {
+    int fds[2];
+    EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    write_fd_ = fds[0];
+    read_fd_ = fds[1];
+  }
+  ~ProtocolTest() override {
+    close(write_fd_);
+    close(read_fd_);
+  }
+
+  void CloseWriter() { shutdown(write_fd_, SHUT_WR); }
+
+  int write_fd_;
+  int read_fd_;
+};
+
+TEST_F(ProtocolTest, FramesRoundTrip) {
+  Request first;
+  first.set_request_id(1);
+  first.mutable_read_file()->set_path("/a");
+  Request second;
+  second.set_request_id(2);
+  second.mutable_write_file()->set_data(std::string("\0\n\xff", 3));
+  ASSERT_OK(WriteFrame(write_fd_, first));
+  ASSERT_OK(WriteFrame(write_fd_, second));
+  CloseWriter();
+
+  Request got;
+  ASSERT_OK(ReadFrame(read_fd_, got));
+  EXPECT_EQ(got.SerializeAsString(), first.SerializeAsString());
+  ASSERT_OK(ReadFrame(read_fd_, got));
+  EXPECT_EQ(got.SerializeAsString(), second.SerializeAsString());
+  EXPECT_THAT(ReadFrame(read_fd_, got),
+              StatusIs(absl::StatusCode::kOutOfRange));
+}
+
+TEST_F(ProtocolTest, TruncatedFrameIsDataLoss) {
+  // A header announcing 16 bytes, followed by only 2.
+  ASSERT_EQ(write(write_fd_, "\x10\0\0\0ab", 6), 6);
+  CloseWriter();
+
+  Request got;
+  EXPECT_THAT(ReadFrame(read_fd_, got), StatusIs(absl::StatusCode::kDataLoss));
+}
+
+TEST_F(ProtocolTest, TruncatedHeaderIsDataLoss) {
+  ASSERT_EQ(write(write_fd_, "\x10\0", 2), 2);
+  CloseWriter();
+
+  Request got;
+  EXPECT_THAT(ReadFrame(read_fd_, got), StatusIs(absl::StatusCode::kDataLoss));
+}
+
+TEST_F(ProtocolTest, OversizedFrameIsRejected) {
+  ASSERT_EQ(write(write_fd_, "\xff\xff\xff\xff", 4), 4);
+
+  Request got;
+  EXPECT_THAT(ReadFrame(read_fd_, got), StatusIs(absl::StatusCode::kDataLoss));
+}
+
+TEST_F(ProtocolTest, WriteToClosedPeerFails) {
+  close(read_fd_);
+  read_fd_ = -1;
+
+  EXPECT_FALSE(WriteFrame(write_fd_, Request()).ok());
+}
+
+}  // namespace
+}  // namespace ocpdiag::hwinterface::remote::agent
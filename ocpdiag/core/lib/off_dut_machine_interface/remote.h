@@ -7,7 +7,18 @@
 #ifndef OCPDIAG_CORE_HWINTERFACE_LIB_OFF_DUT_MACHINE_INTERFACE_REMOTE_H_
 #define OCPDIAG_CORE_HWINTERFACE_LIB_OFF_DUT_MACHINE_INTERFACE_REMOTE_H_
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/string_view.h"
 #include "absl/time/time.h"
 
 namespace ocpdiag::hwinterface {
@@ -20,6 +31,9 @@ struct NodeSpec {
 // Class ConnInterface provides a remote connection to the specified machine
 // node. It provides the file read/write operations, and the capability to
 // launch a remote command on the machine node.
+//
+// Implementations must be thread-safe, e.g. RemoteHostAdapter runs commands
+// from a pool of threads over one connection.
 class ConnInterface {
  public:
   // Options to configure a command.
@@ -41,6 +55,19 @@ class ConnInterface {
     std::string stderr;
   };
 
+  // Options for the chunked file transfers.
+  struct TransferOptions {
+    // The offset in the file to start at, to resume an interrupted transfer.
+    // A write keeps the first `offset` bytes of the file and drops the rest,
+    // and fails with FAILED_PRECONDITION if the file is shorter than that.
+    uint64_t offset = 0;
+    // The file is transferred in chunks of this many bytes. The memory used by
+    // a transfer is bounded by a few chunks, whatever the size of the file.
+    size_t chunk_size = 4 << 20;
+    // Compresses the chunks on the wire. Worth it for text, such as logs.
+    bool compress = false;
+  };
+
   virtual ~ConnInterface() = default;
 
   // ReadFile reads a file from the machine node, and returns the full file
@@ -52,6 +79,52 @@ class ConnInterface {
   virtual absl::Status WriteFile(absl::string_view file_name,
                                  absl::string_view data) = 0;
 
+  // ReadFileInChunks reads a file from the machine node, starting at
+  // `options.offset`, and passes it to `consumer` one chunk at a time, in
+  // order. An error from `consumer` stops the transfer and is returned. The
+  // bytes passed to `consumer` so far are the offset to resume from.
+  //
+  // The default implementation reads the whole file with ReadFile().
+  virtual absl::Status ReadFileInChunks(
+      absl::string_view file_name, const TransferOptions& options,
+      absl::FunctionRef<absl::Status(const absl::Cord& chunk)> consumer) {
+    absl::StatusOr<absl::Cord> content = ReadFile(file_name);
+    if (!content.ok()) return content.status();
+    uint64_t offset = std::min<uint64_t>(options.offset, content->size());
+    while (offset < content->size()) {
+      size_t size = std::min<uint64_t>(options.chunk_size,
+                                       content->size() - offset);
+      absl::Status status = consumer(content->Subcord(offset, size));
+      if (!status.ok()) return status;
+      offset += size;
+    }
+    return absl::OkStatus();
+  }
+
+  // WriteFileInChunks writes the data returned by `producer` to a file on the
+  // machine node, starting at `options.offset`. `producer` is called until it
+  // returns an empty Cord, or an error, which stops the transfer and is
+  // returned.
+  //
+  // The default implementation gathers the data and writes it with
+  // WriteFile(), and only supports writing from the start of the file.
+  virtual absl::Status WriteFileInChunks(
+      absl::string_view file_name, const TransferOptions& options,
+      absl::FunctionRef<absl::StatusOr<absl::Cord>()> producer) {
+    if (options.offset != 0) {
+      return absl::UnimplementedError(
+          "Resuming a write is not supported by this connection.");
+    }
+    absl::Cord data;
+    while (true) {
+      absl::StatusOr<absl::Cord> chunk = producer();
+      if (!chunk.ok()) return chunk.status();
+      if (chunk->empty()) break;
+      data.Append(*std::move(chunk));
+    }
+    return WriteFile(file_name, std::string(data));
+  }
+
   // RunCommand runs a remote command on the machine node, and returns the
   // command output on success, or the error status when applicable.
   // If the command's stdout/stderr is redirected by setting the CommandOption
@@ -18,12 +18,15 @@
 #include "absl/flags/flag.h"
 #include "absl/status/status.h"
 #include "absl/strings/ascii.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/agent/agent_conn.h"
 #include "ocpdiag/core/lib/off_dut_machine_interface/remote.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/ssh/control_master.h"
 #include "ocpdiag/core/lib/off_dut_machine_interface/ssh/remote.h"
 
 ABSL_FLAG(std::string, mi_connection_type, "ssh",
           "The type of Machine Interface to use. Current implementations are "
-          "prod, ssh. Defaults to ssh.");
+          "prod, ssh, ssh_agent. Defaults to ssh.");
 ABSL_FLAG(std::string, mi_service_addr, "",
           "Not Yet Implemented. Machine "
           "interface service address, for Google prod.");
@@ -31,6 +34,19 @@ ABSL_FLAG(std::string, remote_ssh_key_path, "",
           "in case the ssh connection needs a private key, for MTP/vendor.");
 ABSL_FLAG(std::string, remote_ssh_tunnel_file_path, "",
           "ssh multiplex to improve the efficiency, for MTP/vendor.");
+ABSL_FLAG(bool, remote_ssh_multiplexing, true,
+          "Runs the ssh sessions to a node over one shared master connection "
+          "(ControlMaster), unless remote_ssh_tunnel_file_path is set.");
+ABSL_FLAG(int, remote_ssh_max_channels, 10,
+          "The most ssh sessions run over a shared master connection at once. "
+          "Must not exceed the MaxSessions setting of the node's sshd.");
+ABSL_FLAG(absl::Duration, remote_ssh_idle_timeout, absl::Minutes(5),
+          "How long a shared ssh master connection stays up without "
+          "sessions.");
+ABSL_FLAG(std::string, remote_agent_path, "ocpdiag_remote_agent",
+          "The remote agent binary on the machine node, for the ssh_agent "
+          "connection type. All operations are sent to one long-lived agent "
+          "over a single ssh session.");
 
 namespace ocpdiag::hwinterface {
 namespace remote {
@@ -61,6 +77,7 @@ absl::StatusOr<std::string> GetSSHPath(absl::string_view path_env) {
 static const auto* const kStringToConnectionTypeMap =
     new absl::flat_hash_map<absl::string_view, ConnectionTypes>({
         {"ssh", ConnectionTypes::kSSH},
+        {"ssh_agent", ConnectionTypes::kSSHAgent},
     });
 
 absl::StatusOr<std::unique_ptr<ConnInterface>> NewConn(NodeSpec node_spec) {
@@ -77,16 +94,34 @@ absl::StatusOr<std::unique_ptr<ConnInterface>> NewConn(NodeSpec node_spec) {
         mi_connection_type_str, " is an invalid connection type."));
   }
 
+  std::string path_env = getenv("PATH");
+  absl::StatusOr<std::string> ssh_bin = GetSSHPath(path_env);
+  if (!ssh_bin.ok()) {
+    return ssh_bin.status();
+  }
+  auto ssh_conn = std::make_unique<SSHConnInterface>(
+      node_spec, absl::GetFlag(FLAGS_remote_ssh_key_path),
+      absl::GetFlag(FLAGS_remote_ssh_tunnel_file_path), *ssh_bin);
+
   switch (mi_connection_type->second) {
+    case ConnectionTypes::kSSHAgent: {
+      absl::StatusOr<std::unique_ptr<CommandTransport>> transport =
+          CommandTransport::Create(ssh_conn->GenerateSshArg(
+              {absl::GetFlag(FLAGS_remote_agent_path)}));
+      if (!transport.ok()) {
+        return transport.status();
+      }
+      return std::make_unique<AgentConnInterface>(*std::move(transport));
+    }
     default:
-      std::string path_env = getenv("PATH");
-      absl::StatusOr<std::string> ssh_bin = GetSSHPath(path_env);
-      if (!ssh_bin.ok()) {
-        return ssh_bin.status();
+      if (absl::GetFlag(FLAGS_remote_ssh_multiplexing) &&
+          absl::GetFlag(FLAGS_remote_ssh_tunnel_file_path).empty()) {
+        ssh_conn->set_control_master(SshControlMasterPool::Default().Get(
+            ssh_conn->GenerateSshArg({}),
+            {.idle_timeout = absl::GetFlag(FLAGS_remote_ssh_idle_timeout),
+             .max_channels = absl::GetFlag(FLAGS_remote_ssh_max_channels)}));
       }
-      return std::make_unique<SSHConnInterface>(
-          node_spec, absl::GetFlag(FLAGS_remote_ssh_key_path),
-          absl::GetFlag(FLAGS_remote_ssh_tunnel_file_path), *ssh_bin);
+      return ssh_conn;
   }
 }
 
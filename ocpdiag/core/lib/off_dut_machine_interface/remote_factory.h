@@ -8,6 +8,7 @@
 #define OCPDIAG_CORE_HWINTERFACE_LIB_OFF_DUT_MACHINE_INTERFACE_REMOTE_FACTORY_H_
 
 #include "absl/flags/declare.h"
+#include "absl/time/time.h"
 #include "ocpdiag/core/lib/off_dut_machine_interface/remote.h"
 
 // machine interface type.
@@ -19,6 +20,16 @@ ABSL_DECLARE_FLAG(std::string, remote_ssh_key_path);
 // remote_ssh_tunnel_file_path is similar to how OpenTest reuse the ssh
 // connections. Check SSH Multiplexing for more details.
 ABSL_DECLARE_FLAG(std::string, remote_ssh_tunnel_file_path);
+// remote_ssh_multiplexing runs the ssh sessions to a node over one shared
+// master connection when no tunnel file is given.
+ABSL_DECLARE_FLAG(bool, remote_ssh_multiplexing);
+// The most sessions run over a shared master connection at once.
+ABSL_DECLARE_FLAG(int, remote_ssh_max_channels);
+// How long a shared master connection stays up without sessions.
+ABSL_DECLARE_FLAG(absl::Duration, remote_ssh_idle_timeout);
+// remote_agent_path is the remote agent binary on the machine node, for the
+// ssh_agent connection type.
+ABSL_DECLARE_FLAG(std::string, remote_agent_path);
 
 namespace ocpdiag::hwinterface {
 namespace remote {
@@ -26,6 +37,8 @@ namespace remote {
 enum class ConnectionTypes {
   kProd = 0,
   kSSH,
+  // A persistent remote agent, reached through a single ssh session.
+  kSSHAgent,
 };
 
 // NewConn creates a new machine node connection
@@ -0,0 +1,238 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/lib/off_dut_machine_interface/ssh/control_master.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/lib/subprocess/subprocess.h"
+
+namespace ocpdiag::hwinterface {
+namespace remote {
+
+namespace {
+
+// `ssh -O` commands only talk to the local master process.
+constexpr absl::Duration kControlCommandTimeout = absl::Seconds(10);
+
+}  // namespace
+
+SshControlMaster::Channel::~Channel() {
+  if (master_ == nullptr) return;
+  absl::MutexLock lock(&master_->mutex_);
+  --master_->open_channels_;
+  master_->last_used_ = absl::Now();
+}
+
+SshControlMaster::SshControlMaster(std::vector<std::string> ssh_args,
+                                   Options options)
+    : ssh_args_(std::move(ssh_args)), options_(std::move(options)) {
+  // The control socket lives in a private directory, and its path must stay
+  // short: unix socket paths are limited to about 100 bytes.
+  std::string dir_template =
+      (std::filesystem::temp_directory_path() / "ocpdiag_ssh_XXXXXX").string();
+  if (mkdtemp(dir_template.data()) != nullptr) {
+    control_dir_ = dir_template;
+    control_path_ = (std::filesystem::path(control_dir_) / "master").string();
+  }
+}
+
+SshControlMaster::~SshControlMaster() { Stop(); }
+
+void SshControlMaster::Stop() {
+  {
+    absl::MutexLock lock(&mutex_);
+    mutex_.Await(absl::Condition(this, &SshControlMaster::IsNotConnecting));
+    if (stopped_) return;
+    stopped_ = true;
+    connected_ = false;
+  }
+  if (control_dir_.empty()) return;
+  if (std::filesystem::exists(control_path_)) {
+    subprocess::RunCommand(
+        {.args = ControlCommand({"-O", "exit"}),
+         .timeout = kControlCommandTimeout})
+        .IgnoreError();
+  }
+  std::error_code error;
+  std::filesystem::remove_all(control_dir_, error);
+}
+
+absl::StatusOr<SshControlMaster::Channel> SshControlMaster::OpenChannel() {
+  absl::MutexLock lock(&mutex_);
+  mutex_.Await(absl::Condition(this, &SshControlMaster::HasFreeChannel));
+  // The channel is reserved first, as the lock is released while connecting.
+  ++open_channels_;
+  absl::Status status = ConnectLocked();
+  if (!status.ok()) {
+    --open_channels_;
+    return status;
+  }
+  return Channel(this);
+}
+
+absl::StatusOr<std::string> SshControlMaster::Connect() {
+  absl::MutexLock lock(&mutex_);
+  absl::Status status = ConnectLocked();
+  if (!status.ok()) return status;
+  last_used_ = absl::Now();
+  return control_path_;
+}
+
+bool SshControlMaster::HasFreeChannel() const {
+  return open_channels_ < options_.max_channels;
+}
+
+bool SshControlMaster::IsNotConnecting() const { return !connecting_; }
+
+void SshControlMaster::ReportFailure() {
+  absl::MutexLock lock(&mutex_);
+  last_verified_ = absl::InfinitePast();
+}
+
+absl::Status SshControlMaster::ConnectLocked() {
+  if (control_dir_.empty()) {
+    return absl::InternalError(
+        "Failed to create a directory for the ssh control socket.");
+  }
+  // Another thread is checking or starting the master: its outcome is fresh.
+  mutex_.Await(absl::Condition(this, &SshControlMaster::IsNotConnecting));
+  if (stopped_) {
+    return absl::FailedPreconditionError(
+        "The ssh master connection was stopped.");
+  }
+
+  const absl::Time now = absl::Now();
+  // A master that has been idle may have exited on its own. The channel being
+  // opened, if any, is already counted.
+  const bool may_be_idle =
+      open_channels_ <= 1 && now - last_used_ >= options_.idle_timeout;
+  if (connected_ && !may_be_idle &&
+      now - last_verified_ < options_.health_check_interval) {
+    return absl::OkStatus();
+  }
+  const bool may_be_running =
+      connected_ || std::filesystem::exists(control_path_);
+  const bool may_start = now - last_start_failure_ >= options_.retry_interval;
+
+  connecting_ = true;
+  mutex_.Unlock();
+  bool up = may_be_running && IsMasterUp();
+  absl::Status start_status;
+  if (!up && may_start) {
+    start_status = StartMaster();
+    up = start_status.ok();
+  }
+  mutex_.Lock();
+  connecting_ = false;
+
+  connected_ = up;
+  if (up) {
+    last_verified_ = now;
+    return absl::OkStatus();
+  }
+  if (may_start) {
+    last_start_failure_ = now;
+    start_error_ = start_status;
+    LOG(WARNING) << start_error_ << ". Connecting directly for the next "
+                 << options_.retry_interval << ".";
+  }
+  return start_error_;
+}
+
+bool SshControlMaster::IsMasterUp() const {
+  absl::StatusOr<subprocess::Result> check =
+      subprocess::RunCommand({.args = ControlCommand({"-O", "check"}),
+                              .timeout = kControlCommandTimeout});
+  return check.ok() && check->exit_code == 0 && check->term_signal == 0;
+}
+
+absl::Status SshControlMaster::StartMaster() const {
+  std::error_code error;
+  std::filesystem::remove(control_path_, error);
+  const int64_t persist_seconds =
+      std::max<int64_t>(1, absl::ToInt64Seconds(options_.idle_timeout));
+  const int64_t connect_seconds =
+      std::max<int64_t>(1, absl::ToInt64Seconds(options_.connect_timeout));
+  // -f backgrounds the master once it has authenticated, so the command
+  // returns as soon as the master is ready to take sessions.
+  absl::StatusOr<subprocess::Result> start = subprocess::RunCommand(
+      {.args = ControlCommand(
+           {"-M", "-N", "-f", "-o", absl::StrCat("ControlPersist=",
+                                                 persist_seconds),
+            "-o", absl::StrCat("ConnectTimeout=", connect_seconds)}),
+       .timeout = options_.connect_timeout + kControlCommandTimeout});
+  if (!start.ok()) {
+    return absl::UnavailableError(
+        absl::StrCat("Failed to start the ssh master connection: ",
+                     start.status().message()));
+  }
+  if (start->exit_code != 0 || start->term_signal != 0) {
+    return absl::UnavailableError(absl::StrCat(
+        "Failed to start the ssh master connection. Exit code: ",
+        start->exit_code, ". Stderr: ", start->stderr));
+  }
+  return absl::OkStatus();
+}
+
+std::vector<std::string> SshControlMaster::ControlCommand(
+    const std::vector<std::string>& options) const {
+  std::vector<std::string> command = {ssh_args_.front(), "-S", control_path_};
+  command.insert(command.end(), options.begin(), options.end());
+  command.insert(command.end(), ssh_args_.begin() + 1, ssh_args_.end());
+  return command;
+}
+
+SshControlMasterPool& SshControlMasterPool::Default() {
+  // The pool outlives the static destructors, which may still use it, but
+  // its masters are stopped before them.
+  static SshControlMasterPool* const pool = [] {
+    std::atexit([] { Default().Shutdown(); });
+    return new SshControlMasterPool();
+  }();
+  return *pool;
+}
+
+std::shared_ptr<SshControlMaster> SshControlMasterPool::Get(
+    const std::vector<std::string>& ssh_args,
+    const SshControlMaster::Options& options) {
+  absl::MutexLock lock(&mutex_);
+  std::shared_ptr<SshControlMaster>& master =
+      masters_[absl::StrJoin(ssh_args, "\n")];
+  if (master == nullptr) {
+    master = std::make_shared<SshControlMaster>(ssh_args, options);
+  }
+  return master;
+}
+
+void SshControlMasterPool::Shutdown() {
+  absl::flat_hash_map<std::string, std::shared_ptr<SshControlMaster>> masters;
+  {
+    absl::MutexLock lock(&mutex_);
+    masters.swap(masters_);
+  }
+  for (auto& [args, master] : masters) master->Stop();
+}
+
+}  // namespace remote
+}  // namespace ocpdiag::hwinterface
@@ -0,0 +1,163 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_LIB_OFF_DUT_MACHINE_INTERFACE_SSH_CONTROL_MASTER_H_
+#define OCPDIAG_CORE_LIB_OFF_DUT_MACHINE_INTERFACE_SSH_CONTROL_MASTER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace ocpdiag::hwinterface {
+namespace remote {
+
+// SshControlMaster owns an OpenSSH master connection (ControlMaster) to one
+// machine node, so that ssh sessions started with its control path reuse the
+// master's authenticated connection instead of each paying for a TCP and SSH
+// handshake.
+//
+// The master is started on first use and health-checked with `ssh -O check`
+// before it is reused, at most once per `health_check_interval`. A master that
+// has died, e.g. because the node rebooted, is restarted. The master exits on
+// its own once it has had no sessions for `idle_timeout` (ControlPersist), and
+// is restarted when it is next needed. If the master cannot be started,
+// callers are expected to connect directly; the start is not retried for
+// `retry_interval`. Checking and starting the master happen without holding
+// the lock, so that channels keep being released meanwhile; callers that need
+// the master wait for the outcome instead of checking it again.
+//
+// This class is thread-safe.
+class SshControlMaster {
+ public:
+  struct Options {
+    // The master exits after it has had no sessions for this long.
+    absl::Duration idle_timeout = absl::Minutes(5);
+    // How long a successful health check is trusted.
+    absl::Duration health_check_interval = absl::Seconds(30);
+    // How long to wait for the master to connect and authenticate.
+    absl::Duration connect_timeout = absl::Seconds(30);
+    // How long to connect directly after the master fails to start.
+    absl::Duration retry_interval = absl::Seconds(30);
+    // The most sessions run over the master at once. sshd refuses sessions
+    // beyond its MaxSessions setting, which defaults to 10.
+    int max_channels = 10;
+  };
+
+  // A session slot on the master connection, released when destroyed.
+  class Channel {
+   public:
+    Channel(Channel&& other) : master_(other.master_) {
+      other.master_ = nullptr;
+    }
+    Channel& operator=(Channel&& other) = delete;
+    ~Channel();
+
+    // The control path to pass to ssh with -S.
+    const std::string& control_path() const { return master_->control_path_; }
+
+   private:
+    friend class SshControlMaster;
+    explicit Channel(SshControlMaster* master) : master_(master) {}
+
+    SshControlMaster* master_;
+  };
+
+  // `ssh_args` is the ssh command line that connects to the node, starting
+  // with the ssh binary and not including a remote command.
+  SshControlMaster(std::vector<std::string> ssh_args, Options options);
+
+  SshControlMaster(const SshControlMaster&) = delete;
+  SshControlMaster& operator=(const SshControlMaster&) = delete;
+
+  // Stops the master connection.
+  ~SshControlMaster();
+
+  // Stops the master connection, if it was started, and removes its control
+  // socket. Later calls to OpenChannel() and Connect() fail, so that callers
+  // connect directly.
+  void Stop();
+
+  // Waits for a free channel, then makes sure that the master is up. Returns
+  // an error if the master could not be started.
+  absl::StatusOr<Channel> OpenChannel();
+
+  // Makes sure that the master is up and returns its control path, without
+  // reserving a channel. Meant for long-lived sessions that are accounted for
+  // separately.
+  absl::StatusOr<std::string> Connect();
+
+  // Reports that a session over the master failed to connect, so the master is
+  // health-checked before it is used again.
+  void ReportFailure();
+
+ private:
+  bool HasFreeChannel() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  bool IsNotConnecting() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Makes sure that the master is up. The lock is released while `ssh` runs.
+  absl::Status ConnectLocked() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Returns whether the master answers `ssh -O check`.
+  bool IsMasterUp() const;
+  // Starts the master, and returns once it is ready to take sessions.
+  absl::Status StartMaster() const;
+  // Returns the command that runs `ssh -S <control path> <options>`.
+  std::vector<std::string> ControlCommand(
+      const std::vector<std::string>& options) const;
+
+  const std::vector<std::string> ssh_args_;
+  const Options options_;
+  std::string control_dir_;
+  std::string control_path_;
+
+  absl::Mutex mutex_;
+  int open_channels_ ABSL_GUARDED_BY(mutex_) = 0;
+  bool connected_ ABSL_GUARDED_BY(mutex_) = false;
+  // Whether a thread is checking or starting the master.
+  bool connecting_ ABSL_GUARDED_BY(mutex_) = false;
+  bool stopped_ ABSL_GUARDED_BY(mutex_) = false;
+  absl::Time last_verified_ ABSL_GUARDED_BY(mutex_) = absl::InfinitePast();
+  absl::Time last_used_ ABSL_GUARDED_BY(mutex_) = absl::InfinitePast();
+  absl::Time last_start_failure_ ABSL_GUARDED_BY(mutex_) =
+      absl::InfinitePast();
+  absl::Status start_error_ ABSL_GUARDED_BY(mutex_);
+};
+
+// SshControlMasterPool shares one master connection between all the
+// connections to the same node made with the same ssh options.
+class SshControlMasterPool {
+ public:
+  SshControlMasterPool() = default;
+
+  // The pool used by NewConn(). Its masters are stopped when the process
+  // exits, or before if they are idle.
+  static SshControlMasterPool& Default();
+
+  // Returns the master for `ssh_args`, creating it if needed. The options of
+  // an existing master are left unchanged.
+  std::shared_ptr<SshControlMaster> Get(
+      const std::vector<std::string>& ssh_args,
+      const SshControlMaster::Options& options);
+
+  // Stops all the masters and forgets them. Connections that still hold one
+  // of them connect directly from then on.
+  void Shutdown();
+
+ private:
+  absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, std::shared_ptr<SshControlMaster>> masters_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace remote
+}  // namespace ocpdiag::hwinterface
+
+#endif  // OCPDIAG_CORE_LIB_OFF_DUT_MACHINE_INTERFACE_SSH_CONTROL_MASTER_H_
@@ -0,0 +1,254 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/lib/off_dut_machine_interface/ssh/control_master.h"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/remote.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/ssh/remote.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::hwinterface {
+namespace remote {
+namespace {
+
+using ::ocpdiag::testing::StatusIs;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+
+// A fake ssh that logs how it was invoked to $LOG. `-M` creates the control
+// socket (a plain file), `-O check` succeeds if it exists, and `-O exit`
+// removes it. Other invocations are sessions, logged as "mux" if they were
+// given an existing control socket and as "direct" otherwise. Sessions fail if
+// another session is running, when $LOCK is set. `-O check` takes
+// $CHECK_SECONDS, if set.
+constexpr absl::string_view kFakeSsh = R"sh(#!/bin/sh
+socket=""; master=""; op=""
+while [ $# -gt 0 ]; do
+  case "$1" in
+    -S) socket="$2"; shift ;;
+    -M) master=1 ;;
+    -O) op="$2"; shift ;;
+  esac
+  shift
+done
+if [ -n "$master" ]; then
+  echo master >> "$LOG"
+  [ -n "$FAIL_MASTER" ] && exit 255
+  touch "$socket"; exit 0
+fi
+case "$op" in
+  check) [ -n "$CHECK_SECONDS" ] && sleep "$CHECK_SECONDS"
+         [ -e "$socket" ] && exit 0; exit 255 ;;
+  exit) echo exit >> "$LOG"; rm -f "$socket"; exit 0 ;;
+esac
+if [ -n "$socket" ] && [ -e "$socket" ]; then
+  echo mux >> "$LOG"
+else
+  echo direct >> "$LOG"
+fi
+if [ -n "$LOCK" ]; then
+  mkdir "$LOCK" || exit 1
+  sleep 0.05
+  rmdir "$LOCK"
+fi
+)sh";
+
+class SshControlMasterTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = std::filesystem::path(::testing::TempDir()) /
+           ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    std::filesystem::remove_all(dir_);
+    std::filesystem::create_directories(dir_);
+    ssh_path_ = (dir_ / "ssh").string();
+    std::ofstream(ssh_path_) << kFakeSsh;
+    std::filesystem::permissions(ssh_path_, std::filesystem::perms::all);
+    log_path_ = (dir_ / "log").string();
+    setenv("LOG", log_path_.c_str(), /*replace=*/true);
+    unsetenv("FAIL_MASTER");
+    unsetenv("LOCK");
+    unsetenv("CHECK_SECONDS");
+  }
+
+  // Returns the invocations logged by the fake ssh, and clears the log.
+  std::vector<std::string> TakeLog() {
+    std::vector<std::string> lines;
+    std::ifstream log(log_path_);
+    for (std::string line; std::getline(log, line);) lines.push_back(line);
+    std::filesystem::remove(log_path_);
+    return lines;
+  }
+
+  std::unique_ptr<SshControlMaster> NewMaster(
+      SshControlMaster::Options options = {}) {
+    return std::make_unique<SshControlMaster>(
+        std::vector<std::string>{ssh_path_, "root@dut"}, options);
+  }
+
+  // Runs a session through the fake ssh, over `master` if it is up.
+  void RunSession(SshControlMaster& master) {
+    absl::StatusOr<SshControlMaster::Channel> channel = master.OpenChannel();
+    std::vector<std::string> args = {ssh_path_};
+    if (channel.ok()) {
+      args.push_back("-S");
+      args.push_back(channel->control_path());
+    }
+    args.push_back("true");
+    std::ostringstream command;
+    for (const std::string& arg : args) command << "'" << arg << "' ";
+    ASSERT_EQ(system(command.str().c_str()), 0);
+  }
+
+  std::filesystem::path dir_;
+  std::string ssh_path_;
+  std::string log_path_;
+};
+
+TEST_F(SshControlMasterTest, SessionsShareOneMaster) {
+  std::unique_ptr<SshControlMaster> master = NewMaster();
+  for (int i = 0; i < 3; ++i) RunSession(*master);
+  EXPECT_THAT(TakeLog(), ElementsAre("master", "mux", "mux", "mux"));
+}
+
+TEST_F(SshControlMasterTest, RestartsDeadMaster) {
+  std::unique_ptr<SshControlMaster> master =
+      NewMaster({.health_check_interval = absl::ZeroDuration()});
+  absl::StatusOr<std::string> control_path = master->Connect();
+  ASSERT_OK(control_path);
+  RunSession(*master);
+
+  // The master went away, e.g. because the node rebooted.
+  std::filesystem::remove(*control_path);
+  RunSession(*master);
+  EXPECT_THAT(TakeLog(), ElementsAre("master", "mux", "master", "mux"));
+}
+
+TEST_F(SshControlMasterTest, FallsBackToDirectConnections) {
+  setenv("FAIL_MASTER", "1", /*replace=*/true);
+  std::unique_ptr<SshControlMaster> master =
+      NewMaster({.retry_interval = absl::Hours(1)});
+  EXPECT_THAT(master->OpenChannel(),
+              StatusIs(absl::StatusCode::kUnavailable,
+                       HasSubstr("Failed to start the ssh master connection")));
+  RunSession(*master);
+  RunSession(*master);
+  // The master isn't retried within the retry interval.
+  EXPECT_THAT(TakeLog(), ElementsAre("master", "direct", "direct"));
+}
+
+TEST_F(SshControlMasterTest, LimitsOpenChannels) {
+  std::string lock = (dir_ / "lock").string();
+  setenv("LOCK", lock.c_str(), /*replace=*/true);
+  std::unique_ptr<SshControlMaster> master = NewMaster({.max_channels = 1});
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&] { RunSession(*master); });
+  }
+  for (std::thread& thread : threads) thread.join();
+  EXPECT_THAT(TakeLog(), ElementsAre("master", "mux", "mux", "mux", "mux"));
+}
+
+TEST_F(SshControlMasterTest, StopsMasterWhenDestroyed) {
+  std::unique_ptr<SshControlMaster> master = NewMaster();
+  ASSERT_OK(master->Connect());
+  master.reset();
+  EXPECT_THAT(TakeLog(), ElementsAre("master", "exit"));
+}
+
+TEST_F(SshControlMasterTest, ReleasesChannelsWhileCheckingMaster) {
+  std::unique_ptr<SshControlMaster> master =
+      NewMaster({.health_check_interval = absl::ZeroDuration()});
+  absl::StatusOr<SshControlMaster::Channel> opened = master->OpenChannel();
+  ASSERT_OK(opened);
+  std::optional<SshControlMaster::Channel> channel(*std::move(opened));
+
+  // Another thread health-checks the master, which takes a while.
+  setenv("CHECK_SECONDS", "2", /*replace=*/true);
+  std::thread checker([&] { EXPECT_OK(master->OpenChannel()); });
+  absl::SleepFor(absl::Milliseconds(200));
+
+  absl::Time start = absl::Now();
+  channel.reset();
+  master->ReportFailure();
+  EXPECT_LT(absl::Now() - start, absl::Seconds(1));
+  checker.join();
+}
+
+TEST_F(SshControlMasterTest, StoppedMasterIsNotUsed) {
+  std::unique_ptr<SshControlMaster> master = NewMaster();
+  ASSERT_OK(master->Connect());
+  master->Stop();
+  EXPECT_THAT(master->OpenChannel(),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  master.reset();
+  EXPECT_THAT(TakeLog(), ElementsAre("master", "exit"));
+}
+
+TEST_F(SshControlMasterTest, DoesNotStopMasterThatWasNeverStarted) {
+  NewMaster().reset();
+  EXPECT_THAT(TakeLog(), IsEmpty());
+}
+
+TEST_F(SshControlMasterTest, PoolSharesMastersBetweenConnections) {
+  SshControlMasterPool pool;
+  std::shared_ptr<SshControlMaster> master =
+      pool.Get({ssh_path_, "root@dut"}, {});
+  EXPECT_EQ(pool.Get({ssh_path_, "root@dut"}, {}), master);
+  EXPECT_NE(pool.Get({ssh_path_, "root@other"}, {}), master);
+}
+
+TEST_F(SshControlMasterTest, PoolShutdownStopsMasters) {
+  SshControlMasterPool pool;
+  std::shared_ptr<SshControlMaster> master =
+      pool.Get({ssh_path_, "root@dut"}, {});
+  absl::StatusOr<std::string> control_path = master->Connect();
+  ASSERT_OK(control_path);
+
+  pool.Shutdown();
+  EXPECT_THAT(TakeLog(), ElementsAre("master", "exit"));
+  EXPECT_FALSE(std::filesystem::exists(
+      std::filesystem::path(*control_path).parent_path()));
+  // The connections that still hold the master connect directly.
+  RunSession(*master);
+  EXPECT_THAT(TakeLog(), ElementsAre("direct"));
+  EXPECT_NE(pool.Get({ssh_path_, "root@dut"}, {}), master);
+}
+
+TEST_F(SshControlMasterTest, SshConnInterfaceRunsCommandsOverMaster) {
+  SSHConnInterface ssh_conn(NodeSpec{"dut"}, "", "", ssh_path_);
+  SshControlMasterPool pool;
+  ssh_conn.set_control_master(pool.Get(ssh_conn.GenerateSshArg({}), {}));
+
+  for (int i = 0; i < 2; ++i) {
+    absl::StatusOr<ConnInterface::CommandResult> result =
+        ssh_conn.RunCommand(absl::Seconds(10), {"true"},
+                            ConnInterface::CommandOption());
+    ASSERT_OK(result);
+    EXPECT_EQ(result->exit_code, 0);
+  }
+  EXPECT_THAT(TakeLog(), ElementsAre("master", "mux", "mux"));
+}
+
+}  // namespace
+}  // namespace remote
+}  // namespace ocpdiag::hwinterface
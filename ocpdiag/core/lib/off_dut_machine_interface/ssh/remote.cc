@@ -12,39 +12,105 @@
 #include <sys/errno.h>
 #include <sys/stat.h>
 #include <sys/types.h>
-#include <sys/wait.h>
 #include <unistd.h>
 
+#include <array>
 #include <cerrno>
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
-#include <iostream>
 #include <memory>
+#include <optional>
 #include <ostream>
 #include <string>
 #include <string_view>
 #include <vector>
 
 #include "absl/base/casts.h"
-#include "absl/cleanup/cleanup.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
+#include "absl/strings/str_replace.h"
+#include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
-#include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "absl/types/span.h"
+#include "ocpdiag/core/compat/status_macros.h"
+#include "ocpdiag/core/lib/compression/gzip.h"
 #include "ocpdiag/core/lib/off_dut_machine_interface/remote.h"
+#include "ocpdiag/core/lib/subprocess/subprocess.h"
 
 namespace ocpdiag::hwinterface {
 namespace remote {
 
 constexpr absl::string_view kSshCommand = "ssh";
 constexpr absl::string_view kDefaultSSHUser = "root";
-constexpr absl::Duration kPollChildInterval = absl::Milliseconds(100);
 constexpr absl::Duration kRWTimeout = absl::Minutes(15);
 
+namespace {
+
+// Quotes `arg` for the remote shell.
+std::string ShellQuote(absl::string_view arg) {
+  return absl::StrCat("'", absl::StrReplaceAll(arg, {{"'", "'\\''"}}), "'");
+}
+
+// Returns the CRC computed by POSIX cksum, which is available on every node
+// and so is used to check the chunks of a transfer end to end.
+uint32_t PosixCksum(const absl::Cord& data) {
+  static const std::array<uint32_t, 256> kTable = [] {
+    std::array<uint32_t, 256> table;
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i << 24;
+      for (int bit = 0; bit < 8; ++bit) {
+        crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+      }
+      table[i] = crc;
+    }
+    return table;
+  }();
+  uint32_t crc = 0;
+  auto update = [&crc](unsigned char byte) {
+    crc = (crc << 8) ^ kTable[(crc >> 24) ^ byte];
+  };
+  for (absl::string_view piece : data.Chunks()) {
+    for (unsigned char byte : piece) update(byte);
+  }
+  for (uint64_t size = data.size(); size != 0; size >>= 8) update(size & 0xff);
+  return ~crc;
+}
+
+// Checks `data` against the output of cksum, which is the last line of
+// `cksum_output`.
+absl::Status VerifyCksum(absl::string_view cksum_output,
+                         const absl::Cord& data) {
+  std::vector<absl::string_view> lines =
+      absl::StrSplit(cksum_output, '\n', absl::SkipWhitespace());
+  std::vector<absl::string_view> fields;
+  if (!lines.empty()) {
+    fields = absl::StrSplit(lines.back(), ' ', absl::SkipWhitespace());
+  }
+  uint32_t crc;
+  uint64_t size;
+  if (fields.size() != 2 || !absl::SimpleAtoi(fields[0], &crc) ||
+      !absl::SimpleAtoi(fields[1], &size)) {
+    return absl::InternalError(absl::StrCat(
+        "Failed to parse the checksum of a chunk: ", cksum_output));
+  }
+  if (size != data.size() || crc != PosixCksum(data)) {
+    return absl::DataLossError(absl::StrFormat(
+        "Checksum mismatch: the node has %d bytes with CRC %u, but %d bytes "
+        "with CRC %u were transferred.",
+        size, crc, data.size(), PosixCksum(data)));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
 SSHConnInterface::SSHConnInterface(NodeSpec node_spec,
                                    absl::string_view ssh_key_path,
                                    absl::string_view ssh_tunnel_file_path,
@@ -84,29 +150,128 @@ absl::Status SSHConnInterface::WriteFile(absl::string_view file_name,
   return absl::OkStatus();
 }
 
-absl::StatusOr<ConnInterface::CommandResult> SSHConnInterface::RunCommand(
-    absl::Duration timeout, const std::vector<std::string>& args,
-    const ConnInterface::CommandOption& options) {
-  return RunCommandWithStdin(timeout, absl::string_view(), args, options);
+absl::Status SSHConnInterface::ReadFileInChunks(
+    absl::string_view file_name, const TransferOptions& options,
+    absl::FunctionRef<absl::Status(const absl::Cord& chunk)> consumer) {
+  if (options.chunk_size == 0) {
+    return absl::InvalidArgumentError("The chunk size must not be zero.");
+  }
+  const std::string file = ShellQuote(file_name);
+  for (uint64_t offset = options.offset;;) {
+    // One session per chunk: the chunk goes to stdout, possibly compressed,
+    // and its checksum to stderr.
+    std::string script = absl::StrFormat(
+        "[ -r %s ] || { echo 'Cannot read the file.' >&2; exit 1; }; "
+        "{ tail -c +%d %s | head -c %d | tee /dev/fd/4 | cksum >&2; } 4>&1",
+        file, offset + 1, file, options.chunk_size);
+    if (options.compress) absl::StrAppend(&script, " | gzip -1 -c");
+    ASSIGN_OR_RETURN(CommandResult result,
+                     RunCommand(kRWTimeout, {script}, CommandOption()));
+    if (result.exit_code != 0) {
+      return absl::InternalError(absl::StrFormat(
+          "Failed to read the file: %s\nstderr: %s", file_name,
+          result.stderr));
+    }
+    absl::Cord chunk;
+    if (options.compress) {
+      ASSIGN_OR_RETURN(chunk, compression::GzipDecompress(result.stdout));
+    } else {
+      chunk = absl::Cord(std::move(result.stdout));
+    }
+    RETURN_IF_ERROR(VerifyCksum(result.stderr, chunk));
+    if (chunk.empty()) return absl::OkStatus();
+    RETURN_IF_ERROR(consumer(chunk));
+    if (chunk.size() < options.chunk_size) return absl::OkStatus();
+    offset += chunk.size();
+  }
 }
 
-namespace {
+absl::Status SSHConnInterface::WriteFileInChunks(
+    absl::string_view file_name, const TransferOptions& options,
+    absl::FunctionRef<absl::StatusOr<absl::Cord>()> producer) {
+  if (options.chunk_size == 0) {
+    return absl::InvalidArgumentError("The chunk size must not be zero.");
+  }
+  const std::string file = ShellQuote(file_name);
+  // Drop anything past the offset, so that chunks can be appended. A file
+  // shorter than the offset lost data that was reported as written, and must
+  // not be padded to the offset.
+  std::string truncate = absl::StrCat(": > ", file);
+  if (options.offset != 0) {
+    ASSIGN_OR_RETURN(
+        CommandResult result,
+        RunCommand(kRWTimeout,
+                   {absl::StrFormat("[ ! -e %s ] && echo 0 || stat -c %%s %s",
+                                    file, file)},
+                   CommandOption()));
+    uint64_t size;
+    if (result.exit_code != 0 ||
+        !absl::SimpleAtoi(absl::StripAsciiWhitespace(result.stdout), &size)) {
+      return absl::InternalError(absl::StrFormat(
+          "Failed to get the size of the file: %s\nstderr: %s", file_name,
+          result.stderr));
+    }
+    if (size < options.offset) {
+      return absl::FailedPreconditionError(absl::StrFormat(
+          "Cannot resume writing %s at offset %d, past its end at %d.",
+          file_name, options.offset, size));
+    }
+    truncate = size == options.offset ? ""
+                                      : absl::StrFormat("truncate -s %d %s",
+                                                        options.offset, file);
+  }
+  if (!truncate.empty()) {
+    ASSIGN_OR_RETURN(CommandResult result,
+                     RunCommand(kRWTimeout, {truncate}, CommandOption()));
+    if (result.exit_code != 0) {
+      return absl::InternalError(absl::StrFormat(
+          "Failed to write the file: %s\nstderr: %s", file_name,
+          result.stderr));
+    }
+  }
+
+  // Appends a chunk, then checks what landed in the file.
+  auto write_chunk = [&](const absl::Cord& chunk) -> absl::Status {
+    std::string data;
+    if (options.compress) {
+      ASSIGN_OR_RETURN(data, compression::GzipCompress(chunk));
+    } else {
+      data = std::string(chunk);
+    }
+    std::string script =
+        absl::StrFormat("%s >> %s && tail -c %d %s | cksum >&2",
+                        options.compress ? "gzip -d -c" : "cat", file,
+                        chunk.size(), file);
+    ASSIGN_OR_RETURN(
+        CommandResult result,
+        RunCommandWithStdin(kRWTimeout, data, {script}, CommandOption()));
+    if (result.exit_code != 0) {
+      return absl::InternalError(absl::StrFormat(
+          "Failed to write the file: %s\nstderr: %s", file_name,
+          result.stderr));
+    }
+    return VerifyCksum(result.stderr, chunk);
+  };
 
-// Helper to read the entire contents of a file
-absl::StatusOr<std::string> ReadLocalFile(FILE* file) {
-  std::fseek(file, 0, SEEK_END);
-  std::string out;
-  out.resize(std::ftell(file));
-  std::rewind(file);
-  size_t read = std::fread(out.data(), sizeof(char), out.size(), file);
-  if (read < out.size()) {
-    return absl::InternalError("Failed to read entirety of file.");
+  absl::Cord pending;
+  while (true) {
+    ASSIGN_OR_RETURN(absl::Cord data, producer());
+    if (data.empty()) break;
+    pending.Append(std::move(data));
+    while (pending.size() >= options.chunk_size) {
+      RETURN_IF_ERROR(write_chunk(pending.Subcord(0, options.chunk_size)));
+      pending.RemovePrefix(options.chunk_size);
+    }
   }
-  std::fclose(file);
-  return out;
+  if (!pending.empty()) RETURN_IF_ERROR(write_chunk(pending));
+  return absl::OkStatus();
 }
 
-}  // namespace
+absl::StatusOr<ConnInterface::CommandResult> SSHConnInterface::RunCommand(
+    absl::Duration timeout, const std::vector<std::string>& args,
+    const ConnInterface::CommandOption& options) {
+  return RunCommandWithStdin(timeout, absl::string_view(), args, options);
+}
 
 absl::StatusOr<ConnInterface::CommandResult>
 SSHConnInterface::RunCommandWithStdin(
@@ -118,136 +283,51 @@ SSHConnInterface::RunCommandWithStdin(
         "Stdout/stderr redirection is requested but not yet implemented.");
   }
 
-  // Prepare the stdout and stderr temp files.
-  FILE* stdout = std::tmpfile();
-  if (stdout == nullptr) {
-    return absl::InternalError(absl::StrFormat(
-        "Failed to create stdout file for the command: %s.", strerror(errno)));
-  }
-  FILE* stderr = std::tmpfile();
-  if (stderr == nullptr) {
-    return absl::InternalError(absl::StrFormat(
-        "Failed to create stderr file for the command: %s.", strerror(errno)));
-  }
-
-  // Create pipe to route the stdin
-  int fd[2];
-  if (pipe(fd) != 0) {
-    return absl::InternalError(absl::StrFormat(
-        "Failed to create pipe for the command: %s.", strerror(errno)));
-  }
-  auto pipe_cleanup = absl::MakeCleanup([fd] {
-    close(fd[0]);
-    close(fd[1]);
-  });
-
-  pid_t pid = fork();
-  if (pid < 0) {
-    return absl::InternalError(
-        absl::StrFormat("Failed to fork the process: %s.", strerror(errno)));
-  }
-
-  // Child process, never returns.
-  if (pid == 0) {
-    dup2(fileno(stdout), STDOUT_FILENO);
-    dup2(fileno(stderr), STDERR_FILENO);
-
-    // Child process doesn't use it.
-    close(fd[1]);
-    if (dup2(fd[0], STDIN_FILENO) == -1) {
-      return absl::InternalError(absl::StrFormat(
-          "Failed to use pipe for redirect stdin: %s.", strerror(errno)));
+  // Reserve a session on the master connection, if there is one. Without
+  // it, ssh connects directly.
+  std::optional<SshControlMaster::Channel> channel;
+  std::string control_path = ssh_tunnel_file_path_;
+  if (control_path.empty() && control_master_ != nullptr) {
+    absl::StatusOr<SshControlMaster::Channel> opened =
+        control_master_->OpenChannel();
+    if (opened.ok()) {
+      channel.emplace(*std::move(opened));
+      control_path = channel->control_path();
     }
-
-    std::vector<std::string> sshArgs = GenerateSshArg(args);
-    //  convert sshArgs to char*const[] required by execvp.
-    std::vector<char*> sshArg_ptrs(sshArgs.size() + 1);
-    for (std::size_t i = 0; i < sshArgs.size(); i++) {
-      sshArg_ptrs[i] = const_cast<char*>(sshArgs[i].c_str());
-    }
-    sshArg_ptrs.back() = nullptr;
-    execvp(ssh_bin_path_.c_str(), sshArg_ptrs.data());
-
-    // Execvp returns only when fail.
-    std::cerr << "Failed to run ssh." << std::endl;
-    return absl::InternalError(
-        absl::StrFormat("Failed to run the command: %s.", strerror(errno)));
-  }
-
-  // Close fd[0] after child process inherits it.
-  close(fd[0]);
-  // Ignore SIGPIPE to avoid program terminate.
-  struct sigaction ignore, restore;
-  memset(&ignore, 0, sizeof(ignore));
-  ignore.sa_handler = SIG_IGN;
-  sigaction(SIGPIPE, &ignore, &restore);
-  auto sigpipe_cleanup = absl::MakeCleanup(
-      [&restore]() { sigaction(SIGPIPE, &restore, nullptr); });
-  // Write data to pipe for stdin of command.
-  for (size_t written = 0; written < stdin.size();) {
-    ssize_t wrote =
-        write(fd[1], stdin.data() + written, stdin.size() - written);
-    if (wrote < 0) {
-      return absl::InternalError(absl::StrFormat(
-          "Failed to write all data to pipe: %s.", strerror(errno)));
-    }
-    written += wrote;
   }
-  // Close fd[1] to indicate the end of data from pipe.
-  close(fd[1]);
-
-  // Below is the parent process code.
-  // Wait for the child process to finish, or kill the command if it times out.
-  absl::Time deadline = absl::Now() + timeout;
-  while (absl::Now() < deadline) {
-    int status;
-    pid_t w = waitpid(pid, &status, WNOHANG);
-    if (w == 0) {
-      absl::SleepFor(kPollChildInterval);
-      continue;
-    }
-    if (w != pid) {
-      return absl::InternalError("Failed to wait for the child process.");
-    }
 
-    // Command finishes successfully. Populate the result.
-    ConnInterface::CommandResult result;
-    if (WIFEXITED(status)) {
-      result.exit_code = WEXITSTATUS(status);
-    } else if (WIFSIGNALED(status)) {
-      // Exit code is negative when subprocess is terminated by signal.
-      result.exit_code = -abs(WTERMSIG(status));
-    } else {
-      return absl::InternalError(
-          "Unexpected state: waitpid returned when subprocess neither exited "
-          "nor terminated by signal.");
-    }
-    // Copy stdout and stderr to the result.
-    auto stdout_content = ReadLocalFile(stdout);
-    if (!stdout_content.ok()) {
-      std::cerr << "Failed to read the stdout." << std::endl;
-      return stdout_content.status();
-    }
-    result.stdout = *std::move(stdout_content);
-
-    auto stderr_content = ReadLocalFile(stderr);
-    if (!stderr_content.ok()) {
-      std::cerr << "Failed to read the stderr." << std::endl;
-      return stderr_content.status();
-    }
-    result.stderr = *std::move(stderr_content);
-
-    return result;
+  ASSIGN_OR_RETURN(
+      subprocess::Result subprocess_result,
+      subprocess::RunCommand(
+          {.args = GenerateSshArgWithControlPath(args, control_path),
+           .stdin_data = stdin,
+           .timeout = timeout}));
+  // ssh exits with 255 when it fails to connect.
+  if (channel.has_value() && subprocess_result.exit_code == 255) {
+    control_master_->ReportFailure();
   }
-
-  // Timeout, kill the command and return.
-  kill(pid, SIGKILL);
-  return absl::DeadlineExceededError(absl::StrFormat(
-      "Command failed to finish in %s.", absl::FormatDuration(timeout)));
+  ConnInterface::CommandResult result;
+  // Exit code is negative when subprocess is terminated by signal.
+  result.exit_code = subprocess_result.term_signal != 0
+                         ? -subprocess_result.term_signal
+                         : subprocess_result.exit_code;
+  result.stdout = std::move(subprocess_result.stdout);
+  result.stderr = std::move(subprocess_result.stderr);
+  return result;
 }
 
 std::vector<std::string> SSHConnInterface::GenerateSshArg(
     const std::vector<std::string>& args) {
+  std::string control_path = ssh_tunnel_file_path_;
+  if (control_path.empty() && control_master_ != nullptr) {
+    absl::StatusOr<std::string> master_path = control_master_->Connect();
+    if (master_path.ok()) control_path = *std::move(master_path);
+  }
+  return GenerateSshArgWithControlPath(args, control_path);
+}
+
+std::vector<std::string> SSHConnInterface::GenerateSshArgWithControlPath(
+    const std::vector<std::string>& args, absl::string_view control_path) {
   std::vector<std::string> sshArgs;
 
   sshArgs.push_back(std::string(ssh_bin_path_));
@@ -256,9 +336,9 @@ std::vector<std::string> SSHConnInterface::GenerateSshArg(
     sshArgs.push_back("-i");
     sshArgs.push_back(std::string(ssh_key_path_));
   }
-  if (!ssh_tunnel_file_path_.empty()) {
+  if (!control_path.empty()) {
     sshArgs.push_back("-S");
-    sshArgs.push_back(std::string(ssh_tunnel_file_path_));
+    sshArgs.push_back(std::string(control_path));
   }
   // Disable SSH host keys checking
   sshArgs.push_back("-o");
@@ -8,12 +8,18 @@
 #define OCPDIAG_CORE_HWINTERFACE_LIB_OFF_DUT_MACHINE_INTERFACE_SSH_REMOTE_H_
 
 #include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
 #include "ocpdiag/core/lib/off_dut_machine_interface/remote.h"
+#include "ocpdiag/core/lib/off_dut_machine_interface/ssh/control_master.h"
 
 namespace ocpdiag::hwinterface {
 namespace remote {
@@ -36,21 +42,51 @@ class SSHConnInterface : public ConnInterface {
   absl::Status WriteFile(absl::string_view file_name,
                          absl::string_view data) override;
 
+  // ReadFileInChunks reads the given file with one ssh session per chunk, and
+  // checks each chunk against a checksum computed on the node.
+  absl::Status ReadFileInChunks(
+      absl::string_view file_name, const TransferOptions& options,
+      absl::FunctionRef<absl::Status(const absl::Cord& chunk)> consumer)
+      override;
+
+  // WriteFileInChunks appends to the given file with one ssh session per
+  // chunk, and checks each chunk against a checksum computed on the node.
+  absl::Status WriteFileInChunks(
+      absl::string_view file_name, const TransferOptions& options,
+      absl::FunctionRef<absl::StatusOr<absl::Cord>()> producer) override;
+
   // RunCommand runs the specified command on the given machine node.
   absl::StatusOr<CommandResult> RunCommand(
       absl::Duration timeout, const std::vector<std::string>& args,
       const CommandOption& options) override;
 
+  // Returns the ssh command line, starting with the ssh binary, that runs
+  // `args` on the machine node. If the connection has a control master and no
+  // tunnel file, the command line goes through the master when it is up.
+  std::vector<std::string> GenerateSshArg(const std::vector<std::string>& args);
+
+  // Multiplexes the sessions of this connection over `control_master`, which
+  // must have been created for GenerateSshArg({}). Ignored if a tunnel file
+  // path was given. Must be called before the connection is used.
+  void set_control_master(std::shared_ptr<SshControlMaster> control_master) {
+    control_master_ = std::move(control_master);
+  }
+
  private:
   absl::StatusOr<CommandResult> RunCommandWithStdin(
       absl::Duration timeout, absl::string_view stdin,
       const std::vector<std::string>& args, const CommandOption& options);
-  std::vector<std::string> GenerateSshArg(const std::vector<std::string>& args);
+
+  // Same as GenerateSshArg(), with the given control socket (-S) if it is not
+  // empty.
+  std::vector<std::string> GenerateSshArgWithControlPath(
+      const std::vector<std::string>& args, absl::string_view control_path);
 
   NodeSpec node_spec_;
   std::string ssh_key_path_;
   std::string ssh_tunnel_file_path_;
   std::string ssh_bin_path_;
+  std::shared_ptr<SshControlMaster> control_master_;
 };
 
 }  // namespace remote
@@ -12,13 +12,16 @@
 #include <fstream>
 #include <memory>
 #include <sstream>
+#include <string>
 #include <string_view>
 #include <utility>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/cord.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "absl/time/time.h"
@@ -30,6 +33,7 @@ namespace ocpdiag::hwinterface {
 namespace remote {
 
 using ::ocpdiag::testing::StatusIs;
+using ::testing::ElementsAre;
 using ::testing::Eq;
 
 // constexpr absl::string_view kSshPath = "/usr/bin/ssh";
@@ -195,6 +199,182 @@ TEST_F(SshTest, SshWriteFileFeedDataToStdin) {
   EXPECT_THAT(actual, Eq("abc\x01\x05\x0a\x15"));
 }
 
+// Runs the remote command locally, as the node would.
+constexpr absl::string_view kLocalSsh = R"sh(shift
+while [ $# -gt 0 ]; do
+  case "$1" in
+    -o|-i|-S) shift 2 ;;
+    *) break ;;
+  esac
+done
+exec sh -c "$*")sh";
+
+// Returns `size` bytes of mixed data, with runs that compress well.
+std::string TestData(size_t size) {
+  std::string data;
+  for (size_t i = 0; data.size() < size; ++i) {
+    data.append(absl::StrCat("line ", i, " \x01\xff\n"));
+  }
+  data.resize(size);
+  return data;
+}
+
+class SshTransferTest : public SshTest,
+                        public ::testing::WithParamInterface<bool> {
+ protected:
+  void SetUp() override {
+    FakeSsh(kLocalSsh);
+    file_ = absl::StrCat(::testing::TempDir(), "/ssh_transfer 'file'");
+    options_.chunk_size = 1000;
+    options_.compress = GetParam();
+  }
+
+  std::string file_;
+  ConnInterface::TransferOptions options_;
+};
+
+TEST_P(SshTransferTest, ReadsFileInChunks) {
+  std::string data = TestData(2500);
+  std::ofstream(file_) << data;
+  std::vector<size_t> chunk_sizes;
+  std::string content;
+  ASSERT_OK(ssh_conn_.ReadFileInChunks(
+      file_, options_, [&](const absl::Cord& chunk) {
+        chunk_sizes.push_back(chunk.size());
+        absl::StrAppend(&content, std::string(chunk));
+        return absl::OkStatus();
+      }));
+  EXPECT_EQ(content, data);
+  EXPECT_THAT(chunk_sizes, ElementsAre(1000, 1000, 500));
+}
+
+TEST_P(SshTransferTest, ReadsFileOfWholeChunks) {
+  std::ofstream(file_) << TestData(2000);
+  int chunks = 0;
+  ASSERT_OK(ssh_conn_.ReadFileInChunks(
+      file_, options_, [&](const absl::Cord& chunk) {
+        ++chunks;
+        return absl::OkStatus();
+      }));
+  EXPECT_EQ(chunks, 2);
+}
+
+TEST_P(SshTransferTest, ResumesReadAtOffset) {
+  std::string data = TestData(2500);
+  std::ofstream(file_) << data;
+  options_.offset = 1200;
+  std::string content;
+  ASSERT_OK(ssh_conn_.ReadFileInChunks(
+      file_, options_, [&](const absl::Cord& chunk) {
+        absl::StrAppend(&content, std::string(chunk));
+        return absl::OkStatus();
+      }));
+  EXPECT_EQ(content, data.substr(1200));
+}
+
+TEST_P(SshTransferTest, ConsumerErrorStopsRead) {
+  std::ofstream(file_) << TestData(2500);
+  int chunks = 0;
+  EXPECT_THAT(ssh_conn_.ReadFileInChunks(file_, options_,
+                                         [&](const absl::Cord& chunk) {
+                                           ++chunks;
+                                           return absl::CancelledError();
+                                         }),
+              StatusIs(absl::StatusCode::kCancelled));
+  EXPECT_EQ(chunks, 1);
+}
+
+TEST_P(SshTransferTest, ReadMissingFileFails) {
+  std::filesystem::remove(file_);
+  EXPECT_THAT(ssh_conn_.ReadFileInChunks(
+                  file_, options_,
+                  [](const absl::Cord& chunk) { return absl::OkStatus(); }),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST_P(SshTransferTest, WritesFileInChunks) {
+  std::string data = TestData(2500);
+  // The producer's pieces don't line up with the chunks.
+  size_t produced = 0;
+  ASSERT_OK(ssh_conn_.WriteFileInChunks(
+      file_, options_, [&]() -> absl::StatusOr<absl::Cord> {
+        absl::Cord piece(data.substr(produced, 700));
+        produced += piece.size();
+        return piece;
+      }));
+  EXPECT_EQ(ReadLocalFile(file_), data);
+}
+
+TEST_P(SshTransferTest, ResumesWriteAtOffset) {
+  std::string data = TestData(2500);
+  std::ofstream(file_) << data.substr(0, 1500) << "garbage";
+  options_.offset = 1500;
+  bool done = false;
+  ASSERT_OK(ssh_conn_.WriteFileInChunks(
+      file_, options_, [&]() -> absl::StatusOr<absl::Cord> {
+        if (done) return absl::Cord();
+        done = true;
+        return absl::Cord(data.substr(1500));
+      }));
+  EXPECT_EQ(ReadLocalFile(file_), data);
+}
+
+TEST_P(SshTransferTest, ResumesWriteAtEndOfFile) {
+  std::string data = TestData(2500);
+  std::ofstream(file_) << data.substr(0, 1500);
+  options_.offset = 1500;
+  bool done = false;
+  ASSERT_OK(ssh_conn_.WriteFileInChunks(
+      file_, options_, [&]() -> absl::StatusOr<absl::Cord> {
+        if (done) return absl::Cord();
+        done = true;
+        return absl::Cord(data.substr(1500));
+      }));
+  EXPECT_EQ(ReadLocalFile(file_), data);
+}
+
+TEST_P(SshTransferTest, ResumeWritePastEndOfFileFails) {
+  // Part of what was written before is missing, and must not be replaced
+  // with zeros.
+  std::ofstream(file_) << TestData(1000);
+  options_.offset = 1500;
+  EXPECT_THAT(ssh_conn_.WriteFileInChunks(
+                  file_, options_,
+                  []() -> absl::StatusOr<absl::Cord> {
+                    return absl::Cord("data");
+                  }),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  EXPECT_EQ(ReadLocalFile(file_), TestData(1000));
+}
+
+TEST_P(SshTransferTest, ResumeWriteToMissingFileFails) {
+  std::filesystem::remove(file_);
+  options_.offset = 1500;
+  EXPECT_THAT(ssh_conn_.WriteFileInChunks(
+                  file_, options_,
+                  []() -> absl::StatusOr<absl::Cord> {
+                    return absl::Cord("data");
+                  }),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  EXPECT_FALSE(std::filesystem::exists(file_));
+}
+
+TEST_P(SshTransferTest, DetectsCorruptedChunk) {
+  // The node's cksum disagrees with the data that was sent.
+  FakeSsh(absl::StrCat(kLocalSsh, " 2>&1 | sed 's/^[0-9]* /1 /' >&2"));
+  bool done = false;
+  EXPECT_THAT(ssh_conn_.WriteFileInChunks(
+                  file_, options_,
+                  [&]() -> absl::StatusOr<absl::Cord> {
+                    if (done) return absl::Cord();
+                    done = true;
+                    return absl::Cord("data");
+                  }),
+              StatusIs(absl::StatusCode::kDataLoss));
+}
+
+INSTANTIATE_TEST_SUITE_P(Compression, SshTransferTest, ::testing::Bool());
+
 class SshWithKeyPathTest : public SshTest {
  public:
   SshWithKeyPathTest() : SshTest("ssh_key_path", "") {}
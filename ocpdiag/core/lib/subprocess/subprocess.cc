@@ -0,0 +1,436 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/lib/subprocess/subprocess.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/cleanup/cleanup.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+
+namespace ocpdiag::subprocess {
+
+namespace {
+
+constexpr size_t kReadChunkSize = 64 * 1024;
+constexpr int kMaxEvents = 64;
+// How often exited children are reaped when pidfds are not supported by the
+// kernel. Only used as a fallback.
+constexpr int kFallbackReapIntervalMs = 10;
+
+// What an epoll event refers to. The event data holds the index of the child
+// shifted left by kKindBits, or'ed with the kind.
+enum FdKind : uint64_t {
+  kStdout = 0,
+  kStderr = 1,
+  kStdin = 2,
+  kExit = 3,
+  kTimeout = 4,
+};
+constexpr int kKindBits = 3;
+
+absl::Status ErrnoError(absl::string_view message) {
+  return absl::Status(absl::ErrnoToStatusCode(errno),
+                      absl::StrCat(message, ": ", strerror(errno)));
+}
+
+void CloseFd(int& fd) {
+  if (fd >= 0) {
+    close(fd);
+    fd = -1;
+  }
+}
+
+int OpenPidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+  return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+bool SetNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// Makes `from` available as `to` in the child after exec(). Only calls
+// async-signal-safe functions.
+bool Redirect(int from, int to) {
+  if (from == to) return fcntl(to, F_SETFD, 0) == 0;
+  return dup2(from, to) == to;
+}
+
+// The state of one command while it runs.
+struct Child {
+  pid_t pid = -1;
+  int pidfd = -1;
+  int timerfd = -1;
+  // The parent's ends of the command's stdout, stderr and stdin, indexed by
+  // FdKind.
+  int fds[3] = {-1, -1, -1};
+  absl::string_view pending_stdin;
+  bool timed_out = false;
+  Result result;
+};
+
+// Runs a set of commands from a single epoll loop.
+class EventLoop {
+ public:
+  EventLoop(absl::Span<const Command> commands, int epoll_fd)
+      : commands_(commands),
+        epoll_fd_(epoll_fd),
+        children_(commands.size()),
+        results_(commands.size(),
+                 absl::InternalError("The command was not run.")) {}
+
+  std::vector<absl::StatusOr<Result>> Run(size_t max_concurrency);
+
+ private:
+  // Starts the command at `index`, or returns why it could not be started.
+  absl::Status Spawn(size_t index);
+  absl::Status Watch(int fd, size_t index, FdKind kind, uint32_t events);
+  void HandleEvent(size_t index, FdKind kind);
+  void ReadOutput(Child& child, FdKind kind);
+  void WriteStdin(Child& child);
+  void Kill(Child& child);
+  // Reaps the child if it has exited, and completes its result.
+  void MaybeReap(size_t index, bool block);
+  void Finish(size_t index, int wait_status);
+  // Kills and reaps every running child, failing it with `status`.
+  void Abort(const absl::Status& status);
+
+  absl::Span<const Command> commands_;
+  int epoll_fd_;
+  std::vector<Child> children_;
+  std::vector<absl::StatusOr<Result>> results_;
+  std::vector<size_t> running_;
+  bool has_pidless_children_ = false;
+};
+
+std::vector<absl::StatusOr<Result>> EventLoop::Run(size_t max_concurrency) {
+  size_t next = 0;
+  epoll_event events[kMaxEvents];
+  while (true) {
+    while (next < commands_.size() && running_.size() < max_concurrency) {
+      absl::Status status = Spawn(next);
+      if (status.ok()) {
+        running_.push_back(next);
+      } else {
+        results_[next] = status;
+      }
+      ++next;
+    }
+    if (running_.empty()) break;
+
+    int ready =
+        epoll_wait(epoll_fd_, events, kMaxEvents,
+                   has_pidless_children_ ? kFallbackReapIntervalMs : -1);
+    if (ready < 0) {
+      if (errno == EINTR) continue;
+      Abort(ErrnoError("Failed to wait for commands"));
+      break;
+    }
+    for (int i = 0; i < ready; ++i) {
+      HandleEvent(events[i].data.u64 >> kKindBits,
+                  static_cast<FdKind>(events[i].data.u64 &
+                                      ((1 << kKindBits) - 1)));
+    }
+    if (has_pidless_children_) {
+      for (size_t index : std::vector<size_t>(running_)) {
+        if (children_[index].pidfd < 0) MaybeReap(index, /*block=*/false);
+      }
+    }
+  }
+  return std::move(results_);
+}
+
+absl::Status EventLoop::Spawn(size_t index) {
+  const Command& command = commands_[index];
+  Child& child = children_[index];
+  if (command.args.empty()) {
+    return absl::InvalidArgumentError("Empty args.");
+  }
+
+  // Everything the child needs is prepared before fork(), since only
+  // async-signal-safe calls may follow it in a multithreaded process.
+  std::vector<char*> argv;
+  for (const std::string& arg : command.args) {
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  // The child's ends of its stdout, stderr and stdin.
+  int child_fds[3] = {-1, -1, -1};
+  absl::Cleanup close_fds = [&child, &child_fds] {
+    for (int& fd : child_fds) CloseFd(fd);
+    for (int& fd : child.fds) CloseFd(fd);
+    CloseFd(child.timerfd);
+  };
+  for (FdKind kind : {kStdout, kStderr}) {
+    int pipe_fds[2];
+    if (pipe2(pipe_fds, O_CLOEXEC) != 0) {
+      return ErrnoError("Failed to create pipe for the command");
+    }
+    child.fds[kind] = pipe_fds[0];
+    child_fds[kind] = pipe_fds[1];
+    if (!SetNonBlocking(child.fds[kind])) {
+      return ErrnoError("Failed to set up pipe for the command");
+    }
+  }
+  if (command.stdin_data.empty()) {
+    child_fds[kStdin] = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (child_fds[kStdin] < 0) return ErrnoError("Failed to open /dev/null");
+  } else {
+    // A socket rather than a pipe, so that stdin can be written with
+    // MSG_NOSIGNAL and a command that exits early doesn't raise SIGPIPE.
+    int socket_fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, socket_fds) != 0) {
+      return ErrnoError("Failed to create stdin for the command");
+    }
+    child.fds[kStdin] = socket_fds[0];
+    child_fds[kStdin] = socket_fds[1];
+    if (!SetNonBlocking(child.fds[kStdin]) ||
+        shutdown(child.fds[kStdin], SHUT_RD) != 0) {
+      return ErrnoError("Failed to set up stdin for the command");
+    }
+    child.pending_stdin = command.stdin_data;
+  }
+  if (command.timeout != absl::InfiniteDuration()) {
+    child.timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (child.timerfd < 0) return ErrnoError("Failed to create timer");
+    itimerspec spec = {};
+    // A zero expiration would disarm the timer instead.
+    spec.it_value = absl::ToTimespec(
+        std::max(command.timeout, absl::Nanoseconds(1)));
+    if (timerfd_settime(child.timerfd, 0, &spec, nullptr) != 0) {
+      return ErrnoError("Failed to arm timer");
+    }
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) return ErrnoError("Failed to fork the process");
+
+  // Child process, never returns.
+  if (pid == 0) {
+    // The command gets its own process group, so that it can be killed along
+    // with anything it spawns.
+    setpgid(0, 0);
+    if (!Redirect(child_fds[kStdin], STDIN_FILENO) ||
+        !Redirect(child_fds[kStdout], STDOUT_FILENO) ||
+        !Redirect(child_fds[kStderr], STDERR_FILENO)) {
+      _exit(126);
+    }
+    execvp(argv[0], argv.data());
+    // If a command is not found, the child process created to execute it
+    // returns 127. If a command is found but is not executable, return 126.
+    _exit(errno == ENOENT ? 127 : 126);
+  }
+
+  // Also set the process group from the parent, so that it exists even if the
+  // command times out before the child gets to run.
+  setpgid(pid, pid);
+  child.pid = pid;
+  for (int& fd : child_fds) CloseFd(fd);
+  std::move(close_fds).Cancel();
+
+  child.pidfd = OpenPidfd(pid);
+  absl::Status status = absl::OkStatus();
+  if (child.pidfd >= 0) {
+    status.Update(Watch(child.pidfd, index, kExit, EPOLLIN));
+  } else {
+    has_pidless_children_ = true;
+  }
+  status.Update(Watch(child.fds[kStdout], index, kStdout, EPOLLIN));
+  status.Update(Watch(child.fds[kStderr], index, kStderr, EPOLLIN));
+  if (child.fds[kStdin] >= 0) {
+    status.Update(Watch(child.fds[kStdin], index, kStdin, EPOLLOUT));
+  }
+  if (child.timerfd >= 0) {
+    status.Update(Watch(child.timerfd, index, kTimeout, EPOLLIN));
+  }
+  if (!status.ok()) {
+    Kill(child);
+    int wait_status;
+    while (waitpid(pid, &wait_status, 0) < 0 && errno == EINTR) {
+    }
+    for (int& fd : child.fds) CloseFd(fd);
+    CloseFd(child.pidfd);
+    CloseFd(child.timerfd);
+  }
+  return status;
+}
+
+absl::Status EventLoop::Watch(int fd, size_t index, FdKind kind,
+                              uint32_t events) {
+  epoll_event event = {};
+  event.events = events;
+  event.data.u64 = (static_cast<uint64_t>(index) << kKindBits) | kind;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+    return ErrnoError("Failed to watch the command");
+  }
+  return absl::OkStatus();
+}
+
+void EventLoop::HandleEvent(size_t index, FdKind kind) {
+  Child& child = children_[index];
+  if (child.pid < 0) return;  // Finished earlier in this batch of events.
+  switch (kind) {
+    case kStdout:
+    case kStderr:
+      ReadOutput(child, kind);
+      break;
+    case kStdin:
+      WriteStdin(child);
+      break;
+    case kExit:
+      MaybeReap(index, /*block=*/false);
+      break;
+    case kTimeout:
+      child.timed_out = true;
+      CloseFd(child.timerfd);
+      Kill(child);
+      break;
+  }
+}
+
+void EventLoop::ReadOutput(Child& child, FdKind kind) {
+  std::string& output =
+      kind == kStdout ? child.result.stdout : child.result.stderr;
+  int& fd = child.fds[kind];
+  char buffer[kReadChunkSize];
+  while (fd >= 0) {
+    ssize_t got = read(fd, buffer, sizeof(buffer));
+    if (got > 0) {
+      output.append(buffer, got);
+    } else if (got < 0 && errno == EINTR) {
+      continue;
+    } else if (got < 0 && errno == EAGAIN) {
+      break;
+    } else {
+      CloseFd(fd);
+    }
+  }
+}
+
+void EventLoop::WriteStdin(Child& child) {
+  int& fd = child.fds[kStdin];
+  while (!child.pending_stdin.empty()) {
+    ssize_t wrote = send(fd, child.pending_stdin.data(),
+                         child.pending_stdin.size(), MSG_NOSIGNAL);
+    if (wrote < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN) return;
+      // The command closed its stdin; the rest of the data is dropped.
+      break;
+    }
+    child.pending_stdin.remove_prefix(wrote);
+  }
+  // Closing our end signals the end of the data.
+  CloseFd(fd);
+}
+
+void EventLoop::Kill(Child& child) {
+  if (kill(-child.pid, SIGKILL) != 0) kill(child.pid, SIGKILL);
+}
+
+void EventLoop::MaybeReap(size_t index, bool block) {
+  int wait_status = 0;
+  pid_t waited;
+  do {
+    waited = waitpid(children_[index].pid, &wait_status, block ? 0 : WNOHANG);
+  } while (waited < 0 && errno == EINTR);
+  if (waited == 0) return;
+  if (waited < 0) {
+    results_[index] = ErrnoError("Failed to wait for the child process");
+    wait_status = -1;
+  }
+  Finish(index, wait_status);
+}
+
+void EventLoop::Finish(size_t index, int wait_status) {
+  Child& child = children_[index];
+  // Everything the command wrote before it exited is already in the pipes.
+  // Output from any background processes it left behind is not waited for.
+  ReadOutput(child, kStdout);
+  ReadOutput(child, kStderr);
+  for (int& fd : child.fds) CloseFd(fd);
+  CloseFd(child.pidfd);
+  CloseFd(child.timerfd);
+  child.pid = -1;
+  running_.erase(std::find(running_.begin(), running_.end(), index));
+
+  if (wait_status == -1) return;  // The error is already in the result.
+  const Command& command = commands_[index];
+  if (child.timed_out) {
+    results_[index] = absl::DeadlineExceededError(
+        absl::StrFormat("Command failed to finish in %s.",
+                        absl::FormatDuration(command.timeout)));
+  } else if (WIFEXITED(wait_status)) {
+    child.result.exit_code = WEXITSTATUS(wait_status);
+    results_[index] = std::move(child.result);
+  } else if (WIFSIGNALED(wait_status)) {
+    child.result.term_signal = WTERMSIG(wait_status);
+    results_[index] = std::move(child.result);
+  } else {
+    results_[index] = absl::InternalError(absl::StrCat(
+        "Unexpected state: waitpid returned when subprocess neither exited "
+        "nor terminated by signal. status=",
+        wait_status));
+  }
+}
+
+void EventLoop::Abort(const absl::Status& status) {
+  for (size_t index : std::vector<size_t>(running_)) {
+    Kill(children_[index]);
+    MaybeReap(index, /*block=*/true);
+    results_[index] = status;
+  }
+}
+
+}  // namespace
+
+absl::StatusOr<Result> RunCommand(const Command& command) {
+  return std::move(RunCommands(absl::MakeConstSpan(&command, 1))[0]);
+}
+
+std::vector<absl::StatusOr<Result>> RunCommands(
+    absl::Span<const Command> commands, int max_concurrency) {
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    return std::vector<absl::StatusOr<Result>>(
+        commands.size(), ErrnoError("Failed to create epoll instance"));
+  }
+  absl::Cleanup close_epoll = [epoll_fd] { close(epoll_fd); };
+  return EventLoop(commands, epoll_fd)
+      .Run(max_concurrency > 0 ? max_concurrency : commands.size());
+}
+
+}  // namespace ocpdiag::subprocess
@@ -0,0 +1,59 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_LIB_SUBPROCESS_SUBPROCESS_H_
+#define OCPDIAG_CORE_LIB_SUBPROCESS_SUBPROCESS_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "absl/types/span.h"
+
+namespace ocpdiag::subprocess {
+
+// A command to run as a local subprocess.
+struct Command {
+  // The program and its arguments. The program is looked up in PATH.
+  std::vector<std::string> args;
+  // Data written to the command's stdin, which is closed once it has all been
+  // written. The data must outlive the call that runs the command. Commands
+  // without stdin data read from /dev/null.
+  absl::string_view stdin_data;
+  // The command, and everything in its process group, is killed if it runs
+  // for longer than this.
+  absl::Duration timeout = absl::InfiniteDuration();
+};
+
+// The outcome of a command that ran to completion.
+struct Result {
+  // The exit status of the command, if it exited normally. If exec() fails,
+  // this is 127 when the program isn't found and 126 otherwise.
+  int exit_code = 0;
+  // The signal that terminated the command, or zero if it exited normally.
+  int term_signal = 0;
+  std::string stdout;
+  std::string stderr;
+};
+
+// Runs a command and collects its output. Returns DeadlineExceededError if the
+// command times out.
+absl::StatusOr<Result> RunCommand(const Command& command);
+
+// Runs commands concurrently and returns the result of each, in order. All of
+// the children are driven by a single epoll loop on the calling thread: their
+// output is streamed from pipes as it is produced, their exit is observed
+// through a pidfd, and their timeouts are enforced with timerfds, so the call
+// returns as soon as the last command finishes. At most `max_concurrency`
+// commands run at once, or all of them if it is zero.
+std::vector<absl::StatusOr<Result>> RunCommands(
+    absl::Span<const Command> commands, int max_concurrency = 0);
+
+}  // namespace ocpdiag::subprocess
+
+#endif  // OCPDIAG_CORE_LIB_SUBPROCESS_SUBPROCESS_H_
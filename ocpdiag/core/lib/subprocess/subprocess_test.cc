@@ -0,0 +1,182 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/lib/subprocess/subprocess.h"
+
+#include <signal.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::subprocess {
+namespace {
+
+using ::ocpdiag::testing::StatusIs;
+using ::testing::HasSubstr;
+
+// Returns whether `pid` is a live process, as opposed to one that has exited,
+// or one that has been killed and is waiting to be reaped.
+bool IsRunning(pid_t pid) {
+  std::string stat;
+  std::getline(std::ifstream(absl::StrCat("/proc/", pid, "/stat")), stat);
+  size_t state = stat.rfind(')');
+  return state != std::string::npos && state + 2 < stat.size() &&
+         stat[state + 2] != 'Z';
+}
+
+TEST(SubprocessTest, CollectsOutputAndExitCode) {
+  absl::StatusOr<Result> result =
+      RunCommand({.args = {"sh", "-c", "echo out; echo err >&2; exit 3"}});
+  ASSERT_OK(result);
+  EXPECT_EQ(result->exit_code, 3);
+  EXPECT_EQ(result->term_signal, 0);
+  EXPECT_EQ(result->stdout, "out\n");
+  EXPECT_EQ(result->stderr, "err\n");
+}
+
+TEST(SubprocessTest, CollectsOutputLargerThanPipeBuffer) {
+  absl::StatusOr<Result> result =
+      RunCommand({.args = {"head", "-c", "1000000", "/dev/zero"}});
+  ASSERT_OK(result);
+  EXPECT_EQ(result->exit_code, 0);
+  EXPECT_EQ(result->stdout.size(), 1000000);
+}
+
+TEST(SubprocessTest, WritesStdin) {
+  std::string input(1000000, 'x');
+  absl::StatusOr<Result> result =
+      RunCommand({.args = {"wc", "-c"}, .stdin_data = input});
+  ASSERT_OK(result);
+  EXPECT_EQ(result->stdout, "1000000\n");
+}
+
+TEST(SubprocessTest, CommandIgnoringStdinDoesNotFail) {
+  std::string input(1000000, 'x');
+  absl::StatusOr<Result> result =
+      RunCommand({.args = {"true"}, .stdin_data = input});
+  ASSERT_OK(result);
+  EXPECT_EQ(result->exit_code, 0);
+}
+
+TEST(SubprocessTest, StdinIsEmptyByDefault) {
+  absl::StatusOr<Result> result = RunCommand({.args = {"cat"}});
+  ASSERT_OK(result);
+  EXPECT_EQ(result->stdout, "");
+}
+
+TEST(SubprocessTest, NoSuchCommand) {
+  absl::StatusOr<Result> result = RunCommand({.args = {"/no/such/command"}});
+  ASSERT_OK(result);
+  EXPECT_EQ(result->exit_code, 127);
+}
+
+TEST(SubprocessTest, NotExecutable) {
+  absl::StatusOr<Result> result = RunCommand({.args = {"/dev/null"}});
+  ASSERT_OK(result);
+  EXPECT_EQ(result->exit_code, 126);
+}
+
+TEST(SubprocessTest, ReportsTerminatingSignal) {
+  absl::StatusOr<Result> result =
+      RunCommand({.args = {"sh", "-c", "kill -9 $$"}});
+  ASSERT_OK(result);
+  EXPECT_EQ(result->term_signal, SIGKILL);
+}
+
+TEST(SubprocessTest, EmptyArgs) {
+  EXPECT_THAT(RunCommand({}), StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(SubprocessTest, ReturnsAsSoonAsCommandExits) {
+  absl::Time start = absl::Now();
+  ASSERT_OK(RunCommand({.args = {"true"}}));
+  EXPECT_LT(absl::Now() - start, absl::Milliseconds(100));
+}
+
+TEST(SubprocessTest, TimeoutKillsProcessGroup) {
+  std::string pid_file = absl::StrCat(::testing::TempDir(), "/subprocess_pid");
+  EXPECT_THAT(
+      RunCommand({.args = {"sh", "-c",
+                    absl::StrCat("sleep 100 & echo $! >", pid_file, "; wait")},
+           .timeout = absl::Milliseconds(200)}),
+      StatusIs(absl::StatusCode::kDeadlineExceeded,
+               HasSubstr("failed to finish")));
+
+  // The background sleep was in the command's process group, so it was
+  // killed along with the shell.
+  pid_t background_pid = 0;
+  std::ifstream(pid_file) >> background_pid;
+  ASSERT_GT(background_pid, 0);
+  absl::Time deadline = absl::Now() + absl::Seconds(10);
+  while (IsRunning(background_pid) && absl::Now() < deadline) {
+    absl::SleepFor(absl::Milliseconds(10));
+  }
+  EXPECT_FALSE(IsRunning(background_pid));
+}
+
+TEST(SubprocessTest, DoesNotWaitForBackgroundProcesses) {
+  absl::StatusOr<Result> result =
+      RunCommand({.args = {"sh", "-c", "sleep 100 & echo started"},
+           .timeout = absl::Seconds(10)});
+  ASSERT_OK(result);
+  EXPECT_EQ(result->stdout, "started\n");
+}
+
+TEST(SubprocessTest, RunCommandsRunsCommandsConcurrently) {
+  std::vector<Command> commands(20, {.args = {"sleep", "0.5"}});
+  commands.push_back({.args = {"sh", "-c", "echo last"}});
+  absl::Time start = absl::Now();
+  std::vector<absl::StatusOr<Result>> results = RunCommands(commands);
+  EXPECT_LT(absl::Now() - start, absl::Seconds(5));
+
+  ASSERT_EQ(results.size(), commands.size());
+  for (int i = 0; i < 20; ++i) {
+    ASSERT_OK(results[i]);
+    EXPECT_EQ(results[i]->exit_code, 0);
+  }
+  ASSERT_OK(results.back());
+  EXPECT_EQ(results.back()->stdout, "last\n");
+}
+
+TEST(SubprocessTest, RunCommandsLimitsConcurrency) {
+  // Each command fails if another one is running at the same time.
+  std::string lock = absl::StrCat(::testing::TempDir(), "/subprocess_lock");
+  std::string script = absl::StrCat("mkdir ", lock, " && sleep 0.05 && rmdir ",
+                                    lock);
+  std::vector<Command> commands(5, {.args = {"sh", "-c", script}});
+  std::vector<absl::StatusOr<Result>> results =
+      RunCommands(commands, /*max_concurrency=*/1);
+  for (const absl::StatusOr<Result>& result : results) {
+    ASSERT_OK(result);
+    EXPECT_EQ(result->exit_code, 0) << result->stderr;
+  }
+}
+
+TEST(SubprocessTest, RunCommandsReportsEachFailureSeparately) {
+  std::vector<Command> commands = {
+      {.args = {"true"}},
+      {},
+      {.args = {"sleep", "100"}, .timeout = absl::Milliseconds(10)},
+  };
+  std::vector<absl::StatusOr<Result>> results = RunCommands(commands);
+  ASSERT_EQ(results.size(), 3);
+  EXPECT_OK(results[0]);
+  EXPECT_THAT(results[1], StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(results[2], StatusIs(absl::StatusCode::kDeadlineExceeded));
+}
+
+}  // namespace
+}  // namespace ocpdiag::subprocess
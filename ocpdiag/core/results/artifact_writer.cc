@@ -11,6 +11,7 @@
 #include <ostream>
 #include <string>
 #include <thread>  //
+#include <vector>
 
 #include "absl/log/check.h"
 #include "absl/status/status.h"
@@ -34,7 +35,7 @@ constexpr absl::Duration kFlushFreq = absl::Minutes(1);
 ArtifactWriter::ArtifactWriter(absl::string_view output_filepath,
                                std::ostream* output_stream,
                                bool flush_each_minute)
-    : output_filepath_(output_filepath),
+    : output_filepath_(std::string(output_filepath)),
       output_stream_(output_stream),
       flush_each_minute_(flush_each_minute) {
   CHECK(!output_filepath.empty() || output_stream_ != nullptr)
@@ -44,6 +45,17 @@ ArtifactWriter::ArtifactWriter(absl::string_view output_filepath,
   SetupPeriodicFlush();
 }
 
+ArtifactWriter::ArtifactWriter(
+    std::vector<ocpdiag_results_v2_pb::OutputArtifact>* output_artifacts,
+    std::ostream* output_stream)
+    : output_stream_(output_stream),
+      output_artifacts_(output_artifacts),
+      flush_each_minute_(false) {
+  CHECK(output_artifacts_ != nullptr)
+      << "Must specify a valid artifact vector when creating an in-memory "
+         "artifact writer.";
+}
+
 void ArtifactWriter::SetupRecordWriter() {
   if (output_filepath_.empty()) return;
   riegeli::RecordsMetadata metadata;
@@ -108,6 +120,7 @@ void ArtifactWriter::Write(ocpdiag_results_v2_pb::OutputArtifact& artifact) {
   artifact.set_sequence_number(sequence_number_.Next());
   WriteToFile(artifact);
   WriteToStream(artifact);
+  WriteToMemory(artifact);
 }
 
 void ArtifactWriter::WriteToFile(
@@ -149,6 +162,12 @@ void ArtifactWriter::WriteToStream(
   *output_stream_ << json << std::endl;
 }
 
+void ArtifactWriter::WriteToMemory(
+    const ocpdiag_results_v2_pb::OutputArtifact& artifact) {
+  if (output_artifacts_ == nullptr) return;
+  output_artifacts_->push_back(artifact);
+}
+
 ArtifactWriter::~ArtifactWriter() {
   absl::ReleasableMutexLock releasable_lock(&mutex_);
   stop_flush_routine_ = true;
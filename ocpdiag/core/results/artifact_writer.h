@@ -8,7 +8,9 @@
 #define OCPDIAG_LIB_RESULTS_INTERNAL_LOGGING_H_
 
 #include <ostream>
+#include <string>
 #include <thread>  //
+#include <vector>
 
 #include "absl/base/thread_annotations.h"
 #include "absl/strings/string_view.h"
@@ -28,6 +30,14 @@ class ArtifactWriter {
   ArtifactWriter(absl::string_view output_filepath,
                  std::ostream* output_stream = nullptr,
                  bool flush_each_minute = true);
+  // Appends artifacts to output_artifacts instead of writing them to a file,
+  // which avoids file I/O in unit tests. The vector must outlive the writer.
+  // Appends are serialized by the writer's mutex, but readers do not take it,
+  // so the vector may only be read once nothing can write to it any more,
+  // i.e. after the TestRun owning this writer has ended.
+  explicit ArtifactWriter(
+      std::vector<ocpdiag_results_v2_pb::OutputArtifact>* output_artifacts,
+      std::ostream* output_stream = nullptr);
   ~ArtifactWriter();
 
   // Flushes the file buffer, if any
@@ -51,10 +61,14 @@ class ArtifactWriter {
       ABSL_SHARED_LOCKS_REQUIRED(&mutex_);
   void WriteToStream(const ocpdiag_results_v2_pb::OutputArtifact& artifact)
       ABSL_SHARED_LOCKS_REQUIRED(&mutex_);
+  void WriteToMemory(const ocpdiag_results_v2_pb::OutputArtifact& artifact)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   absl::Mutex mutex_;
-  absl::string_view output_filepath_;
+  const std::string output_filepath_;
   std::ostream* output_stream_ ABSL_GUARDED_BY(mutex_);
+  std::vector<ocpdiag_results_v2_pb::OutputArtifact>* output_artifacts_
+      ABSL_GUARDED_BY(mutex_) = nullptr;
   bool flush_each_minute_ = true;
   riegeli::RecordWriter<riegeli::FdWriter<>> output_file_writer_
       ABSL_GUARDED_BY(mutex_){riegeli::kClosed};
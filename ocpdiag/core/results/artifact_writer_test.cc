@@ -11,6 +11,7 @@
 #include <cstdlib>
 #include <filesystem>  //
 #include <thread>      //
+#include <vector>
 
 #include "google/protobuf/struct.pb.h"
 #include "gmock/gmock.h"
@@ -155,6 +156,33 @@ TEST(ArtifactWriterTest, TestStepArtifactWritesSuccessfully) {
               )pb"))));
 }
 
+TEST(ArtifactWriterDeathTest, NullArtifactVectorCausesDeath) {
+  EXPECT_DEATH(
+      ArtifactWriter(
+          static_cast<std::vector<ocpdiag_results_v2_pb::OutputArtifact>*>(
+              nullptr)),
+      "valid artifact vector");
+}
+
+TEST(ArtifactWriterTest, InMemoryWriterStoresArtifacts) {
+  ocpdiag_results_v2_pb::SchemaVersion input_proto;
+  input_proto.set_major(2);
+  std::vector<ocpdiag_results_v2_pb::OutputArtifact> artifacts;
+  std::stringstream json_stream;
+  {
+    ArtifactWriter writer(&artifacts, &json_stream);
+    writer.Write(input_proto);
+    writer.Write(input_proto);
+  }
+
+  ASSERT_EQ(artifacts.size(), 2);
+  EXPECT_THAT(artifacts[1], Partially(EqualsProto(R"pb(
+                schema_version { major: 2 }
+                sequence_number: 1
+              )pb")));
+  EXPECT_THAT(json_stream.str(), HasSubstr("\"schemaVersion\""));
+}
+
 TEST(ArtifactWriterTest, SimultaneousWritesExecuteSuccessfully) {
   std::string tmp_filepath = GetTempFilepath();
   {
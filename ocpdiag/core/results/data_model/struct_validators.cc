@@ -6,160 +6,317 @@
 
 #include "ocpdiag/core/results/data_model/struct_validators.h"
 
+#include <string>
 #include <variant>
 
 #include "absl/log/check.h"
-#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "ocpdiag/core/compat/status_macros.h"
 #include "ocpdiag/core/results/data_model/input_model.h"
+#include "ocpdiag/core/results/data_model/output_model.h"
 #include "ocpdiag/core/results/data_model/variant.h"
 
 namespace ocpdiag::results {
 
-void ValidateStructOrDie(const Validator& validator) {
+namespace {
+
+template <typename MeasurementSeriesStartStruct>
+absl::Status ValidateMeasurementSeriesStart(
+    const MeasurementSeriesStartStruct& measurement_series_start) {
+  if (measurement_series_start.name.empty()) {
+    return absl::InvalidArgumentError(
+        "Must specify the name field of the measurement series start struct");
+  }
+  if (measurement_series_start.subcomponent.has_value())
+    RETURN_IF_ERROR(ValidateStruct(*measurement_series_start.subcomponent));
+
+  if (measurement_series_start.validators.empty()) return absl::OkStatus();
+  for (const Validator& validator : measurement_series_start.validators)
+    RETURN_IF_ERROR(ValidateStruct(validator));
+  int type_index = measurement_series_start.validators[0].value[0].index();
+  for (const Validator& validator : measurement_series_start.validators) {
+    if (type_index != validator.value[0].index()) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "All validators must be the same type for measurement series start: ",
+          measurement_series_start.name));
+    }
+  }
+  return absl::OkStatus();
+}
+
+template <typename MeasurementStruct>
+absl::Status ValidateMeasurement(const MeasurementStruct& measurement) {
+  if (measurement.name.empty()) {
+    return absl::InvalidArgumentError(
+        "Must specify the name field of the measurement struct");
+  }
+  if (measurement.subcomponent.has_value())
+    RETURN_IF_ERROR(ValidateStruct(*measurement.subcomponent));
+
+  int type_index = measurement.value.index();
+  for (const Validator& validator : measurement.validators) {
+    RETURN_IF_ERROR(ValidateStruct(validator));
+    if (type_index != validator.value[0].index()) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("All validators and the value must be the same type for "
+                       "measurement: ",
+                       measurement.name));
+    }
+  }
+  return absl::OkStatus();
+}
+
+template <typename DiagnosisStruct>
+absl::Status ValidateDiagnosis(const DiagnosisStruct& diagnosis) {
+  if (diagnosis.verdict.empty()) {
+    return absl::InvalidArgumentError(
+        "Must specify the verdict field of the diagnosis struct");
+  }
+  if (diagnosis.type == DiagnosisType::kUnknown)
+    return absl::InvalidArgumentError("Must specify a type for all diagnoses");
+  if (diagnosis.subcomponent.has_value())
+    RETURN_IF_ERROR(ValidateStruct(*diagnosis.subcomponent));
+  return absl::OkStatus();
+}
+
+template <typename ErrorStruct>
+absl::Status ValidateError(const ErrorStruct& error) {
+  if (error.symptom.empty()) {
+    return absl::InvalidArgumentError(
+        "Must specify the symptom field of the error struct");
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+absl::Status ValidateStruct(const Validator& validator) {
   absl::string_view identifier = validator.name;
   if (identifier.empty()) identifier = "Unnamed Validator";
-  CHECK(!validator.value.empty())
-      << "At least one value must be specified for validator: " << identifier;
+  if (validator.value.empty()) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "At least one value must be specified for validator: ", identifier));
+  }
   int type_index = validator.value[0].index();
   for (const Variant& variant : validator.value) {
-    CHECK(variant.index() == type_index)
-        << "All values must be of the same type for validator: " << identifier;
+    if (variant.index() != type_index) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "All values must be of the same type for validator: ", identifier));
+    }
   }
 
   switch (validator.type) {
     case ValidatorType::kEqual:
     case ValidatorType::kNotEqual:
-      CHECK(validator.value.size() == 1)
-          << "Must specify exactly one value for EQUAL or NOT EQUAL validator: "
-          << identifier;
+      if (validator.value.size() != 1) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Must specify exactly one value for EQUAL or NOT "
+                         "EQUAL validator: ",
+                         identifier));
+      }
       break;
     case ValidatorType::kLessThan:
     case ValidatorType::kLessThanOrEqual:
     case ValidatorType::kGreaterThan:
     case ValidatorType::kGreaterThanOrEqual:
-      CHECK(validator.value.size() == 1)
-          << "Must specify exactly one value for numerical comparison type "
-             "validator: "
-          << identifier;
-      CHECK(std::holds_alternative<double>(validator.value[0]))
-          << "Value must be numerical for numerical comparison validator: "
-          << identifier;
+      if (validator.value.size() != 1) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Must specify exactly one value for numerical "
+                         "comparison type validator: ",
+                         identifier));
+      }
+      if (!std::holds_alternative<double>(validator.value[0])) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Value must be numerical for numerical comparison "
+                         "validator: ",
+                         identifier));
+      }
       break;
     case ValidatorType::kRegexMatch:
     case ValidatorType::kRegexNoMatch:
-      CHECK(std::holds_alternative<std::string>(validator.value[0]))
-          << "Value must be a string or string collection for REGEX validator: "
-          << identifier;
+      if (!std::holds_alternative<std::string>(validator.value[0])) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Value must be a string or string collection for "
+                         "REGEX validator: ",
+                         identifier));
+      }
       break;
     case ValidatorType::kInSet:
     case ValidatorType::kNotInSet:
-      CHECK(std::holds_alternative<std::string>(validator.value[0]) ||
-            std::holds_alternative<double>(validator.value[0]))
-          << "Value must be a string or numerical type for set validator: "
-          << identifier;
+      if (!std::holds_alternative<std::string>(validator.value[0]) &&
+          !std::holds_alternative<double>(validator.value[0])) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Value must be a string or numerical type for set "
+                         "validator: ",
+                         identifier));
+      }
       break;
     default:
-      LOG(FATAL) << "Must specify type for validator: " << identifier;
-      break;
+      return absl::InvalidArgumentError(
+          absl::StrCat("Must specify type for validator: ", identifier));
   }
+  return absl::OkStatus();
 }
 
-void ValidateStructOrDie(const HardwareInfo& hardware_info) {
-  CHECK(!hardware_info.name.empty())
-      << "Must specify the name field of the hardware info struct";
+absl::Status ValidateStruct(const HardwareInfo& hardware_info) {
+  if (hardware_info.name.empty()) {
+    return absl::InvalidArgumentError(
+        "Must specify the name field of the hardware info struct");
+  }
+  return absl::OkStatus();
 }
 
-void ValidateStructOrDie(const SoftwareInfo& software_info) {
-  CHECK(!software_info.name.empty())
-      << "Must specify the name field of the software info struct";
+absl::Status ValidateStruct(const SoftwareInfo& software_info) {
+  if (software_info.name.empty()) {
+    return absl::InvalidArgumentError(
+        "Must specify the name field of the software info struct");
+  }
+  return absl::OkStatus();
 }
 
-void ValidateStructOrDie(const PlatformInfo& platform_info) {
-  CHECK(!platform_info.info.empty())
-      << "Must specify the info field of the platform info struct";
+absl::Status ValidateStruct(const PlatformInfo& platform_info) {
+  if (platform_info.info.empty()) {
+    return absl::InvalidArgumentError(
+        "Must specify the info field of the platform info struct");
+  }
+  return absl::OkStatus();
 }
 
-void ValidateStructOrDie(const Subcomponent& subcomponent) {
-  CHECK(!subcomponent.name.empty())
-      << "Must specify the name field of the subcomponent struct";
+absl::Status ValidateStruct(const Subcomponent& subcomponent) {
+  if (subcomponent.name.empty()) {
+    return absl::InvalidArgumentError(
+        "Must specify the name field of the subcomponent struct");
+  }
+  return absl::OkStatus();
 }
 
-void ValidateStructOrDie(
+absl::Status ValidateStruct(
     const MeasurementSeriesStart& measurement_series_start) {
-  CHECK(!measurement_series_start.name.empty())
-      << "Must specify the name field of the measurement series start struct";
-  if (measurement_series_start.subcomponent.has_value())
-    ValidateStructOrDie(*measurement_series_start.subcomponent);
+  return ValidateMeasurementSeriesStart(measurement_series_start);
+}
 
-  if (measurement_series_start.validators.empty()) return;
-  int type_index = measurement_series_start.validators[0].value[0].index();
-  for (const Validator& validator : measurement_series_start.validators) {
-    ValidateStructOrDie(validator);
-    CHECK(type_index == -1 || type_index == validator.value[0].index())
-        << "All validators must be the same type for measurement series start: "
-        << measurement_series_start.name;
-  }
+absl::Status ValidateStruct(
+    const MeasurementSeriesStartOutput& measurement_series_start) {
+  return ValidateMeasurementSeriesStart(measurement_series_start);
 }
 
-void ValidateStructOrDie(const Measurement& measurement) {
-  CHECK(!measurement.name.empty())
-      << "Must specify the name field of the measurement struct";
-  if (measurement.subcomponent.has_value())
-    ValidateStructOrDie(*measurement.subcomponent);
+absl::Status ValidateStruct(const Measurement& measurement) {
+  return ValidateMeasurement(measurement);
+}
 
-  int type_index = measurement.value.index();
-  for (const Validator& validator : measurement.validators) {
-    ValidateStructOrDie(validator);
-    CHECK(type_index == validator.value[0].index())
-        << "All validators and the value must be the same type for "
-           "measurement: "
-        << measurement.name;
-  }
+absl::Status ValidateStruct(const MeasurementOutput& measurement) {
+  return ValidateMeasurement(measurement);
 }
 
-void ValidateStructOrDie(const Diagnosis& diagnosis) {
-  CHECK(!diagnosis.verdict.empty())
-      << "Must specify the verdict field of the diagnosis struct";
-  CHECK(diagnosis.type != DiagnosisType::kUnknown)
-      << "Must specify a type for all diagnoses";
-  if (diagnosis.subcomponent.has_value())
-    ValidateStructOrDie(*diagnosis.subcomponent);
+absl::Status ValidateStruct(const Diagnosis& diagnosis) {
+  return ValidateDiagnosis(diagnosis);
 }
 
-void ValidateStructOrDie(const Error& error) {
-  CHECK(!error.symptom.empty())
-      << "Must specify the symptom field of the error struct";
+absl::Status ValidateStruct(const DiagnosisOutput& diagnosis) {
+  return ValidateDiagnosis(diagnosis);
+}
+
+absl::Status ValidateStruct(const Error& error) { return ValidateError(error); }
+
+absl::Status ValidateStruct(const ErrorOutput& error) {
+  return ValidateError(error);
 }
 
-void ValidateStructOrDie(const Log& log) {
-  CHECK(!log.message.empty()) << "Must specify the message field of the log";
+absl::Status ValidateStruct(const Log& log) {
+  if (log.message.empty()) {
+    return absl::InvalidArgumentError(
+        "Must specify the message field of the log");
+  }
+  return absl::OkStatus();
 }
 
-void ValidateStructOrDie(const File& file) {
-  CHECK(!file.display_name.empty())
-      << "Must specify the display name of the file struct";
-  CHECK(!file.uri.empty()) << "Must specify the URI of the file struct: "
-                           << file.display_name;
+absl::Status ValidateStruct(const File& file) {
+  if (file.display_name.empty()) {
+    return absl::InvalidArgumentError(
+        "Must specify the display name of the file struct");
+  }
+  if (file.uri.empty()) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Must specify the URI of the file struct: ", file.display_name));
+  }
   //
   // implemented
+  return absl::OkStatus();
 }
 
+absl::Status ValidateStruct(const TestRunStart& test_run_info) {
+  if (test_run_info.name.empty()) {
+    return absl::InvalidArgumentError(
+        "Must specify the name of the test run info");
+  }
+  if (test_run_info.version.empty()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Must specify the version in the test run info: ",
+                     test_run_info.name));
+  }
+  if (test_run_info.command_line.empty()) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Must specify the command line invocation in the test run info: ",
+        test_run_info.name));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ValidateStruct(const Extension& extension) {
+  if (extension.name.empty())
+    return absl::InvalidArgumentError("Must specify the name of the extension");
+  if (extension.content_json.empty()) {
+    return absl::InvalidArgumentError(
+        "Must specify the content of the extension");
+  }
+  return absl::OkStatus();
+}
+
+void ValidateStructOrDie(const Validator& validator) {
+  CHECK_OK(ValidateStruct(validator));
+}
+
+void ValidateStructOrDie(const HardwareInfo& hardware_info) {
+  CHECK_OK(ValidateStruct(hardware_info));
+}
+
+void ValidateStructOrDie(const SoftwareInfo& software_info) {
+  CHECK_OK(ValidateStruct(software_info));
+}
+
+void ValidateStructOrDie(const PlatformInfo& platform_info) {
+  CHECK_OK(ValidateStruct(platform_info));
+}
+
+void ValidateStructOrDie(
+    const MeasurementSeriesStart& measurement_series_start) {
+  CHECK_OK(ValidateStruct(measurement_series_start));
+}
+
+void ValidateStructOrDie(const Measurement& measurement) {
+  CHECK_OK(ValidateStruct(measurement));
+}
+
+void ValidateStructOrDie(const Diagnosis& diagnosis) {
+  CHECK_OK(ValidateStruct(diagnosis));
+}
+
+void ValidateStructOrDie(const Error& error) {
+  CHECK_OK(ValidateStruct(error));
+}
+
+void ValidateStructOrDie(const Log& log) { CHECK_OK(ValidateStruct(log)); }
+
+void ValidateStructOrDie(const File& file) { CHECK_OK(ValidateStruct(file)); }
+
 void ValidateStructOrDie(const TestRunStart& test_run_info) {
-  CHECK(!test_run_info.name.empty())
-      << "Must specify the name of the test run info";
-  CHECK(!test_run_info.version.empty())
-      << "Must specify the version in the test run info: "
-      << test_run_info.name;
-  CHECK(!test_run_info.command_line.empty())
-      << "Must specify the command line invocation in the test run info: "
-      << test_run_info.name;
+  CHECK_OK(ValidateStruct(test_run_info));
 }
 
 void ValidateStructOrDie(const Extension& extension) {
-  CHECK(!extension.name.empty()) << "Must specify the name of the extension";
-  CHECK(!extension.content_json.empty())
-      << "Must specify the content of the extension";
+  CHECK_OK(ValidateStruct(extension));
 }
 
 }  // namespace ocpdiag::results
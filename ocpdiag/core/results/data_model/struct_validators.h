@@ -9,10 +9,38 @@
 #ifndef OCPDIAG_CORE_RESULTS_OCP_STRUCT_VALIDATORS_H_
 #define OCPDIAG_CORE_RESULTS_OCP_STRUCT_VALIDATORS_H_
 
+#include "absl/status/status.h"
 #include "ocpdiag/core/results/data_model/input_model.h"
+#include "ocpdiag/core/results/data_model/output_model.h"
 
 namespace ocpdiag::results {
 
+// Returns an InvalidArgumentError describing the first way in which the struct
+// does not meet the OCP spec, or OkStatus if it is valid.
+absl::Status ValidateStruct(const Validator& validator);
+absl::Status ValidateStruct(const HardwareInfo& hardware_info);
+absl::Status ValidateStruct(const SoftwareInfo& software_info);
+absl::Status ValidateStruct(const PlatformInfo& platform_info);
+absl::Status ValidateStruct(const Subcomponent& subcomponent);
+absl::Status ValidateStruct(
+    const MeasurementSeriesStart& measurement_series_start);
+absl::Status ValidateStruct(const Measurement& measurement);
+absl::Status ValidateStruct(const Diagnosis& diagnosis);
+absl::Status ValidateStruct(const Error& error);
+absl::Status ValidateStruct(const Log& log);
+absl::Status ValidateStruct(const File& file);
+absl::Status ValidateStruct(const TestRunStart& test_run_info);
+absl::Status ValidateStruct(const Extension& extension);
+
+// Output structs are checked against the same rules as their input
+// counterparts, so that emitted results can be validated offline.
+absl::Status ValidateStruct(
+    const MeasurementSeriesStartOutput& measurement_series_start);
+absl::Status ValidateStruct(const MeasurementOutput& measurement);
+absl::Status ValidateStruct(const DiagnosisOutput& diagnosis);
+absl::Status ValidateStruct(const ErrorOutput& error);
+
+// Same as above, but crash the program if the struct is invalid.
 void ValidateStructOrDie(const Validator& validator);
 void ValidateStructOrDie(const HardwareInfo& hardware_info);
 void ValidateStructOrDie(const SoftwareInfo& software_info);
@@ -8,10 +8,15 @@
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/status/status.h"
 #include "ocpdiag/core/results/data_model/input_model.h"
+#include "ocpdiag/core/results/data_model/output_model.h"
+#include "ocpdiag/core/testing/status_matchers.h"
 
 namespace ocpdiag::results {
 
+using ::ocpdiag::testing::StatusIs;
+using ::testing::HasSubstr;
 using ::testing::Values;
 
 class ValidValidatorStructTest : public ::testing::TestWithParam<Validator> {};
@@ -369,4 +374,25 @@ INSTANTIATE_TEST_SUITE_P(
                {.extension = {.name = "No content JSON"},
                 .want_error_regex = "content of the extension"})));
 
+TEST(ValidateStructTest, InvalidStructReturnsInvalidArgument) {
+  EXPECT_THAT(ValidateStruct(Log({.message = ""})),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("message field of the log")));
+  EXPECT_OK(ValidateStruct(Log({.message = "Valid message"})));
+}
+
+TEST(ValidateStructTest, OutputStructsFollowInputRules) {
+  EXPECT_THAT(ValidateStruct(DiagnosisOutput({.verdict = "verdict"})),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("type for all diagnoses")));
+  EXPECT_THAT(
+      ValidateStruct(MeasurementOutput({
+          .name = "measurement",
+          .validators = {{.type = ValidatorType::kEqual, .value = {"str"}}},
+          .value = 10.,
+      })),
+      StatusIs(absl::StatusCode::kInvalidArgument, HasSubstr("same type")));
+  EXPECT_OK(ValidateStruct(ErrorOutput({.symptom = "symptom"})));
+}
+
 }  // namespace ocpdiag::results
@@ -14,7 +14,12 @@
 
 namespace ocpdiag::results::internal {
 
-// Custom ABSL LogSink that redirect the ABSL log to the global ArtifactWriter.
+// Custom ABSL LogSink that redirect the ABSL log to an ArtifactWriter.
+//
+// Several sinks may be registered at once when multiple TestRuns are active in
+// the same program. A thread can be bound to a single sink with
+// ScopedLogSinkRouting, in which case only that sink records its logs. Logs
+// from unbound threads are recorded by every registered sink.
 class LogSink : public absl::LogSink {
  public:
   LogSink(ArtifactWriter& writer) : writer_(writer) {}
@@ -22,6 +27,8 @@ class LogSink : public absl::LogSink {
   // Log function that directly logs the message with ArtifactWriter. This will
   // allow logging without TestRun or TestStep.
   void Send(const absl::LogEntry& entry) final {
+    const LogSink* routed_sink = RoutedSink();
+    if (routed_sink != nullptr && routed_sink != this) return;
     ocpdiag_results_v2_pb::TestRunArtifact run_proto;
     ocpdiag_results_v2_pb::Log* log_proto = run_proto.mutable_log();
     log_proto->set_message(std::string(entry.text_message()));
@@ -35,9 +42,34 @@ class LogSink : public absl::LogSink {
   void Flush() final { writer_.Flush(); }
 
  private:
+  friend class ScopedLogSinkRouting;
+
+  // Returns the sink the calling thread is bound to, or nullptr if unbound.
+  static const LogSink*& RoutedSink() {
+    thread_local const LogSink* routed_sink = nullptr;
+    return routed_sink;
+  }
+
   ArtifactWriter& writer_;
 };
 
+// Binds the calling thread to the given sink for the lifetime of this object,
+// so that logs emitted from the thread are only recorded by that sink. Bindings
+// nest, and the previous binding is restored on destruction.
+class ScopedLogSinkRouting {
+ public:
+  explicit ScopedLogSinkRouting(const LogSink& sink)
+      : previous_sink_(LogSink::RoutedSink()) {
+    LogSink::RoutedSink() = &sink;
+  }
+  ScopedLogSinkRouting(const ScopedLogSinkRouting&) = delete;
+  ScopedLogSinkRouting& operator=(const ScopedLogSinkRouting&) = delete;
+  ~ScopedLogSinkRouting() { LogSink::RoutedSink() = previous_sink_; }
+
+ private:
+  const LogSink* previous_sink_;
+};
+
 }  // namespace ocpdiag::results::internal
 
 #endif  // OCPDIAG_CORE_RESULTS_OCP_LOG_SINK_H_
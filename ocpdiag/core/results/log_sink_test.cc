@@ -49,6 +49,34 @@ TEST(LogSinkTest, WarningLogPropagatesToOutputProperly) {
             LogSeverity::kWarning);
 }
 
+TEST(LogSinkTest, RoutedLogsOnlyReachBoundSink) {
+  OutputReceiver bound_receiver;
+  OutputReceiver other_receiver;
+  std::unique_ptr<ArtifactWriter> bound_writer =
+      bound_receiver.MakeArtifactWriter();
+  std::unique_ptr<ArtifactWriter> other_writer =
+      other_receiver.MakeArtifactWriter();
+  LogSink bound_sink(*bound_writer);
+  LogSink other_sink(*other_writer);
+  {
+    ScopedLogSinkRouting routing(bound_sink);
+    LOG(INFO).ToSinkOnly(&bound_sink) << "bound message";
+    LOG(INFO).ToSinkOnly(&other_sink) << "bound message";
+  }
+  LOG(INFO).ToSinkOnly(&other_sink) << "unbound message";
+  bound_sink.Flush();
+  other_sink.Flush();
+
+  ASSERT_EQ(bound_receiver.GetOutputModel().test_run.pre_start_logs.size(), 1);
+  EXPECT_THAT(
+      bound_receiver.GetOutputModel().test_run.pre_start_logs[0].message,
+      HasSubstr("bound message"));
+  ASSERT_EQ(other_receiver.GetOutputModel().test_run.pre_start_logs.size(), 1);
+  EXPECT_THAT(
+      other_receiver.GetOutputModel().test_run.pre_start_logs[0].message,
+      HasSubstr("unbound message"));
+}
+
 }  // namespace
 
 }  // namespace ocpdiag::results::internal
@@ -7,9 +7,11 @@
 #ifndef OCPDIAG_CORE_RESULTS_OUTPUT_ITERATOR_H_
 #define OCPDIAG_CORE_RESULTS_OUTPUT_ITERATOR_H_
 
+#include <cstddef>
 #include <memory>
 #include <optional>
 #include <string>
+#include <vector>
 
 #include "absl/log/check.h"
 #include "ocpdiag/core/results/data_model/output_model.h"
@@ -22,7 +24,8 @@ namespace ocpdiag::results {
 
 // Satisfies the interface for range-based for loops in C++, to allow you to
 // iterate through OCPDiag test OutputArtifacts by pointing this class to the
-// recordio OCPDiag output. It crashes if errors are encountered, so this is not
+// recordio OCPDiag output, or to artifacts stored in memory by an
+// ArtifactWriter. It crashes if errors are encountered, so this is not
 // suitable for production code. It is intended for unit tests only.
 class OutputIterator {
  public:
@@ -35,12 +38,29 @@ class OutputIterator {
     ++(*this);  // advance ourselves so we always start on the first item
   }
 
+  // Constructs a new iterator over artifacts held in memory. The stored
+  // protos are converted one at a time without being serialized.
+  explicit OutputIterator(
+      const std::vector<ocpdiag_results_v2_pb::OutputArtifact> *artifacts)
+      : artifacts_(artifacts) {
+    ++(*this);
+  }
+
   // Dereferences the iterator.
   OutputArtifact &operator*() { return output_; }
   OutputArtifact *operator->() { return &output_; }
 
   // Advances the iterator.
   OutputIterator &operator++() {
+    if (artifacts_ != nullptr) {
+      if (next_index_ >= artifacts_->size()) {
+        artifacts_ = nullptr;
+        return *this;
+      }
+      output_ = internal::ProtoToStruct((*artifacts_)[next_index_++]);
+      return *this;
+    }
+
     ocpdiag_results_v2_pb::OutputArtifact output_proto;
     if (!reader_->ReadRecord(output_proto)) {
       CHECK_OK(reader_->status()) << "Failed while reading recordio";
@@ -53,7 +73,7 @@ class OutputIterator {
 
   // The boolean operator can also be used to tell if the iterator still has
   // data left to consume.
-  operator bool() const { return reader_ != nullptr; }
+  operator bool() const { return reader_ != nullptr || artifacts_ != nullptr; }
 
   // We can only compare valid iterator vs. invalid, but we can't tell the
   // difference between two valid iterators.
@@ -63,6 +83,9 @@ class OutputIterator {
 
  private:
   std::unique_ptr<riegeli::RecordReader<riegeli::FdReader<>>> reader_;
+  const std::vector<ocpdiag_results_v2_pb::OutputArtifact> *artifacts_ =
+      nullptr;
+  size_t next_index_ = 0;
   OutputArtifact output_;
 };
 
@@ -71,6 +94,9 @@ class OutputIterator {
 //
 // Example:
 //   for (const OutputArtifact& artifact : OutputContainer(path)) {...}
+//
+// It can also be used to iterate through artifacts written to memory, in which
+// case file_path() is empty.
 class OutputContainer {
  public:
   // The iterator allows this class to be used as a container in range-based for
@@ -80,13 +106,24 @@ class OutputContainer {
   // The container will read from the given file_path.
   OutputContainer(absl::string_view file_path) : file_path_(file_path) {}
 
+  // The container will read from the given artifacts, which must outlive it
+  // and must not be written to while it is being iterated.
+  explicit OutputContainer(
+      const std::vector<ocpdiag_results_v2_pb::OutputArtifact> *artifacts)
+      : artifacts_(artifacts) {}
+
   absl::string_view file_path() const { return file_path_; }
 
-  const_iterator begin() const { return OutputIterator(file_path_); }
+  const_iterator begin() const {
+    if (artifacts_ != nullptr) return OutputIterator(artifacts_);
+    return OutputIterator(file_path_);
+  }
   const_iterator end() const { return OutputIterator(); }
 
  private:
   std::string file_path_;
+  const std::vector<ocpdiag_results_v2_pb::OutputArtifact> *artifacts_ =
+      nullptr;
 };
 
 }  // namespace ocpdiag::results
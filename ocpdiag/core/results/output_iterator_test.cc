@@ -7,6 +7,7 @@
 #include "ocpdiag/core/results/output_iterator.h"
 
 #include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "ocpdiag/core/results/data_model/results.pb.h"
@@ -66,6 +67,27 @@ TEST_F(OutputIteratorTest, ContainerWorksInRangeBasedForLoop) {
   EXPECT_EQ(cnt, num_protos_);
 }
 
+TEST(OutputIteratorInMemoryTest, ContainerIteratesOverStoredArtifacts) {
+  constexpr int kNumArtifacts = 3;
+  std::vector<ocpdiag_results_v2_pb::OutputArtifact> artifacts(kNumArtifacts);
+  for (int i = 0; i < kNumArtifacts; ++i) artifacts[i].set_sequence_number(i);
+  OutputContainer container(&artifacts);
+  EXPECT_TRUE(container.file_path().empty());
+
+  // The container can be iterated over more than once.
+  for (int pass = 0; pass < 2; ++pass) {
+    int cnt = 0;
+    for (const OutputArtifact& artifact : container)
+      EXPECT_EQ(artifact.sequence_number, cnt++);
+    EXPECT_EQ(cnt, kNumArtifacts);
+  }
+}
+
+TEST(OutputIteratorInMemoryTest, EmptyVectorYieldsNoArtifacts) {
+  std::vector<ocpdiag_results_v2_pb::OutputArtifact> artifacts;
+  EXPECT_FALSE(OutputIterator(&artifacts));
+}
+
 TEST(OutputIteratorDeathTest, BadFilepathCausesDeath) {
   EXPECT_DEATH(OutputIterator(""), "");
   EXPECT_DEATH(OutputIterator("path-doesnt-exist"), "");
@@ -6,7 +6,6 @@
 
 #include "ocpdiag/core/results/output_receiver.h"
 
-#include <filesystem>  //
 #include <iostream>
 #include <memory>
 #include <optional>
@@ -16,19 +15,18 @@
 
 #include "absl/log/check.h"
 #include "absl/log/log.h"
+#include "absl/strings/string_view.h"
 #include "ocpdiag/core/results/data_model/output_model.h"
 #include "ocpdiag/core/results/output_iterator.h"
-#include "ocpdiag/core/testing/file_utils.h"
 
 namespace ocpdiag::results {
 
-OutputReceiver::OutputReceiver()
-    : container_([] {
-        std::string path = testutils::MkTempFileOrDie("output_receiver");
-        if (std::filesystem::exists(path))
-          CHECK(std::filesystem::remove(path)) << "Cannot remove temp file";
-        return path;
-      }()) {}
+OutputReceiver::OutputReceiver() : container_(&artifacts_) {}
+
+OutputReceiver::OutputReceiver(absl::string_view output_filepath)
+    : container_(output_filepath) {
+  CHECK(!output_filepath.empty()) << "Must specify a valid output filepath";
+}
 
 std::unique_ptr<internal::ArtifactWriter> OutputReceiver::MakeArtifactWriter() {
   CHECK(!writer_created_)
@@ -36,10 +34,13 @@ std::unique_ptr<internal::ArtifactWriter> OutputReceiver::MakeArtifactWriter() {
          "created for this Output Receiver";
   writer_created_ = true;
 
-  // Create an artifact writer that outputs to a file, as well as stdout for
-  // easier examination during unit tests.
+  // Create an artifact writer that outputs to memory or a file, as well as
+  // stdout for easier examination during unit tests.
   std::ostream* out_stream = nullptr;
 
+  if (container_.file_path().empty()) {
+    return std::make_unique<internal::ArtifactWriter>(&artifacts_, out_stream);
+  }
   return std::make_unique<internal::ArtifactWriter>(
       container_.file_path(), out_stream, /*flush_each_minute=*/false);
 }
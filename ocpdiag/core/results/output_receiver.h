@@ -10,8 +10,10 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
 #include "ocpdiag/core/results/artifact_writer.h"
 #include "ocpdiag/core/results/data_model/output_model.h"
 #include "ocpdiag/core/results/data_model/results.pb.h"
@@ -24,11 +26,20 @@ namespace ocpdiag::results {
 // in two ways. Either you can use the structured OutputModel, or iterate over
 // the class itself to get one OutputArtifact at a time.
 //
+// By default the artifacts are kept in memory, so tests do not touch the
+// filesystem. Pass a file path to the constructor to have them written to a
+// recordio file instead, e.g. to test code that consumes the file. In-memory
+// artifacts are not guarded against concurrent writes, so only read them after
+// the TestRun using the artifact writer has ended.
+//
 // This class is not thread-safe and not meant for production code. It is
 // intended to be used for unit testing.
 class OutputReceiver {
  public:
   OutputReceiver();
+  explicit OutputReceiver(absl::string_view output_filepath);
+  OutputReceiver(const OutputReceiver&) = delete;
+  OutputReceiver& operator=(const OutputReceiver&) = delete;
 
   // Creates an artifact writer that will write to this receiver instance. This
   // should only be called once per OutputReceiver instance. Note that this
@@ -38,7 +49,8 @@ class OutputReceiver {
 
   // Returns an iterable container of the raw output artifacts. It can be
   // iterated over as many times as you like. This should not be called until
-  // an artifact writer has been created.
+  // an artifact writer has been created, and should not be iterated until the
+  // TestRun using that writer has ended.
   const OutputContainer& GetOutputContainer() const;
 
   // Returns all the output artifacts in a structured data model. The
@@ -65,6 +77,7 @@ class OutputReceiver {
   int GetMeasurementSeriesIdx(const std::string& measurement_series_id,
                               int step_idx);
 
+  std::vector<ocpdiag_results_v2_pb::OutputArtifact> artifacts_;
   OutputContainer container_;
   std::optional<OutputModel> model_;
   absl::flat_hash_map<std::string, int> test_step_id_to_idx_;
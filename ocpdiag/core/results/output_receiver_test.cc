@@ -7,6 +7,7 @@
 #include "ocpdiag/core/results/output_receiver.h"
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -14,6 +15,8 @@
 #include "ocpdiag/core/results/data_model/output_model.h"
 #include "ocpdiag/core/results/data_model/proto_to_struct.h"
 #include "ocpdiag/core/results/data_model/results.pb.h"
+#include "ocpdiag/core/results/output_iterator.h"
+#include "ocpdiag/core/testing/file_utils.h"
 #include "ocpdiag/core/testing/parse_text_proto.h"
 
 namespace ocpdiag::results {
@@ -88,6 +91,37 @@ TEST(OutputReceiverTest, OutputContainerIteratesProperly) {
   EXPECT_EQ(*test_run_end, ProtoToStruct(second_artifact.test_run_end()));
 }
 
+TEST(OutputReceiverTest, ArtifactsAreKeptInMemoryByDefault) {
+  OutputReceiver receiver;
+  {
+    std::unique_ptr<internal::ArtifactWriter> writer =
+        receiver.MakeArtifactWriter();
+    writer->Write(GetExampleSchemaVersion());
+  }
+
+  EXPECT_TRUE(receiver.GetOutputContainer().file_path().empty());
+  int count = 0;
+  for (auto unused : receiver.GetOutputContainer()) count++;
+  EXPECT_EQ(count, 1);
+}
+
+TEST(OutputReceiverTest, FileBackedReceiverWritesToFile) {
+  std::string path = testutils::MkTempFileOrDie("output_receiver");
+  OutputReceiver receiver(path);
+  {
+    std::unique_ptr<internal::ArtifactWriter> writer =
+        receiver.MakeArtifactWriter();
+    writer->Write(GetExampleSchemaVersion());
+  }
+
+  EXPECT_EQ(receiver.GetOutputContainer().file_path(), path);
+  EXPECT_EQ(receiver.GetOutputModel().schema_version,
+            ProtoToStruct(GetExampleSchemaVersion()));
+  int count = 0;
+  for (auto unused : OutputContainer(path)) count++;
+  EXPECT_EQ(count, 1);
+}
+
 TEST(OutputReceiverTest, SchemaVersionAppearsInModel) {
   OutputReceiver receiver;
   std::unique_ptr<internal::ArtifactWriter> writer =
@@ -0,0 +1,629 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/results/output_validator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>  //
+#include <utility>
+#include <vector>
+
+#include "google/protobuf/struct.pb.h"
+#include "google/protobuf/util/json_util.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "ocpdiag/core/compat/status_converters.h"
+#include "ocpdiag/core/compat/status_macros.h"
+#include "ocpdiag/core/results/data_model/input_model.h"
+#include "ocpdiag/core/results/data_model/output_model.h"
+#include "ocpdiag/core/results/data_model/proto_to_struct.h"
+#include "ocpdiag/core/results/data_model/results.pb.h"
+#include "ocpdiag/core/results/data_model/struct_validators.h"
+#include "riegeli/bytes/fd_reader.h"
+#include "riegeli/records/record_reader.h"
+
+namespace ocpdiag::results {
+
+namespace {
+
+using ::ocpdiag::results::internal::RecordSummary;
+using Kind = ::ocpdiag::results::internal::RecordSummary::Kind;
+
+struct RawRecord {
+  uint64_t offset;
+  std::string data;
+};
+
+// Reads the raw records of a results file in batches.
+class RecordSource {
+ public:
+  virtual ~RecordSource() = default;
+
+  // Replaces the contents of `records` with up to `max_records` records. The
+  // vector is left empty once the end of the file has been reached.
+  virtual absl::Status ReadBatch(int max_records,
+                                 std::vector<RawRecord>& records) = 0;
+
+  // Parses a raw record into an artifact. This must be thread-safe.
+  virtual absl::Status Parse(
+      absl::string_view data,
+      ocpdiag_results_v2_pb::OutputArtifact& artifact) const = 0;
+};
+
+class BinaryRecordSource : public RecordSource {
+ public:
+  explicit BinaryRecordSource(absl::string_view file_path)
+      : reader_(riegeli::FdReader(file_path)) {}
+
+  absl::Status status() const { return reader_.status(); }
+
+  absl::Status ReadBatch(int max_records,
+                         std::vector<RawRecord>& records) override {
+    records.clear();
+    std::string record;
+    while (static_cast<int>(records.size()) < max_records) {
+      if (!reader_.ReadRecord(record)) {
+        if (!reader_.ok()) return reader_.status();
+        break;
+      }
+      records.push_back({reader_.last_pos().numeric(), std::move(record)});
+    }
+    return absl::OkStatus();
+  }
+
+  absl::Status Parse(
+      absl::string_view data,
+      ocpdiag_results_v2_pb::OutputArtifact& artifact) const override {
+    if (!artifact.ParseFromArray(data.data(), data.size())) {
+      return absl::InvalidArgumentError(
+          "Record is not an OutputArtifact proto");
+    }
+    return absl::OkStatus();
+  }
+
+ private:
+  riegeli::RecordReader<riegeli::FdReader<>> reader_;
+};
+
+class JsonlRecordSource : public RecordSource {
+ public:
+  explicit JsonlRecordSource(absl::string_view file_path)
+      : stream_(std::string(file_path), std::ios::binary) {}
+
+  bool is_open() const { return stream_.is_open(); }
+
+  absl::Status ReadBatch(int max_records,
+                         std::vector<RawRecord>& records) override {
+    records.clear();
+    std::string line;
+    while (static_cast<int>(records.size()) < max_records &&
+           std::getline(stream_, line)) {
+      const uint64_t offset = offset_;
+      offset_ += line.size() + 1;
+      if (line.empty()) continue;
+      records.push_back({offset, std::move(line)});
+    }
+    if (stream_.bad())
+      return absl::DataLossError("Failed while reading the JSONL file");
+    return absl::OkStatus();
+  }
+
+  absl::Status Parse(
+      absl::string_view data,
+      ocpdiag_results_v2_pb::OutputArtifact& artifact) const override {
+    return AsAbslStatus(
+        google::protobuf::util::JsonStringToMessage(data, &artifact));
+  }
+
+ private:
+  std::ifstream stream_;
+  uint64_t offset_ = 0;
+};
+
+// Returns an error if the value cannot be represented by a results Variant.
+absl::Status CheckVariantValue(const google::protobuf::Value& value,
+                               absl::string_view field) {
+  if (value.has_string_value() || value.has_number_value() ||
+      value.has_bool_value()) {
+    return absl::OkStatus();
+  }
+  return absl::InvalidArgumentError(
+      absl::StrCat("The ", field, " must be a string, number or boolean"));
+}
+
+template <typename Validators>
+absl::Status CheckValidatorValues(const Validators& validators) {
+  for (const ocpdiag_results_v2_pb::Validator& validator : validators) {
+    if (!validator.value().has_list_value()) {
+      RETURN_IF_ERROR(CheckVariantValue(validator.value(), "validator value"));
+      continue;
+    }
+    for (const google::protobuf::Value& value :
+         validator.value().list_value().values())
+      RETURN_IF_ERROR(CheckVariantValue(value, "validator value"));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ValidateTestRunStart(
+    const ocpdiag_results_v2_pb::TestRunStart& proto) {
+  TestRunStartOutput start = internal::ProtoToStruct(proto);
+  RETURN_IF_ERROR(ValidateStruct(start));
+  for (const PlatformInfoOutput& platform_info : start.dut_info.platform_infos)
+    RETURN_IF_ERROR(ValidateStruct(platform_info));
+  for (const HardwareInfoOutput& hardware_info : start.dut_info.hardware_infos)
+    RETURN_IF_ERROR(ValidateStruct(hardware_info));
+  for (const SoftwareInfoOutput& software_info : start.dut_info.software_infos)
+    RETURN_IF_ERROR(ValidateStruct(software_info));
+  return absl::OkStatus();
+}
+
+absl::Status SummarizeTestRunArtifact(
+    const ocpdiag_results_v2_pb::TestRunArtifact& artifact,
+    RecordSummary& summary) {
+  switch (artifact.artifact_case()) {
+    case ocpdiag_results_v2_pb::TestRunArtifact::kTestRunStart:
+      summary.kind = Kind::kTestRunStart;
+      return ValidateTestRunStart(artifact.test_run_start());
+    case ocpdiag_results_v2_pb::TestRunArtifact::kTestRunEnd:
+      summary.kind = Kind::kTestRunEnd;
+      return absl::OkStatus();
+    case ocpdiag_results_v2_pb::TestRunArtifact::kLog:
+      summary.kind = Kind::kTestRunOther;
+      return ValidateStruct(internal::ProtoToStruct(artifact.log()));
+    case ocpdiag_results_v2_pb::TestRunArtifact::kError:
+      summary.kind = Kind::kTestRunOther;
+      return ValidateStruct(internal::ProtoToStruct(artifact.error()));
+    default:
+      return absl::InvalidArgumentError(
+          "Test run artifact does not contain an artifact");
+  }
+}
+
+absl::Status SummarizeTestStepArtifact(
+    const ocpdiag_results_v2_pb::TestStepArtifact& artifact,
+    RecordSummary& summary) {
+  summary.test_step_id = artifact.test_step_id();
+  summary.kind = Kind::kTestStepOther;
+  if (summary.test_step_id.empty()) {
+    return absl::InvalidArgumentError(
+        "Test step artifacts must specify a test step ID");
+  }
+  switch (artifact.artifact_case()) {
+    case ocpdiag_results_v2_pb::TestStepArtifact::kTestStepStart:
+      summary.kind = Kind::kTestStepStart;
+      if (artifact.test_step_start().name().empty())
+        return absl::InvalidArgumentError("Test step names cannot be empty");
+      return absl::OkStatus();
+    case ocpdiag_results_v2_pb::TestStepArtifact::kTestStepEnd:
+      summary.kind = Kind::kTestStepEnd;
+      return absl::OkStatus();
+    case ocpdiag_results_v2_pb::TestStepArtifact::kMeasurement: {
+      const ocpdiag_results_v2_pb::Measurement& measurement =
+          artifact.measurement();
+      RETURN_IF_ERROR(
+          CheckVariantValue(measurement.value(), "measurement value"));
+      RETURN_IF_ERROR(CheckValidatorValues(measurement.validators()));
+      return ValidateStruct(internal::ProtoToStruct(measurement));
+    }
+    case ocpdiag_results_v2_pb::TestStepArtifact::kMeasurementSeriesStart: {
+      const ocpdiag_results_v2_pb::MeasurementSeriesStart& start =
+          artifact.measurement_series_start();
+      summary.kind = Kind::kMeasurementSeriesStart;
+      summary.measurement_series_id = start.measurement_series_id();
+      if (summary.measurement_series_id.empty()) {
+        return absl::InvalidArgumentError(
+            "Measurement series start must specify a measurement series ID");
+      }
+      RETURN_IF_ERROR(CheckValidatorValues(start.validators()));
+      return ValidateStruct(internal::ProtoToStruct(start));
+    }
+    case ocpdiag_results_v2_pb::TestStepArtifact::kMeasurementSeriesElement: {
+      const ocpdiag_results_v2_pb::MeasurementSeriesElement& element =
+          artifact.measurement_series_element();
+      summary.kind = Kind::kMeasurementSeriesElement;
+      summary.measurement_series_id = element.measurement_series_id();
+      summary.count = element.index();
+      if (summary.measurement_series_id.empty()) {
+        return absl::InvalidArgumentError(
+            "Measurement series element must specify a measurement series ID");
+      }
+      return CheckVariantValue(element.value(),
+                               "measurement series element value");
+    }
+    case ocpdiag_results_v2_pb::TestStepArtifact::kMeasurementSeriesEnd:
+      summary.kind = Kind::kMeasurementSeriesEnd;
+      summary.measurement_series_id =
+          artifact.measurement_series_end().measurement_series_id();
+      summary.count = artifact.measurement_series_end().total_count();
+      if (summary.measurement_series_id.empty()) {
+        return absl::InvalidArgumentError(
+            "Measurement series end must specify a measurement series ID");
+      }
+      return absl::OkStatus();
+    case ocpdiag_results_v2_pb::TestStepArtifact::kDiagnosis:
+      return ValidateStruct(internal::ProtoToStruct(artifact.diagnosis()));
+    case ocpdiag_results_v2_pb::TestStepArtifact::kError:
+      return ValidateStruct(internal::ProtoToStruct(artifact.error()));
+    case ocpdiag_results_v2_pb::TestStepArtifact::kFile:
+      return ValidateStruct(internal::ProtoToStruct(artifact.file()));
+    case ocpdiag_results_v2_pb::TestStepArtifact::kLog:
+      return ValidateStruct(internal::ProtoToStruct(artifact.log()));
+    case ocpdiag_results_v2_pb::TestStepArtifact::kExtension:
+      return ValidateStruct(internal::ProtoToStruct(artifact.extension()));
+    default:
+      return absl::InvalidArgumentError(
+          "Test step artifact does not contain an artifact");
+  }
+}
+
+// Parses and summarizes a batch of records, splitting it into chunks that are
+// processed in parallel. Summaries are returned in the order of the records.
+std::vector<RecordSummary> SummarizeBatch(const RecordSource& source,
+                                          const std::vector<RawRecord>& batch,
+                                          int num_threads,
+                                          int records_per_chunk) {
+  std::vector<RecordSummary> summaries(batch.size());
+  auto summarize_chunks = [&](int first_chunk) {
+    for (size_t begin = first_chunk * records_per_chunk; begin < batch.size();
+         begin += num_threads * records_per_chunk) {
+      const size_t end = std::min(batch.size(), begin + records_per_chunk);
+      for (size_t i = begin; i < end; ++i) {
+        ocpdiag_results_v2_pb::OutputArtifact artifact;
+        if (absl::Status status = source.Parse(batch[i].data, artifact);
+            !status.ok()) {
+          summaries[i].offset = batch[i].offset;
+          summaries[i].errors.push_back(
+              absl::StrCat("Could not parse record: ", status.message()));
+          continue;
+        }
+        summaries[i] = internal::SummarizeRecord(batch[i].offset, artifact);
+      }
+    }
+  };
+
+  const int chunk_count =
+      (batch.size() + records_per_chunk - 1) / records_per_chunk;
+  const int thread_count = std::min(num_threads, chunk_count);
+  if (thread_count <= 1) {
+    summarize_chunks(0);
+    return summaries;
+  }
+  std::vector<std::thread> threads;
+  threads.reserve(thread_count);
+  for (int i = 0; i < thread_count; ++i)
+    threads.emplace_back(summarize_chunks, i);
+  for (std::thread& thread : threads) thread.join();
+  return summaries;
+}
+
+absl::StatusOr<std::vector<OutputValidationError>> ValidateRecords(
+    RecordSource& source, const OutputValidationOptions& options) {
+  const int num_threads =
+      options.num_threads > 0
+          ? options.num_threads
+          : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  const int records_per_chunk = std::max(1, options.records_per_chunk);
+  const int batch_size = num_threads * records_per_chunk;
+  const size_t max_errors = std::max(1, options.max_errors);
+
+  std::vector<OutputValidationError> errors;
+  internal::ArtifactSequenceChecker checker;
+  std::vector<RawRecord> batch;
+  RETURN_IF_ERROR(source.ReadBatch(batch_size, batch));
+  while (!batch.empty()) {
+    // Read the next batch while the current one is being validated.
+    std::vector<RawRecord> next_batch;
+    absl::Status read_status;
+    std::thread reader([&] {
+      read_status = source.ReadBatch(batch_size, next_batch);
+    });
+    std::vector<RecordSummary> summaries =
+        SummarizeBatch(source, batch, num_threads, records_per_chunk);
+    reader.join();
+
+    for (const RecordSummary& summary : summaries) {
+      checker.Check(summary, errors);
+      if (errors.size() >= max_errors) {
+        errors.resize(max_errors);
+        return errors;
+      }
+    }
+    RETURN_IF_ERROR(read_status);
+    batch = std::move(next_batch);
+  }
+  checker.Finish(errors);
+
+  // Unfinished steps and series are reported at the offset where they started,
+  // so restore file order before truncating.
+  std::stable_sort(
+      errors.begin(), errors.end(),
+      [](const OutputValidationError& a, const OutputValidationError& b) {
+        return a.record_offset < b.record_offset;
+      });
+  if (errors.size() > max_errors) errors.resize(max_errors);
+  return errors;
+}
+
+}  // namespace
+
+absl::StatusOr<std::vector<OutputValidationError>> ValidateBinaryOutput(
+    absl::string_view file_path, const OutputValidationOptions& options) {
+  BinaryRecordSource source(file_path);
+  RETURN_IF_ERROR(source.status());
+  return ValidateRecords(source, options);
+}
+
+absl::StatusOr<std::vector<OutputValidationError>> ValidateJsonlOutput(
+    absl::string_view file_path, const OutputValidationOptions& options) {
+  JsonlRecordSource source(file_path);
+  if (!source.is_open()) {
+    return absl::NotFoundError(
+        absl::StrCat("Unable to open results file: ", file_path));
+  }
+  return ValidateRecords(source, options);
+}
+
+namespace internal {
+
+RecordSummary SummarizeRecord(
+    uint64_t offset, const ocpdiag_results_v2_pb::OutputArtifact& artifact) {
+  RecordSummary summary = {
+      .offset = offset,
+      .sequence_number = artifact.sequence_number(),
+  };
+  absl::Status status;
+  switch (artifact.artifact_case()) {
+    case ocpdiag_results_v2_pb::OutputArtifact::kSchemaVersion:
+      summary.kind = Kind::kSchemaVersion;
+      if (artifact.schema_version().major() != kMajorSchemaVersion) {
+        status = absl::InvalidArgumentError(absl::StrCat(
+            "Unsupported major schema version ",
+            artifact.schema_version().major(), ", expected ",
+            kMajorSchemaVersion));
+      }
+      break;
+    case ocpdiag_results_v2_pb::OutputArtifact::kTestRunArtifact:
+      status = SummarizeTestRunArtifact(artifact.test_run_artifact(), summary);
+      break;
+    case ocpdiag_results_v2_pb::OutputArtifact::kTestStepArtifact:
+      status =
+          SummarizeTestStepArtifact(artifact.test_step_artifact(), summary);
+      break;
+    default:
+      status =
+          absl::InvalidArgumentError("Record does not contain an artifact");
+  }
+  if (!status.ok()) summary.errors.push_back(std::string(status.message()));
+  return summary;
+}
+
+void ArtifactSequenceChecker::Check(
+    const RecordSummary& record, std::vector<OutputValidationError>& errors) {
+  for (const std::string& error : record.errors)
+    errors.push_back({record.offset, error});
+  last_offset_ = record.offset;
+  if (record.kind == Kind::kInvalid) return;
+
+  if (has_sequence_number_ && record.sequence_number <= last_sequence_number_) {
+    errors.push_back(
+        {record.offset,
+         absl::StrCat("Sequence number ", record.sequence_number,
+                      " does not follow the previous sequence number ",
+                      last_sequence_number_)});
+  }
+  has_sequence_number_ = true;
+  last_sequence_number_ = record.sequence_number;
+
+  switch (record.kind) {
+    case Kind::kSchemaVersion:
+    case Kind::kTestRunOther:
+      break;
+    case Kind::kTestRunStart:
+      if (run_started_) {
+        errors.push_back(
+            {record.offset, "The test run was started more than once"});
+      }
+      run_started_ = true;
+      break;
+    case Kind::kTestRunEnd:
+      if (!run_started_) {
+        errors.push_back(
+            {record.offset, "The test run ended before it was started"});
+      } else if (run_ended_) {
+        errors.push_back(
+            {record.offset, "The test run was ended more than once"});
+      }
+      run_ended_ = true;
+      break;
+    default:
+      CheckStepArtifact(record, errors);
+  }
+}
+
+void ArtifactSequenceChecker::CheckStepArtifact(
+    const RecordSummary& record, std::vector<OutputValidationError>& errors) {
+  // Artifacts without a step ID have already been reported.
+  if (record.test_step_id.empty()) return;
+  const std::string& step_id = record.test_step_id;
+  if (!run_started_) {
+    errors.push_back(
+        {record.offset, absl::StrCat("Artifact for test step \"", step_id,
+                                     "\" was emitted before the test run "
+                                     "started")});
+  } else if (run_ended_) {
+    errors.push_back(
+        {record.offset, absl::StrCat("Artifact for test step \"", step_id,
+                                     "\" was emitted after the test run "
+                                     "ended")});
+  }
+
+  if (record.kind == Kind::kTestStepStart) {
+    auto [it, inserted] = steps_.try_emplace(step_id);
+    if (!inserted) {
+      errors.push_back({record.offset,
+                        absl::StrCat("Test step \"", step_id,
+                                     "\" was started more than once")});
+      return;
+    }
+    it->second.start_offset = record.offset;
+    return;
+  }
+
+  auto it = steps_.find(step_id);
+  if (it == steps_.end()) {
+    errors.push_back(
+        {record.offset, absl::StrCat("Artifact for test step \"", step_id,
+                                     "\" was emitted before the step "
+                                     "started")});
+    return;
+  }
+  StepState& step = it->second;
+  if (step.ended) {
+    errors.push_back(
+        {record.offset, absl::StrCat("Artifact for test step \"", step_id,
+                                     "\" was emitted after the step ended")});
+    return;
+  }
+
+  switch (record.kind) {
+    case Kind::kTestStepEnd: {
+      step.ended = true;
+      std::vector<std::string> open_series(step.open_series.begin(),
+                                           step.open_series.end());
+      std::sort(open_series.begin(), open_series.end());
+      for (const std::string& series_id : open_series) {
+        series_[series_id].ended = true;
+        errors.push_back(
+            {record.offset,
+             absl::StrCat("Measurement series \"", series_id,
+                          "\" was not ended before its test step \"", step_id,
+                          "\" ended")});
+      }
+      step.open_series.clear();
+      break;
+    }
+    case Kind::kMeasurementSeriesStart:
+    case Kind::kMeasurementSeriesElement:
+    case Kind::kMeasurementSeriesEnd:
+      CheckSeriesArtifact(record, step, errors);
+      break;
+    default:
+      break;
+  }
+}
+
+void ArtifactSequenceChecker::CheckSeriesArtifact(
+    const RecordSummary& record, StepState& step,
+    std::vector<OutputValidationError>& errors) {
+  // Artifacts without a series ID have already been reported.
+  if (record.measurement_series_id.empty()) return;
+  const std::string& series_id = record.measurement_series_id;
+
+  if (record.kind == Kind::kMeasurementSeriesStart) {
+    auto [it, inserted] = series_.try_emplace(series_id);
+    if (!inserted) {
+      errors.push_back({record.offset,
+                        absl::StrCat("Measurement series \"", series_id,
+                                     "\" was started more than once")});
+      return;
+    }
+    it->second.test_step_id = record.test_step_id;
+    it->second.start_offset = record.offset;
+    step.open_series.insert(series_id);
+    return;
+  }
+
+  auto it = series_.find(series_id);
+  if (it == series_.end()) {
+    errors.push_back(
+        {record.offset, absl::StrCat("Artifact for measurement series \"",
+                                     series_id,
+                                     "\" was emitted before the series "
+                                     "started")});
+    return;
+  }
+  SeriesState& series = it->second;
+  if (series.test_step_id != record.test_step_id) {
+    errors.push_back(
+        {record.offset,
+         absl::StrCat("Measurement series \"", series_id,
+                      "\" was started in test step \"", series.test_step_id,
+                      "\" but used in test step \"", record.test_step_id,
+                      "\"")});
+    return;
+  }
+  if (series.ended) {
+    errors.push_back(
+        {record.offset, absl::StrCat("Artifact for measurement series \"",
+                                     series_id,
+                                     "\" was emitted after the series "
+                                     "ended")});
+    return;
+  }
+
+  if (record.kind == Kind::kMeasurementSeriesElement) {
+    if (record.count != series.next_index) {
+      errors.push_back(
+          {record.offset,
+           absl::StrCat("Measurement series \"", series_id,
+                        "\" element has index ", record.count, ", expected ",
+                        series.next_index)});
+    }
+    // Resynchronize on the emitted index so a single gap is reported once.
+    series.next_index = record.count + 1;
+    ++series.element_count;
+    return;
+  }
+
+  series.ended = true;
+  step.open_series.erase(series_id);
+  if (record.count != series.element_count) {
+    errors.push_back(
+        {record.offset,
+         absl::StrCat("Measurement series \"", series_id, "\" total count ",
+                      record.count, " does not match the ",
+                      series.element_count, " elements emitted")});
+  }
+}
+
+void ArtifactSequenceChecker::Finish(
+    std::vector<OutputValidationError>& errors) {
+  if (!run_started_)
+    errors.push_back({last_offset_, "The test run was never started"});
+  if (!run_ended_)
+    errors.push_back({last_offset_, "The test run was never ended"});
+
+  std::vector<OutputValidationError> unfinished;
+  for (const auto& [step_id, step] : steps_) {
+    if (step.ended) continue;
+    unfinished.push_back(
+        {step.start_offset,
+         absl::StrCat("Test step \"", step_id, "\" was never ended")});
+  }
+  for (const auto& [series_id, series] : series_) {
+    if (series.ended) continue;
+    unfinished.push_back({series.start_offset,
+                          absl::StrCat("Measurement series \"", series_id,
+                                       "\" was never ended")});
+  }
+  std::sort(
+      unfinished.begin(), unfinished.end(),
+      [](const OutputValidationError& a, const OutputValidationError& b) {
+        return a.record_offset < b.record_offset;
+      });
+  errors.insert(errors.end(), unfinished.begin(), unfinished.end());
+}
+
+}  // namespace internal
+
+}  // namespace ocpdiag::results
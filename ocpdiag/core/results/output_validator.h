@@ -0,0 +1,147 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_RESULTS_OUTPUT_VALIDATOR_H_
+#define OCPDIAG_CORE_RESULTS_OUTPUT_VALIDATOR_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "ocpdiag/core/results/data_model/results.pb.h"
+
+namespace ocpdiag::results {
+
+// A violation of the OCP output spec found in a results file.
+struct OutputValidationError {
+  // Location of the offending record: the byte offset of its line for JSONL
+  // files, or its numeric riegeli record position for binary files.
+  uint64_t record_offset;
+  std::string message;
+
+  bool operator==(const OutputValidationError& rhs) const {
+    return record_offset == rhs.record_offset && message == rhs.message;
+  }
+};
+
+struct OutputValidationOptions {
+  // Number of threads used to parse and validate records. Zero uses the number
+  // of hardware threads.
+  int num_threads = 0;
+  // Number of records handed to each thread at a time.
+  int records_per_chunk = 4096;
+  // Validation stops once this many errors have been found.
+  int max_errors = 1000;
+};
+
+// Validates a binary (riegeli) results file written by the ArtifactWriter
+// against the OCP output spec. Each record is checked against the same rules
+// that the results library enforces when emitting artifacts, and the sequence
+// of records is checked for cross-artifact invariants:
+//   - sequence numbers are strictly increasing,
+//   - the test run starts before any step, and no step artifacts follow its
+//     end,
+//   - each step starts before its artifacts and emits nothing after its end,
+//   - each measurement series belongs to a started step, its element indices
+//     are contiguous from zero, its total_count matches the element count, and
+//     it ends before its step does.
+//
+// Records are read in chunks and validated in parallel while the next chunk
+// is read, so large files can be validated at close to disk speed. Returns an
+// error status only if the file cannot be read; spec violations are returned
+// as a list, ordered by position in the file. At most `max_errors` violations
+// are returned.
+absl::StatusOr<std::vector<OutputValidationError>> ValidateBinaryOutput(
+    absl::string_view file_path, const OutputValidationOptions& options = {});
+
+// Same as above, for a JSONL results file such as the one written to stdout.
+absl::StatusOr<std::vector<OutputValidationError>> ValidateJsonlOutput(
+    absl::string_view file_path, const OutputValidationOptions& options = {});
+
+namespace internal {
+
+// The parts of a record needed to check cross-artifact invariants, along with
+// the errors found when validating the record on its own.
+struct RecordSummary {
+  enum class Kind {
+    kInvalid,
+    kSchemaVersion,
+    kTestRunStart,
+    kTestRunEnd,
+    kTestRunOther,
+    kTestStepStart,
+    kTestStepEnd,
+    kMeasurementSeriesStart,
+    kMeasurementSeriesElement,
+    kMeasurementSeriesEnd,
+    kTestStepOther,
+  };
+
+  uint64_t offset = 0;
+  Kind kind = Kind::kInvalid;
+  int sequence_number = 0;
+  std::string test_step_id;
+  std::string measurement_series_id;
+  // The element index, or the total count for a series end.
+  int count = 0;
+  std::vector<std::string> errors;
+};
+
+// Validates a single parsed record on its own.
+RecordSummary SummarizeRecord(
+    uint64_t offset, const ocpdiag_results_v2_pb::OutputArtifact& artifact);
+
+// Checks the invariants that span multiple records. Records must be passed in
+// the order they appear in the file.
+class ArtifactSequenceChecker {
+ public:
+  ArtifactSequenceChecker() = default;
+
+  // Checks a record against the records seen so far, appending any errors
+  // (including those already in the summary) to `errors`.
+  void Check(const RecordSummary& record,
+             std::vector<OutputValidationError>& errors);
+
+  // Reports anything left unfinished once the whole file has been checked.
+  void Finish(std::vector<OutputValidationError>& errors);
+
+ private:
+  struct StepState {
+    uint64_t start_offset = 0;
+    bool ended = false;
+    absl::flat_hash_set<std::string> open_series;
+  };
+  struct SeriesState {
+    std::string test_step_id;
+    uint64_t start_offset = 0;
+    int next_index = 0;
+    int element_count = 0;
+    bool ended = false;
+  };
+
+  void CheckStepArtifact(const RecordSummary& record,
+                         std::vector<OutputValidationError>& errors);
+  void CheckSeriesArtifact(const RecordSummary& record, StepState& step,
+                           std::vector<OutputValidationError>& errors);
+
+  bool has_sequence_number_ = false;
+  int last_sequence_number_ = 0;
+  bool run_started_ = false;
+  bool run_ended_ = false;
+  uint64_t last_offset_ = 0;
+  absl::flat_hash_map<std::string, StepState> steps_;
+  absl::flat_hash_map<std::string, SeriesState> series_;
+};
+
+}  // namespace internal
+
+}  // namespace ocpdiag::results
+
+#endif  // OCPDIAG_CORE_RESULTS_OUTPUT_VALIDATOR_H_
@@ -0,0 +1,273 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/results/output_validator.h"
+
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "ocpdiag/core/results/artifact_writer.h"
+#include "ocpdiag/core/results/data_model/dut_info.h"
+#include "ocpdiag/core/results/data_model/input_model.h"
+#include "ocpdiag/core/results/data_model/results.pb.h"
+#include "ocpdiag/core/results/measurement_series.h"
+#include "ocpdiag/core/results/test_run.h"
+#include "ocpdiag/core/results/test_step.h"
+#include "ocpdiag/core/testing/file_utils.h"
+#include "ocpdiag/core/testing/parse_text_proto.h"
+#include "ocpdiag/core/testing/status_matchers.h"
+
+namespace ocpdiag::results {
+
+using ::ocpdiag::testing::IsOkAndHolds;
+using ::ocpdiag::testing::ParseTextProtoOrDie;
+using ::ocpdiag::testing::StatusIs;
+using ::testing::ElementsAre;
+using ::testing::Field;
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+
+namespace {
+
+constexpr absl::string_view kStepStart =
+    R"pb(test_step_start { name: "step" } test_step_id: "0")pb";
+constexpr absl::string_view kStepEnd =
+    R"pb(test_step_end { status: COMPLETE } test_step_id: "0")pb";
+constexpr absl::string_view kUnnamedMeasurement =
+    R"pb(measurement { value { number_value: 1 } } test_step_id: "0")pb";
+
+auto ErrorWithMessage(absl::string_view message) {
+  return Field(&OutputValidationError::message, HasSubstr(message));
+}
+
+class OutputValidatorTest : public ::testing::Test {
+ protected:
+  OutputValidatorTest()
+      : binary_path_(testutils::MkTempFileOrDie("output_validator")),
+        jsonl_path_(testutils::MkTempFileOrDie("output_validator_jsonl")),
+        writer_(std::make_unique<internal::ArtifactWriter>(
+            binary_path_, &jsonl_stream_, /*flush_each_minute=*/false)) {}
+
+  void WriteRunStart() {
+    WriteRunArtifact(R"pb(test_run_start {
+                            name: "test"
+                            version: "1.0"
+                            command_line: "./test"
+                          })pb");
+  }
+
+  void WriteRunEnd() {
+    WriteRunArtifact(R"pb(test_run_end { status: COMPLETE })pb");
+  }
+
+  void WriteRunArtifact(absl::string_view text_proto) {
+    ocpdiag_results_v2_pb::TestRunArtifact artifact =
+        ParseTextProtoOrDie(text_proto);
+    writer_->Write(artifact);
+  }
+
+  void WriteStepArtifact(absl::string_view text_proto) {
+    ocpdiag_results_v2_pb::TestStepArtifact artifact =
+        ParseTextProtoOrDie(text_proto);
+    writer_->Write(artifact);
+  }
+
+  // Closes the writer so that both output files are complete.
+  void FinishWriting() {
+    writer_.reset();
+    std::ofstream(jsonl_path_) << jsonl_stream_.str();
+  }
+
+  std::string binary_path_;
+  std::string jsonl_path_;
+  std::stringstream jsonl_stream_;
+  std::unique_ptr<internal::ArtifactWriter> writer_;
+};
+
+TEST_F(OutputValidatorTest, OutputFromResultsLibraryIsValid) {
+  {
+    TestRun run({.name = "test", .version = "1.0", .command_line = "./test"},
+                std::move(writer_));
+    run.StartAndRegisterDutInfo(std::make_unique<DutInfo>("dut", "id"));
+    TestStep step("step", run);
+    step.AddMeasurement({.name = "measurement", .value = 1.});
+    step.AddDiagnosis({.verdict = "good", .type = DiagnosisType::kPass});
+    step.AddLog({.message = "log"});
+    step.AddExtension({.name = "extension", .content_json = R"({"a":1})"});
+    MeasurementSeries series({.name = "series"}, step);
+    for (int i = 0; i < 3; ++i) series.AddElement({.value = double(i)});
+  }
+  FinishWriting();
+
+  EXPECT_THAT(ValidateBinaryOutput(binary_path_), IsOkAndHolds(IsEmpty()));
+  EXPECT_THAT(ValidateJsonlOutput(jsonl_path_), IsOkAndHolds(IsEmpty()));
+}
+
+TEST_F(OutputValidatorTest, InvalidRecordIsReportedAtItsOffset) {
+  WriteRunStart();
+  WriteStepArtifact(kStepStart);
+  WriteStepArtifact(kUnnamedMeasurement);
+  WriteStepArtifact(kStepEnd);
+  WriteRunEnd();
+  FinishWriting();
+
+  absl::StatusOr<std::vector<OutputValidationError>> errors =
+      ValidateJsonlOutput(jsonl_path_);
+  ASSERT_OK(errors);
+  ASSERT_THAT(*errors, ElementsAre(ErrorWithMessage("name field of the "
+                                                    "measurement")));
+
+  // The offset points at the start of the third line.
+  std::string jsonl = jsonl_stream_.str();
+  size_t third_line = jsonl.find('\n', jsonl.find('\n') + 1) + 1;
+  EXPECT_EQ((*errors)[0].record_offset, third_line);
+  EXPECT_THAT(ValidateBinaryOutput(binary_path_),
+              IsOkAndHolds(ElementsAre(ErrorWithMessage("measurement"))));
+}
+
+TEST_F(OutputValidatorTest, SeriesInvariantsAreChecked) {
+  WriteRunStart();
+  WriteStepArtifact(kStepStart);
+  WriteStepArtifact(R"pb(measurement_series_start {
+                           measurement_series_id: "0"
+                           name: "series"
+                         }
+                         test_step_id: "0")pb");
+  WriteStepArtifact(R"pb(measurement_series_element {
+                           measurement_series_id: "0"
+                           index: 0
+                           value { number_value: 1 }
+                         }
+                         test_step_id: "0")pb");
+  WriteStepArtifact(R"pb(measurement_series_element {
+                           measurement_series_id: "0"
+                           index: 2
+                           value { number_value: 1 }
+                         }
+                         test_step_id: "0")pb");
+  WriteStepArtifact(R"pb(measurement_series_end {
+                           measurement_series_id: "0"
+                           total_count: 3
+                         }
+                         test_step_id: "0")pb");
+  WriteStepArtifact(R"pb(measurement_series_start {
+                           measurement_series_id: "1"
+                           name: "unended series"
+                         }
+                         test_step_id: "0")pb");
+  WriteStepArtifact(kStepEnd);
+  WriteRunEnd();
+  FinishWriting();
+
+  EXPECT_THAT(
+      ValidateBinaryOutput(binary_path_),
+      IsOkAndHolds(ElementsAre(
+          ErrorWithMessage("element has index 2, expected 1"),
+          ErrorWithMessage("total count 3 does not match the 2 elements"),
+          ErrorWithMessage("\"1\" was not ended before its test step"))));
+}
+
+TEST_F(OutputValidatorTest, StepOrderingInvariantsAreChecked) {
+  WriteRunStart();
+  WriteStepArtifact(R"pb(log { message: "early" } test_step_id: "0")pb");
+  WriteStepArtifact(kStepStart);
+  WriteStepArtifact(kStepEnd);
+  WriteStepArtifact(R"pb(log { message: "late" } test_step_id: "0")pb");
+  WriteStepArtifact(
+      R"pb(test_step_start { name: "unended" } test_step_id: "1")pb");
+  WriteRunEnd();
+  FinishWriting();
+
+  EXPECT_THAT(
+      ValidateJsonlOutput(jsonl_path_),
+      IsOkAndHolds(ElementsAre(ErrorWithMessage("before the step started"),
+                               ErrorWithMessage("after the step ended"),
+                               ErrorWithMessage("\"1\" was never ended"))));
+}
+
+TEST_F(OutputValidatorTest, MissingRunStartAndEndAreReported) {
+  FinishWriting();
+  EXPECT_THAT(ValidateBinaryOutput(binary_path_),
+              IsOkAndHolds(ElementsAre(ErrorWithMessage("never started"),
+                                       ErrorWithMessage("never ended"))));
+}
+
+TEST_F(OutputValidatorTest, ParallelValidationMatchesSerialValidation) {
+  WriteRunStart();
+  WriteStepArtifact(kStepStart);
+  for (int i = 0; i < 500; ++i) {
+    // Every tenth measurement is missing its name.
+    WriteStepArtifact(i % 10 == 0 ? kUnnamedMeasurement
+                                  : R"pb(measurement {
+                                           name: "m"
+                                           value { number_value: 1 }
+                                         }
+                                         test_step_id: "0")pb");
+  }
+  WriteStepArtifact(kStepEnd);
+  WriteRunEnd();
+  FinishWriting();
+
+  absl::StatusOr<std::vector<OutputValidationError>> serial =
+      ValidateBinaryOutput(binary_path_,
+                           {.num_threads = 1, .records_per_chunk = 1000});
+  absl::StatusOr<std::vector<OutputValidationError>> parallel =
+      ValidateBinaryOutput(binary_path_,
+                           {.num_threads = 4, .records_per_chunk = 7});
+  ASSERT_OK(serial);
+  ASSERT_OK(parallel);
+  EXPECT_EQ(serial->size(), 50);
+  EXPECT_EQ(*serial, *parallel);
+}
+
+TEST_F(OutputValidatorTest, ErrorsAreCappedAtMaxErrors) {
+  WriteRunStart();
+  WriteStepArtifact(kStepStart);
+  for (int i = 0; i < 10; ++i)
+    WriteStepArtifact(R"pb(log {} test_step_id: "0")pb");
+  FinishWriting();
+
+  absl::StatusOr<std::vector<OutputValidationError>> errors =
+      ValidateBinaryOutput(binary_path_, {.max_errors = 3});
+  ASSERT_OK(errors);
+  EXPECT_EQ(errors->size(), 3);
+}
+
+TEST(OutputValidatorFileTest, MissingFileReturnsError) {
+  EXPECT_THAT(ValidateJsonlOutput("/nonexistent/results.jsonl"),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST(ArtifactSequenceCheckerTest, NonMonotonicSequenceNumbersAreReported) {
+  internal::ArtifactSequenceChecker checker;
+  std::vector<OutputValidationError> errors;
+  checker.Check({.offset = 0,
+                 .kind = internal::RecordSummary::Kind::kSchemaVersion,
+                 .sequence_number = 5},
+                errors);
+  checker.Check({.offset = 10,
+                 .kind = internal::RecordSummary::Kind::kTestRunStart,
+                 .sequence_number = 5},
+                errors);
+
+  EXPECT_THAT(errors,
+              ElementsAre(OutputValidationError{
+                  .record_offset = 10,
+                  .message = "Sequence number 5 does not follow the previous "
+                             "sequence number 5"}));
+}
+
+}  // namespace
+
+}  // namespace ocpdiag::results
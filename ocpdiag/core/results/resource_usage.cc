@@ -0,0 +1,170 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/results/resource_usage.h"
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/results/data_model/input_model.h"
+
+namespace ocpdiag::results::internal {
+
+namespace {
+
+// Fills in the CPU time and context switch counters of the calling thread.
+void ReadThreadRusage(ResourceCounters& counters) {
+  struct rusage usage;
+  if (getrusage(RUSAGE_THREAD, &usage) != 0) return;
+  counters.user_cpu_time = absl::DurationFromTimeval(usage.ru_utime);
+  counters.system_cpu_time = absl::DurationFromTimeval(usage.ru_stime);
+  counters.voluntary_context_switches = usage.ru_nvcsw;
+  counters.involuntary_context_switches = usage.ru_nivcsw;
+}
+
+// Returns the peak resident set size of the process in kilobytes.
+int64_t ReadMaxRssKb() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+  return usage.ru_maxrss;
+}
+
+// Fills in the storage IO counters from the given /proc io file. These files
+// may be unreadable (e.g. under some sandboxes), in which case the counters
+// are left unset.
+void ReadProcIo(const char* path, ResourceCounters& counters) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return;
+  char buffer[512];
+  ssize_t size = read(fd, buffer, sizeof(buffer));
+  close(fd);
+  if (size <= 0) return;
+
+  for (absl::string_view line : absl::StrSplit(
+           absl::string_view(buffer, size), '\n', absl::SkipEmpty())) {
+    std::pair<absl::string_view, absl::string_view> field =
+        absl::StrSplit(line, absl::MaxSplits(": ", 1));
+    if (field.first == "read_bytes") {
+      if (!absl::SimpleAtoi(field.second, &counters.read_bytes))
+        counters.read_bytes = -1;
+    } else if (field.first == "write_bytes") {
+      if (!absl::SimpleAtoi(field.second, &counters.write_bytes))
+        counters.write_bytes = -1;
+    }
+  }
+}
+
+// Adds the difference between two IO counters to `total`, which becomes -1
+// once any of them is unavailable.
+void AddIoDelta(int64_t start, int64_t end, int64_t& total) {
+  if (start < 0 || end < 0 || total < 0) {
+    total = -1;
+  } else {
+    total += end - start;
+  }
+}
+
+pid_t CurrentThreadId() { return syscall(SYS_gettid); }
+
+}  // namespace
+
+ResourceCounters SampleThreadResourceCounters() {
+  ResourceCounters counters;
+  ReadThreadRusage(counters);
+  ReadProcIo("/proc/thread-self/io", counters);
+  return counters;
+}
+
+StepResourceUsage::StepResourceUsage()
+    : start_time_(absl::Now()), start_max_rss_kb_(ReadMaxRssKb()) {
+  total_.read_bytes = 0;
+  total_.write_bytes = 0;
+  EnterThread();
+}
+
+void StepResourceUsage::EnterThread() {
+  const pid_t thread_id = CurrentThreadId();
+  absl::MutexLock lock(&mutex_);
+  if (ended_) return;
+  EnteredThread& thread = entered_threads_[thread_id];
+  if (thread.depth++ == 0) thread.start = SampleThreadResourceCounters();
+}
+
+void StepResourceUsage::ExitThread() {
+  const pid_t thread_id = CurrentThreadId();
+  absl::MutexLock lock(&mutex_);
+  if (ended_) return;
+  ExitThreadLocked(thread_id);
+}
+
+void StepResourceUsage::ExitThreadLocked(pid_t thread_id) {
+  auto it = entered_threads_.find(thread_id);
+  if (it == entered_threads_.end() || --it->second.depth > 0) return;
+  const ResourceCounters& start = it->second.start;
+  const ResourceCounters end = SampleThreadResourceCounters();
+  total_.user_cpu_time += end.user_cpu_time - start.user_cpu_time;
+  total_.system_cpu_time += end.system_cpu_time - start.system_cpu_time;
+  total_.voluntary_context_switches +=
+      end.voluntary_context_switches - start.voluntary_context_switches;
+  total_.involuntary_context_switches +=
+      end.involuntary_context_switches - start.involuntary_context_switches;
+  AddIoDelta(start.read_bytes, end.read_bytes, total_.read_bytes);
+  AddIoDelta(start.write_bytes, end.write_bytes, total_.write_bytes);
+  ++accounted_threads_;
+  entered_threads_.erase(it);
+}
+
+Extension StepResourceUsage::End() {
+  const pid_t thread_id = CurrentThreadId();
+  absl::MutexLock lock(&mutex_);
+  if (!ended_) {
+    // Nested entries of the calling thread end with the step too.
+    auto it = entered_threads_.find(thread_id);
+    if (it != entered_threads_.end()) {
+      it->second.depth = 1;
+      ExitThreadLocked(thread_id);
+    }
+    ended_ = true;
+  }
+
+  std::string json = absl::StrCat(
+      "{\"scope\":\"step_threads\"",
+      ",\"accounted_threads\":", accounted_threads_,
+      ",\"unaccounted_threads\":", entered_threads_.size(),
+      ",\"wall_time_us\":",
+      absl::ToInt64Microseconds(absl::Now() - start_time_),
+      ",\"user_cpu_time_us\":",
+      absl::ToInt64Microseconds(total_.user_cpu_time),
+      ",\"system_cpu_time_us\":",
+      absl::ToInt64Microseconds(total_.system_cpu_time),
+      ",\"process_max_rss_delta_kb\":", ReadMaxRssKb() - start_max_rss_kb_,
+      ",\"voluntary_context_switches\":", total_.voluntary_context_switches,
+      ",\"involuntary_context_switches\":",
+      total_.involuntary_context_switches);
+  if (total_.read_bytes >= 0)
+    absl::StrAppend(&json, ",\"read_bytes\":", total_.read_bytes);
+  if (total_.write_bytes >= 0)
+    absl::StrAppend(&json, ",\"write_bytes\":", total_.write_bytes);
+  absl::StrAppend(&json, "}");
+
+  return {.name = kResourceUsageExtensionName, .content_json = json};
+}
+
+}  // namespace ocpdiag::results::internal
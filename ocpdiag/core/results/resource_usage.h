@@ -0,0 +1,85 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_RESULTS_RESOURCE_USAGE_H_
+#define OCPDIAG_CORE_RESULTS_RESOURCE_USAGE_H_
+
+#include <sys/types.h>
+
+#include <cstdint>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/results/data_model/input_model.h"
+
+namespace ocpdiag::results::internal {
+
+// Name of the extension that TestSteps emit their resource usage under.
+constexpr char kResourceUsageExtensionName[] = "ocpdiag_step_resource_usage";
+
+// Resource counters of a single thread.
+struct ResourceCounters {
+  absl::Duration user_cpu_time;
+  absl::Duration system_cpu_time;
+  int64_t voluntary_context_switches = 0;
+  int64_t involuntary_context_switches = 0;
+  // Bytes read from and written to storage, or -1 if unavailable.
+  int64_t read_bytes = -1;
+  int64_t write_bytes = -1;
+};
+
+// Samples the counters of the calling thread. This costs a few system calls.
+ResourceCounters SampleThreadResourceCounters();
+
+// StepResourceUsage totals the resources used by a test step over the threads
+// that work on it. A thread is accounted from EnterThread() to ExitThread(),
+// which must both be called on that thread. Nested calls on the same thread
+// account it once. The peak resident set size is only known for the process as
+// a whole, so the growth of the process peak during the step is reported.
+//
+// This class is thread-safe.
+class StepResourceUsage {
+ public:
+  // Starts the step, accounting the calling thread until End().
+  StepResourceUsage();
+  StepResourceUsage(const StepResourceUsage&) = delete;
+  StepResourceUsage& operator=(const StepResourceUsage&) = delete;
+
+  // Starts and stops accounting the calling thread. These do nothing once the
+  // step has ended.
+  void EnterThread() ABSL_LOCKS_EXCLUDED(mutex_);
+  void ExitThread() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Stops accounting the calling thread, and returns an extension with the
+  // totals. Other threads that have not exited yet cannot be sampled from here,
+  // so their usage is left out and they are counted as unaccounted threads,
+  // e.g. the thread that started the step if it is ended on another thread.
+  Extension End() ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  struct EnteredThread {
+    ResourceCounters start;
+    int depth = 0;
+  };
+
+  void ExitThreadLocked(pid_t thread_id) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const absl::Time start_time_;
+  const int64_t start_max_rss_kb_;
+
+  absl::Mutex mutex_;
+  absl::flat_hash_map<pid_t, EnteredThread> entered_threads_
+      ABSL_GUARDED_BY(mutex_);
+  ResourceCounters total_ ABSL_GUARDED_BY(mutex_);
+  int accounted_threads_ ABSL_GUARDED_BY(mutex_) = 0;
+  bool ended_ ABSL_GUARDED_BY(mutex_) = false;
+};
+
+}  // namespace ocpdiag::results::internal
+
+#endif  // OCPDIAG_CORE_RESULTS_RESOURCE_USAGE_H_
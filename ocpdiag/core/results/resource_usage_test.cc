@@ -0,0 +1,95 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/results/resource_usage.h"
+
+#include <thread>  //
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/results/data_model/input_model.h"
+
+namespace ocpdiag::results::internal {
+
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+namespace {
+
+// Keeps the calling thread on the CPU for a while.
+void Spin(absl::Duration duration) {
+  const absl::Time end = absl::Now() + duration;
+  while (absl::Now() < end) {
+  }
+}
+
+TEST(ResourceUsageTest, ThreadCountersArePopulated) {
+  Spin(absl::Milliseconds(2));
+  ResourceCounters counters = SampleThreadResourceCounters();
+  EXPECT_GT(counters.user_cpu_time + counters.system_cpu_time,
+            absl::ZeroDuration());
+}
+
+TEST(StepResourceUsageTest, ReportsStartingThread) {
+  StepResourceUsage usage;
+  absl::SleepFor(absl::Milliseconds(5));
+  Extension extension = usage.End();
+
+  EXPECT_EQ(extension.name, kResourceUsageExtensionName);
+  EXPECT_THAT(extension.content_json, HasSubstr(R"("scope":"step_threads")"));
+  EXPECT_THAT(extension.content_json,
+              HasSubstr(R"("accounted_threads":1)"));
+  EXPECT_THAT(extension.content_json,
+              HasSubstr(R"("unaccounted_threads":0)"));
+  EXPECT_THAT(extension.content_json, HasSubstr("wall_time_us"));
+  EXPECT_THAT(extension.content_json, HasSubstr("user_cpu_time_us"));
+  EXPECT_THAT(extension.content_json, HasSubstr("process_max_rss_delta_kb"));
+}
+
+TEST(StepResourceUsageTest, TotalsWorkerThreads) {
+  StepResourceUsage usage;
+  std::vector<std::thread> workers;
+  for (int i = 0; i < 2; ++i) {
+    workers.emplace_back([&usage] {
+      usage.EnterThread();
+      usage.EnterThread();
+      Spin(absl::Milliseconds(20));
+      usage.ExitThread();
+      usage.ExitThread();
+    });
+  }
+  for (std::thread& worker : workers) worker.join();
+  Extension extension = usage.End();
+
+  EXPECT_THAT(extension.content_json,
+              HasSubstr(R"("accounted_threads":3)"));
+  EXPECT_THAT(extension.content_json,
+              HasSubstr(R"("unaccounted_threads":0)"));
+  EXPECT_THAT(extension.content_json,
+              Not(HasSubstr(R"("user_cpu_time_us":0,)")));
+}
+
+TEST(StepResourceUsageTest, ThreadsThatHaveNotExitedAreUnaccounted) {
+  StepResourceUsage usage;
+  Extension extension;
+  std::thread([&] {
+    usage.EnterThread();
+    extension = usage.End();
+    usage.ExitThread();
+  }).join();
+
+  EXPECT_THAT(extension.content_json,
+              HasSubstr(R"("accounted_threads":1)"));
+  EXPECT_THAT(extension.content_json,
+              HasSubstr(R"("unaccounted_threads":1)"));
+}
+
+}  // namespace
+
+}  // namespace ocpdiag::results::internal
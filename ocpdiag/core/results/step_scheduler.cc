@@ -0,0 +1,222 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/results/step_scheduler.h"
+
+#include <algorithm>
+#include <string>
+#include <thread>  //
+#include <utility>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "absl/log/log.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/results/data_model/input_model.h"
+#include "ocpdiag/core/results/data_model/output_model.h"
+#include "ocpdiag/core/results/test_run.h"
+#include "ocpdiag/core/results/test_step.h"
+
+namespace ocpdiag::results {
+
+StepScheduler::StepScheduler(TestRun& test_run, Options options)
+    : test_run_(test_run),
+      max_concurrency_(
+          options.max_concurrency > 0
+              ? options.max_concurrency
+              : std::max(1, static_cast<int>(
+                                std::thread::hardware_concurrency()))) {}
+
+StepScheduler::StepHandle StepScheduler::AddStep(
+    absl::string_view name, StepBody body,
+    const std::vector<StepHandle>& dependencies,
+    const std::vector<std::string>& resource_tags) {
+  CHECK(!ran_) << "Steps cannot be added after the scheduler has run";
+  CHECK(body) << "A body must be provided for step \"" << name << "\"";
+  const StepHandle handle = steps_.size();
+  for (StepHandle dependency : dependencies) {
+    CHECK(dependency >= 0 && dependency < handle)
+        << "Step \"" << name
+        << "\" depends on a step that has not been added to the scheduler";
+    steps_[dependency].dependents.push_back(handle);
+  }
+  steps_.push_back({
+      .name = std::string(name),
+      .body = std::move(body),
+      .dependencies = dependencies,
+      .resource_tags = resource_tags,
+      .pending_dependencies = static_cast<int>(dependencies.size()),
+  });
+  return handle;
+}
+
+StepScheduleReport StepScheduler::Run() {
+  CHECK(!ran_) << "A StepScheduler can only be run once";
+  CHECK(test_run_.Started())
+      << "The test run must be started before scheduling steps";
+  ran_ = true;
+
+  const absl::Time start = absl::Now();
+  {
+    absl::MutexLock lock(&mutex_);
+    report_.steps.resize(steps_.size());
+    for (StepHandle handle = 0; handle < StepCount(); ++handle) {
+      report_.steps[handle].name = steps_[handle].name;
+      if (steps_[handle].pending_dependencies == 0)
+        ready_steps_.push_back(handle);
+    }
+  }
+
+  const int worker_count = std::min(max_concurrency_, std::max(StepCount(), 1));
+  std::vector<std::thread> workers;
+  workers.reserve(worker_count);
+  for (int i = 0; i < worker_count; ++i)
+    workers.emplace_back(&StepScheduler::WorkerLoop, this);
+  for (std::thread& worker : workers) worker.join();
+
+  ComputeCriticalPath();
+  absl::MutexLock lock(&mutex_);
+  report_.wall_time = absl::Now() - start;
+  if (!report_.critical_path.empty()) {
+    std::vector<std::string> names;
+    for (StepHandle handle : report_.critical_path)
+      names.push_back(report_.steps[handle].name);
+    ScopedLogRouting routing(test_run_);
+    LOG(INFO) << "Step scheduler finished " << steps_.size() << " steps in "
+              << report_.wall_time << " using " << worker_count
+              << " workers. Critical path (" << report_.critical_path_time
+              << "): " << absl::StrJoin(names, " -> ");
+  }
+  return report_;
+}
+
+void StepScheduler::WorkerLoop() {
+  ScopedLogRouting routing(test_run_);
+  while (true) {
+    StepHandle handle;
+    {
+      absl::MutexLock lock(&mutex_);
+      mutex_.Await(
+          absl::Condition(this, &StepScheduler::HasRunnableStepOrDone));
+      if (finished_steps_ == StepCount()) return;
+      handle = TakeRunnableStep();
+    }
+    ExecuteStep(handle);
+    absl::MutexLock lock(&mutex_);
+    FinishStep(handle);
+  }
+}
+
+bool StepScheduler::HasRunnableStepOrDone() const {
+  if (finished_steps_ == StepCount()) return true;
+  return std::any_of(
+      ready_steps_.begin(), ready_steps_.end(), [this](StepHandle handle) {
+        return std::none_of(steps_[handle].resource_tags.begin(),
+                            steps_[handle].resource_tags.end(),
+                            [this](const std::string& tag) {
+                              return held_resource_tags_.contains(tag);
+                            });
+      });
+}
+
+int StepScheduler::TakeRunnableStep() {
+  // Ready steps are kept in the order they became ready, so the oldest step
+  // whose resources are free is picked first.
+  for (auto it = ready_steps_.begin(); it != ready_steps_.end(); ++it) {
+    const StepNode& step = steps_[*it];
+    if (std::any_of(step.resource_tags.begin(), step.resource_tags.end(),
+                    [this](const std::string& tag) {
+                      return held_resource_tags_.contains(tag);
+                    })) {
+      continue;
+    }
+    StepHandle handle = *it;
+    ready_steps_.erase(it);
+    held_resource_tags_.insert(step.resource_tags.begin(),
+                               step.resource_tags.end());
+    return handle;
+  }
+  LOG(FATAL) << "No runnable step was available";
+}
+
+void StepScheduler::ExecuteStep(StepHandle handle) {
+  StepNode& node = steps_[handle];
+  const std::string failed_dependency = FailedDependency(handle);
+  const absl::Time start = absl::Now();
+  TestStep step(node.name, test_run_);
+  if (failed_dependency.empty()) {
+    node.body(step);
+    step.End();
+  } else {
+    step.AddLog({
+        .severity = LogSeverity::kInfo,
+        .message = absl::StrCat("Skipped because dependency \"",
+                                failed_dependency, "\" did not complete"),
+    });
+    step.Skip();
+  }
+  const absl::Time end = absl::Now();
+
+  absl::MutexLock lock(&mutex_);
+  ScheduledStepTiming& timing = report_.steps[handle];
+  timing.step_id = step.Id();
+  timing.start = start;
+  timing.end = end;
+  timing.status = step.Status();
+}
+
+void StepScheduler::FinishStep(StepHandle handle) {
+  for (const std::string& tag : steps_[handle].resource_tags)
+    held_resource_tags_.erase(tag);
+  for (StepHandle dependent : steps_[handle].dependents) {
+    if (--steps_[dependent].pending_dependencies == 0)
+      ready_steps_.push_back(dependent);
+  }
+  ++finished_steps_;
+}
+
+std::string StepScheduler::FailedDependency(StepHandle handle) {
+  absl::MutexLock lock(&mutex_);
+  for (StepHandle dependency : steps_[handle].dependencies) {
+    if (report_.steps[dependency].status != TestStatus::kComplete)
+      return steps_[dependency].name;
+  }
+  return "";
+}
+
+void StepScheduler::ComputeCriticalPath() {
+  absl::MutexLock lock(&mutex_);
+  if (report_.steps.empty()) return;
+
+  // The critical path ends at the step that finished last, and is traced back
+  // through the dependency that finished last at each step, since that is the
+  // one that gated the step's start.
+  auto ends_before = [this](StepHandle a, StepHandle b) {
+    return report_.steps[a].end < report_.steps[b].end;
+  };
+  StepHandle current = 0;
+  for (StepHandle handle = 1; handle < StepCount(); ++handle)
+    if (ends_before(current, handle)) current = handle;
+
+  std::vector<StepHandle> path = {current};
+  while (!steps_[current].dependencies.empty()) {
+    const std::vector<StepHandle>& dependencies = steps_[current].dependencies;
+    current = *std::max_element(dependencies.begin(), dependencies.end(),
+                                ends_before);
+    path.push_back(current);
+  }
+  std::reverse(path.begin(), path.end());
+  report_.critical_path_time =
+      report_.steps[path.back()].end - report_.steps[path.front()].start;
+  report_.critical_path = std::move(path);
+}
+
+}  // namespace ocpdiag::results
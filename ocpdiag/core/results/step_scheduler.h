@@ -0,0 +1,121 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#ifndef OCPDIAG_CORE_RESULTS_STEP_SCHEDULER_H_
+#define OCPDIAG_CORE_RESULTS_STEP_SCHEDULER_H_
+
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/results/data_model/output_model.h"
+#include "ocpdiag/core/results/test_run.h"
+#include "ocpdiag/core/results/test_step.h"
+
+namespace ocpdiag::results {
+
+// Timing and final status of a single step run by the StepScheduler.
+struct ScheduledStepTiming {
+  std::string name;
+  std::string step_id;
+  absl::Time start;
+  absl::Time end;
+  TestStatus status = TestStatus::kUnknown;
+};
+
+// Summary of a StepScheduler run. Steps are indexed by their StepHandle.
+struct StepScheduleReport {
+  std::vector<ScheduledStepTiming> steps;
+  // Handles of the chain of dependent steps that determined the total wall
+  // time, ordered from the first step to the last.
+  std::vector<int> critical_path;
+  absl::Duration critical_path_time;
+  absl::Duration wall_time;
+};
+
+// Runs TestSteps of a TestRun concurrently on a bounded pool of worker threads.
+//
+// Steps are declared with the steps they depend on and a set of resource tags.
+// A step starts once all of its dependencies have ended, and never runs at the
+// same time as another step sharing one of its resource tags (e.g. "socket0"
+// for steps that need exclusive use of a CPU socket). If a dependency does not
+// complete successfully, the dependent step is emitted as skipped.
+//
+// Example:
+//   StepScheduler scheduler(test_run, {.max_concurrency = 8});
+//   StepScheduler::StepHandle setup = scheduler.AddStep("setup", Setup);
+//   for (const std::string& dimm : dimms) {
+//     scheduler.AddStep(absl::StrCat("check_", dimm), CheckDimm(dimm),
+//                       /*dependencies=*/{setup}, /*resource_tags=*/{dimm});
+//   }
+//   StepScheduleReport report = scheduler.Run();
+class StepScheduler {
+ public:
+  using StepHandle = int;
+  using StepBody = std::function<void(TestStep&)>;
+
+  struct Options {
+    // Maximum number of steps running at once. Zero uses the number of
+    // hardware threads.
+    int max_concurrency = 0;
+  };
+
+  explicit StepScheduler(TestRun& test_run) : StepScheduler(test_run, {}) {}
+  StepScheduler(TestRun& test_run, Options options);
+  StepScheduler(const StepScheduler&) = delete;
+  StepScheduler& operator=(const StepScheduler&) = delete;
+
+  // Declares a step to run. Dependencies must refer to previously added steps,
+  // which keeps the dependency graph acyclic. The body is handed the started
+  // TestStep, which is ended by the scheduler once the body returns.
+  StepHandle AddStep(absl::string_view name, StepBody body,
+                     const std::vector<StepHandle>& dependencies = {},
+                     const std::vector<std::string>& resource_tags = {});
+
+  // Runs all declared steps and blocks until they have ended. The TestRun must
+  // already be started. The critical path is logged to the TestRun and
+  // returned in the report. This can only be called once.
+  StepScheduleReport Run();
+
+ private:
+  struct StepNode {
+    std::string name;
+    StepBody body;
+    std::vector<StepHandle> dependencies;
+    std::vector<StepHandle> dependents;
+    std::vector<std::string> resource_tags;
+    int pending_dependencies = 0;
+  };
+
+  int StepCount() const { return steps_.size(); }
+  void WorkerLoop() ABSL_LOCKS_EXCLUDED(mutex_);
+  bool HasRunnableStepOrDone() const ABSL_SHARED_LOCKS_REQUIRED(mutex_);
+  int TakeRunnableStep() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void ExecuteStep(StepHandle handle) ABSL_LOCKS_EXCLUDED(mutex_);
+  void FinishStep(StepHandle handle) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  std::string FailedDependency(StepHandle handle) ABSL_LOCKS_EXCLUDED(mutex_);
+  void ComputeCriticalPath() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  TestRun& test_run_;
+  const int max_concurrency_;
+  std::vector<StepNode> steps_;
+  bool ran_ = false;
+
+  mutable absl::Mutex mutex_;
+  std::vector<StepHandle> ready_steps_ ABSL_GUARDED_BY(mutex_);
+  std::set<std::string> held_resource_tags_ ABSL_GUARDED_BY(mutex_);
+  int finished_steps_ ABSL_GUARDED_BY(mutex_) = 0;
+  StepScheduleReport report_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace ocpdiag::results
+
+#endif  // OCPDIAG_CORE_RESULTS_STEP_SCHEDULER_H_
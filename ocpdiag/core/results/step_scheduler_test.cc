@@ -0,0 +1,169 @@
+// Copyright 2022 Google LLC
+//
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#include "ocpdiag/core/results/step_scheduler.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "ocpdiag/core/results/data_model/dut_info.h"
+#include "ocpdiag/core/results/data_model/input_model.h"
+#include "ocpdiag/core/results/output_receiver.h"
+#include "ocpdiag/core/results/test_run.h"
+#include "ocpdiag/core/results/test_step.h"
+
+namespace ocpdiag::results {
+
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+
+namespace {
+
+constexpr absl::Duration kWaitTimeout = absl::Seconds(10);
+
+class StepSchedulerTest : public ::testing::Test {
+ protected:
+  StepSchedulerTest()
+      : run_(std::make_unique<TestRun>(
+            TestRunStart{.name = "scheduler_test",
+                         .version = "1.0",
+                         .command_line = "./scheduler_test"},
+            receiver_.MakeArtifactWriter())) {
+    run_->StartAndRegisterDutInfo(std::make_unique<DutInfo>("dut", "id"));
+  }
+
+  // Ends the test run so that all output can be read.
+  OutputModel EndRunAndGetOutput() {
+    run_.reset();
+    return receiver_.GetOutputModel();
+  }
+
+  OutputReceiver receiver_;
+  std::unique_ptr<TestRun> run_;
+};
+
+class StepSchedulerDeathTest : public StepSchedulerTest {};
+
+TEST_F(StepSchedulerTest, IndependentStepsRunConcurrently) {
+  absl::Notification first_started, second_started;
+  StepScheduler scheduler(*run_, {.max_concurrency = 2});
+  scheduler.AddStep("first", [&](TestStep&) {
+    first_started.Notify();
+    EXPECT_TRUE(second_started.WaitForNotificationWithTimeout(kWaitTimeout));
+  });
+  scheduler.AddStep("second", [&](TestStep&) {
+    second_started.Notify();
+    EXPECT_TRUE(first_started.WaitForNotificationWithTimeout(kWaitTimeout));
+  });
+  StepScheduleReport report = scheduler.Run();
+
+  ASSERT_EQ(report.steps.size(), 2);
+  EXPECT_EQ(report.steps[0].status, TestStatus::kComplete);
+  EXPECT_EQ(report.steps[1].status, TestStatus::kComplete);
+  EXPECT_EQ(EndRunAndGetOutput().test_steps.size(), 2);
+}
+
+TEST_F(StepSchedulerTest, DependentStepsRunInOrder) {
+  absl::Mutex mutex;
+  std::vector<std::string> order;
+  auto record = [&](std::string name) {
+    return [&, name](TestStep&) {
+      absl::MutexLock lock(&mutex);
+      order.push_back(name);
+    };
+  };
+  StepScheduler scheduler(*run_, {.max_concurrency = 4});
+  StepScheduler::StepHandle setup = scheduler.AddStep("setup", record("setup"));
+  StepScheduler::StepHandle check =
+      scheduler.AddStep("check", record("check"), {setup});
+  scheduler.AddStep("teardown", record("teardown"), {check});
+  scheduler.Run();
+
+  EXPECT_THAT(order, ElementsAre("setup", "check", "teardown"));
+}
+
+TEST_F(StepSchedulerTest, StepsSharingResourceTagDoNotOverlap) {
+  absl::Mutex mutex;
+  int running = 0;
+  int max_running = 0;
+  auto body = [&](TestStep&) {
+    {
+      absl::MutexLock lock(&mutex);
+      max_running = std::max(max_running, ++running);
+    }
+    absl::SleepFor(absl::Milliseconds(20));
+    absl::MutexLock lock(&mutex);
+    --running;
+  };
+  StepScheduler scheduler(*run_, {.max_concurrency = 4});
+  for (int i = 0; i < 4; ++i) {
+    scheduler.AddStep("socket_step", body, /*dependencies=*/{},
+                      /*resource_tags=*/{"socket0"});
+  }
+  scheduler.Run();
+
+  EXPECT_EQ(max_running, 1);
+}
+
+TEST_F(StepSchedulerTest, FailedDependencySkipsDependentStep) {
+  bool dependent_ran = false;
+  StepScheduler scheduler(*run_, {.max_concurrency = 2});
+  StepScheduler::StepHandle failing =
+      scheduler.AddStep("failing", [](TestStep& step) {
+        step.AddError({.symptom = "bad-thing", .message = "Bad thing"});
+      });
+  scheduler.AddStep(
+      "dependent", [&](TestStep&) { dependent_ran = true; }, {failing});
+  StepScheduleReport report = scheduler.Run();
+
+  EXPECT_FALSE(dependent_ran);
+  EXPECT_EQ(report.steps[0].status, TestStatus::kError);
+  EXPECT_EQ(report.steps[1].status, TestStatus::kSkip);
+  OutputModel output = EndRunAndGetOutput();
+  ASSERT_EQ(output.test_steps.size(), 2);
+  const TestStepModel& dependent =
+      output.test_steps[0].start.name == "dependent" ? output.test_steps[0]
+                                                     : output.test_steps[1];
+  EXPECT_EQ(dependent.end.status, TestStatus::kSkip);
+  ASSERT_EQ(dependent.logs.size(), 1);
+  EXPECT_THAT(dependent.logs[0].message, HasSubstr("\"failing\""));
+}
+
+TEST_F(StepSchedulerTest, ReportsCriticalPath) {
+  auto sleep_for = [](absl::Duration duration) {
+    return [duration](TestStep&) { absl::SleepFor(duration); };
+  };
+  StepScheduler scheduler(*run_, {.max_concurrency = 4});
+  StepScheduler::StepHandle slow =
+      scheduler.AddStep("slow", sleep_for(absl::Milliseconds(100)));
+  StepScheduler::StepHandle fast =
+      scheduler.AddStep("fast", sleep_for(absl::Milliseconds(1)));
+  StepScheduler::StepHandle last =
+      scheduler.AddStep("last", sleep_for(absl::Milliseconds(1)), {slow, fast});
+  StepScheduleReport report = scheduler.Run();
+
+  EXPECT_THAT(report.critical_path, ElementsAre(slow, last));
+  EXPECT_GE(report.critical_path_time, absl::Milliseconds(100));
+  EXPECT_GE(report.wall_time, report.critical_path_time);
+}
+
+TEST_F(StepSchedulerDeathTest, UnknownDependencyCausesDeath) {
+  StepScheduler scheduler(*run_);
+  EXPECT_DEATH(scheduler.AddStep("step", [](TestStep&) {}, {3}),
+               "has not been added");
+}
+
+}  // namespace
+
+}  // namespace ocpdiag::results
@@ -40,6 +40,8 @@ namespace ocpdiag::results {
 
 namespace {
 
+// Guards the TestRun that writes to the default output, i.e. the results file
+// flag and stdout, which can only have one writer.
 ABSL_CONST_INIT absl::Mutex initialization_mutex(absl::kConstInit);
 bool initialized ABSL_GUARDED_BY(initialization_mutex) = false;
 
@@ -48,6 +50,7 @@ bool initialized ABSL_GUARDED_BY(initialization_mutex) = false;
 TestRun::TestRun(const TestRunStart& test_run_start,
                  std::unique_ptr<internal::ArtifactWriter> writer)
     : test_run_start_(test_run_start),
+      uses_default_writer_(writer == nullptr),
       writer_(writer == nullptr
                   ? std::make_unique<internal::ArtifactWriter>(
                         absl::GetFlag(FLAGS_ocpdiag_binary_results_filepath),
@@ -57,7 +60,7 @@ TestRun::TestRun(const TestRunStart& test_run_start,
                   : std::move(writer)),
       result_calculator_(std::make_unique<TestResultCalculator>()),
       log_sink_(*writer_) {
-  CheckAndSetInitializationGuard();
+  if (uses_default_writer_) CheckAndSetInitializationGuard();
   RegisterLogSink();
   ValidateStructOrDie(test_run_start);
   EmitSchemaVersion();
@@ -65,8 +68,8 @@ TestRun::TestRun(const TestRunStart& test_run_start,
 
 void TestRun::CheckAndSetInitializationGuard() {
   absl::MutexLock lock(&initialization_mutex);
-  CHECK(!initialized)
-      << "Only one TestRun object can be active at a time within a program";
+  CHECK(!initialized) << "Only one TestRun object can be active at a time "
+                         "within a program without its own ArtifactWriter";
   initialized = true;
 }
 
@@ -124,7 +127,7 @@ void TestRun::StartAndRegisterDutInfo(std::unique_ptr<DutInfo> dut_info) {
 TestRun::~TestRun() {
   End();
   DeregisterLogSink();
-  UnsetInitializationGuard();
+  if (uses_default_writer_) UnsetInitializationGuard();
 }
 
 void TestRun::End() {
@@ -28,8 +28,10 @@ namespace ocpdiag::results {
 
 // Class that keeps track of the start, end, and status of the test.
 // This class handles emitting test run artifacts. There should only be one
-// TestRun object per test and only one instance of this class can exist at a
-// time.
+// TestRun object per test. Several TestRuns may be active at the same time
+// within a program (e.g. one per DUT in a multi-DUT harness), as long as each
+// one is given its own artifact writer. Only one TestRun at a time may use the
+// default writer, which writes to the results file flag and stdout.
 class TestRun {
  public:
   // Initializes the TestRun with all required TestRunStart information so that
@@ -94,6 +96,8 @@ class TestRun {
   TestResultCalculator& GetResultCalculator() { return *result_calculator_; }
 
  private:
+  friend class ScopedLogRouting;
+
   void CheckAndSetInitializationGuard();
   void RegisterLogSink();
   void EmitSchemaVersion();
@@ -104,6 +108,9 @@ class TestRun {
   void UnsetInitializationGuard();
 
   TestRunStart test_run_start_;
+  // Whether this writes to the default output, which is checked to have a
+  // single TestRun.
+  const bool uses_default_writer_;
   std::unique_ptr<internal::ArtifactWriter> writer_;
   std::unique_ptr<TestResultCalculator> result_calculator_;
   internal::LogSink log_sink_;
@@ -115,6 +122,20 @@ class TestRun {
   bool started_ ABSL_GUARDED_BY(mutex_) = false;
 };
 
+// Routes Abseil logs emitted from the calling thread to the given TestRun only,
+// for as long as this object is in scope. When multiple TestRuns are active,
+// logs from threads without a routing are recorded by every TestRun.
+class ScopedLogRouting {
+ public:
+  explicit ScopedLogRouting(const TestRun& test_run)
+      : routing_(test_run.log_sink_) {}
+  ScopedLogRouting(const ScopedLogRouting&) = delete;
+  ScopedLogRouting& operator=(const ScopedLogRouting&) = delete;
+
+ private:
+  internal::ScopedLogSinkRouting routing_;
+};
+
 }  // namespace ocpdiag::results
 
 #endif  // OCPDIAG_CORE_RESULTS_OCP_TEST_RUN_H_
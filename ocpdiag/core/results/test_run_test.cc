@@ -7,8 +7,11 @@
 #include "ocpdiag/core/results/test_run.h"
 
 #include <memory>
+#include <thread>  //
 
+#include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/log/log.h"
 #include "ocpdiag/core/results/artifact_writer.h"
 #include "ocpdiag/core/results/data_model/dut_info.h"
 #include "ocpdiag/core/results/data_model/input_model.h"
@@ -16,6 +19,8 @@
 
 namespace ocpdiag::results {
 
+using ::testing::HasSubstr;
+
 namespace {
 
 TestRunStart GetExampleTestRunStart() {
@@ -53,12 +58,67 @@ TEST(TestRunTest, SequentialInitilizationSucceeds) {
   TestRun second_test_run(GetExampleTestRunStart());
 }
 
-TEST(TestRunDeathTest, InitializingSecondTestRunCausesDeath) {
+TEST(TestRunDeathTest, InitializingSecondDefaultTestRunCausesDeath) {
   TestRunStart start = GetExampleTestRunStart();
   TestRun first_test_run(start);
   EXPECT_DEATH(TestRun second_test_run(start), "Only one TestRun");
 }
 
+TEST(TestRunTest, TestRunWithWriterCoexistsWithDefaultTestRun) {
+  OutputReceiver receiver;
+  TestRun first_test_run(GetExampleTestRunStart());
+  TestRun second_test_run(GetExampleTestRunStart(),
+                          receiver.MakeArtifactWriter());
+}
+
+TEST(TestRunTest, ConcurrentTestRunsWriteToSeparateOutputs) {
+  OutputReceiver first_receiver;
+  OutputReceiver second_receiver;
+  {
+    TestRunStart first_start = GetExampleTestRunStart();
+    first_start.name = "first_run";
+    TestRunStart second_start = GetExampleTestRunStart();
+    second_start.name = "second_run";
+
+    TestRun first_test_run(first_start, first_receiver.MakeArtifactWriter());
+    TestRun second_test_run(second_start,
+                            second_receiver.MakeArtifactWriter());
+    first_test_run.AddPreStartError(
+        {.symptom = "first-error", .message = "Only in the first run"});
+  }
+
+  TestRunModel first_model = first_receiver.GetOutputModel().test_run;
+  TestRunModel second_model = second_receiver.GetOutputModel().test_run;
+  EXPECT_EQ(first_model.start.name, "first_run");
+  EXPECT_EQ(second_model.start.name, "second_run");
+  EXPECT_EQ(first_model.pre_start_errors.size(), 1);
+  EXPECT_TRUE(second_model.pre_start_errors.empty());
+  EXPECT_EQ(first_model.end.status, TestStatus::kError);
+  EXPECT_EQ(second_model.end.status, TestStatus::kSkip);
+}
+
+TEST(TestRunTest, ScopedLogRoutingSendsLogsToSingleTestRun) {
+  OutputReceiver first_receiver;
+  OutputReceiver second_receiver;
+  {
+    TestRun first_test_run(GetExampleTestRunStart(),
+                           first_receiver.MakeArtifactWriter());
+    TestRun second_test_run(GetExampleTestRunStart(),
+                            second_receiver.MakeArtifactWriter());
+    std::thread worker([&second_test_run] {
+      ScopedLogRouting routing(second_test_run);
+      LOG(INFO) << "routed message";
+    });
+    worker.join();
+  }
+
+  EXPECT_TRUE(first_receiver.GetOutputModel().test_run.pre_start_logs.empty());
+  ASSERT_EQ(second_receiver.GetOutputModel().test_run.pre_start_logs.size(), 1);
+  EXPECT_THAT(
+      second_receiver.GetOutputModel().test_run.pre_start_logs[0].message,
+      HasSubstr("routed message"));
+}
+
 TEST(TestRunTest, AddingErrorBeforeStartSucceeds) {
   OutputReceiver receiver;
   Error error = {.symptom = "really-bad-error",
@@ -6,6 +6,9 @@
 
 #include "ocpdiag/core/results/test_step.h"
 
+#include <memory>
+
+#include "absl/flags/flag.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
 #include "absl/strings/string_view.h"
@@ -15,8 +18,14 @@
 #include "ocpdiag/core/results/data_model/results.pb.h"
 #include "ocpdiag/core/results/data_model/struct_to_proto.h"
 #include "ocpdiag/core/results/data_model/struct_validators.h"
+#include "ocpdiag/core/results/resource_usage.h"
 #include "ocpdiag/core/results/test_run.h"
 
+ABSL_FLAG(bool, ocpdiag_step_resource_usage, false,
+          "If set to true, each test step emits an extension with the "
+          "resources its threads used (wall time, CPU time, context switches, "
+          "storage IO, and the peak RSS growth of the process) when it ends.");
+
 namespace ocpdiag::results {
 
 TestStep::TestStep(absl::string_view name, TestRun& test_run)
@@ -24,6 +33,8 @@ TestStep::TestStep(absl::string_view name, TestRun& test_run)
   CHECK(test_run.Started())
       << "TestSteps must be created after the test run has started";
   EmitStart();
+  if (absl::GetFlag(FLAGS_ocpdiag_step_resource_usage))
+    resource_usage_ = std::make_unique<internal::StepResourceUsage>();
 }
 
 void TestStep::EmitStart() {
@@ -124,9 +135,18 @@ void TestStep::End() {
   if (ended_) return;
   ended_ = true;
   if (status_ == TestStatus::kUnknown) status_ = TestStatus::kComplete;
+  EmitResourceUsage();
   EmitEnd();
 }
 
+void TestStep::EmitResourceUsage() {
+  if (resource_usage_ == nullptr) return;
+  ocpdiag_results_v2_pb::TestStepArtifact proto;
+  *proto.mutable_extension() =
+      internal::StructToProto(resource_usage_->End());
+  AssignIdAndEmitArtifact(proto);
+}
+
 void TestStep::EmitEnd() {
   ocpdiag_results_v2_pb::TestStepArtifact step_proto;
   ocpdiag_results_v2_pb::TestStepEnd* end_proto =
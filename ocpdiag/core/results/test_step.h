@@ -7,20 +7,32 @@
 #ifndef OCPDIAG_CORE_RESULTS_OCP_TEST_STEP_H_
 #define OCPDIAG_CORE_RESULTS_OCP_TEST_STEP_H_
 
+#include <memory>
 #include <string>
 
 #include "absl/base/thread_annotations.h"
+#include "absl/flags/declare.h"
 #include "absl/strings/string_view.h"
 #include "absl/synchronization/mutex.h"
 #include "ocpdiag/core/results/artifact_writer.h"
 #include "ocpdiag/core/results/data_model/input_model.h"
 #include "ocpdiag/core/results/data_model/results.pb.h"
+#include "ocpdiag/core/results/resource_usage.h"
 #include "ocpdiag/core/results/test_run.h"
 
+ABSL_DECLARE_FLAG(bool, ocpdiag_step_resource_usage);
+
 namespace ocpdiag::results {
 
 // A logical subdivision of the TestRun used to emit most of artifacts created
 // during the test.
+//
+// The resources used by the step (wall and CPU time, context switches and
+// storage IO of its threads, and the peak RSS growth of the process) are
+// emitted as an extension just before the TestStepEnd artifact when
+// --ocpdiag_step_resource_usage is set. The thread that creates the step is
+// accounted until End(), and other threads that work on it with a
+// ScopedStepResourceUsage.
 class TestStep {
  public:
   TestStep(absl::string_view name, TestRun& test_run);
@@ -73,9 +85,12 @@ class TestStep {
   TestRun& GetTestRun() { return test_run_; }
 
  private:
+  friend class ScopedStepResourceUsage;
+
   void EmitStart();
   void CheckEndedAndEmitArtifact(
       ocpdiag_results_v2_pb::TestStepArtifact& artifact);
+  void EmitResourceUsage() ABSL_SHARED_LOCKS_REQUIRED(mutex_);
   void EmitEnd() ABSL_SHARED_LOCKS_REQUIRED(mutex_);
   void AssignIdAndEmitArtifact(
       ocpdiag_results_v2_pb::TestStepArtifact& artifact);
@@ -84,11 +99,42 @@ class TestStep {
   TestRun& test_run_;
   std::string id_;
   std::string name_;
+  // Null unless resource usage is enabled.
+  std::unique_ptr<internal::StepResourceUsage> resource_usage_;
   mutable absl::Mutex mutex_;
   TestStatus status_ ABSL_GUARDED_BY(mutex_) = TestStatus::kUnknown;
   bool ended_ ABSL_GUARDED_BY(mutex_) = false;
 };
 
+// Accounts the resources used by the calling thread to a TestStep, for as long
+// as this object is in scope. Use it in the threads that a step hands its work
+// to, e.g.:
+//
+//   workers.emplace_back([&step] {
+//     ScopedStepResourceUsage usage(step);
+//     StressDimm(step);
+//   });
+//
+// It keeps a pointer into the step, so it must not outlive the step. Destroy
+// it before the step ends for the thread's usage to be counted; a thread still
+// in scope when the step ends is reported as unaccounted. This does nothing
+// when resource usage is disabled.
+class ScopedStepResourceUsage {
+ public:
+  explicit ScopedStepResourceUsage(TestStep& step)
+      : usage_(step.resource_usage_.get()) {
+    if (usage_ != nullptr) usage_->EnterThread();
+  }
+  ~ScopedStepResourceUsage() {
+    if (usage_ != nullptr) usage_->ExitThread();
+  }
+  ScopedStepResourceUsage(const ScopedStepResourceUsage&) = delete;
+  ScopedStepResourceUsage& operator=(const ScopedStepResourceUsage&) = delete;
+
+ private:
+  internal::StepResourceUsage* usage_;
+};
+
 }  // namespace ocpdiag::results
 
 #endif  // OCPDIAG_CORE_RESULTS_OCP_TEST_STEP_H_
@@ -8,15 +8,22 @@
 
 #include <memory>
 #include <string>
+#include <thread>  //
 
+#include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/flags/flag.h"
+#include "absl/flags/reflection.h"
 #include "ocpdiag/core/results/data_model/dut_info.h"
 #include "ocpdiag/core/results/data_model/input_model.h"
 #include "ocpdiag/core/results/output_receiver.h"
+#include "ocpdiag/core/results/resource_usage.h"
 #include "ocpdiag/core/results/test_run.h"
 
 namespace ocpdiag::results {
 
+using ::testing::HasSubstr;
+
 namespace {
 
 TestRun MakeTestRun(OutputReceiver& receiver) {
@@ -240,6 +247,70 @@ TEST_F(TestStepTest, CallingEndMultipleTimesEmitsOneEndArtifact) {
   EXPECT_EQ(count, 4);
 }
 
+TEST(TestStepResourceUsageFlagTest, ResourceUsageIsDisabledByDefault) {
+  OutputReceiver receiver;
+  TestRun run = MakeTestRun(receiver);
+  StartTestRun(run);
+  { TestStep step("name", run); }
+
+  ASSERT_EQ(receiver.GetOutputModel().test_steps.size(), 1);
+  EXPECT_TRUE(receiver.GetOutputModel().test_steps[0].extensions.empty());
+}
+
+class TestStepResourceUsageTest : public ::testing::Test {
+ protected:
+  TestStepResourceUsageTest() : run_(MakeTestRun(receiver_)) {
+    absl::SetFlag(&FLAGS_ocpdiag_step_resource_usage, true);
+    StartTestRun(run_);
+  }
+
+  absl::FlagSaver flag_saver_;
+  OutputReceiver receiver_;
+  TestRun run_;
+};
+
+TEST_F(TestStepResourceUsageTest, EndEmitsResourceUsageExtension) {
+  { TestStep step("name", run_); }
+
+  TestStepModel model = receiver_.GetOutputModel().test_steps[0];
+  ASSERT_EQ(model.extensions.size(), 1);
+  EXPECT_EQ(model.extensions[0].name, internal::kResourceUsageExtensionName);
+  EXPECT_THAT(model.extensions[0].content_json, HasSubstr("wall_time_us"));
+  EXPECT_THAT(model.extensions[0].content_json,
+              HasSubstr("voluntary_context_switches"));
+  EXPECT_THAT(model.extensions[0].content_json,
+              HasSubstr(R"("accounted_threads":1)"));
+  EXPECT_THAT(model.extensions[0].content_json,
+              HasSubstr(R"("unaccounted_threads":0)"));
+}
+
+TEST_F(TestStepResourceUsageTest, WorkerThreadsAreAccounted) {
+  {
+    TestStep step("name", run_);
+    std::thread worker([&step] { ScopedStepResourceUsage usage(step); });
+    worker.join();
+  }
+
+  TestStepModel model = receiver_.GetOutputModel().test_steps[0];
+  ASSERT_EQ(model.extensions.size(), 1);
+  EXPECT_THAT(model.extensions[0].content_json,
+              HasSubstr(R"("accounted_threads":2)"));
+  EXPECT_THAT(model.extensions[0].content_json,
+              HasSubstr(R"("unaccounted_threads":0)"));
+}
+
+TEST_F(TestStepResourceUsageTest, StartingThreadIsUnaccountedIfEndedElsewhere) {
+  TestStep step("name", run_);
+  std::thread([&step] { step.End(); }).join();
+
+  TestStepModel model = receiver_.GetOutputModel().test_steps[0];
+  ASSERT_EQ(model.extensions.size(), 1);
+  EXPECT_THAT(model.extensions[0].content_json,
+              HasSubstr(R"("accounted_threads":0)"));
+  EXPECT_THAT(model.extensions[0].content_json,
+              HasSubstr(R"("unaccounted_threads":1)"));
+}
+
 TEST_F(TestStepTest, TestRunCanBeRetrieved) {
   EXPECT_EQ(&run_, &step_.GetTestRun());
 }